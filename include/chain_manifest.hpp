@@ -0,0 +1,152 @@
+#ifndef CHAIN_MANIFEST_HPP
+#define CHAIN_MANIFEST_HPP
+
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "chkpt_writer.hpp"
+
+// First word of a manifest file
+#define MANIFEST_MAGIC "DEDUP_MANIFEST"
+#define MANIFEST_VERSION 1
+
+/** \struct manifest_entry_t
+ *  \brief Where a checkpoint is stored and what it needs to restart
+ */
+typedef struct manifest_entry_t {
+  uint32_t chkpt_id;                  // ID of the checkpoint
+  uint32_t ref_id;                    // ID of the reference checkpoint of its chain
+  std::string path;                   // File holding the checkpoint
+  uint64_t offset;                    // Offset of the checkpoint in the file
+  uint64_t length;                    // Length of the checkpoint in bytes
+  uint64_t datalen;                   // Length of the checkpointed data in bytes
+  std::vector<uint32_t> prior_chkpts; // Prior checkpoints referenced by shifted duplicates
+  std::string digest;                 // Hex digest of the checkpoint bytes
+} manifest_entry_t;
+
+/** \class ChainManifest
+ *  \brief Small text file describing every checkpoint of a chain
+ *
+ *  Each entry records where a checkpoint is stored, its reference checkpoint, the prior
+ *  checkpoints it references, and a digest of its bytes. A restart plans which
+ *  checkpoints to read from the manifest alone, without opening any checkpoint file,
+ *  and checks the bytes it reads against the digests. The manifest is rewritten into a
+ *  temporary file that is renamed over the manifest, so a crash leaves either the old or
+ *  the new manifest, never a partial one. When it is rewritten follows the durability
+ *  policy: with DurableChkpt after every recorded checkpoint, synced; with DurableGroup
+ *  by save, synced, which a GroupCommit calls with every commit; with DurableNone by
+ *  save, not synced. The manifest is also saved when it is destroyed. Entries can be
+ *  recorded from several threads.
+ */
+class ChainManifest {
+  public:
+    /**
+     * Open a manifest, reading its entries if the file exists. Throws
+     * std::ios_base::failure if the file exists but is not a manifest.
+     *
+     * \param filename   Manifest file
+     * \param durability When the manifest is written and whether it is synced
+     */
+    ChainManifest(const std::string& filename, DurabilityPolicy durability=DurableChkpt);
+
+    /// Save entries recorded since the last save
+    ~ChainManifest();
+
+    ChainManifest(const ChainManifest&) = delete;
+    ChainManifest& operator=(const ChainManifest&) = delete;
+
+    /**
+     * Record a checkpoint, replacing any earlier entry with the same ID, and save the
+     * manifest with DurableChkpt. The reference and prior checkpoints are read from the header and prior
+     * table of incremental checkpoints. Full checkpoints are their own reference.
+     *
+     * \param chkpt_id    ID of the checkpoint
+     * \param chkpt       Checkpoint on the Host
+     * \param len         Length of the checkpoint in bytes
+     * \param path        File holding the checkpoint
+     * \param offset      Offset of the checkpoint in the file
+     * \param incremental Whether the checkpoint starts with a header
+     */
+    void record(uint32_t chkpt_id, const uint8_t* chkpt, uint64_t len,
+                const std::string& path, uint64_t offset, bool incremental);
+
+    /**
+     * Read a checkpoint file, which may be split over several files, and record it
+     *
+     * \param chkpt_id    ID of the checkpoint
+     * \param path        Checkpoint file
+     * \param incremental Whether the checkpoint starts with a header
+     */
+    void record_file(uint32_t chkpt_id, const std::string& path, bool incremental);
+
+    /**
+     * Write the manifest to a temporary file, sync it unless the policy is DurableNone,
+     * and rename it over the manifest. Does nothing if no entry was recorded since the
+     * last save. Throws std::ios_base::failure if the manifest cannot be written.
+     */
+    void save();
+
+    /**
+     * Find a checkpoint
+     *
+     * \param chkpt_id ID of the checkpoint
+     * \param entry    Output entry of the checkpoint
+     *
+     * \return Whether the manifest holds the checkpoint
+     */
+    bool find(uint32_t chkpt_id, manifest_entry_t& entry) const;
+
+    /// Entries ordered by checkpoint ID
+    std::vector<manifest_entry_t> entries() const;
+
+    /// One more than the largest checkpoint ID, 0 for an empty manifest
+    uint32_t num_chkpts() const;
+
+    /**
+     * Checkpoints read to restart a checkpoint: its reference and prior checkpoints,
+     * theirs in turn, and every checkpoint between the oldest and newest of them.
+     * Throws std::ios_base::failure if a needed checkpoint is missing.
+     *
+     * \param chkpt_id ID of the checkpoint to restart
+     *
+     * \return IDs of the checkpoints in increasing order
+     */
+    std::vector<uint32_t> restart_plan(uint32_t chkpt_id) const;
+
+    /**
+     * Read the checkpoints of a restart plan on several threads, each from its own file
+     * and offset, and check them against their digests. Throws std::ios_base::failure if
+     * a checkpoint cannot be read or does not match its digest.
+     *
+     * \param chkpt_id    ID of the checkpoint to restart
+     * \param config      Writer configuration used to read striped checkpoints
+     * \param num_threads Number of checkpoints read at the same time
+     *
+     * \return Host checkpoints indexed by ID. Checkpoints outside the plan are empty.
+     */
+    std::vector<Kokkos::View<uint8_t*>::HostMirror> read_plan(uint32_t chkpt_id,
+                                                             const writer_config_t& config,
+                                                             uint32_t num_threads) const;
+
+    /**
+     * Hex digest of checkpoint bytes as stored in the manifest
+     *
+     * \param chkpt Checkpoint on the Host
+     * \param len   Length of the checkpoint in bytes
+     */
+    static std::string digest(const uint8_t* chkpt, uint64_t len);
+
+  private:
+    std::string filename;
+    DurabilityPolicy policy;
+    bool dirty;  // Entries recorded since the last save
+    std::map<uint32_t, manifest_entry_t> chkpts;
+    mutable std::mutex mutex;
+
+    void save_locked();
+};
+
+#endif // CHAIN_MANIFEST_HPP
@@ -0,0 +1,346 @@
+#ifndef CHKPT_CHAIN_HPP
+#define CHKPT_CHAIN_HPP
+
+#include <Kokkos_Core.hpp>
+#include <climits>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include "utils.hpp"
+#include "map_helpers.hpp"
+#include "reference_set.hpp"
+#include "region_map.hpp"
+#include "chkpt_writer.hpp"
+
+// Size of the Host staging buffer used when streaming chunks between checkpoints
+#ifndef CHAIN_STREAM_BUFFER
+#define CHAIN_STREAM_BUFFER (64*1024*1024)
+#endif
+
+// Extension of the file listing the checkpoints a consolidation is replacing. The file
+// exists from the first to the last checkpoint renamed over the chain.
+#define CONSOLIDATE_MARKER_EXT ".consolidating"
+
+/**
+ * Location of a single chunk inside a chain of incremental checkpoints
+ */
+struct ChunkLocation {
+  uint32_t chkpt;   // Index of the checkpoint holding the chunk data
+  uint64_t offset;  // Byte offset of the chunk data within that checkpoint
+
+  ChunkLocation() {
+    chkpt = UINT_MAX;
+    offset = 0;
+  }
+
+  ChunkLocation(uint32_t c, uint64_t o) {
+    chkpt = c;
+    offset = o;
+  }
+};
+
+/**
+ * Bytes of a restarted checkpoint stored contiguously in one checkpoint of the chain
+ */
+struct ChunkRun {
+  uint32_t chkpt;   // Index of the checkpoint holding the bytes
+  uint64_t src;     // Byte offset of the bytes within that checkpoint
+  uint64_t dst;     // Byte offset of the bytes in the restarted data
+  uint64_t len;     // Number of bytes
+
+  ChunkRun() {
+    chkpt = UINT_MAX;
+    src = 0;
+    dst = 0;
+    len = 0;
+  }
+
+  ChunkRun(uint32_t c, uint64_t s, uint64_t d, uint64_t l) {
+    chkpt = c;
+    src = s;
+    dst = d;
+    len = l;
+  }
+};
+
+/**
+ * Host side view of a chain of Basic, List, or Tree incremental checkpoints.
+ * Only the header and metadata of a checkpoint are loaded, and only when a chunk
+ * needs to be resolved through that checkpoint. Chunk data is read on demand so
+ * that partial restarts only touch the bytes they need.
+ * Forward chains reference older checkpoints (ref_id <= chkpt_id). Reverse chains keep 
+ * the newest checkpoint complete and reference newer checkpoints (ref_id > chkpt_id).
+ * Chains seeded from reference datasets start at a reference checkpoint whose chunks
+ * are read from the mapped reference files.
+ */
+class ChkptChain {
+  public:
+    /**
+     * Region of consecutive chunks described by a single metadata entry
+     */
+    struct Region {
+      uint32_t start;     // First chunk covered by the region
+      uint32_t len;       // Number of chunks in the region
+      uint32_t src;       // First occurrence: slot in data section. Shifted duplicate: first source chunk
+      uint32_t src_chkpt; // Checkpoint holding the source (UINT_MAX for first occurrences)
+    };
+
+    /**
+     * Parsed metadata for one incremental checkpoint
+     */
+    struct ChkptMetadata {
+      bool loaded;
+      header_t header;
+      uint64_t data_offset;
+      uint32_t num_slots;          // Number of chunk slots in the data section
+      std::vector<Region> regions; // Sorted by starting chunk
+    };
+
+    /**
+     * Chain backed by incremental checkpoints stored in Host Views
+     *
+     * \param chkpts      Vector of incremental checkpoints stored on the Host
+     * \param tree_layout Whether metadata entries are Merkle tree nodes (Tree) or chunks (Basic/List)
+     */
+    ChkptChain(std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, bool tree_layout);
+
+    /**
+     * Chain backed by incremental checkpoint files
+     *
+     * \param chkpt_files Vector of incremental checkpoint filenames (with extensions)
+     * \param tree_layout Whether metadata entries are Merkle tree nodes (Tree) or chunks (Basic/List)
+     */
+    ChkptChain(std::vector<std::string>& chkpt_files, bool tree_layout);
+
+    ~ChkptChain();
+
+    /**
+     * Load (if necessary) and return the parsed metadata of a checkpoint
+     *
+     * \param chkpt_idx Index of the checkpoint in the chain
+     */
+    ChkptMetadata& metadata(uint32_t chkpt_idx);
+
+    /**
+     * Follow the chain backwards until the checkpoint holding the chunk data is found
+     *
+     * \param chkpt_idx Checkpoint to resolve the chunk for
+     * \param chunk     Chunk index
+     *
+     * \return Location of the chunk data. chkpt is UINT_MAX if the chunk could not be found
+     */
+    ChunkLocation locate(uint32_t chkpt_idx, uint32_t chunk);
+
+    /**
+     * Resolve a byte range of a checkpoint into the runs of bytes to copy from the chain.
+     * Consecutive chunks stored contiguously in the same checkpoint form a single run.
+     * Throws std::ios_base::failure if a chunk is not found in the chain.
+     *
+     * \param chkpt_idx Checkpoint to resolve
+     * \param offset    Byte offset of the range in the restarted data
+     * \param length    Length of the range in bytes (must not run past the end of the data)
+     * \param runs      Output runs in the order of the restarted data
+     */
+    void resolve(uint32_t chkpt_idx, uint64_t offset, uint64_t length, std::vector<ChunkRun>& runs);
+
+    /**
+     * Read bytes from a checkpoint in the chain
+     *
+     * \param chkpt_idx Index of the checkpoint in the chain
+     * \param offset    Byte offset in the checkpoint
+     * \param len       Number of bytes to read
+     * \param dst       Host buffer to read into
+     */
+    void read(uint32_t chkpt_idx, uint64_t offset, uint64_t len, uint8_t* dst);
+
+    /**
+     * Restart a byte range of a checkpoint. Only the chunks overlapping the range are
+     * resolved and only their bytes are read from the chain. Throws std::ios_base::failure
+     * if a chunk of the range is not found in the chain.
+     *
+     * \param chkpt_idx Checkpoint to restart
+     * \param offset    Byte offset of the range in the restarted data
+     * \param length    Length of the range in bytes
+     * \param data      Device View to store the range in, resized if shorter than the range
+     *
+     * \return Time spent copying the range from host to device and restarting the range
+     */
+    std::pair<double,double> restart_range(uint32_t chkpt_idx,
+                                           uint64_t offset,
+                                           uint64_t length,
+                                           Kokkos::View<uint8_t*>& data);
+
+    /**
+     * Restart a multi-region checkpoint into the regions it was made from. Each region is
+     * restarted as a byte range of the logical data directly into its device buffer.
+     *
+     * \param chkpt_idx Checkpoint to restart
+     * \param regions   Regions to restart into, in the order they were checkpointed
+     *
+     * \return Time spent copying the regions from host to device and restarting them
+     */
+    std::pair<double,double> restart_regions(uint32_t chkpt_idx, std::vector<region_t>& regions);
+
+    /**
+     * Restart a checkpoint into a file without holding the data in memory. The data is
+     * gathered through the chain one window at a time and each window is written at its
+     * offset in the file with pwrite while the next window is gathered. Only the metadata
+     * of the chain and two windows are held in Host memory. Throws std::ios_base::failure
+     * if a chunk is not found in the chain.
+     *
+     * \param chkpt_idx Checkpoint to restart
+     * \param fd        File descriptor open for writing
+     * \param budget    Host memory for the two windows in bytes. Each window holds at
+     *                  least one chunk
+     *
+     * \return Number of bytes written. Less than the length of the data if a write failed
+     */
+    uint64_t restart_fd(uint32_t chkpt_idx, int fd, uint64_t budget);
+
+    /**
+     * Restart a checkpoint into a file through the writer of the chain. With the stream
+     * writer this is restart_fd. Otherwise each window is handed to the writer, which
+     * writes it from its own buffer pool while the next window is gathered.
+     *
+     * \param chkpt_idx   Checkpoint to restart
+     * \param output_file File to create
+     * \param budget      Host memory for the windows in bytes, besides the buffer pool
+     *                    of the writer
+     *
+     * \return Number of bytes written. Less than the length of the data if a write failed
+     */
+    uint64_t restart_file(uint32_t chkpt_idx, const std::string& output_file, uint64_t budget);
+
+    /**
+     * Set how consolidated checkpoints, reverse deltas, and restarted files are written
+     *
+     * \param config Writer configuration
+     */
+    void set_writer_config(const writer_config_t& config) {
+      writer_config = config;
+    }
+
+    /**
+     * Consolidate the chain into a new self-contained baseline at baseline_idx and rewrite
+     * the checkpoints after it so that they only reference the new baseline or later
+     * checkpoints. Chunks are streamed from the chain without restarting the data.
+     * Checkpoints before baseline_idx are not written. Only applies to forward chains.
+     *
+     * \param baseline_idx Checkpoint to turn into the new baseline
+     * \param output_files Output filenames indexed the same as the chain. Must not be the
+     *                     files the chain is reading from
+     *
+     * \return Number of bytes written
+     */
+    uint64_t consolidate(uint32_t baseline_idx, std::vector<std::string>& output_files);
+
+    /**
+     * Consolidate the chain into a new self-contained baseline at baseline_idx and store
+     * the rewritten checkpoints in Host Views.
+     *
+     * \param baseline_idx  Checkpoint to turn into the new baseline
+     * \param output_chkpts Output checkpoints indexed the same as the chain
+     *
+     * \return Number of bytes written
+     */
+    uint64_t consolidate(uint32_t baseline_idx, std::vector<Kokkos::View<uint8_t*>::HostMirror>& output_chkpts);
+
+    /**
+     * Check whether a checkpoint is a reverse delta, i.e. its unchanged chunks are stored
+     * in the next (newer) checkpoint of the chain instead of the previous one
+     *
+     * \param chkpt_idx Index of the checkpoint in the chain
+     */
+    bool reverse(uint32_t chkpt_idx);
+
+    /**
+     * Check whether a checkpoint is a reference checkpoint, i.e. it names the reference
+     * datasets a chain was seeded from instead of storing data. Its reference files are
+     * mapped the first time it is read.
+     *
+     * \param chkpt_idx Index of the checkpoint in the chain
+     */
+    bool reference(uint32_t chkpt_idx);
+
+    /**
+     * Check whether the chain of a forward checkpoint starts at a reference checkpoint
+     *
+     * \param chkpt_idx Index of the checkpoint in the chain
+     */
+    bool seeded(uint32_t chkpt_idx);
+
+    /**
+     * Restart a whole checkpoint through the chain. Works for forward and reverse chains.
+     *
+     * \param chkpt_idx Checkpoint to restart
+     * \param data      Device View to store the checkpoint in
+     *
+     * \return Time spent copying the data from host to device and restarting the checkpoint
+     */
+    std::pair<double,double> restart(uint32_t chkpt_idx, Kokkos::View<uint8_t*>& data);
+
+    /**
+     * Rewrite a checkpoint as a reverse delta against the next checkpoint in the chain.
+     * Chunks identical to the chunk at the same offset in the next checkpoint are dropped,
+     * chunks found elsewhere in the same or the next checkpoint become shifted duplicates,
+     * and all other chunks are stored as first occurrences.
+     *
+     * \param chkpt_idx   Checkpoint to rewrite. The next checkpoint must be in the chain
+     * \param output_file Output filename. Must not be a file the chain is reading from
+     *
+     * \return Number of bytes written
+     */
+    uint64_t reverse_delta(uint32_t chkpt_idx, std::string& output_file);
+
+    /**
+     * Rewrite a checkpoint as a reverse delta against the next checkpoint in the chain
+     * and store it in a Host View.
+     *
+     * \param chkpt_idx    Checkpoint to rewrite. The next checkpoint must be in the chain
+     * \param output_chkpt Output checkpoint
+     *
+     * \return Number of bytes written
+     */
+    uint64_t reverse_delta(uint32_t chkpt_idx, Kokkos::View<uint8_t*>::HostMirror& output_chkpt);
+
+    uint64_t bytes_read() const { return num_bytes_read; }
+
+  private:
+    bool tree;
+    writer_config_t writer_config = default_writer_config();
+    std::vector<Kokkos::View<uint8_t*>::HostMirror> views;
+    std::vector<std::string> files;
+    std::vector<std::unique_ptr<std::ifstream>> streams;
+    std::vector<ChkptMetadata> chain;
+    std::vector<std::unique_ptr<ReferenceSet>> refs; // Mapped files of reference checkpoints
+    std::vector<std::vector<uint8_t>> ref_chkpts;    // Raw reference checkpoints
+    uint64_t num_bytes_read;
+
+    uint32_t size() const;
+
+    bool load_reference(uint32_t chkpt_idx, const header_t& header);
+
+    void read_metadata(uint32_t chkpt_idx, 
+                       header_t& header,
+                       std::vector<uint32_t>& first_ocur, 
+                       std::vector<uint32_t>& shift_dupl, 
+                       std::vector<uint32_t>& shift_src);
+
+    void gather(uint32_t chkpt_idx, uint64_t offset, uint64_t length, uint8_t* dst);
+
+    uint64_t write_chunks(uint32_t chkpt_idx, uint32_t start, uint32_t len, std::ostream& out);
+
+    uint64_t copy_bytes(uint32_t chkpt_idx, uint64_t offset, uint64_t len, std::ostream& out);
+
+    uint64_t write_consolidated(uint32_t baseline_idx, uint32_t chkpt_idx, std::ostream& out);
+
+    void digest_chunks(uint32_t chkpt_idx, std::vector<HashDigest>& digests);
+
+    uint64_t write_reverse_delta(uint32_t chkpt_idx, std::ostream& out);
+};
+
+#endif // CHKPT_CHAIN_HPP
@@ -0,0 +1,161 @@
+#ifndef CHKPT_PACK_HPP
+#define CHKPT_PACK_HPP
+
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// "DEDUPPAK" marks the trailer of a pack file
+#define PACK_MAGIC 0x4b41505055444544ULL
+// "DEDUPREC" marks the write-ahead record of a checkpoint in a pack file
+#define PACK_RECORD_MAGIC 0x4345525055444544ULL
+// Version 2 writes a record ahead of each checkpoint, version 3 a digest of the index
+// ahead of the trailer. Version 1 and 2 packs are still read.
+#define PACK_VERSION 3
+// Bytes of the index digest between the index and the trailer, from version 3 on
+#define PACK_INDEX_DIGEST_SIZE 16
+// Alignment of the checkpoints in a pack file
+#define PACK_ALIGNMENT 64
+// Bytes taken by a record, the checkpoint follows it
+#define PACK_RECORD_SIZE 64
+// Entry flag of checkpoints with a record
+#define PACK_ENTRY_RECORD 1
+
+// Location of a checkpoint in a pack file
+typedef struct pack_entry_t {
+  uint32_t chkpt_id;  // ID of the checkpoint
+  uint32_t flags;     // PACK_ENTRY_RECORD if a record precedes the checkpoint
+  uint64_t offset;    // Offset of the checkpoint in the pack file
+  uint64_t length;    // Length of the checkpoint in bytes
+} pack_entry_t;
+
+// Written ahead of each checkpoint so that a checkpoint torn by a crash is detected
+typedef struct pack_record_t {
+  uint64_t magic;       // PACK_RECORD_MAGIC
+  uint32_t chkpt_id;    // ID of the checkpoint
+  uint32_t version;     // PACK_VERSION
+  uint64_t length;      // Length of the checkpoint in bytes
+  uint8_t digest[16];   // Digest of the checkpoint
+} pack_record_t;
+
+// Last bytes of a pack file, locates the index. From version 3 on the index is followed
+// by its digest and then the trailer.
+typedef struct pack_trailer_t {
+  uint64_t index_offset;  // Offset of the index in the pack file
+  uint32_t num_entries;   // Number of index entries
+  uint32_t version;       // PACK_VERSION
+  uint64_t magic;         // PACK_MAGIC
+} pack_trailer_t;
+
+/** \class ChkptPack
+ *  \brief Append-only file holding a chain of checkpoints
+ *
+ *  Checkpoints are appended one after another and a trailing index maps each checkpoint
+ *  ID to the offset and length of the checkpoint. Each append writes the checkpoint over
+ *  the previous index and writes the new index, its digest, and the trailer after it, so
+ *  the pack always ends with the index of every checkpoint in it. When a checkpoint ID is appended again
+ *  the latest copy is used. Checkpoints are read by mapping their extent of the file.
+ *
+ *  Each checkpoint is preceded by a write-ahead record with its ID, length, and digest.
+ *  A crash during an append leaves either a pack whose last checkpoint does not match
+ *  its record, or a pack without a valid index. A short checkpoint can overwrite the
+ *  start of a longer old index and leave its trailer in place, so an index is only used
+ *  when it matches its digest and every entry lies in order before it. Opening the pack
+ *  detects both: the torn checkpoint is dropped, the index is rebuilt from the records
+ *  when it is lost, and the pack is usable again with every complete checkpoint.
+ */
+class ChkptPack {
+  public:
+    /**
+     * Open a pack file, dropping a torn last checkpoint. A writable pack is rewritten
+     * without it. Throws std::ios_base::failure if the file cannot be opened or is not a
+     * pack file.
+     *
+     * \param filename Pack file
+     * \param writable Open for appending, creating the pack if it does not exist
+     */
+    ChkptPack(const std::string& filename, bool writable);
+
+    /// Unmap the checkpoints and close the file. Views of the pack become invalid.
+    ~ChkptPack();
+
+    ChkptPack(const ChkptPack&) = delete;
+    ChkptPack& operator=(const ChkptPack&) = delete;
+
+    /**
+     * Append a checkpoint and rewrite the index. Throws std::ios_base::failure if the
+     * pack cannot be written.
+     *
+     * \param chkpt_id ID of the checkpoint
+     * \param data     Checkpoint on the Host
+     * \param len      Length of the checkpoint in bytes
+     *
+     * \return Index entry locating the checkpoint in the pack
+     */
+    pack_entry_t append(uint32_t chkpt_id, const uint8_t* data, uint64_t len);
+
+    /**
+     * Find a checkpoint in the index
+     *
+     * \param chkpt_id ID of the checkpoint
+     * \param entry    Output location of the latest copy of the checkpoint
+     *
+     * \return Whether the pack holds the checkpoint
+     */
+    bool find(uint32_t chkpt_id, pack_entry_t& entry) const;
+
+    /**
+     * Map a checkpoint of the pack. Only the pages of the checkpoint are mapped and
+     * they are read from the file when the view is first accessed. The mapping is
+     * private, writes to the view do not reach the file. Throws std::ios_base::failure
+     * if the pack does not hold the checkpoint.
+     *
+     * \param chkpt_id ID of the checkpoint
+     *
+     * \return Unmanaged Host view of the checkpoint, valid as long as the pack is open
+     */
+    Kokkos::View<uint8_t*>::HostMirror view(uint32_t chkpt_id);
+
+    /// Index entries in the order the checkpoints were appended
+    const std::vector<pack_entry_t>& entries() const {
+      return index;
+    }
+
+    /// Size of the pack file in bytes
+    uint64_t size() const {
+      return file_len;
+    }
+
+    /**
+     * Whether opening the pack dropped a torn checkpoint
+     *
+     * \param chkpt_id Output ID of the torn checkpoint
+     */
+    bool torn(uint32_t& chkpt_id) const {
+      chkpt_id = torn_id;
+      return has_torn;
+    }
+
+  private:
+    void write_index();
+    bool valid_index(const pack_trailer_t& trailer);
+    bool read_record(uint64_t record_offset, pack_record_t& record);
+    bool matches_record(const pack_record_t& record, uint64_t offset);
+    bool recover();
+
+    std::string filename;
+    int fd;
+    bool writable;
+    std::vector<pack_entry_t> index;
+    uint64_t data_end;  // End of the last checkpoint
+    uint64_t file_len;
+    bool has_torn;
+    uint32_t torn_id;
+    std::map<uint32_t, Kokkos::View<uint8_t*>::HostMirror> views;
+    std::vector<std::pair<void*, uint64_t>> maps;
+};
+
+#endif // CHKPT_PACK_HPP
@@ -0,0 +1,106 @@
+#ifndef CHKPT_PREFETCH_HPP
+#define CHKPT_PREFETCH_HPP
+
+#include <Kokkos_Core.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chkpt_writer.hpp"
+
+// Host memory held by checkpoints read ahead of the restart
+#ifndef PREFETCH_BUFFER
+#define PREFETCH_BUFFER (256*1024*1024)
+#endif
+
+/** \class ChkptPrefetcher
+ *  \brief Reads the checkpoint files of a restart ahead of the restart kernels
+ *
+ *  The checkpoints are read whole by a pool of threads in the order the restart
+ *  consumes them, so reading the next checkpoints overlaps restarting the current one.
+ *  Checkpoints are read ahead only while the buffered checkpoints fit the memory budget,
+ *  and a checkpoint the restart waits for is read even if it does not fit. Each
+ *  checkpoint should be released once the restart no longer needs its Host buffer.
+ */
+class ChkptPrefetcher {
+  public:
+    typedef Kokkos::View<uint8_t*, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged> > HostBuffer;
+
+    /**
+     * Start reading checkpoints with config.stripe_threads threads. Throws
+     * std::ios_base::failure if a checkpoint appears more than once in the order.
+     *
+     * \param chkpt_files Checkpoint files indexed by checkpoint ID
+     * \param order       IDs of the checkpoints to read, in the order they are used
+     * \param config      Writer configuration used to read the checkpoints
+     * \param max_bytes   Host memory for checkpoints read but not yet released
+     */
+    ChkptPrefetcher(const std::vector<std::string>& chkpt_files,
+                    const std::vector<uint32_t>& order,
+                    const writer_config_t& config,
+                    uint64_t max_bytes=PREFETCH_BUFFER);
+
+    /// Stop reading ahead and wait for the reads in flight
+    ~ChkptPrefetcher();
+
+    ChkptPrefetcher(const ChkptPrefetcher&) = delete;
+    ChkptPrefetcher& operator=(const ChkptPrefetcher&) = delete;
+
+    /**
+     * Wait until a checkpoint is read. Throws std::ios_base::failure if the checkpoint is
+     * not part of the order, or else the error that stopped it from being read.
+     *
+     * \param chkpt_id ID of the checkpoint
+     *
+     * \return Host buffer with the whole checkpoint, valid until it is released
+     */
+    HostBuffer get(uint32_t chkpt_id);
+
+    /**
+     * Free the Host buffer of a checkpoint so later checkpoints can be read ahead
+     *
+     * \param chkpt_id ID of the checkpoint
+     */
+    void release(uint32_t chkpt_id);
+
+    /// Seconds the restart waited for checkpoints that were not read yet
+    double wait_time() const;
+
+    /// Bytes read so far
+    uint64_t bytes_read() const;
+
+  private:
+    struct Item {
+      uint32_t chkpt_id;
+      std::string filename;
+      uint64_t size;
+      std::unique_ptr<uint8_t[]> data;
+      bool ready;
+      bool released;
+      std::exception_ptr error;
+    };
+
+    void read_ahead();
+
+    writer_config_t config;
+    uint64_t max_bytes;
+    std::vector<Item> items;            // Checkpoints in the order they are used
+    std::map<uint32_t, uint64_t> index; // Position of each checkpoint in items
+    uint64_t next;                      // Next item to read
+    uint64_t demanded;                  // Items up to here are read regardless of the budget
+    uint64_t buffered;                  // Bytes of items read or in flight, not released
+    uint64_t num_read;
+    double wait_seconds;
+    bool stop;
+    std::vector<std::thread> threads;
+    mutable std::mutex mutex;
+    std::condition_variable can_read;
+    std::condition_variable item_ready;
+};
+
+#endif // CHKPT_PREFETCH_HPP
@@ -0,0 +1,76 @@
+#ifndef CHKPT_SINK_HPP
+#define CHKPT_SINK_HPP
+
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <string>
+#include "chkpt_writer.hpp"
+#include "striped_io.hpp"
+
+/** \class ChkptSink
+ *  \brief Output file of a checkpoint
+ *
+ *  When the default execution space can access Host memory the checkpoint is gathered
+ *  straight into the file. The file is allocated to the final size of the checkpoint and
+ *  mapped, and the gather kernels write the header, metadata, and chunks into the
+ *  mapping, so the checkpoint is never copied to the Host or through the file stream.
+ *  Otherwise, or when the file cannot be mapped, the checkpoint is gathered on the
+ *  device as usual and written from the Host copy. Files are only mapped with the
+ *  stream writer, other writers always write from the Host copy. The striped writer
+ *  writes stripes of the Host copy concurrently and can split the file.
+ */
+class ChkptSink {
+  public:
+    /// Whether kernels of the default execution space can write into a mapped file
+    static constexpr bool zero_copy = 
+      Kokkos::SpaceAccessibility<Kokkos::DefaultExecutionSpace, Kokkos::HostSpace>::accessible;
+
+    /**
+     * Output sink for a checkpoint file. The file is not created until it is mapped or
+     * written.
+     *
+     * \param filename    Checkpoint file
+     * \param config      How the file is written
+     * \param split_files Whether the striped writer may split the file over several files
+     */
+    ChkptSink(const std::string& filename, const writer_config_t& config, bool split_files=false);
+
+    /// Unmap and close the file
+    ~ChkptSink();
+
+    ChkptSink(const ChkptSink&) = delete;
+    ChkptSink& operator=(const ChkptSink&) = delete;
+
+    /**
+     * Create the file with its final size and map it. Throws std::ios_base::failure if
+     * the blocks of the file cannot be allocated, e.g. when the file system is full.
+     *
+     * \param size Size of the checkpoint in bytes
+     *
+     * \return Pointer to the mapped file, or NULL if the checkpoint has to be gathered
+     *         on the device
+     */
+    uint8_t* map(uint64_t size);
+
+    /// Whether the checkpoint was gathered into the file
+    bool mapped() const {
+      return map_ptr != NULL;
+    }
+
+    /**
+     * Write the checkpoint to the file unless it was gathered into the mapping
+     *
+     * \param diff_h Checkpoint on the Host
+     */
+    void write(const Kokkos::View<uint8_t*>::HostMirror& diff_h);
+
+  private:
+    std::string filename;
+    writer_config_t writer_config;
+    bool split;
+    int fd;
+    uint8_t* map_ptr;
+    uint64_t map_len;
+};
+
+#endif // CHKPT_SINK_HPP
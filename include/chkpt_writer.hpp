@@ -0,0 +1,201 @@
+#ifndef CHKPT_WRITER_HPP
+#define CHKPT_WRITER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Alignment of buffers, offsets, and lengths of O_DIRECT writes
+#define WRITER_ALIGNMENT 4096
+
+enum WriterBackend {
+  WriterStream,   // Single buffered stream, or a mapped file when kernels can write to it
+  WriterThreads,  // Pool of threads issuing pwrite
+  WriterUring,    // io_uring, falls back to the thread pool when unavailable
+  WriterStriped   // Stripes of the Host checkpoint written concurrently with pwrite
+};
+
+enum DurabilityPolicy {
+  DurableNone,    // Leave checkpoints in the page cache, the file system writes them back
+  DurableChkpt,   // Sync every checkpoint before the next one is made
+  DurableGroup    // Sync checkpoints in groups of group_chkpts or every group_seconds
+};
+
+// How checkpoint files are written
+typedef struct writer_config_t {
+  WriterBackend backend;  // Writer backend
+  bool direct;            // Bypass the page cache with O_DIRECT
+  uint32_t queue_depth;   // Number of writes in flight and of pool buffers
+  uint64_t block_size;    // Size of each write and pool buffer in bytes
+  uint32_t stripe_threads;              // Threads writing or reading stripes
+  uint64_t stripe_size;                 // Size of each stripe in bytes
+  uint32_t stripe_files;                // Number of files the stripes are spread over
+  std::vector<std::string> stripe_dirs; // Directories of the stripe files besides the
+                                        // directory of the checkpoint
+  DurabilityPolicy durability;          // When written checkpoints are synced
+  uint32_t group_chkpts;                // Checkpoints per group commit, 0 for no limit
+  double group_seconds;                 // Seconds between group commits, 0 for no limit
+} writer_config_t;
+
+/**
+ * Default writer configuration, a single buffered stream
+ */
+writer_config_t default_writer_config();
+
+/**
+ * Read the writer flags of the command line tools
+ *   --writer threads|uring|striped : Writer backend
+ *   --direct-io                    : Bypass the page cache
+ *   --io-depth N                   : Number of writes in flight
+ *   --io-block B                   : Size of each write in bytes
+ *   --stripe-threads N             : Threads writing or reading stripes
+ *   --stripe-size B                : Size of each stripe in bytes
+ *   --stripe-files N               : Number of files the stripes are spread over
+ *   --stripe-dir DIR               : Directory for stripe files, can be repeated
+ *   --durability none|chkpt|group  : When written checkpoints are synced
+ *   --group-chkpts N               : Checkpoints per group commit
+ *   --group-seconds T              : Seconds between group commits
+ *
+ * \param argc Number of arguments
+ * \param argv Arguments
+ *
+ * \return Writer configuration, the default one for flags that are not given
+ */
+writer_config_t get_writer_config(int argc, char** argv);
+
+/// Name of a writer backend
+const char* writer_backend_name(WriterBackend backend);
+
+/// Name of a durability policy
+const char* durability_name(DurabilityPolicy policy);
+
+/**
+ * Write a whole buffer at an offset, retrying interrupted and short writes. Writes to
+ * emulated files opened with storage_open pay the cost of the emulated storage.
+ *
+ * \return Whether all bytes were written
+ */
+bool pwrite_all(int fd, const uint8_t* buf, uint64_t len, uint64_t offset);
+
+/**
+ * Read a whole range at an offset, retrying interrupted and short reads. Reads of
+ * emulated files opened with storage_open pay the cost of the emulated storage.
+ *
+ * \return Whether all bytes were read
+ */
+bool pread_all(int fd, uint8_t* buf, uint64_t len, uint64_t offset);
+
+/**
+ * Replace a small file atomically: the contents are written to filename.tmp, which is
+ * renamed over the file, so a crash leaves either the old or the new file. Throws
+ * std::ios_base::failure if the file cannot be written.
+ *
+ * \param filename File to replace
+ * \param data     New contents
+ * \param len      Length of the new contents in bytes
+ * \param sync     Whether to sync the contents before the rename and the directory after
+ */
+void replace_file(const std::string& filename, const uint8_t* data, uint64_t len, bool sync);
+
+class WriteQueue;
+
+/** \class ChkptWriter
+ *  \brief Asynchronous sequential writer for checkpoint files
+ *
+ *  Data is staged into a pool of aligned buffers of block_size bytes. Each full buffer
+ *  is written at its offset in the file while the next one is filled, with up to
+ *  queue_depth writes in flight. With io_uring the pool is registered with the ring
+ *  when the memory lock limit allows it. With O_DIRECT the last buffer is padded to the
+ *  alignment and the file is truncated to its real size on close. Files on file systems
+ *  that do not support O_DIRECT are written through the page cache.
+ */
+class ChkptWriter {
+  public:
+    /**
+     * Create or truncate a file for writing
+     *
+     * \param filename File to write
+     * \param config   Writer configuration. The stream backend writes with one thread and
+     *                 the striped backend with the thread pool.
+     */
+    ChkptWriter(const std::string& filename, const writer_config_t& config);
+
+    /// Wait for writes in flight and close the file without reporting errors
+    ~ChkptWriter();
+
+    ChkptWriter(const ChkptWriter&) = delete;
+    ChkptWriter& operator=(const ChkptWriter&) = delete;
+
+    /**
+     * Append data to the file. The data is copied and can be reused on return.
+     *
+     * \param data Data to write
+     * \param len  Length of the data in bytes
+     */
+    void write(const uint8_t* data, uint64_t len);
+
+    /**
+     * Write the remaining data, wait for all writes, and close the file. Throws
+     * std::ios_base::failure if any write failed.
+     *
+     * \return Number of bytes written
+     */
+    uint64_t close();
+
+    /// Backend in use, after falling back
+    WriterBackend backend() const {
+      return active_backend;
+    }
+
+    /// Whether the file is written with O_DIRECT
+    bool direct() const {
+      return direct_io;
+    }
+
+  private:
+    void submit_current();
+    void reap_one();
+
+    std::string filename;
+    int fd;
+    WriterBackend active_backend;
+    bool direct_io;
+    uint64_t block_size;
+    std::vector<uint8_t*> buffers;
+    std::vector<uint32_t> free_slots;
+    uint32_t in_flight;
+    uint32_t cur_slot;
+    uint64_t cur_fill;
+    uint64_t file_offset; // Offset of the buffer being filled
+    int error;
+    std::unique_ptr<WriteQueue> queue;
+};
+
+/** \class WriterStreamBuf
+ *  \brief Output stream buffer that appends to a ChkptWriter
+ */
+class WriterStreamBuf : public std::streambuf {
+  public:
+    WriterStreamBuf(ChkptWriter& writer) : out(writer) {}
+
+  protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+      out.write(reinterpret_cast<const uint8_t*>(s), static_cast<uint64_t>(n));
+      return n;
+    }
+
+    int_type overflow(int_type c) override {
+      if(c != traits_type::eof()) {
+        uint8_t byte = static_cast<uint8_t>(c);
+        out.write(&byte, 1);
+      }
+      return traits_type::not_eof(c);
+    }
+
+  private:
+    ChkptWriter& out;
+};
+
+#endif // CHKPT_WRITER_HPP
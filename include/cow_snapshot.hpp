@@ -0,0 +1,103 @@
+#ifndef COW_SNAPSHOT_HPP
+#define COW_SNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Maximum number of snapshots that can be taken at the same time
+#ifndef MAX_COW_SNAPSHOTS
+#define MAX_COW_SNAPSHOTS 16
+#endif
+
+/** \class CowSnapshot
+ *  \brief Copy-on-write snapshot of Host memory
+ *
+ *  The pages holding the data are write protected when the snapshot is taken. Reads of
+ *  the snapshot copy from the live pages and lift the protection of each page once all
+ *  of its bytes have been read. A write to a page that has not been read yet faults,
+ *  the fault handler copies the page to a shadow buffer and lifts the protection so the
+ *  write can proceed. Only pages written before they are read are ever copied. A fault
+ *  never waits for a read: a read that overlaps the copy of its page reads the page
+ *  again from the shadow buffer.
+ *
+ *  Faults are caught with a process wide SIGSEGV handler, installed by the first active
+ *  snapshot and replaced by the previous handler when the last one ends. Faults outside
+ *  of every snapshot are passed on to the previous handler. The data must be Host
+ *  memory and buffers that snapshots are read into must not share pages with the data.
+ *
+ *  Only writes by the CPU fault. System calls that write into protected pages, such as
+ *  read() or recv(), fail with EFAULT instead, and device copies into the pages fail
+ *  too. Such data must be received into a separate buffer and copied into the pages
+ *  while a snapshot is active.
+ */
+class CowSnapshot {
+  public:
+    /**
+     * Write protect the data and start the snapshot
+     *
+     * \param data_ptr Host pointer to the data
+     * \param len      Length of the data in bytes
+     */
+    CowSnapshot(uint8_t* data_ptr, uint64_t len);
+
+    /**
+     * Lift the protection of pages that were not read and drop the shadow pages
+     */
+    ~CowSnapshot();
+
+    CowSnapshot(const CowSnapshot&) = delete;
+    CowSnapshot& operator=(const CowSnapshot&) = delete;
+
+    /**
+     * Copy part of the snapshot. Parts must be read in increasing order and each byte
+     * read at most once.
+     *
+     * \param offset Offset of the part in bytes
+     * \param len    Length of the part in bytes
+     * \param dst    Host buffer of len bytes
+     */
+    void read(uint64_t offset, uint64_t len, uint8_t* dst);
+
+    /// Length of the data in bytes
+    uint64_t size() const {
+      return data_len;
+    }
+
+    /// Number of pages copied because they were written before being read
+    uint64_t pages_copied() const {
+      return num_copied.load();
+    }
+
+    /**
+     * Handle a write fault
+     *
+     * \param addr Faulting address
+     *
+     * \return Whether the address belongs to the snapshot
+     */
+    bool handle_fault(uintptr_t addr);
+
+  private:
+    /// State of each page of the snapshot
+    enum PageState : uint8_t {
+      PROTECTED = 0,  // Write protected, snapshot data in the live page
+      COPYING = 1,    // Write protected and being copied by the fault handler
+      COPIED = 2,     // Writable, snapshot data in the shadow page
+      RELEASED = 3    // Writable once its protection is lifted, page has been read
+    };
+
+    void unprotect(uint64_t first_page, uint64_t num_pages);
+
+    uint8_t* data_ptr;
+    uint64_t data_len;
+    uint64_t page_size;
+    uint8_t* pages_begin;   // First page overlapping the data
+    uint64_t num_pages;
+    uint8_t* shadow;        // Reserved copy of the pages, only touched when copied
+    std::unique_ptr<std::atomic<uint8_t>[]> states;
+    std::atomic<uint64_t> num_copied;
+    uint32_t slot;          // Slot in the table of active snapshots
+};
+
+#endif // COW_SNAPSHOT_HPP
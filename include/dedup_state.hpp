@@ -0,0 +1,63 @@
+#ifndef DEDUP_STATE_HPP
+#define DEDUP_STATE_HPP
+
+#include <Kokkos_Core.hpp>
+#include <string>
+#include <vector>
+#include "utils.hpp"
+#include "map_helpers.hpp"
+
+#define DEDUP_STATE_VERSION 1
+
+/**
+ * Write the state of a deduplicator to a file. The file holds the state header, the
+ * digests of the list or tree, and the entries of the first occurrence index. The
+ * state is written to filename.tmp and renamed over the file, so an existing state is
+ * kept if the write fails. Throws std::ios_base::failure if the file cannot be written.
+ *
+ * \param filename    File to write
+ * \param header      State header, num_digests and num_entries are filled in
+ * \param digests     List or tree digests on the device
+ * \param num_digests Number of digests to save
+ * \param index       First occurrence index, empty for approaches without one
+ */
+void write_dedup_state(const std::string& filename,
+                       state_header_t& header,
+                       const Kokkos::View<HashDigest*>& digests,
+                       uint64_t num_digests,
+                       const DigestNodeIDDeviceMap& index);
+
+/**
+ * Read the state of a deduplicator from a file written by write_dedup_state.
+ *
+ * \param filename   File to read
+ * \param mode       Approach of the deduplicator loading the state
+ * \param chunk_size Chunk size of the deduplicator loading the state
+ * \param header     Output state header
+ * \param digests    Output list or tree digests on the device
+ * \param index      Output first occurrence index
+ *
+ * \return Whether the file holds a state for the same approach and chunk size
+ */
+bool read_dedup_state(const std::string& filename,
+                      DedupMode mode,
+                      uint32_t chunk_size,
+                      state_header_t& header,
+                      Kokkos::View<HashDigest*>& digests,
+                      DigestNodeIDDeviceMap& index);
+
+/**
+ * Recover the position in a chain of incremental checkpoint files from the header of a
+ * checkpoint and the sizes of the files in its chain.
+ *
+ * \param chkpt_files Checkpoint files of the chain
+ * \param chkpt_id    ID of the last checkpoint written
+ * \param header      Output state header with the IDs and chain filled in
+ *
+ * \return Whether the checkpoint and its chain could be read
+ */
+bool read_chain_state(std::vector<std::string>& chkpt_files,
+                      uint32_t chkpt_id,
+                      state_header_t& header);
+
+#endif // DEDUP_STATE_HPP
@@ -11,6 +11,15 @@
 //=============================================================================
 #include "deduplicator_interface.hpp"
 
+//=============================================================================
+// Checkpoint storage
+//=============================================================================
+#include "chkpt_pack.hpp"
+#include "tiered_store.hpp"
+#include "storage_emulator.hpp"
+#include "chkpt_prefetch.hpp"
+#include "restart_plan.hpp"
+
 //=============================================================================
 // Explicit implementations of deduplicator
 //=============================================================================
@@ -9,7 +9,12 @@
 #include <fstream>
 #include <iostream>
 #include <utility>
+#include <cstring>
 #include "stdio.h"
+#include "utils.hpp"
+#include "chkpt_sink.hpp"
+#include "chain_manifest.hpp"
+#include "group_commit.hpp"
 
 class BaseDeduplicator {
   protected:
@@ -21,6 +26,247 @@ class BaseDeduplicator {
     std::pair<uint64_t,uint64_t> datasizes;
     double timers[4];
     double restart_timers[2];
+    // Automatic baseline policy and the size of the current chain
+    baseline_policy_t baseline_policy = {0, 0, 0};
+    uint32_t chain_len = 0;
+    uint64_t chain_bytes = 0;
+    std::vector<baseline_event_t> baseline_events;
+    // First occurrence index lifecycle
+    index_policy_t index_policy = {0, false};
+    uint32_t index_min_chkpt = 0;
+    uint64_t index_evicted = 0;
+    std::vector<index_stats_t> index_stats;
+    // Digest filter in front of index lookups
+    uint32_t filter_bits = 0;
+    std::vector<filter_stats_t> filter_stats;
+    // Output file the next checkpoint is gathered into, if any
+    ChkptSink* sink = NULL;
+    // How checkpoint files are written
+    writer_config_t writer_config = default_writer_config();
+    // Manifest the checkpoint files are recorded in, if any
+    ChainManifest* manifest = NULL;
+    // Syncs the checkpoint files per the durability policy, if any
+    GroupCommit* commits = NULL;
+
+    /**
+     * Decide whether the next checkpoint starts a new chain. A baseline is made when
+     * requested or when the current chain crosses a limit of the baseline policy.
+     * Restarting reads every checkpoint in the chain so the restart cost of the next 
+     * checkpoint is estimated as the chain length times the average checkpoint size.
+     *
+     * \param make_baseline Flag determining whether a baseline was requested
+     * \param index_entries Number of entries in the first occurrence index
+     * \param event         Output baseline event describing why a baseline is made
+     *
+     * \return Whether to make a baseline checkpoint
+     */
+    bool check_baseline_policy(bool make_baseline, uint64_t index_entries, baseline_event_t& event) const {
+      event = {current_id, BaselineRequested, 0, 0};
+      // Without a chain to extend, e.g. after loading a state that has none, start one
+      if(make_baseline || (current_id == 0) || (chain_len == 0))
+        return true;
+      uint64_t restart_bytes = chain_bytes + chain_bytes/chain_len;
+      if((baseline_policy.max_chain_len > 0) && (chain_len >= baseline_policy.max_chain_len)) {
+        event = {current_id, BaselineChainLength, chain_len, baseline_policy.max_chain_len};
+      } else if((baseline_policy.max_restart_bytes > 0) && 
+                (restart_bytes > baseline_policy.max_restart_bytes)) {
+        event = {current_id, BaselineRestartCost, restart_bytes, baseline_policy.max_restart_bytes};
+      } else if((baseline_policy.max_index_entries > 0) && 
+                (index_entries > baseline_policy.max_index_entries)) {
+        event = {current_id, BaselineIndexSize, index_entries, baseline_policy.max_index_entries};
+      } else {
+        return false;
+      }
+      return true;
+    }
+
+    /**
+     * Apply the baseline policy to the next checkpoint. Every baseline is recorded 
+     * along with the reason it was made.
+     *
+     * \param make_baseline Flag determining whether a baseline was requested
+     * \param index_entries Number of entries in the first occurrence index
+     *
+     * \return Whether to make a baseline checkpoint
+     */
+    bool apply_baseline_policy(bool make_baseline, uint64_t index_entries) {
+      baseline_event_t event;
+      if(!check_baseline_policy(make_baseline, index_entries, event))
+        return false;
+      if(event.reason != BaselineRequested) {
+        STDOUT_PRINT("New baseline at checkpoint %u: %s %lu (limit %lu)\n", event.chkpt_id,
+                     baseline_reason_name(event.reason), event.value, event.limit);
+      }
+      baseline_events.push_back(event);
+      return true;
+    }
+
+    /**
+     * Fill in the total size and restart cost of a planned checkpoint. Restarting reads 
+     * every checkpoint in the chain, so a checkpoint added to the current chain costs 
+     * the bytes already in the chain plus its own size.
+     *
+     * \param plan Planned checkpoint with the header and sizes filled in
+     */
+    void estimate_restart(chkpt_plan_t& plan) const {
+      plan.chkpt_bytes = plan.data_bytes + plan.metadata_bytes;
+      plan.chain_len = 1;
+      plan.restart_bytes = plan.chkpt_bytes;
+      if(!plan.make_baseline) {
+        plan.chain_len += chain_len;
+        plan.restart_bytes += chain_bytes;
+      }
+    }
+
+    /**
+     * Allocate the buffer a checkpoint is gathered into. With an output sink that can be
+     * mapped the buffer is the output file itself, otherwise it is a device View.
+     *
+     * \param buffer_d Buffer to allocate
+     * \param size     Size of the checkpoint in bytes
+     */
+    void alloc_diff_buffer(Kokkos::View<uint8_t*>& buffer_d, uint64_t size) {
+      uint8_t* file_ptr = (sink != NULL) ? sink->map(size) : NULL;
+      if(file_ptr != NULL) {
+        buffer_d = Kokkos::View<uint8_t*>(file_ptr, size);
+      } else {
+        Kokkos::resize(buffer_d, size);
+      }
+    }
+
+    /**
+     * Make the gathered checkpoint available on the Host and fill in its header. A
+     * checkpoint gathered into the output sink is already on the Host and is not copied.
+     *
+     * \param diff   Gathered checkpoint
+     * \param diff_h Host View of the checkpoint
+     * \param header The checkpoint header
+     */
+    void diff_to_host(Kokkos::View<uint8_t*>& diff, 
+                      Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                      header_t& header) {
+      if((sink != NULL) && sink->mapped()) {
+        Kokkos::fence();
+        diff_h = Kokkos::View<uint8_t*>::HostMirror(diff.data(), diff.size());
+      } else {
+        Kokkos::resize(diff_h, diff.size());
+        Kokkos::deep_copy(diff_h, diff);
+      }
+      memcpy(diff_h.data(), &header, sizeof(header_t));
+    }
+
+    /**
+     * Finish a checkpoint written to a file: report it to the group commit, which syncs
+     * it per the durability policy, then record it in the manifest, if there is one.
+     * With DurableChkpt the checkpoint is synced before the manifest is saved, with
+     * DurableGroup the manifest is saved by the commit that syncs the checkpoint, and
+     * with DurableNone neither is synced and the manifest can list checkpoints lost in
+     * a crash.
+     *
+     * \param filename    Checkpoint file
+     * \param diff_h      Checkpoint on the Host
+     * \param incremental Whether the checkpoint starts with a header
+     */
+    void finish_file(const std::string& filename, 
+                     const Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                     bool incremental) {
+      if(commits != NULL)
+        commits->written(filename);
+      if(manifest != NULL)
+        manifest->record(current_id, diff_h.data(), diff_h.size(), filename, 0, incremental);
+    }
+
+    /**
+     * Add a checkpoint to the current chain.
+     *
+     * \param make_baseline Whether the checkpoint is a baseline
+     * \param chkpt_size    Size of the checkpoint in bytes
+     */
+    void update_chain(bool make_baseline, uint64_t chkpt_size) {
+      if(make_baseline) {
+        chain_len = 0;
+        chain_bytes = 0;
+      }
+      chain_len += 1;
+      chain_bytes += chkpt_size;
+    }
+
+    /**
+     * Oldest checkpoint whose first occurrences can still be referenced by the next
+     * checkpoint under the index policy and explicit evictions.
+     */
+    uint32_t index_min_reachable() const {
+      uint32_t min_chkpt = index_min_chkpt;
+      if((index_policy.max_age > 0) && (current_id > index_policy.max_age) &&
+         (current_id - index_policy.max_age > min_chkpt))
+        min_chkpt = current_id - index_policy.max_age;
+      return min_chkpt;
+    }
+
+    /**
+     * Record the size of the first occurrence index after a checkpoint along with the
+     * number of entries evicted before it.
+     *
+     * \param num_entries  Number of entries in the index
+     * \param capacity     Number of slots in the index
+     * \param memory_bytes Device memory used by the index
+     */
+    void record_index_stats(uint64_t num_entries, uint64_t capacity, uint64_t memory_bytes) {
+      index_stats_t stats = {current_id, num_entries, capacity, memory_bytes, index_evicted};
+      STDOUT_PRINT("Index after checkpoint %u: %lu entries, %lu bytes, %lu evicted\n", 
+                   current_id, num_entries, memory_bytes, index_evicted);
+      index_stats.push_back(stats);
+      index_evicted = 0;
+    }
+
+    /**
+     * Record the digest filter lookups of a checkpoint
+     *
+     * \param lookups         Index lookups that went through the filter
+     * \param rejected        Lookups answered by the filter
+     * \param false_positives Lookups passed by the filter that missed in the index
+     * \param memory_bytes    Memory used by the filter
+     */
+    void record_filter_stats(uint64_t lookups, uint64_t rejected, uint64_t false_positives,
+                             uint64_t memory_bytes) {
+      filter_stats_t stats = {current_id, lookups, rejected, false_positives, memory_bytes};
+      STDOUT_PRINT("Filter checkpoint %u: %lu lookups, %lu rejected, %lu false positives\n",
+                   current_id, lookups, rejected, false_positives);
+      filter_stats.push_back(stats);
+    }
+
+    /**
+     * Fill a state header with the checkpoint IDs, current chain, and data length
+     *
+     * \param mode Approach of the deduplicator
+     */
+    state_header_t fill_state_header(DedupMode mode) const {
+      state_header_t header;
+      memset(&header, 0, sizeof(state_header_t));
+      header.mode = static_cast<uint32_t>(mode);
+      header.chunk_size = chunk_size;
+      header.current_id = current_id;
+      header.baseline_id = baseline_id;
+      header.chain_len = chain_len;
+      header.chain_bytes = chain_bytes;
+      header.data_len = data_len;
+      return header;
+    }
+
+    /**
+     * Resume the checkpoint IDs, current chain, and data length of a saved state
+     *
+     * \param header State header
+     */
+    void restore_state_header(const state_header_t& header) {
+      current_id = header.current_id;
+      baseline_id = header.baseline_id;
+      chain_len = header.chain_len;
+      chain_bytes = header.chain_bytes;
+      data_len = header.data_len;
+      index_min_chkpt = 0;
+      index_evicted = 0;
+    }
 
   public:
     /**
@@ -30,6 +276,118 @@ class BaseDeduplicator {
 
     BaseDeduplicator(uint32_t bytes_per_chunk) {}
 
+    /**
+     * Set limits for automatically making a new baseline. The limits apply to the 
+     * Basic, List, and Tree approaches and are checked before each checkpoint.
+     *
+     * \param policy Limits on chain length, estimated restart cost, and index size
+     */
+    void set_baseline_policy(const baseline_policy_t& policy) {
+      baseline_policy = policy;
+    }
+
+    baseline_policy_t get_baseline_policy() const {
+      return baseline_policy;
+    }
+
+    /**
+     * Baselines made so far along with the reason each one was made
+     */
+    const std::vector<baseline_event_t>& get_baseline_events() const {
+      return baseline_events;
+    }
+
+    /**
+     * Set how the first occurrence index of the List and Tree approaches is trimmed.
+     * Entries are evicted and the index is compacted before each checkpoint.
+     *
+     * \param policy Maximum entry age and whether to drop unmatched interior nodes
+     */
+    void set_index_policy(const index_policy_t& policy) {
+      index_policy = policy;
+    }
+
+    index_policy_t get_index_policy() const {
+      return index_policy;
+    }
+
+    /**
+     * Evict the first occurrences of checkpoints before min_chkpt from the index, e.g.
+     * once they are dropped after consolidating the chain. Later checkpoints will not
+     * reference them. Eviction happens before the next checkpoint.
+     *
+     * \param min_chkpt Oldest checkpoint that later checkpoints may reference
+     */
+    void evict_index(uint32_t min_chkpt) {
+      if(min_chkpt > index_min_chkpt)
+        index_min_chkpt = min_chkpt;
+    }
+
+    /**
+     * Size of the first occurrence index after each checkpoint
+     */
+    const std::vector<index_stats_t>& get_index_stats() const {
+      return index_stats;
+    }
+
+    /**
+     * Put a blocked Bloom filter in front of the first occurrence index lookups of the
+     * Tree approaches. Lookups of digests rejected by the filter skip the index.
+     *
+     * \param bits_per_entry Filter bits per index entry, 0 disables the filter
+     */
+    void set_digest_filter(uint32_t bits_per_entry) {
+      filter_bits = bits_per_entry;
+    }
+
+    /**
+     * Digest filter lookups of each checkpoint
+     */
+    const std::vector<filter_stats_t>& get_filter_stats() const {
+      return filter_stats;
+    }
+
+    /**
+     * Set how checkpoint files are written. The stream writer gathers checkpoints
+     * straight into mapped files when kernels can access Host memory.
+     *
+     * \param config Writer backend, O_DIRECT, queue depth, and block size
+     */
+    void set_writer_config(const writer_config_t& config) {
+      writer_config = config;
+    }
+
+    writer_config_t get_writer_config() const {
+      return writer_config;
+    }
+
+    /**
+     * Record every checkpoint written to a file in a chain manifest. The manifest must
+     * outlive the checkpoints.
+     *
+     * \param chain_manifest Manifest to record checkpoints in, NULL to stop recording
+     */
+    void set_manifest(ChainManifest* chain_manifest) {
+      manifest = chain_manifest;
+    }
+
+    /**
+     * Sync every checkpoint written to a file per the durability policy of the group
+     * commit. The group commit must outlive the checkpoints.
+     *
+     * \param group_commit Group commit to report checkpoints to, NULL to stop syncing
+     */
+    void set_group_commit(GroupCommit* group_commit) {
+      commits = group_commit;
+    }
+
+    /**
+     * Number of the next checkpoint
+     */
+    uint32_t get_current_id() const {
+      return current_id;
+    }
+
     /**
      * Destructor
      */
@@ -116,6 +474,74 @@ class BaseDeduplicator {
                             std::string& logname, 
                             bool make_baseline) = 0;
 
+    /**
+     * Dry run of a checkpoint. Deduplicates the data and counts the metadata to predict
+     * the size of the checkpoint and the cost of restarting it without gathering chunks
+     * or copying the checkpoint to the Host. The state of the deduplicator is left 
+     * unchanged so the next checkpoint behaves as if the plan was never made.
+     *
+     * \param data_ptr      Raw data pointer that needs to be deduplicated
+     * \param len           Length of data
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     *
+     * \return Predicted header, data and metadata sizes, and restart read volume
+     */
+    virtual chkpt_plan_t plan(uint8_t* data_ptr, 
+                              size_t len, 
+                              bool make_baseline) = 0;
+
+    /**
+     * Save the state needed to continue deduplicating after a job restart: the checkpoint
+     * IDs, the current chain, the list or tree of digests, and the first occurrence index.
+     *
+     * \param filename File to save the state in
+     */
+    virtual void save_state(const std::string& filename) = 0;
+
+    /**
+     * Load a state saved by save_state. The next checkpoint continues the saved chain
+     * instead of starting a new baseline.
+     *
+     * \param filename File with the saved state
+     *
+     * \return Whether the state was saved by the same approach with the same chunk size
+     */
+    virtual bool load_state(const std::string& filename) = 0;
+
+    /**
+     * Rebuild the state from the data of a restarted checkpoint when no saved state is
+     * available. The digests are recomputed from the data and the checkpoint IDs and
+     * chain are read from the checkpoint files.
+     *
+     * \param data            Data restarted from checkpoint chkpt_id
+     * \param chkpt_filenames Checkpoint files of the chain, as passed to restart
+     * \param chkpt_id        ID of the restarted checkpoint
+     *
+     * \return Whether the checkpoint chain could be read
+     */
+    virtual bool rebuild_state(Kokkos::View<uint8_t*> data,
+                               std::vector<std::string>& chkpt_filenames,
+                               uint32_t chkpt_id) = 0;
+
+    /**
+     * Seed the deduplicator with reference datasets before the first checkpoint, e.g.
+     * input files whose contents reappear in the checkpointed data. The reference image
+     * is the concatenation of the files, cut or zero filled to len bytes so that its
+     * chunks line up with the data. The image is indexed as a reference checkpoint that 
+     * starts the chain and only names the files. Later checkpoints store chunks found in
+     * the image as duplicates instead of data, and restarts read them from the files.
+     * The reference files must not change while the chain is in use.
+     *
+     * \param reference_files Files with the reference data
+     * \param len             Length of the data that will be checkpointed
+     * \param chkpt_h         Output reference checkpoint on the Host
+     *
+     * \return Whether the approach supports seeding and the files could be read
+     */
+    virtual bool seed_reference(std::vector<std::string>& reference_files,
+                                size_t len,
+                                Kokkos::View<uint8_t*>::HostMirror& chkpt_h) = 0;
+
     /**
      * Restart checkpoint from vector of incremental checkpoints loaded on the Host.
      *
@@ -158,6 +584,45 @@ class BaseDeduplicator {
                          std::string& logname, 
                          uint32_t chkpt_id) = 0;
 
+    /**
+     * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+     * on the Host. Only chunks overlapping [offset, offset+length) are restarted. Throws
+     * std::ios_base::failure if a chunk of the range is not found in the chain.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    virtual void restart_range(Kokkos::View<uint8_t*>& data,
+                               uint64_t offset,
+                               uint64_t length,
+                               std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts,
+                               std::string& logname,
+                               uint32_t chkpt_id) = 0;
+
+    /**
+     * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+     * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+     * are read. Throws std::ios_base::failure if a chunk of the range is not found in the
+     * chain.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param filenames  Vector of prior incremental checkpoints stored in files
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    virtual void restart_range(Kokkos::View<uint8_t*>& data,
+                               uint64_t offset,
+                               uint64_t length,
+                               std::vector<std::string>& chkpt_filenames,
+                               std::string& logname,
+                               uint32_t chkpt_id) = 0;
+
     /**
      * Write logs for the checkpoint metadata/data breakdown, runtimes, and the overall summary.
      * The data breakdown log shows the proportion of data and metadata as well as how much 
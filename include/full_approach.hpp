@@ -9,6 +9,7 @@
 #include <utility>
 #include "utils.hpp"
 #include "deduplicator_interface.hpp"
+#include "dedup_state.hpp"
 
 class FullDeduplicator : public BaseDeduplicator {
   public:
@@ -98,6 +99,66 @@ class FullDeduplicator : public BaseDeduplicator {
                     std::string& logname, 
                     bool make_baseline) override;
 
+    /**
+     * Dry run of a checkpoint. Predicts the size of the checkpoint and the cost of
+     * restarting it without gathering chunks or copying the checkpoint to the Host.
+     * Full checkpoints are always the size of the data.
+     *
+     * \param data_ptr      Raw data pointer that needs to be deduplicated
+     * \param len           Length of data
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     *
+     * \return Predicted header, data and metadata sizes, and restart read volume
+     */
+    chkpt_plan_t plan(uint8_t* data_ptr, 
+                      size_t len, 
+                      bool make_baseline) override;
+
+    /**
+     * Save the state needed to continue deduplicating after a job restart.
+     * Saves the checkpoint IDs and data length. Full checkpoints have no other state.
+     *
+     * \param filename File to save the state in
+     */
+    void save_state(const std::string& filename) override;
+
+    /**
+     * Load a state saved by save_state. The next checkpoint continues the saved chain.
+     *
+     * \param filename File with the saved state
+     *
+     * \return Whether the state was saved by the same approach with the same chunk size
+     */
+    bool load_state(const std::string& filename) override;
+
+    /**
+     * Rebuild the state from the data of a restarted checkpoint.
+     * Reads the checkpoint IDs and data length from the checkpoint files.
+     *
+     * \param data            Data restarted from checkpoint chkpt_id
+     * \param chkpt_filenames Checkpoint files of the chain, as passed to restart
+     * \param chkpt_id        ID of the restarted checkpoint
+     *
+     * \return Whether the checkpoint chain could be read
+     */
+    bool rebuild_state(Kokkos::View<uint8_t*> data,
+                       std::vector<std::string>& chkpt_filenames,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Full checkpoints store all data and cannot reference other datasets, so seeding
+     * is not supported.
+     *
+     * \param reference_files Files with the reference data
+     * \param len             Length of the data that will be checkpointed
+     * \param chkpt_h         Output reference checkpoint on the Host
+     *
+     * \return false
+     */
+    bool seed_reference(std::vector<std::string>& reference_files,
+                        size_t len,
+                        Kokkos::View<uint8_t*>::HostMirror& chkpt_h) override;
+
     /**
      * Restart checkpoint from vector of incremental checkpoints loaded on the Host.
      *
@@ -140,6 +201,43 @@ class FullDeduplicator : public BaseDeduplicator {
                  std::string& logname, 
                  uint32_t chkpt_id) override;
 
+    /**
+     * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+     * on the Host. Only chunks overlapping [offset, offset+length) are restarted.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart_range(Kokkos::View<uint8_t*>& data,
+                       uint64_t offset,
+                       uint64_t length,
+                       std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts,
+                       std::string& logname,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+     * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+     * are read.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param filenames  Vector of prior incremental checkpoints stored in files
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart_range(Kokkos::View<uint8_t*>& data,
+                       uint64_t offset,
+                       uint64_t length,
+                       std::vector<std::string>& chkpt_filenames,
+                       std::string& logname,
+                       uint32_t chkpt_id) override;
+
     /**
      * Write logs for the checkpoint metadata/data breakdown, runtimes, and the overall summary.
      * The data breakdown log shows the proportion of data and metadata as well as how much 
@@ -0,0 +1,100 @@
+#ifndef GROUP_COMMIT_HPP
+#define GROUP_COMMIT_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include "chain_manifest.hpp"
+#include "chkpt_writer.hpp"
+
+/** \class GroupCommit
+ *  \brief Syncs written checkpoints according to the durability policy of the writer
+ *
+ *  Checkpoint files are reported once they are completely written. With DurableNone
+ *  nothing is synced. With DurableChkpt each checkpoint is synced right away, so its
+ *  latency includes the time for the storage to acknowledge it. With DurableGroup
+ *  checkpoints are collected and synced together once group_chkpts checkpoints are
+ *  pending or group_seconds have passed since the last commit, trading the last
+ *  checkpoints of a crash for fewer syncs. A timer thread commits a group whose
+ *  group_seconds have passed even when no further checkpoint is reported. A pack file reported several times in a group
+ *  is synced with a single fdatasync. Files are synced with fdatasync, together with the
+ *  stripe files and layout of split checkpoints, and the directory of a file is synced
+ *  the first time the file is committed so that the new name survives a crash. A chain
+ *  manifest can be saved by every commit, after the files of its entries are synced.
+ *  Safe to use from several threads.
+ */
+class GroupCommit {
+  public:
+    /**
+     * \param config Writer configuration holding the durability policy
+     */
+    GroupCommit(const writer_config_t& config);
+
+    /// Stop the timer and commit the pending checkpoints
+    ~GroupCommit();
+
+    GroupCommit(const GroupCommit&) = delete;
+    GroupCommit& operator=(const GroupCommit&) = delete;
+
+    /**
+     * Save a chain manifest with every commit, so that with DurableGroup it only lists
+     * synced checkpoints. The manifest must outlive the group commit.
+     *
+     * \param chain_manifest Manifest, NULL to stop saving one
+     */
+    void set_manifest(ChainManifest* chain_manifest);
+
+    /**
+     * Report a completely written checkpoint and sync it if the policy says so. Throws
+     * std::ios_base::failure if a sync fails, here or in an earlier commit of the timer.
+     *
+     * \param filename Checkpoint file or pack file holding the checkpoint
+     */
+    void written(const std::string& filename);
+
+    /**
+     * Sync every pending checkpoint and save the manifest now. Throws
+     * std::ios_base::failure if a sync fails, here or in an earlier commit of the timer.
+     */
+    void commit();
+
+    /// Checkpoints reported so far
+    uint64_t num_chkpts() const;
+
+    /// Commits that synced at least one file
+    uint64_t num_commits() const;
+
+    /// Files and directories synced
+    uint64_t num_syncs() const;
+
+    /// Seconds spent syncing
+    double sync_time() const;
+
+  private:
+    void commit_locked();
+    void timer_loop();
+    void raise_timer_error();
+
+    writer_config_t config;
+    ChainManifest* manifest;
+    std::set<std::string> pending;    // Files written since the last commit
+    std::set<std::string> committed;  // Files committed at least once
+    uint32_t num_pending;             // Checkpoints reported since the last commit
+    std::chrono::steady_clock::time_point last_commit;
+    uint64_t chkpts;
+    uint64_t commits;
+    uint64_t syncs;
+    double sync_seconds;
+    mutable std::mutex mutex;
+    std::condition_variable timer_cv;
+    std::thread timer;
+    bool stop;
+    std::exception_ptr timer_error;   // Failed commit of the timer not reported yet
+};
+
+#endif // GROUP_COMMIT_HPP
@@ -0,0 +1,121 @@
+#ifndef KOKKOS_DIGEST_FILTER_HPP
+#define KOKKOS_DIGEST_FILTER_HPP
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include "map_helpers.hpp"
+
+/** \class DigestFilter
+ *  \brief Blocked Bloom filter over digests
+ *
+ *  Each digest sets bits_per_key bits inside one 512-bit block, so a lookup touches a
+ *  single cache line. Digests are already uniformly distributed hashes, so the block
+ *  and the bit positions are taken directly from the digest. A default constructed
+ *  filter is disabled: may_contain always returns true and inserts do nothing.
+ */
+class DigestFilter {
+public:
+  static constexpr uint32_t words_per_block = 8;
+  static constexpr uint32_t bits_per_key    = 7;
+
+  DigestFilter() {}
+
+  /**
+   * Allocate a filter for the given number of digests
+   *
+   * \param num_keys       Number of digests the filter is sized for
+   * \param bits_per_entry Number of filter bits per digest
+   */
+  DigestFilter(const uint64_t num_keys, const uint32_t bits_per_entry) {
+    uint64_t num_bits = num_keys*bits_per_entry;
+    uint64_t num_blocks = 1;
+    while(num_blocks*words_per_block*64 < num_bits)
+      num_blocks *= 2;
+    m_capacity = num_keys;
+    m_block_mask = num_blocks-1;
+    m_blocks = Kokkos::View<uint64_t*>("Digest filter", num_blocks*words_per_block);
+    Kokkos::deep_copy(m_blocks, 0);
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  bool enabled() const {
+    return m_blocks.size() > 0;
+  }
+
+  /// Number of digests the filter is sized for
+  uint64_t capacity() const {
+    return m_capacity;
+  }
+
+  uint64_t memory_bytes() const {
+    return m_blocks.size()*sizeof(uint64_t);
+  }
+
+  void clear() {
+    if(enabled())
+      Kokkos::deep_copy(m_blocks, 0);
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  void insert(const HashDigest& digest) const {
+    if(!enabled())
+      return;
+    uint64_t masks[words_per_block];
+    uint64_t base = block_masks(digest, masks);
+    for(uint32_t w=0; w<words_per_block; w++) {
+      if(masks[w] && ((m_blocks(base+w) & masks[w]) != masks[w]))
+        Kokkos::atomic_fetch_or(&m_blocks(base+w), masks[w]);
+    }
+  }
+
+  /**
+   * Whether the digest may have been inserted. False means it was never inserted.
+   */
+  KOKKOS_INLINE_FUNCTION
+  bool may_contain(const HashDigest& digest) const {
+    if(!enabled())
+      return true;
+    uint64_t masks[words_per_block];
+    uint64_t base = block_masks(digest, masks);
+    for(uint32_t w=0; w<words_per_block; w++) {
+      if((m_blocks(base+w) & masks[w]) != masks[w])
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * Deep copy of the filter contents
+   */
+  DigestFilter clone() const {
+    DigestFilter copy;
+    copy.m_capacity = m_capacity;
+    copy.m_block_mask = m_block_mask;
+    if(enabled()) {
+      copy.m_blocks = Kokkos::View<uint64_t*>("Digest filter", m_blocks.size());
+      Kokkos::deep_copy(copy.m_blocks, m_blocks);
+    }
+    return copy;
+  }
+
+private:
+  Kokkos::View<uint64_t*> m_blocks;
+  uint64_t m_capacity = 0;
+  uint64_t m_block_mask = 0;
+
+  /// Fill the bit mask of each word of the digest's block and return the first word
+  KOKKOS_FORCEINLINE_FUNCTION
+  uint64_t block_masks(const HashDigest& digest, uint64_t* masks) const {
+    const uint64_t* digest_ptr = (const uint64_t*) digest.digest;
+    uint64_t block = digest_ptr[0] & m_block_mask;
+    uint64_t bits = digest_ptr[1];
+    for(uint32_t w=0; w<words_per_block; w++)
+      masks[w] = 0;
+    for(uint32_t k=0; k<bits_per_key; k++) {
+      uint32_t pos = static_cast<uint32_t>(bits >> (9*k)) & 511;
+      masks[pos >> 6] |= 1ULL << (pos & 63);
+    }
+    return block*words_per_block;
+  }
+};
+
+#endif // KOKKOS_DIGEST_FILTER_HPP
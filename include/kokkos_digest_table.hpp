@@ -0,0 +1,678 @@
+#ifndef KOKKOS_DIGEST_TABLE_HPP
+#define KOKKOS_DIGEST_TABLE_HPP
+#include <Kokkos_Core.hpp>
+#include <climits>
+#include <cstdint>
+#if defined(__SSE2__) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#include <emmintrin.h>
+#define DIGEST_TABLE_SSE2
+#endif
+
+/** \class DigestTableInsertResult
+ *  \brief Result of inserting into a DigestTable
+ *
+ *  Same interface as Kokkos::UnorderedMapInsertResult so the table can be used
+ *  wherever the deduplicators used an UnorderedMap.
+ */
+class DigestTableInsertResult {
+public:
+  enum Status : uint32_t {
+    SUCCESS  = 0,
+    EXISTING = 1,
+    FAILED   = 2
+  };
+
+  KOKKOS_FORCEINLINE_FUNCTION
+  DigestTableInsertResult() : m_index(UINT_MAX), m_status(FAILED) {}
+
+  KOKKOS_FORCEINLINE_FUNCTION
+  DigestTableInsertResult(uint32_t index, Status status) : m_index(index), m_status(status) {}
+
+  /// Key was inserted
+  KOKKOS_FORCEINLINE_FUNCTION bool success() const { return m_status == SUCCESS; }
+  /// Key already exists in the table
+  KOKKOS_FORCEINLINE_FUNCTION bool existing() const { return m_status == EXISTING; }
+  /// Table is full
+  KOKKOS_FORCEINLINE_FUNCTION bool failed() const { return m_status == FAILED; }
+  /// Index of the inserted or existing entry
+  KOKKOS_FORCEINLINE_FUNCTION uint32_t index() const { return m_index; }
+
+private:
+  uint32_t m_index;
+  Status m_status;
+};
+
+/** \class DigestTable
+ *  \brief Open addressing hash table for fixed size digests
+ *
+ *  Keys, values, and one byte tags are stored in separate arrays. Slots are probed in
+ *  groups of 16 tags. Each tag holds 7 bits of the hash so most non-matching slots are
+ *  rejected without reading the key. The host compares a whole group of tags with SSE2
+ *  and the device compares 8 tags at a time inside 64-bit words.
+ *
+ *  The table grows incrementally. reserve() allocates a new generation and the entries
+ *  of the previous generation are migrated a slice at a time by later calls. Until the
+ *  migration finishes, lookups check both generations and entries in the previous
+ *  generation use indices past capacity().
+ *
+ *  Inserts never wait on each other. An insert claims a free slot, writes its key and
+ *  value, and publishes the slot as a pending copy of the key. Each group has a
+ *  decision word recording the last copy chosen among inserts whose keys start in that
+ *  group. An insert first completes the recorded decision, then looks for a decided
+ *  copy of its key, deleting its own copy if one exists, and otherwise records its own
+ *  copy with a compare and swap and retries if another insert won the swap. Only one
+ *  copy of a key is ever decided and lookups skip pending copies. Slots of erased keys
+ *  are reused by later inserts.
+ *
+ *  Each slot also has a mark that callers can set when an entry is used. compact()
+ *  removes entries rejected by a predicate, which can take the mark into account, and
+ *  rebuilds the table in its own arrays, shrinking them if the remaining entries fit.
+ *
+ *  \tparam Key       Key type, compared with EqualTo
+ *  \tparam Value     Value type
+ *  \tparam ExecSpace Execution space of the table
+ *  \tparam Hasher    Functor returning a 64-bit hash of a key
+ *  \tparam EqualTo   Functor comparing two keys
+ */
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+class DigestTable {
+public:
+  using execution_space = ExecSpace;
+  using memory_space    = typename ExecSpace::memory_space;
+  using key_type        = Key;
+  using value_type      = Value;
+  using size_type       = uint32_t;
+  using insert_result   = DigestTableInsertResult;
+
+  static constexpr uint32_t group_size    = 16;
+  static constexpr uint32_t invalid_index = UINT_MAX;
+  static constexpr uint8_t  tag_empty     = 0x00; ///< Slot has never been used
+  static constexpr uint8_t  tag_busy      = 0x01; ///< Slot is being written by an insert
+  static constexpr uint8_t  tag_deleted   = 0x02; ///< Entry was erased or moved to the current generation
+  static constexpr uint64_t no_decision   = 0xFFFFFFFFULL; ///< Decision word recording no pending copy
+
+  /// Empty table with no capacity
+  DigestTable() {}
+
+  /**
+   * Allocate a table for at least the given number of entries
+   *
+   * \param capacity_hint Number of entries the table must hold
+   */
+  DigestTable(const uint32_t capacity_hint) {
+    m_size = Kokkos::View<uint32_t[1], ExecSpace>("Digest table size");
+    allocate(slots_for(capacity_hint));
+  }
+
+  /// Number of slots in the current generation
+  KOKKOS_INLINE_FUNCTION
+  uint32_t capacity() const {
+    return m_capacity;
+  }
+
+  /// Number of slots in both generations. Every index below it can be passed to valid_at
+  uint32_t num_slots() const {
+    return m_capacity + m_old_capacity;
+  }
+
+  /// Number of entries in the table
+  uint32_t size() const {
+    if(!m_size.is_allocated())
+      return 0;
+    auto size_h = Kokkos::create_mirror_view(m_size);
+    Kokkos::deep_copy(size_h, m_size);
+    return size_h(0);
+  }
+
+  /// Bytes of device memory used by both generations
+  uint64_t memory_bytes() const {
+    uint64_t slot_bytes = 2*sizeof(uint8_t)+sizeof(Key)+sizeof(Value);
+    uint64_t decision_bytes = sizeof(uint64_t)*static_cast<uint64_t>(m_capacity/group_size);
+    return slot_bytes*(static_cast<uint64_t>(m_capacity)+static_cast<uint64_t>(m_old_capacity)) + decision_bytes;
+  }
+
+  /// Whether entries of a previous generation still need to be migrated
+  bool migrating() const {
+    return m_old_capacity > 0;
+  }
+
+  /**
+   * Make room for the given number of entries. If the current generation is too small
+   * a new generation with at least twice the slots is started and the previous
+   * generation is migrated incrementally. Every call also migrates one slice of a
+   * pending migration.
+   *
+   * \param requested     Number of entries the table must hold
+   * \param num_slices    Number of calls to spread a migration over
+   */
+  void reserve(const uint32_t requested, const uint32_t num_slices=4) {
+    if(!m_size.is_allocated())
+      m_size = Kokkos::View<uint32_t[1], ExecSpace>("Digest table size");
+    uint32_t num_slots = slots_for(requested);
+    if(num_slots > m_capacity) {
+      // Only two generations are kept at a time
+      migrate(m_old_capacity);
+      if(num_slots < 2*m_capacity)
+        num_slots = 2*m_capacity;
+      m_old_tags = m_tags;
+      m_old_keys = m_keys;
+      m_old_values = m_values;
+      m_old_marks = m_marks;
+      m_old_capacity = m_capacity;
+      m_migrate_pos = 0;
+      allocate(num_slots);
+    } else if(migrating()) {
+      migrate((m_old_capacity+num_slices-1)/num_slices);
+    }
+  }
+
+  /**
+   * Grow the table to hold the given number of entries and finish any migration.
+   * Same blocking behavior as Kokkos::UnorderedMap::rehash.
+   *
+   * \param requested Number of entries the table must hold
+   *
+   * \return Whether the table was resized
+   */
+  bool rehash(const uint32_t requested) {
+    reserve(requested);
+    migrate(m_old_capacity);
+    return true;
+  }
+
+  /**
+   * Move up to num_slots slots of the previous generation into the current one
+   *
+   * \param num_slots Number of slots of the previous generation to migrate
+   */
+  void migrate(const uint32_t num_slots) {
+    if(!migrating())
+      return;
+    uint32_t end = m_migrate_pos + num_slots;
+    if(end > m_old_capacity)
+      end = m_old_capacity;
+    DigestTable table = *this;
+    Kokkos::parallel_for("Digest table: Migrate", Kokkos::RangePolicy<ExecSpace>(m_migrate_pos, end),
+                         KOKKOS_LAMBDA(const uint32_t slot) {
+      uint8_t tag = table.m_old_tags(slot);
+      if(tag & 0x80) {
+        insert_result result = table.insert_into(table.m_tags, table.m_keys, table.m_values, table.m_decisions,
+                                                 table.m_capacity, table.m_old_keys(slot), table.m_old_values(slot),
+                                                 false);
+        if(!result.failed() && table.m_old_marks(slot))
+          table.m_marks(result.index()) = 1;
+        set_tag(&table.m_old_tags(slot), tag, tag_deleted);
+      }
+    });
+    Kokkos::fence();
+    m_migrate_pos = end;
+    if(m_migrate_pos == m_old_capacity) {
+      m_old_tags = Kokkos::View<uint8_t*, ExecSpace>();
+      m_old_keys = Kokkos::View<Key*, ExecSpace>();
+      m_old_values = Kokkos::View<Value*, ExecSpace>();
+      m_old_marks = Kokkos::View<uint8_t*, ExecSpace>();
+      m_old_capacity = 0;
+      m_migrate_pos = 0;
+    }
+  }
+
+  /**
+   * Insert a key and value if the key is not in the table
+   *
+   * \param key   Key to insert
+   * \param value Value for the key
+   *
+   * \return Whether the key was inserted or already existed, and the index of its entry
+   */
+  KOKKOS_INLINE_FUNCTION
+  insert_result insert(const Key& key, const Value& value = Value()) const {
+    if(m_old_capacity > 0) {
+      uint32_t old_slot = find_in(m_old_tags, m_old_keys, m_old_capacity, key);
+      if(old_slot != invalid_index)
+        return insert_result(m_capacity+old_slot, insert_result::EXISTING);
+    }
+    return insert_into(m_tags, m_keys, m_values, m_decisions, m_capacity, key, value, true);
+  }
+
+  /**
+   * Find the index of a key
+   *
+   * \param key Key to find
+   *
+   * \return Index of the entry or invalid_index if the key is not in the table
+   */
+  KOKKOS_INLINE_FUNCTION
+  uint32_t find(const Key& key) const {
+    uint32_t slot = find_in(m_tags, m_keys, m_capacity, key);
+    if(slot == invalid_index && m_old_capacity > 0) {
+      slot = find_in(m_old_tags, m_old_keys, m_old_capacity, key);
+      if(slot != invalid_index)
+        slot += m_capacity;
+    }
+    return slot;
+  }
+
+  /**
+   * Remove a key from the table. The slot is reused by later inserts. Erases must not
+   * run in the same kernel as inserts.
+   *
+   * \param key Key to remove
+   *
+   * \return Whether the key was removed
+   */
+  KOKKOS_INLINE_FUNCTION
+  bool erase(const Key& key) const {
+    uint32_t slot = find(key);
+    if(slot == invalid_index)
+      return false;
+    uint8_t* tag_ptr = slot < m_capacity ? &m_tags(slot) : &m_old_tags(slot-m_capacity);
+    uint8_t tag = *tag_ptr;
+    if((tag & 0x80) && set_tag(tag_ptr, tag, tag_deleted)) {
+      Kokkos::atomic_decrement(&m_size(0));
+      return true;
+    }
+    return false;
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  bool exists(const Key& key) const {
+    return find(key) != invalid_index;
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  bool valid_at(const uint32_t i) const {
+    if(i < m_capacity)
+      return (m_tags(i) & 0x80) != 0;
+    if(i - m_capacity < m_old_capacity)
+      return (m_old_tags(i-m_capacity) & 0x80) != 0;
+    return false;
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  Key& key_at(const uint32_t i) const {
+    if(i < m_capacity)
+      return m_keys(i);
+    return m_old_keys(i-m_capacity);
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  Value& value_at(const uint32_t i) const {
+    if(i < m_capacity)
+      return m_values(i);
+    return m_old_values(i-m_capacity);
+  }
+
+  /// Mark the entry at index i as used
+  KOKKOS_INLINE_FUNCTION
+  void mark(const uint32_t i) const {
+    if(i < m_capacity) {
+      m_marks(i) = 1;
+    } else if(i - m_capacity < m_old_capacity) {
+      m_old_marks(i-m_capacity) = 1;
+    }
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  bool marked_at(const uint32_t i) const {
+    if(i < m_capacity)
+      return m_marks(i) != 0;
+    if(i - m_capacity < m_old_capacity)
+      return m_old_marks(i-m_capacity) != 0;
+    return false;
+  }
+
+  /**
+   * Remove every entry rejected by a predicate and rebuild the table. Remaining entries
+   * are packed into temporary arrays and reinserted into the same arrays, so erased
+   * slots can be reused. The arrays shrink if the remaining entries plus the requested
+   * room fit in fewer slots. Pending migrations are finished first.
+   *
+   * \param keep       Functor called as keep(key, value, marked), true keeps the entry
+   * \param extra      Number of entries to leave room for
+   *
+   * \return Number of entries removed
+   */
+  template<class Keep>
+  uint32_t compact(const Keep& keep, const uint32_t extra = 0) {
+    migrate(m_old_capacity);
+    if(m_capacity == 0)
+      return 0;
+    Kokkos::View<uint8_t*, ExecSpace> tags = m_tags;
+    Kokkos::View<Key*, ExecSpace> keys = m_keys;
+    Kokkos::View<Value*, ExecSpace> values = m_values;
+    Kokkos::View<uint8_t*, ExecSpace> marks = m_marks;
+    uint32_t num_entries = size();
+    uint32_t num_keep = 0;
+    Kokkos::parallel_reduce("Digest table: Count kept entries", Kokkos::RangePolicy<ExecSpace>(0, m_capacity),
+                            KOKKOS_LAMBDA(const uint32_t slot, uint32_t& sum) {
+      if((tags(slot) & 0x80) && keep(keys(slot), values(slot), marks(slot) != 0))
+        sum += 1;
+    }, Kokkos::Sum<uint32_t>(num_keep));
+    if(num_keep == num_entries)
+      return 0;
+
+    Kokkos::View<Key*, ExecSpace> kept_keys("Digest table kept keys", num_keep);
+    Kokkos::View<Value*, ExecSpace> kept_values("Digest table kept values", num_keep);
+    Kokkos::View<uint8_t*, ExecSpace> kept_marks("Digest table kept marks", num_keep);
+    Kokkos::parallel_scan("Digest table: Pack kept entries", Kokkos::RangePolicy<ExecSpace>(0, m_capacity),
+                          KOKKOS_LAMBDA(const uint32_t slot, uint32_t& pos, const bool is_final) {
+      if((tags(slot) & 0x80) && keep(keys(slot), values(slot), marks(slot) != 0)) {
+        if(is_final) {
+          kept_keys(pos) = keys(slot);
+          kept_values(pos) = values(slot);
+          kept_marks(pos) = marks(slot);
+        }
+        pos += 1;
+      }
+    });
+
+    uint64_t needed = static_cast<uint64_t>(num_keep) + extra;
+    uint32_t num_slots = needed < m_capacity ? slots_for(static_cast<uint32_t>(needed)) : m_capacity;
+    tags = Kokkos::View<uint8_t*, ExecSpace>();
+    keys = Kokkos::View<Key*, ExecSpace>();
+    values = Kokkos::View<Value*, ExecSpace>();
+    marks = Kokkos::View<uint8_t*, ExecSpace>();
+    if(num_slots < m_capacity) {
+      m_tags = Kokkos::View<uint8_t*, ExecSpace>();
+      m_keys = Kokkos::View<Key*, ExecSpace>();
+      m_values = Kokkos::View<Value*, ExecSpace>();
+      m_marks = Kokkos::View<uint8_t*, ExecSpace>();
+      m_decisions = Kokkos::View<uint64_t*, ExecSpace>();
+      allocate(num_slots);
+    } else {
+      Kokkos::deep_copy(m_tags, static_cast<uint8_t>(tag_empty));
+      Kokkos::deep_copy(m_marks, static_cast<uint8_t>(0));
+    }
+    DigestTable table = *this;
+    Kokkos::parallel_for("Digest table: Reinsert kept entries", Kokkos::RangePolicy<ExecSpace>(0, num_keep),
+                         KOKKOS_LAMBDA(const uint32_t i) {
+      insert_result result = table.insert_into(table.m_tags, table.m_keys, table.m_values, table.m_decisions,
+                                               table.m_capacity, kept_keys(i), kept_values(i), false);
+      if(!result.failed())
+        table.m_marks(result.index()) = kept_marks(i);
+    });
+    Kokkos::deep_copy(m_size, num_keep);
+    Kokkos::fence();
+    return num_entries - num_keep;
+  }
+
+  /**
+   * Replace the contents of the table with a copy of another table
+   *
+   * \param src Table to copy, possibly in a different execution space
+   */
+  template<class SrcSpace>
+  void create_copy_view(const DigestTable<Key,Value,SrcSpace,Hasher,EqualTo>& src) {
+    m_capacity = src.m_capacity;
+    m_old_capacity = src.m_old_capacity;
+    m_migrate_pos = src.m_migrate_pos;
+    m_tags = Kokkos::View<uint8_t*, ExecSpace>("Digest table tags", m_capacity);
+    m_keys = Kokkos::View<Key*, ExecSpace>("Digest table keys", m_capacity);
+    m_values = Kokkos::View<Value*, ExecSpace>("Digest table values", m_capacity);
+    Kokkos::deep_copy(m_tags, src.m_tags);
+    Kokkos::deep_copy(m_keys, src.m_keys);
+    Kokkos::deep_copy(m_values, src.m_values);
+    m_marks = Kokkos::View<uint8_t*, ExecSpace>("Digest table marks", m_capacity);
+    Kokkos::deep_copy(m_marks, src.m_marks);
+    m_decisions = Kokkos::View<uint64_t*, ExecSpace>("Digest table decisions", m_capacity/group_size);
+    Kokkos::deep_copy(m_decisions, src.m_decisions);
+    m_old_tags = Kokkos::View<uint8_t*, ExecSpace>("Digest table old tags", m_old_capacity);
+    m_old_keys = Kokkos::View<Key*, ExecSpace>("Digest table old keys", m_old_capacity);
+    m_old_values = Kokkos::View<Value*, ExecSpace>("Digest table old values", m_old_capacity);
+    m_old_marks = Kokkos::View<uint8_t*, ExecSpace>("Digest table old marks", m_old_capacity);
+    if(m_old_capacity > 0) {
+      Kokkos::deep_copy(m_old_tags, src.m_old_tags);
+      Kokkos::deep_copy(m_old_keys, src.m_old_keys);
+      Kokkos::deep_copy(m_old_values, src.m_old_values);
+      Kokkos::deep_copy(m_old_marks, src.m_old_marks);
+    }
+    m_size = Kokkos::View<uint32_t[1], ExecSpace>("Digest table size");
+    if(src.m_size.is_allocated())
+      Kokkos::deep_copy(m_size, src.m_size);
+  }
+
+private:
+  template<class K, class V, class S, class H, class E> friend class DigestTable;
+
+  Kokkos::View<uint8_t*, ExecSpace> m_tags;
+  Kokkos::View<Key*, ExecSpace> m_keys;
+  Kokkos::View<Value*, ExecSpace> m_values;
+  Kokkos::View<uint8_t*, ExecSpace> m_marks;
+  // Last copy chosen by the inserts of each group
+  Kokkos::View<uint64_t*, ExecSpace> m_decisions;
+  uint32_t m_capacity = 0;
+  // Previous generation while it is being migrated
+  Kokkos::View<uint8_t*, ExecSpace> m_old_tags;
+  Kokkos::View<Key*, ExecSpace> m_old_keys;
+  Kokkos::View<Value*, ExecSpace> m_old_values;
+  Kokkos::View<uint8_t*, ExecSpace> m_old_marks;
+  uint32_t m_old_capacity = 0;
+  uint32_t m_migrate_pos = 0;
+  Kokkos::View<uint32_t[1], ExecSpace> m_size;
+
+  /// Slots needed for the given number of entries at a load factor of 7/8
+  static uint32_t slots_for(const uint32_t num_entries) {
+    uint64_t needed = (static_cast<uint64_t>(num_entries)*8)/7 + 1;
+    uint64_t num_slots = group_size;
+    while(num_slots < needed)
+      num_slots *= 2;
+    return static_cast<uint32_t>(num_slots);
+  }
+
+  void allocate(const uint32_t num_slots) {
+    m_capacity = num_slots;
+    m_tags = Kokkos::View<uint8_t*, ExecSpace>("Digest table tags", num_slots);
+    m_keys = Kokkos::View<Key*, ExecSpace>("Digest table keys", num_slots);
+    m_values = Kokkos::View<Value*, ExecSpace>("Digest table values", num_slots);
+    m_marks = Kokkos::View<uint8_t*, ExecSpace>("Digest table marks", num_slots);
+    m_decisions = Kokkos::View<uint64_t*, ExecSpace>("Digest table decisions", num_slots/group_size);
+    Kokkos::deep_copy(m_tags, static_cast<uint8_t>(tag_empty));
+    Kokkos::deep_copy(m_decisions, no_decision);
+  }
+
+  /// Tags of occupied slots have the high bit set and 7 bits of the hash
+  KOKKOS_FORCEINLINE_FUNCTION
+  static uint8_t tag_of(const uint64_t hash) {
+    return static_cast<uint8_t>(0x80 | (hash >> 57));
+  }
+
+  /// Tags of pending copies have the second bit set and 6 bits of the hash
+  KOKKOS_FORCEINLINE_FUNCTION
+  static uint8_t pending_tag_of(const uint64_t hash) {
+    return static_cast<uint8_t>(0x40 | (hash >> 58));
+  }
+
+  KOKKOS_FORCEINLINE_FUNCTION
+  static uint32_t lowest_bit(const uint32_t mask) {
+#if defined(__CUDA_ARCH__) || defined(__HIP_DEVICE_COMPILE__)
+    return __ffs(mask)-1;
+#else
+    return __builtin_ctz(mask);
+#endif
+  }
+
+  /// 0x80 in every byte of x that equals zero
+  KOKKOS_FORCEINLINE_FUNCTION
+  static uint64_t zero_bytes(const uint64_t x) {
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    return ~(((x & low7) + low7) | x | low7);
+  }
+
+  /// Collapse the high bit of each byte into an 8-bit mask
+  KOKKOS_FORCEINLINE_FUNCTION
+  static uint32_t byte_mask(const uint64_t high_bits) {
+    return static_cast<uint32_t>(((high_bits >> 7) * 0x0102040810204080ULL) >> 56);
+  }
+
+  /**
+   * Compare a group of 16 tags with a tag
+   *
+   * \param tags  Pointer to the first tag of the group
+   * \param tag   Tag to look for
+   * \param match Output mask of slots with the tag
+   * \param empty   Output mask of empty slots
+   * \param deleted Output mask of deleted slots
+   */
+  KOKKOS_FORCEINLINE_FUNCTION
+  static void probe_group(const uint8_t* tags, const uint8_t tag,
+                          uint32_t& match, uint32_t& empty, uint32_t& deleted) {
+#ifdef DIGEST_TABLE_SSE2
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags));
+    match = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag)))));
+    empty = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag_empty)))));
+    deleted = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag_deleted)))));
+#else
+    const volatile uint64_t* words = reinterpret_cast<const volatile uint64_t*>(tags);
+    const uint64_t ones = 0x0101010101010101ULL;
+    match = 0; empty = 0; deleted = 0;
+    for(uint32_t w=0; w<group_size/8; w++) {
+      uint64_t word = words[w];
+      match |= byte_mask(zero_bytes(word ^ (ones*tag))) << (8*w);
+      empty |= byte_mask(zero_bytes(word ^ (ones*tag_empty))) << (8*w);
+      deleted |= byte_mask(zero_bytes(word ^ (ones*tag_deleted))) << (8*w);
+    }
+#endif
+  }
+
+  /**
+   * Atomically change a tag. Tags are updated through the aligned 32-bit word that
+   * holds them since not every device has byte sized atomics.
+   *
+   * \param tag_ptr Pointer to the tag
+   * \param expected Tag the slot must have
+   * \param desired  New tag
+   *
+   * \return Whether the tag was changed
+   */
+  KOKKOS_FORCEINLINE_FUNCTION
+  static bool set_tag(uint8_t* tag_ptr, const uint8_t expected, const uint8_t desired) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(tag_ptr);
+    uint32_t* word = reinterpret_cast<uint32_t*>(addr & ~static_cast<uintptr_t>(3));
+    uint32_t shift = 8*static_cast<uint32_t>(addr & 3);
+    uint32_t old_word = *reinterpret_cast<volatile uint32_t*>(word);
+    while(((old_word >> shift) & 0xFF) == expected) {
+      uint32_t new_word = (old_word & ~(0xFFu << shift)) | (static_cast<uint32_t>(desired) << shift);
+      uint32_t prev = Kokkos::atomic_compare_exchange(word, old_word, new_word);
+      if(prev == old_word)
+        return true;
+      old_word = prev;
+    }
+    return false;
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  static uint32_t find_in(const Kokkos::View<uint8_t*, ExecSpace>& tags,
+                          const Kokkos::View<Key*, ExecSpace>& keys,
+                          const uint32_t num_slots, const Key& key) {
+    if(num_slots == 0)
+      return invalid_index;
+    uint64_t hash = Hasher()(key);
+    uint8_t tag = tag_of(hash);
+    uint32_t group_mask = num_slots/group_size - 1;
+    uint32_t group = static_cast<uint32_t>(hash) & group_mask;
+    for(uint32_t probe=0; probe<=group_mask; probe++) {
+      uint32_t match, empty, deleted;
+      probe_group(tags.data()+group*group_size, tag, match, empty, deleted);
+      while(match) {
+        uint32_t slot = group*group_size + lowest_bit(match);
+        if(EqualTo()(keys(slot), key))
+          return slot;
+        match &= match-1;
+      }
+      if(empty)
+        return invalid_index;
+      group = (group + probe + 1) & group_mask;
+    }
+    return invalid_index;
+  }
+
+  /// Turn the pending copy of a decision into an entry, if it is still pending
+  KOKKOS_INLINE_FUNCTION
+  static void finish_decision(const Kokkos::View<uint8_t*, ExecSpace>& tags,
+                              const Kokkos::View<Key*, ExecSpace>& keys,
+                              const uint32_t slot) {
+    if(slot == static_cast<uint32_t>(no_decision))
+      return;
+    uint64_t hash = Hasher()(keys(slot));
+    set_tag(&tags(slot), pending_tag_of(hash), tag_of(hash));
+  }
+
+  KOKKOS_INLINE_FUNCTION
+  insert_result insert_into(const Kokkos::View<uint8_t*, ExecSpace>& tags,
+                            const Kokkos::View<Key*, ExecSpace>& keys,
+                            const Kokkos::View<Value*, ExecSpace>& values,
+                            const Kokkos::View<uint64_t*, ExecSpace>& decisions,
+                            const uint32_t num_slots, const Key& key, const Value& value,
+                            const bool count) const {
+    if(num_slots == 0)
+      return insert_result();
+    uint64_t hash = Hasher()(key);
+    uint8_t tag = tag_of(hash);
+    uint8_t pending = pending_tag_of(hash);
+    uint32_t group_mask = num_slots/group_size - 1;
+    uint32_t home = static_cast<uint32_t>(hash) & group_mask;
+
+    // Claim the first free slot of the probe sequence unless the key is found first
+    uint32_t slot = invalid_index;
+    uint32_t group = home;
+    for(uint32_t probe=0; probe<=group_mask && slot == invalid_index; probe++) {
+      uint32_t match, empty, deleted;
+      probe_group(tags.data()+group*group_size, tag, match, empty, deleted);
+      while(match) {
+        uint32_t i = group*group_size + lowest_bit(match);
+        if(EqualTo()(keys(i), key))
+          return insert_result(i, insert_result::EXISTING);
+        match &= match-1;
+      }
+      uint32_t free = empty | deleted;
+      while(free && slot == invalid_index) {
+        uint32_t bit = lowest_bit(free);
+        uint8_t expected = ((empty >> bit) & 1) ? tag_empty : tag_deleted;
+        if(set_tag(&tags(group*group_size+bit), expected, tag_busy))
+          slot = group*group_size + bit;
+        free &= free-1;
+      }
+      group = (group + probe + 1) & group_mask;
+    }
+    if(slot == invalid_index)
+      return insert_result();
+    keys(slot) = key;
+    values(slot) = value;
+    Kokkos::memory_fence();
+    set_tag(&tags(slot), tag_busy, pending);
+
+    // Keep the copy only if no other copy of the key was decided. A failed swap means
+    // another insert of the same group decided, so that decision is checked next.
+    uint64_t* decision = &decisions(home);
+    while(true) {
+      Kokkos::memory_fence();
+      uint64_t last = *reinterpret_cast<volatile uint64_t*>(decision);
+      finish_decision(tags, keys, static_cast<uint32_t>(last));
+      Kokkos::memory_fence();
+      uint32_t existing = find_in(tags, keys, num_slots, key);
+      if(existing != invalid_index) {
+        set_tag(&tags(slot), pending, tag_deleted);
+        return insert_result(existing, insert_result::EXISTING);
+      }
+      uint64_t round = ((last >> 32) + 1) << 32;
+      if(Kokkos::atomic_compare_exchange(decision, last, round | slot) == last) {
+        set_tag(&tags(slot), pending, tag);
+        // Later inserts no longer need to finish this decision
+        Kokkos::atomic_compare_exchange(decision, round | slot, round | no_decision);
+        if(count)
+          Kokkos::atomic_increment(&m_size(0));
+        return insert_result(slot, insert_result::SUCCESS);
+      }
+    }
+  }
+};
+
+namespace Kokkos {
+template<class Key, class Value, class DstSpace, class SrcSpace, class Hasher, class EqualTo>
+inline void deep_copy(DigestTable<Key,Value,DstSpace,Hasher,EqualTo>& dst,
+                      const DigestTable<Key,Value,SrcSpace,Hasher,EqualTo>& src) {
+  dst.create_copy_view(src);
+}
+}
+
+#endif // KOKKOS_DIGEST_TABLE_HPP
@@ -9,6 +9,11 @@
 #include <climits>
 #include <chrono>
 #include <fstream>
+#include <thread>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <algorithm>
 #include <vector>
 #include <utility>
 #include "kokkos_hash_list.hpp"
@@ -17,6 +22,34 @@
 #include "map_helpers.hpp"
 #include "utils.hpp"
 #include "deduplicator_interface.hpp"
+#include "dedup_state.hpp"
+#include "reference_set.hpp"
+#include "region_map.hpp"
+#include "view_layout.hpp"
+#include "chkpt_chain.hpp"
+#include "cow_snapshot.hpp"
+#include "storage_emulator.hpp"
+#include "chkpt_prefetch.hpp"
+
+/**
+ * Background checkpoint and the snapshot it reads. Shared with the copies of the
+ * deduplicator captured by kernels, the last owner waits for the checkpoint.
+ */
+struct AsyncChkpt {
+  std::thread thread;
+  std::unique_ptr<CowSnapshot> snapshot;
+  std::exception_ptr error; // Error of the checkpoint, rethrown by wait_async
+
+  ~AsyncChkpt() {
+    if(thread.joinable()) {
+      if(thread.get_id() == std::this_thread::get_id()) {
+        thread.detach();
+      } else {
+        thread.join();
+      }
+    }
+  }
+};
 
 class ListDeduplicator : public BaseDeduplicator {
   public:
@@ -29,12 +62,47 @@ class ListDeduplicator : public BaseDeduplicator {
     void dedup_data(const uint8_t* data_ptr, 
                     const size_t len);
 
+    void dedup_data(const RegionMap& regions);
+
+    void setup_dedup(const size_t len, 
+                     bool make_baseline);
+
+    void setup_stream(const size_t len, 
+                      uint32_t window_chunks, 
+                      bool make_baseline);
+
+    void dedup_window(const uint8_t* window_ptr, 
+                      uint64_t window_len, 
+                      uint32_t first_chunk);
+
+    void checkpoint_windows(uint64_t len, 
+                            const std::function<void(uint64_t,uint64_t,uint8_t*)>& read_window,
+                            uint64_t window_len, 
+                            std::string& filename, 
+                            std::string& logname, 
+                            bool make_baseline);
+
+    std::shared_ptr<AsyncChkpt> async_chkpt; // Background checkpoint started by checkpoint_async
+
+    std::pair<uint64_t,uint64_t> 
+    count_diff(header_t& header);
+
     std::pair<uint64_t,uint64_t> 
     collect_diff( const uint8_t* data_ptr, 
                   const size_t len,
                   Kokkos::View<uint8_t*>& buffer_d, 
                   header_t& header);
 
+    std::pair<uint64_t,uint64_t> 
+    collect_diff( const RegionMap& regions,
+                  Kokkos::View<uint8_t*>& buffer_d, 
+                  header_t& header);
+
+    void checkpoint(header_t& header, 
+                    const RegionMap& regions, 
+                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                    bool make_baseline);
+
     std::pair<double,double>
     restart_chkpt( std::vector<Kokkos::View<uint8_t*>::HostMirror>& incr_chkpts,
                    const int chkpt_idx, 
@@ -131,6 +199,157 @@ class ListDeduplicator : public BaseDeduplicator {
                     std::string& logname, 
                     bool make_baseline) override;
 
+    /**
+     * Checkpoint several device buffers as one logical checkpoint. Chunks are hashed and
+     * copied in place and identical chunks in different regions are deduplicated. Each
+     * region starts at a chunk boundary of the logical data. Save checkpoint to host view.
+     *
+     * \param regions       Regions to checkpoint, in order
+     * \param diff_h        Host View to store incremental checkpoint
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    void checkpoint(std::vector<region_t>& regions, 
+                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                    bool make_baseline);
+
+    /**
+     * Checkpoint several device buffers as one logical checkpoint and save it to a file.
+     *
+     * \param regions       Regions to checkpoint, in order
+     * \param filename      Filename to save checkpoint
+     * \param logname       Base filename for logs
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    void checkpoint(std::vector<region_t>& regions, 
+                    std::string& filename, 
+                    std::string& logname, 
+                    bool make_baseline);
+
+    /**
+     * Checkpoint a file too large for device memory. The file is read in windows, the
+     * next window being read while the current one is deduplicated. Only one window of
+     * data and digests is on the device at a time. The digests of the whole file are
+     * kept on the Host. The first occurrence index stays on the device and has an entry
+     * for every distinct chunk, so it grows with the file unless an index policy bounds
+     * it. The checkpoint stores the same chunks and metadata as one made from the whole
+     * file. A deduplicator that streams checkpoints can only make streamed checkpoints.
+     * Throws std::ios_base::failure if the file cannot be read or has more than
+     * 2^32-1 chunks.
+     *
+     * \param data_file     File with the data to checkpoint
+     * \param window_len    Length of a window in bytes, rounded down to a multiple of
+     *                      the chunk size
+     * \param filename      Filename to save checkpoint
+     * \param logname       Base filename for logs
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    void checkpoint_stream(std::string& data_file, 
+                           uint64_t window_len, 
+                           std::string& filename, 
+                           std::string& logname, 
+                           bool make_baseline);
+
+    /**
+     * Checkpoint Host data in the background. The pages of the data are write protected
+     * and the function returns right away. The checkpoint is streamed from the live pages
+     * in windows like checkpoint_stream. Pages written by the application before their
+     * window is read are copied first, so the checkpoint holds the data as it was when
+     * checkpoint_async was called. A previous background checkpoint is waited for first
+     * and every other call of the deduplicator waits for it too.
+     *
+     * The kernels and copies of the checkpoint run on the default execution space
+     * instance from the checkpoint thread, so the application may keep computing on the
+     * Host but must not launch Kokkos kernels, copies, or fences until wait_async
+     * returns: Host backends cannot run kernels launched from two threads at once, and
+     * on devices the work of both threads would be serialized on one instance. The data
+     * may only be written by the CPU, system calls such as read() or recv() into the
+     * data fail with EFAULT while it is protected (see CowSnapshot).
+     *
+     * \param data_ptr      Host pointer to the data
+     * \param len           Length of data
+     * \param window_len    Length of a window in bytes, rounded down to a multiple of
+     *                      the chunk size
+     * \param filename      Filename to save checkpoint
+     * \param logname       Base filename for logs
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    void checkpoint_async(uint8_t* data_ptr, 
+                          size_t len, 
+                          uint64_t window_len, 
+                          std::string& filename, 
+                          std::string& logname, 
+                          bool make_baseline);
+
+    /**
+     * Wait for the background checkpoint and lift the remaining write protection.
+     * Rethrows the error that stopped the checkpoint, if any.
+     *
+     * \return Number of pages copied because they were written during the checkpoint
+     */
+    uint64_t wait_async();
+
+    /**
+     * Dry run of a checkpoint. Predicts the size of the checkpoint and the cost of
+     * restarting it without gathering chunks or copying the checkpoint to the Host.
+     * Chunks are deduplicated against copies of the list and first occurrence map.
+     *
+     * \param data_ptr      Raw data pointer that needs to be deduplicated
+     * \param len           Length of data
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     *
+     * \return Predicted header, data and metadata sizes, and restart read volume
+     */
+    chkpt_plan_t plan(uint8_t* data_ptr, 
+                      size_t len, 
+                      bool make_baseline) override;
+
+    /**
+     * Save the state needed to continue deduplicating after a job restart.
+     * Saves the checkpoint IDs, the current chain, the list of chunk digests, and the
+     * first occurrence map.
+     *
+     * \param filename File to save the state in
+     */
+    void save_state(const std::string& filename) override;
+
+    /**
+     * Load a state saved by save_state. The next checkpoint continues the saved chain.
+     *
+     * \param filename File with the saved state
+     *
+     * \return Whether the state was saved by the same approach with the same chunk size
+     */
+    bool load_state(const std::string& filename) override;
+
+    /**
+     * Rebuild the state from the data of a restarted checkpoint.
+     * Hashes the chunks of the restarted data into the list and indexes every chunk as
+     * found in the restarted checkpoint.
+     *
+     * \param data            Data restarted from checkpoint chkpt_id
+     * \param chkpt_filenames Checkpoint files of the chain, as passed to restart
+     * \param chkpt_id        ID of the restarted checkpoint
+     *
+     * \return Whether the checkpoint chain could be read
+     */
+    bool rebuild_state(Kokkos::View<uint8_t*> data,
+                       std::vector<std::string>& chkpt_filenames,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Seed the list and the first occurrence map with reference datasets. Every chunk of
+     * the reference image is indexed as a first occurrence of the reference checkpoint.
+     *
+     * \param reference_files Files with the reference data
+     * \param len             Length of the data that will be checkpointed
+     * \param chkpt_h         Output reference checkpoint on the Host
+     *
+     * \return Whether the files could be read
+     */
+    bool seed_reference(std::vector<std::string>& reference_files,
+                        size_t len,
+                        Kokkos::View<uint8_t*>::HostMirror& chkpt_h) override;
+
     /**
      * Restart checkpoint from vector of incremental checkpoints loaded on the Host.
      *
@@ -173,6 +392,108 @@ class ListDeduplicator : public BaseDeduplicator {
                  std::string& logname, 
                  uint32_t chkpt_id) override;
 
+    /**
+     * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+     * on the Host. Only chunks overlapping [offset, offset+length) are restarted.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart_range(Kokkos::View<uint8_t*>& data,
+                       uint64_t offset,
+                       uint64_t length,
+                       std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts,
+                       std::string& logname,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+     * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+     * are read.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param filenames  Vector of prior incremental checkpoints stored in files
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart_range(Kokkos::View<uint8_t*>& data,
+                       uint64_t offset,
+                       uint64_t length,
+                       std::vector<std::string>& chkpt_filenames,
+                       std::string& logname,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Restart a multi-region checkpoint from vector of incremental checkpoints loaded on
+     * the Host. Each region is restarted in place through the chain.
+     *
+     * \param regions    Regions to restart into, in the order they were checkpointed
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart(std::vector<region_t>& regions, 
+                 std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                 std::string& logname, 
+                 uint32_t chkpt_id);
+
+    /**
+     * Restart a multi-region checkpoint from checkpoint files. Each region is restarted
+     * in place through the chain.
+     *
+     * \param regions    Regions to restart into, in the order they were checkpointed
+     * \param filenames  Vector of prior incremental checkpoints stored in files
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart(std::vector<region_t>& regions, 
+                 std::vector<std::string>& chkpt_filenames, 
+                 std::string& logname, 
+                 uint32_t chkpt_id);
+
+    /**
+     * Checkpoint a View of any rank and layout. The View is traversed through its
+     * strides and each contiguous innermost run is deduplicated in place as a region, so
+     * strided subviews and multi-dimensional Views are not packed first. Views whose runs
+     * are shorter than a chunk are packed into a scratch buffer.
+     *
+     * \param view          Device View to checkpoint
+     * \param diff_h        Host View to store incremental checkpoint
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    template<class ViewType, 
+             typename std::enable_if<Kokkos::is_view<ViewType>::value, int>::type = 0>
+    void checkpoint(const ViewType& view, 
+                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                    bool make_baseline) {
+      checkpoint_view(*this, chunk_size, view, diff_h, make_baseline);
+    }
+
+    /**
+     * Restart a checkpoint of a View of any rank and layout into a View with the same
+     * extents and layout.
+     *
+     * \param view       Device View to restart into
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host or
+     *                   filenames of prior incremental checkpoints
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    template<class ViewType, class ChkptType, 
+             typename std::enable_if<Kokkos::is_view<ViewType>::value, int>::type = 0>
+    void restart(const ViewType& view, 
+                 std::vector<ChkptType>& chkpts, 
+                 std::string& logname, 
+                 uint32_t chkpt_id) {
+      restart_view(*this, chunk_size, view, chkpts, logname, chkpt_id);
+    }
+
     /**
      * Write logs for the checkpoint metadata/data breakdown, runtimes, and the overall summary.
      * The data breakdown log shows the proportion of data and metadata as well as how much 
@@ -3,6 +3,7 @@
 #include <Kokkos_Core.hpp>
 #include <Kokkos_UnorderedMap.hpp>
 #include <climits>
+#include "kokkos_digest_table.hpp"
 
 struct alignas(16) HashDigest {
   uint8_t digest[16];
@@ -84,6 +85,29 @@ struct digest_hash {
   }
 };
 
+// Mixes the whole digest so that both the group index and the tag bits of DigestTable
+// are well distributed
+struct digest_hash64 {
+  using argument_type = HashDigest;
+  using result_type   = uint64_t;
+
+  KOKKOS_FORCEINLINE_FUNCTION
+  static uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+  }
+
+  KOKKOS_FORCEINLINE_FUNCTION
+  uint64_t operator()(HashDigest const& digest) const {
+    const uint64_t* digest_ptr = (const uint64_t*) digest.digest;
+    return fmix64(digest_ptr[0] ^ fmix64(digest_ptr[1]));
+  }
+};
+
 struct digest_equal_to {
   using first_argument_type  = HashDigest;
   using second_argument_type = HashDigest;
@@ -102,8 +126,13 @@ struct digest_equal_to {
   }
 };
 
+#ifdef DIGEST_UNORDERED_MAP
 template<class Value, class ExecSpace>
 using DigestMap = Kokkos::UnorderedMap<HashDigest, Value, ExecSpace, digest_hash, digest_equal_to>;
+#else
+template<class Value, class ExecSpace>
+using DigestMap = DigestTable<HashDigest, Value, ExecSpace, digest_hash64, digest_equal_to>;
+#endif
 using DigestNodeIDDeviceMap = DigestMap<NodeID, Kokkos::DefaultExecutionSpace>;
 using DigestNodeIDHostMap   = DigestMap<NodeID, Kokkos::DefaultHostExecutionSpace>;
 using DigestIdxDeviceMap = DigestMap<uint32_t, Kokkos::DefaultExecutionSpace>;
@@ -111,5 +140,110 @@ using DigestIdxHostMap   = DigestMap<uint32_t, Kokkos::DefaultHostExecutionSpace
 
 using IdxNodeIDDeviceMap = Kokkos::UnorderedMap<uint32_t, NodeID>;
 using IdxNodeIDHostMap = Kokkos::UnorderedMap<uint32_t, NodeID, Kokkos::DefaultHostExecutionSpace>;
+
+/**
+ * Make sure a map can hold the given number of entries. UnorderedMaps are rehashed
+ * in one step, DigestTables grow incrementally.
+ *
+ * \param map         Map to resize
+ * \param num_entries Number of entries the map must hold
+ */
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+void reserve_entries(Kokkos::UnorderedMap<Key,Value,ExecSpace,Hasher,EqualTo>& map, uint32_t num_entries) {
+  if(map.capacity() < num_entries)
+    map.rehash(num_entries);
+}
+
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+void reserve_entries(DigestTable<Key,Value,ExecSpace,Hasher,EqualTo>& map, uint32_t num_entries) {
+  map.reserve(num_entries);
+}
+
+/**
+ * Selects which first occurrence entries to keep when compacting an index. Entries
+ * from checkpoints before min_tree are evicted. Interior tree nodes from checkpoints 
+ * before unmatched_tree are dropped unless they have been matched since.
+ */
+struct KeepFirstOcur {
+  uint32_t min_tree;       // Oldest checkpoint that can still be referenced
+  uint32_t unmatched_tree; // Unmatched interior nodes before this checkpoint are dropped
+  uint32_t num_interior;   // Number of interior nodes, 0 for the List approach
+
+  KOKKOS_INLINE_FUNCTION
+  bool operator()(const HashDigest& digest, const NodeID& info, const bool marked) const {
+    if(info.tree < min_tree)
+      return false;
+    if(!marked && (info.node < num_interior) && (info.tree < unmatched_tree))
+      return false;
+    return true;
+  }
+};
+
+/**
+ * Record that the entry at index i matched a duplicate. UnorderedMaps do not track
+ * matches so compaction treats all of their entries as matched.
+ */
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+KOKKOS_INLINE_FUNCTION
+void mark_entry(const Kokkos::UnorderedMap<Key,Value,ExecSpace,Hasher,EqualTo>& map, uint32_t i) {}
+
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+KOKKOS_INLINE_FUNCTION
+void mark_entry(const DigestTable<Key,Value,ExecSpace,Hasher,EqualTo>& map, uint32_t i) {
+  map.mark(i);
+}
+
+/**
+ * Remove the entries rejected by keep and leave room for extra more entries.
+ * UnorderedMaps are copied into a new map since they cannot be rebuilt in place.
+ *
+ * \param map   Map to compact
+ * \param keep  Functor called as keep(key, value, marked), true keeps the entry
+ * \param extra Number of entries to leave room for
+ *
+ * \return Number of entries removed
+ */
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo, class Keep>
+uint32_t compact_entries(Kokkos::UnorderedMap<Key,Value,ExecSpace,Hasher,EqualTo>& map, const Keep& keep, uint32_t extra) {
+  using map_type = Kokkos::UnorderedMap<Key,Value,ExecSpace,Hasher,EqualTo>;
+  uint32_t num_entries = map.size();
+  map_type old_map = map;
+  map_type new_map(num_entries+extra);
+  Kokkos::parallel_for("Compact map", Kokkos::RangePolicy<ExecSpace>(0, old_map.capacity()), KOKKOS_LAMBDA(const uint32_t i) {
+    if(old_map.valid_at(i) && keep(old_map.key_at(i), old_map.value_at(i), true))
+      new_map.insert(old_map.key_at(i), old_map.value_at(i));
+  });
+  Kokkos::fence();
+  map = new_map;
+  return num_entries - map.size();
+}
+
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo, class Keep>
+uint32_t compact_entries(DigestTable<Key,Value,ExecSpace,Hasher,EqualTo>& map, const Keep& keep, uint32_t extra) {
+  return map.compact(keep, extra);
+}
+
+/// Number of slot indices of a map that can be passed to valid_at
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+uint32_t map_num_slots(const Kokkos::UnorderedMap<Key,Value,ExecSpace,Hasher,EqualTo>& map) {
+  return map.capacity();
+}
+
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+uint32_t map_num_slots(const DigestTable<Key,Value,ExecSpace,Hasher,EqualTo>& map) {
+  return map.num_slots();
+}
+
+/// Approximate device memory used by a map
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+uint64_t map_memory_bytes(const Kokkos::UnorderedMap<Key,Value,ExecSpace,Hasher,EqualTo>& map) {
+  // Keys, values, next index, and hash list entry per slot plus the occupancy bitset
+  return static_cast<uint64_t>(map.capacity())*(sizeof(Key)+sizeof(Value)+2*sizeof(uint32_t)) + map.capacity()/8;
+}
+
+template<class Key, class Value, class ExecSpace, class Hasher, class EqualTo>
+uint64_t map_memory_bytes(const DigestTable<Key,Value,ExecSpace,Hasher,EqualTo>& map) {
+  return map.memory_bytes();
+}
 #endif
 
@@ -0,0 +1,88 @@
+#ifndef REFERENCE_SET_HPP
+#define REFERENCE_SET_HPP
+
+#include <Kokkos_Core.hpp>
+#include <string>
+#include <vector>
+#include "utils.hpp"
+
+/** \class ReferenceSet
+ *  \brief Read-only reference datasets mapped into memory
+ *
+ *  The files are memory mapped and read as one image, the concatenation of the files
+ *  in order. Reads past the end of the last file return zeros so the image can be
+ *  extended to the length of the checkpointed data.
+ */
+class ReferenceSet {
+  public:
+    /**
+     * Map the reference files. Failures are reported and leave the set invalid.
+     *
+     * \param reference_files Files in the order they appear in the image
+     */
+    ReferenceSet(const std::vector<std::string>& reference_files);
+
+    ~ReferenceSet();
+
+    ReferenceSet(const ReferenceSet&) = delete;
+    ReferenceSet& operator=(const ReferenceSet&) = delete;
+
+    /// Whether every file could be mapped
+    bool valid() const { return ok; }
+
+    /// Total size of the files in bytes
+    uint64_t size() const { return total_size; }
+
+    const std::vector<std::string>& files() const { return names; }
+
+    const std::vector<uint64_t>& file_sizes() const { return sizes; }
+
+    /**
+     * Read bytes of the reference image
+     *
+     * \param offset Byte offset in the image
+     * \param len    Number of bytes to read
+     * \param dst    Host buffer to read into
+     */
+    void read(uint64_t offset, uint64_t len, uint8_t* dst) const;
+
+  private:
+    std::vector<std::string> names;
+    std::vector<uint64_t> sizes;
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t*> maps;
+    uint64_t total_size;
+    bool ok;
+};
+
+/**
+ * Write a reference checkpoint. It takes the place of the baseline of a chain seeded
+ * from reference datasets and only names the files: the header (ref_id == chkpt_id, no
+ * entries), the magic "DDREFSET", the number of files, and the size and name of each.
+ * Every chunk of the image is a first occurrence of the reference checkpoint.
+ *
+ * \param header  Header of the reference checkpoint
+ * \param refs    Mapped reference files
+ * \param chkpt_h Output reference checkpoint on the Host
+ */
+void write_reference_chkpt(const header_t& header,
+                           const ReferenceSet& refs,
+                           Kokkos::View<uint8_t*>::HostMirror& chkpt_h);
+
+/**
+ * Copy the start of the reference image to the device
+ *
+ * \param refs    Mapped reference files
+ * \param image_d Device View filled with the first image_d.size() bytes of the image
+ */
+void read_reference_image(const ReferenceSet& refs, Kokkos::View<uint8_t*>& image_d);
+
+/**
+ * Whether a checkpoint header may belong to a reference checkpoint. Only the header is
+ * checked, the magic after it confirms the checkpoint is a reference.
+ *
+ * \param header Checkpoint header
+ */
+bool maybe_reference_chkpt(const header_t& header);
+
+#endif // REFERENCE_SET_HPP
@@ -0,0 +1,120 @@
+#ifndef REGION_MAP_HPP
+#define REGION_MAP_HPP
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Named region of device memory that is part of a multi-region checkpoint
+typedef struct region_t {
+  uint8_t* ptr;       // Device pointer to the region
+  uint64_t len;       // Length of the region in bytes
+  std::string name;   // Name used in messages
+} region_t;
+
+/** \class RegionMap
+ *  \brief Layout of several device buffers deduplicated as one checkpoint
+ *
+ *  The regions are laid out back to back in one logical buffer. Every region starts at
+ *  a chunk boundary so that chunks never span two regions and can be hashed and copied
+ *  in place. The last chunk of a region is partial and the logical bytes up to the next
+ *  region are zeros. A single buffer is a map with one region.
+ */
+class RegionMap {
+public:
+  /// Device pointers of the regions
+  Kokkos::View<uintptr_t*> ptrs_d;
+  /// Logical offset of the start of each region
+  Kokkos::View<uint64_t*> starts_d;
+  /// Logical offset of the end of each region
+  Kokkos::View<uint64_t*> ends_d;
+  /// Logical offsets of the regions. Host mirrors
+  Kokkos::View<uint64_t*>::HostMirror starts_h;
+  Kokkos::View<uint64_t*>::HostMirror ends_h;
+  uint32_t num_regions;
+  /// Length of the logical buffer in bytes
+  uint64_t len;
+
+  /// empty constructor
+  RegionMap() {
+    num_regions = 0;
+    len = 0;
+  }
+
+  /**
+   * Map a single contiguous buffer
+   *
+   * \param data_ptr Device pointer to the buffer
+   * \param data_len Length of the buffer in bytes
+   */
+  RegionMap(const uint8_t* data_ptr, uint64_t data_len) {
+    std::vector<region_t> regions(1);
+    regions[0].ptr = const_cast<uint8_t*>(data_ptr);
+    regions[0].len = data_len;
+    init(regions, 1);
+  }
+
+  /**
+   * Lay out several buffers
+   *
+   * \param regions    Regions in the order they appear in the logical buffer
+   * \param chunk_size Size of chunks, regions start at a multiple of it
+   */
+  RegionMap(const std::vector<region_t>& regions, uint32_t chunk_size) {
+    init(regions, chunk_size);
+  }
+
+  /**
+   * Find the bytes of a chunk of the logical buffer
+   *
+   * \param chunk      Chunk index
+   * \param chunk_size Size of chunks
+   * \param num_bytes  Output number of bytes of the chunk stored in its region
+   *
+   * \return Device pointer to the start of the chunk
+   */
+  KOKKOS_INLINE_FUNCTION const uint8_t* chunk_ptr(uint32_t chunk, uint32_t chunk_size, uint32_t& num_bytes) const {
+    uint64_t offset = static_cast<uint64_t>(chunk)*static_cast<uint64_t>(chunk_size);
+    // Last region starting at or before the offset. Empty regions share their start
+    // with the next region and are skipped.
+    uint32_t lo = 0;
+    uint32_t hi = num_regions-1;
+    while(lo < hi) {
+      uint32_t mid = (lo+hi+1)/2;
+      if(starts_d(mid) <= offset) {
+        lo = mid;
+      } else {
+        hi = mid-1;
+      }
+    }
+    uint64_t remaining = ends_d(lo) - offset;
+    num_bytes = (remaining < chunk_size) ? static_cast<uint32_t>(remaining) : chunk_size;
+    return reinterpret_cast<const uint8_t*>(ptrs_d(lo)) + (offset - starts_d(lo));
+  }
+
+private:
+  void init(const std::vector<region_t>& regions, uint32_t chunk_size) {
+    num_regions = static_cast<uint32_t>(regions.size());
+    ptrs_d = Kokkos::View<uintptr_t*>("Region pointers", num_regions);
+    starts_d = Kokkos::View<uint64_t*>("Region starts", num_regions);
+    ends_d = Kokkos::View<uint64_t*>("Region ends", num_regions);
+    auto ptrs_h = Kokkos::create_mirror_view(ptrs_d);
+    starts_h = Kokkos::create_mirror_view(starts_d);
+    ends_h = Kokkos::create_mirror_view(ends_d);
+    uint64_t offset = 0;
+    len = 0;
+    for(uint32_t i=0; i<num_regions; i++) {
+      ptrs_h(i) = reinterpret_cast<uintptr_t>(regions[i].ptr);
+      starts_h(i) = offset;
+      ends_h(i) = offset + regions[i].len;
+      offset = ((ends_h(i)+chunk_size-1)/chunk_size)*chunk_size;
+      if(regions[i].len > 0)
+        len = ends_h(i);
+    }
+    Kokkos::deep_copy(ptrs_d, ptrs_h);
+    Kokkos::deep_copy(starts_d, starts_h);
+    Kokkos::deep_copy(ends_d, ends_h);
+  }
+};
+
+#endif // REGION_MAP_HPP
@@ -0,0 +1,110 @@
+#ifndef RESTART_PLAN_HPP
+#define RESTART_PLAN_HPP
+
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chain_manifest.hpp"
+#include "chkpt_chain.hpp"
+#include "chkpt_writer.hpp"
+
+// First word of a restart plan file
+#define RESTART_PLAN_MAGIC "DEDUP_RESTART_PLAN"
+#define RESTART_PLAN_VERSION 1
+
+/** \struct restart_plan_t
+ *  \brief Where every byte of a restarted checkpoint is stored in its chain
+ */
+typedef struct restart_plan_t {
+  uint32_t chkpt_id;                       // ID of the restarted checkpoint
+  uint64_t datalen;                        // Length of the restarted data in bytes
+  std::map<uint32_t, std::string> digests; // Manifest digest of each checkpoint of the restart
+  std::vector<ChunkRun> runs;              // Runs of bytes in the order of the restarted data
+} restart_plan_t;
+
+/** \class RestartPlanCache
+ *  \brief Resolved restarts kept in memory and in files next to the chain manifest
+ *
+ *  A plan maps the restarted data to the bytes of the checkpoints holding it, so a
+ *  restart with a plan copies those bytes from the files in the manifest without
+ *  reading any header or metadata. Plans are saved to MANIFEST.plan.ID and are only
+ *  used while the manifest digests of the checkpoints they were resolved from are
+ *  unchanged, so re-recording any of those checkpoints invalidates the plan. Restarts
+ *  reading from a reference set are not cached.
+ */
+class RestartPlanCache {
+  public:
+    /**
+     * Open the cache of a manifest. The manifest must outlive the cache.
+     *
+     * \param manifest      Manifest of the chain
+     * \param manifest_file File of the manifest, which plan files are named after
+     */
+    RestartPlanCache(const ChainManifest& manifest, const std::string& manifest_file);
+
+    /**
+     * Find a plan still valid for the manifest, in memory or else in its plan file. A
+     * plan file is only used if its runs cover the data in order from offset 0 and each
+     * run lies within its checkpoint as recorded in the manifest.
+     *
+     * \param chkpt_id ID of the restarted checkpoint
+     * \param plan     Output plan
+     *
+     * \return Whether a valid plan was found
+     */
+    bool find(uint32_t chkpt_id, restart_plan_t& plan);
+
+    /**
+     * Resolve the restart of a checkpoint through its chain and cache the plan. A plan
+     * that cannot be saved is still kept in memory. Throws std::ios_base::failure if
+     * the chain misses a chunk or its runs do not cover the data, so no partial plan is
+     * cached.
+     *
+     * \param chain    Chain indexed by checkpoint ID
+     * \param chkpt_id ID of the restarted checkpoint
+     * \param plan     Output plan
+     *
+     * \return Whether the restart could be planned, false if it reads a reference set
+     */
+    bool resolve(ChkptChain& chain, uint32_t chkpt_id, restart_plan_t& plan);
+
+    /**
+     * Restart data by copying the runs of a plan from the checkpoint files. Throws
+     * std::ios_base::failure if a checkpoint cannot be read.
+     *
+     * \param plan   Plan of the restart
+     * \param config Writer configuration used to read the checkpoints, whose
+     *               stripe_threads checkpoints are read at the same time
+     * \param data   Device View to store the data in
+     *
+     * \return Time spent copying the data from host to device and restarting the data
+     */
+    std::pair<double,double> restart(const restart_plan_t& plan,
+                                     const writer_config_t& config,
+                                     Kokkos::View<uint8_t*>& data) const;
+
+    /// File holding the plan of a checkpoint
+    std::string plan_file(uint32_t chkpt_id) const;
+
+    /// Plans found valid
+    uint64_t num_hits() const;
+
+    /// Plans missing or invalidated by the manifest
+    uint64_t num_misses() const;
+
+  private:
+    const ChainManifest& manifest;
+    std::string prefix;
+    std::map<uint32_t, restart_plan_t> plans;
+    uint64_t hits;
+    uint64_t misses;
+
+    bool valid(const restart_plan_t& plan) const;
+    bool load(uint32_t chkpt_id, restart_plan_t& plan) const;
+    void save(const restart_plan_t& plan) const;
+};
+
+#endif // RESTART_PLAN_HPP
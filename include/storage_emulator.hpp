@@ -0,0 +1,127 @@
+#ifndef STORAGE_EMULATOR_HPP
+#define STORAGE_EMULATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+// Performance of the emulated storage
+typedef struct storage_model_t {
+  std::string dir;           // Directory whose files are emulated, empty disables the emulator
+  uint64_t write_bandwidth;  // Aggregate write bandwidth in bytes per second, 0 for no limit
+  uint64_t read_bandwidth;   // Aggregate read bandwidth in bytes per second, 0 for no limit
+  double latency;            // Seconds added to every read and write
+  double metadata_cost;      // Seconds of every open, create, and rename
+  uint32_t max_concurrency;  // Reads and writes in service at once, 0 for no limit
+} storage_model_t;
+
+// Work done by the emulated storage
+typedef struct storage_stats_t {
+  uint64_t bytes_written;    // Bytes written to emulated files
+  uint64_t bytes_read;       // Bytes read from emulated files
+  uint64_t num_transfers;    // Reads and writes of emulated files
+  uint64_t num_metadata_ops; // Opens, creates, and renames of emulated files
+  double delay;              // Seconds callers were held back in total
+} storage_stats_t;
+
+/**
+ * Default storage model, nothing is emulated
+ */
+storage_model_t default_storage_model();
+
+/**
+ * Read the storage emulator flags of the command line tools
+ *   --emulate-dir DIR         : Directory whose files are emulated
+ *   --emulate-write-bw B      : Aggregate write bandwidth in bytes per second
+ *   --emulate-read-bw B       : Aggregate read bandwidth in bytes per second
+ *   --emulate-latency US      : Microseconds added to every read and write
+ *   --emulate-metadata US     : Microseconds of every open, create, and rename
+ *   --emulate-concurrency N   : Reads and writes in service at once
+ *
+ * \param argc Number of arguments
+ * \param argv Arguments
+ *
+ * \return Storage model, the default one for flags that are not given
+ */
+storage_model_t get_storage_model(int argc, char** argv);
+
+/**
+ * Emulate slower storage for every file under a directory. Reads and writes of these
+ * files share the bandwidth of the model, each one finishing no earlier than its share
+ * of the bandwidth and the latency allow, with at most max_concurrency of them in
+ * service. Opens, creates, and renames are served one at a time by an emulated metadata
+ * server. The data itself is stored in the directory as usual. Applies to the whole
+ * process and resets the statistics.
+ *
+ * \param model Storage model
+ */
+void set_storage_model(const storage_model_t& model);
+
+/**
+ * Statistics of the emulated storage since the model was set
+ */
+storage_stats_t get_storage_stats();
+
+/**
+ * Whether a file is stored in the emulated directory
+ *
+ * \param path File
+ */
+bool storage_emulated(const std::string& path);
+
+/**
+ * Open a file, paying the metadata cost if it is emulated. Reads and writes of the
+ * returned descriptor through pread_all and pwrite_all are emulated.
+ *
+ * \return File descriptor, or -1 with errno set
+ */
+int storage_open(const std::string& path, int flags, mode_t mode=0644);
+
+/**
+ * Close a file opened with storage_open
+ *
+ * \return Result of close
+ */
+int storage_close(int fd);
+
+/**
+ * Rename a file, paying the metadata cost if it is emulated
+ *
+ * \return Result of rename
+ */
+int storage_rename(const std::string& from, const std::string& to);
+
+/**
+ * Pay the metadata cost of opening an emulated file through a stream
+ *
+ * \param path File
+ */
+void storage_metadata(const std::string& path);
+
+/**
+ * Pay the cost of a read or write of an emulated file done through a stream or a
+ * mapping
+ *
+ * \param path  File
+ * \param len   Number of bytes
+ * \param write Whether the bytes were written
+ */
+void storage_transfer(const std::string& path, uint64_t len, bool write);
+
+/**
+ * Whether a descriptor was opened on an emulated file
+ *
+ * \param fd File descriptor from storage_open
+ */
+bool storage_fd_emulated(int fd);
+
+/**
+ * Pay the cost of a read or write of a descriptor opened on an emulated file
+ *
+ * \param fd    File descriptor from storage_open
+ * \param len   Number of bytes
+ * \param write Whether the bytes were written
+ */
+void storage_transfer_fd(int fd, uint64_t len, bool write);
+
+#endif // STORAGE_EMULATOR_HPP
@@ -0,0 +1,123 @@
+#ifndef STRIPED_IO_HPP
+#define STRIPED_IO_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chkpt_writer.hpp"
+
+// Extension of the layout file of a checkpoint split over several files
+#define STRIPE_LAYOUT_EXT ".stripes"
+
+/** \struct stripe_layout_t
+ *  \brief Where the stripes of a checkpoint are stored
+ *
+ *  Stripe i of the checkpoint is stored in files[i % files.size()] at offset
+ *  (i / files.size()) * stripe_size. The first file is the checkpoint file itself. A
+ *  checkpoint in a single file has no layout file and is read as one file.
+ */
+typedef struct stripe_layout_t {
+  uint64_t stripe_size;             // Size of each stripe in bytes
+  uint64_t total_len;               // Length of the checkpoint in bytes
+  std::vector<std::string> files;   // Files holding the stripes, in round robin order
+} stripe_layout_t;
+
+/**
+ * Run a function for each index in [0, num_items) on up to num_threads threads. Items
+ * are handed out one at a time so threads that finish early take more items.
+ */
+template<typename Func>
+void
+parallel_items(uint64_t num_items, uint32_t num_threads, Func func) {
+  uint64_t n = std::min(static_cast<uint64_t>(std::max(num_threads, 1u)), num_items);
+  std::atomic<uint64_t> next(0);
+  auto worker = [&]() {
+    uint64_t item;
+    while((item = next.fetch_add(1)) < num_items) {
+      func(item);
+    }
+  };
+  std::vector<std::thread> threads;
+  for(uint64_t t=1; t<n; t++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for(uint32_t t=0; t<threads.size(); t++) {
+    threads[t].join();
+  }
+}
+
+/**
+ * Write a Host checkpoint in stripes of config.stripe_size bytes, with
+ * config.stripe_threads threads issuing pwrite concurrently. Stripes are spread round
+ * robin over config.stripe_files files, or one file per directory of config.stripe_dirs
+ * plus the checkpoint file if that is more. Extra files are named after the checkpoint
+ * with the extension .stripe<i> and placed in the directory of the checkpoint and the
+ * stripe directories in turn. A layout file with the extension STRIPE_LAYOUT_EXT then
+ * lists the files. Throws std::ios_base::failure if any write fails.
+ *
+ * \param filename    Checkpoint file
+ * \param data        Host checkpoint
+ * \param len         Length of the checkpoint in bytes
+ * \param config      Writer configuration
+ * \param split_files Whether the checkpoint may be split over several files. Only
+ *                    checkpoints that are always read back whole should be split.
+ *
+ * \return Number of bytes written
+ */
+uint64_t write_striped(const std::string& filename,
+                       const uint8_t* data,
+                       uint64_t len,
+                       const writer_config_t& config,
+                       bool split_files);
+
+/**
+ * Layout of a checkpoint, read from its layout file if it was split over several files
+ *
+ * \param filename Checkpoint file
+ * \param layout   Output layout. A checkpoint in a single file gets one file and a
+ *                 stripe size of the file length.
+ *
+ * \return Whether the checkpoint exists
+ */
+bool read_stripe_layout(const std::string& filename, stripe_layout_t& layout);
+
+/**
+ * Length of a checkpoint that may have been split over several files
+ *
+ * \param filename Checkpoint file
+ *
+ * \return Length in bytes, 0 if the checkpoint does not exist
+ */
+uint64_t striped_size(const std::string& filename);
+
+/**
+ * Read part of a checkpoint that may have been split over several files. With the
+ * striped backend the part is read in pieces of config.stripe_size bytes by
+ * config.stripe_threads threads issuing pread concurrently, otherwise by one thread.
+ * Throws std::ios_base::failure if the checkpoint cannot be read.
+ *
+ * \param filename Checkpoint file
+ * \param offset   Offset of the part in bytes
+ * \param len      Length of the part in bytes
+ * \param dst      Host buffer of len bytes
+ * \param config   Writer configuration of the restart
+ */
+void read_striped(const std::string& filename,
+                  uint64_t offset,
+                  uint64_t len,
+                  uint8_t* dst,
+                  const writer_config_t& config);
+
+/**
+ * Remove the stripe files and the layout file of a checkpoint, if any. The checkpoint
+ * file itself is kept.
+ *
+ * \param filename Checkpoint file
+ */
+void remove_stripes(const std::string& filename);
+
+#endif // STRIPED_IO_HPP
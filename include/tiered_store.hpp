@@ -0,0 +1,162 @@
+#ifndef TIERED_STORE_HPP
+#define TIERED_STORE_HPP
+
+#include <Kokkos_Core.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "chain_manifest.hpp"
+#include "group_commit.hpp"
+
+// Where checkpoints are kept before and after they are flushed
+typedef struct tier_config_t {
+  uint32_t capacity;         // Checkpoints kept in the fast tier, 0 disables the store
+  std::string fast_dir;      // Directory of the fast tier (e.g. /dev/shm), empty for Host memory
+  std::string slow_dir;      // Directory checkpoints are flushed to, empty for their own path
+  uint64_t flush_bandwidth;  // Bytes per second written by the flush, 0 for no limit
+} tier_config_t;
+
+/**
+ * Default tier configuration, no fast tier
+ */
+tier_config_t default_tier_config();
+
+/**
+ * Read the tier flags of the command line tools
+ *   --ring K              : Checkpoints kept in the fast tier
+ *   --ring-dir DIR        : Directory of the fast tier
+ *   --flush-dir DIR       : Directory checkpoints are flushed to
+ *   --flush-bandwidth B   : Bytes per second written by the flush
+ *
+ * \param argc Number of arguments
+ * \param argv Arguments
+ *
+ * \return Tier configuration, the default one for flags that are not given
+ */
+tier_config_t get_tier_config(int argc, char** argv);
+
+/** \class TieredStore
+ *  \brief Ring of recent checkpoints in a fast tier, flushed in the background
+ *
+ *  The last capacity checkpoints are kept in Host memory, or as files in a fast
+ *  directory such as /dev/shm that survives the process. A background thread flushes
+ *  each checkpoint in order to the slow tier, at most flush_bandwidth bytes per second
+ *  so the flush does not starve the application of file system bandwidth. Flushed files
+ *  are written under a temporary name and renamed, so a file in the slow tier is always
+ *  complete. A checkpoint leaves the ring only once it has been flushed. Putting a
+ *  checkpoint into a full ring waits for the oldest one to be flushed. A checkpoint
+ *  that fails to flush stays in the ring, the error is thrown by the next put or drain
+ *  and the flush is then retried. Reads take each checkpoint from the fastest tier that
+ *  holds it.
+ */
+class TieredStore {
+  public:
+    /**
+     * Start the flush thread
+     *
+     * \param config Tier configuration
+     */
+    TieredStore(const tier_config_t& config);
+
+    /// Flush every checkpoint left in the ring and stop the flush thread
+    ~TieredStore();
+
+    TieredStore(const TieredStore&) = delete;
+    TieredStore& operator=(const TieredStore&) = delete;
+
+    /**
+     * Record flushed checkpoints, under their slow tier path, in a chain manifest
+     *
+     * \param chain_manifest Manifest, NULL to stop recording
+     */
+    void set_manifest(ChainManifest* chain_manifest);
+
+    /**
+     * Sync flushed checkpoints per the durability policy of a group commit, before they
+     * are recorded in the manifest
+     *
+     * \param group_commit Group commit, NULL to stop syncing
+     */
+    void set_group_commit(GroupCommit* group_commit);
+
+    /**
+     * Put a checkpoint into the ring and queue it for the flush. The Host View is kept
+     * until the checkpoint is flushed and must not be changed by the caller. Throws
+     * std::ios_base::failure if the fast tier file cannot be written, or the error of
+     * a failed flush, in which case the checkpoint is not put.
+     *
+     * \param chkpt_id    ID of the checkpoint
+     * \param name        Checkpoint file name. Its last path component names the
+     *                    checkpoint in the fast and slow tier directories.
+     * \param chkpt       Checkpoint on the Host
+     * \param incremental Whether the checkpoint starts with a header
+     */
+    void put(uint32_t chkpt_id, const std::string& name,
+             const Kokkos::View<uint8_t*>::HostMirror& chkpt, bool incremental=true);
+
+    /**
+     * Get a checkpoint from the fastest tier that holds it
+     *
+     * \param chkpt_id ID of the checkpoint
+     * \param chkpt    Output checkpoint on the Host
+     *
+     * \return Whether any tier holds the checkpoint
+     */
+    bool get(uint32_t chkpt_id, Kokkos::View<uint8_t*>::HostMirror& chkpt);
+
+    /**
+     * Wait until every checkpoint put so far has been flushed. Throws the error of a
+     * failed flush, which is retried afterwards.
+     */
+    void drain();
+
+    /// Bytes written to the slow tier so far
+    uint64_t bytes_flushed() const;
+
+    /// Seconds put waited for a slot in the ring
+    double stall_time() const;
+
+    /**
+     * Path of the fastest tier file holding a checkpoint, looked up by name so that a
+     * later process can find checkpoints left in the fast tier
+     *
+     * \param config Tier configuration
+     * \param name   Checkpoint file name as given to put
+     *
+     * \return Fast tier file, else slow tier file, else name itself
+     */
+    static std::string locate(const tier_config_t& config, const std::string& name);
+
+  private:
+    typedef struct slot_t {
+      uint32_t chkpt_id;
+      std::string name;
+      Kokkos::View<uint8_t*>::HostMirror chkpt;
+      bool incremental;
+      bool flushed;
+    } slot_t;
+
+    tier_config_t config;
+    ChainManifest* manifest;
+    GroupCommit* commits;
+    std::deque<slot_t> ring;
+    std::map<uint32_t, std::string> slow_paths;  // Flushed checkpoints
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::thread flusher;
+    bool stop;
+    uint64_t num_flushed_bytes;
+    double stall_seconds;
+    std::exception_ptr flush_error;  // Failed flush not reported yet
+
+    void flush_loop();
+    void flush(const slot_t& slot);
+    void raise_flush_error();
+};
+
+#endif // TIERED_STORE_HPP
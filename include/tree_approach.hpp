@@ -7,16 +7,26 @@
 #include <climits>
 #include "hash_functions.hpp"
 #include "map_helpers.hpp"
+#include "kokkos_digest_filter.hpp"
 #include "kokkos_merkle_tree.hpp"
 #include "reference_impl.hpp"
 #include "utils.hpp"
 #include "deduplicator_interface.hpp"
+#include "dedup_state.hpp"
+#include "reference_set.hpp"
+#include "region_map.hpp"
+#include "view_layout.hpp"
+#include "chkpt_chain.hpp"
+#include "storage_emulator.hpp"
+#include "chkpt_prefetch.hpp"
 #include "kokkos_vector.hpp"
 
 class TreeDeduplicator : public BaseDeduplicator {
   public:
     MerkleTree tree;
     DigestNodeIDDeviceMap first_ocur_d; // Map of first occurrences
+    DigestFilter first_ocur_filter; // Filter of digests in the first occurrence map
+    Kokkos::View<uint64_t[3]> filter_counters; // Lookups, rejections, false positives
     Vector<uint32_t> first_ocur_vec; // First occurrence root offsets
     Vector<uint32_t> shift_dupl_vec; // Shifted duplicate root offsets
     uint32_t num_chunks;
@@ -25,15 +35,69 @@ class TreeDeduplicator : public BaseDeduplicator {
     void dedup_data_baseline(const uint8_t* data_ptr, 
                     const size_t len);
 
+    void dedup_data_baseline(const RegionMap& regions);
+
     void dedup_data(const uint8_t* data_ptr, 
                     const size_t len);
 
+    void dedup_data(const RegionMap& regions);
+
+    void setup_dedup(const size_t data_size, 
+                     bool make_baseline);
+
+    void setup_filter(bool make_baseline);
+
+    /**
+     * Check whether a digest is in the first occurrence map and mark its entry as
+     * matched. Digests rejected by the digest filter are not looked up.
+     *
+     * \param digest Digest to look up
+     *
+     * \return Whether the digest is in the map
+     */
+    KOKKOS_INLINE_FUNCTION
+    bool match_first_ocur(const HashDigest& digest) const {
+      if(!first_ocur_filter.enabled()) {
+        uint32_t idx = first_ocur_d.find(digest);
+        if(!first_ocur_d.valid_at(idx))
+          return false;
+        mark_entry(first_ocur_d, idx);
+        return true;
+      }
+      Kokkos::atomic_add(&filter_counters(0), static_cast<uint64_t>(1));
+      if(!first_ocur_filter.may_contain(digest)) {
+        Kokkos::atomic_add(&filter_counters(1), static_cast<uint64_t>(1));
+        return false;
+      }
+      uint32_t idx = first_ocur_d.find(digest);
+      if(!first_ocur_d.valid_at(idx)) {
+        Kokkos::atomic_add(&filter_counters(2), static_cast<uint64_t>(1));
+        return false;
+      }
+      mark_entry(first_ocur_d, idx);
+      return true;
+    }
+
+    std::pair<uint64_t,uint64_t> 
+    count_diff(const size_t data_size, 
+               header_t& header);
+
     std::pair<uint64_t,uint64_t> 
     collect_diff( const uint8_t* data_ptr, 
                   const size_t len,
                   Kokkos::View<uint8_t*>& buffer_d, 
                   header_t& header);
 
+    std::pair<uint64_t,uint64_t> 
+    collect_diff( const RegionMap& regions,
+                  Kokkos::View<uint8_t*>& buffer_d, 
+                  header_t& header);
+
+    void checkpoint(header_t& header, 
+                    const RegionMap& regions, 
+                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                    bool make_baseline);
+
     std::pair<double,double>
     restart_chkpt( std::vector<Kokkos::View<uint8_t*>::HostMirror>& incr_chkpts,
                    const int chkpt_idx, 
@@ -138,6 +202,95 @@ class TreeDeduplicator : public BaseDeduplicator {
                     std::string& logname, 
                     bool make_baseline) override;
 
+    /**
+     * Checkpoint several device buffers as one logical checkpoint. Chunks are hashed and
+     * copied in place and identical chunks or subtrees in different regions are
+     * deduplicated. Each region starts at a chunk boundary of the logical data. Save
+     * checkpoint to host view.
+     *
+     * \param regions       Regions to checkpoint, in order
+     * \param diff_h        Host View to store incremental checkpoint
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    void checkpoint(std::vector<region_t>& regions, 
+                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                    bool make_baseline);
+
+    /**
+     * Checkpoint several device buffers as one logical checkpoint and save it to a file.
+     *
+     * \param regions       Regions to checkpoint, in order
+     * \param filename      Filename to save checkpoint
+     * \param logname       Base filename for logs
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    void checkpoint(std::vector<region_t>& regions, 
+                    std::string& filename, 
+                    std::string& logname, 
+                    bool make_baseline);
+
+    /**
+     * Dry run of a checkpoint. Predicts the size of the checkpoint and the cost of
+     * restarting it without gathering chunks or copying the checkpoint to the Host.
+     * Chunks are deduplicated against copies of the tree and first occurrence map.
+     *
+     * \param data_ptr      Raw data pointer that needs to be deduplicated
+     * \param len           Length of data
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     *
+     * \return Predicted header, data and metadata sizes, and restart read volume
+     */
+    chkpt_plan_t plan(uint8_t* data_ptr, 
+                      size_t len, 
+                      bool make_baseline) override;
+
+    /**
+     * Save the state needed to continue deduplicating after a job restart.
+     * Saves the checkpoint IDs, the current chain, the Merkle tree, and the first
+     * occurrence map. The digest filter is rebuilt from the map before the next checkpoint.
+     *
+     * \param filename File to save the state in
+     */
+    void save_state(const std::string& filename) override;
+
+    /**
+     * Load a state saved by save_state. The next checkpoint continues the saved chain.
+     *
+     * \param filename File with the saved state
+     *
+     * \return Whether the state was saved by the same approach with the same chunk size
+     */
+    bool load_state(const std::string& filename) override;
+
+    /**
+     * Rebuild the state from the data of a restarted checkpoint.
+     * Rebuilds the Merkle tree from the restarted data and indexes every node as found
+     * in the restarted checkpoint.
+     *
+     * \param data            Data restarted from checkpoint chkpt_id
+     * \param chkpt_filenames Checkpoint files of the chain, as passed to restart
+     * \param chkpt_id        ID of the restarted checkpoint
+     *
+     * \return Whether the checkpoint chain could be read
+     */
+    bool rebuild_state(Kokkos::View<uint8_t*> data,
+                       std::vector<std::string>& chkpt_filenames,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Seed the tree and the first occurrence map with reference datasets. The tree of the
+     * reference image is built and indexed the same way as a baseline.
+     *
+     * \param reference_files Files with the reference data
+     * \param len             Length of the data that will be checkpointed
+     * \param chkpt_h         Output reference checkpoint on the Host
+     *
+     * \return Whether the files could be read
+     */
+    bool seed_reference(std::vector<std::string>& reference_files,
+                        size_t len,
+                        Kokkos::View<uint8_t*>::HostMirror& chkpt_h) override;
+
     /**
      * Restart checkpoint from vector of incremental checkpoints loaded on the Host.
      *
@@ -180,6 +333,108 @@ class TreeDeduplicator : public BaseDeduplicator {
                  std::string& logname, 
                  uint32_t chkpt_id) override;
 
+    /**
+     * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+     * on the Host. Only chunks overlapping [offset, offset+length) are restarted.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart_range(Kokkos::View<uint8_t*>& data,
+                       uint64_t offset,
+                       uint64_t length,
+                       std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts,
+                       std::string& logname,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+     * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+     * are read.
+     *
+     * \param data       Data View to restart the range into, resized if shorter than the range
+     * \param offset     Byte offset of the range in the checkpointed data
+     * \param length     Length of the range in bytes
+     * \param filenames  Vector of prior incremental checkpoints stored in files
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart_range(Kokkos::View<uint8_t*>& data,
+                       uint64_t offset,
+                       uint64_t length,
+                       std::vector<std::string>& chkpt_filenames,
+                       std::string& logname,
+                       uint32_t chkpt_id) override;
+
+    /**
+     * Restart a multi-region checkpoint from vector of incremental checkpoints loaded on
+     * the Host. Each region is restarted in place through the chain.
+     *
+     * \param regions    Regions to restart into, in the order they were checkpointed
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart(std::vector<region_t>& regions, 
+                 std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                 std::string& logname, 
+                 uint32_t chkpt_id);
+
+    /**
+     * Restart a multi-region checkpoint from checkpoint files. Each region is restarted
+     * in place through the chain.
+     *
+     * \param regions    Regions to restart into, in the order they were checkpointed
+     * \param filenames  Vector of prior incremental checkpoints stored in files
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    void restart(std::vector<region_t>& regions, 
+                 std::vector<std::string>& chkpt_filenames, 
+                 std::string& logname, 
+                 uint32_t chkpt_id);
+
+    /**
+     * Checkpoint a View of any rank and layout. The View is traversed through its
+     * strides and each contiguous innermost run is deduplicated in place as a region, so
+     * strided subviews and multi-dimensional Views are not packed first. Views whose runs
+     * are shorter than a chunk are packed into a scratch buffer.
+     *
+     * \param view          Device View to checkpoint
+     * \param diff_h        Host View to store incremental checkpoint
+     * \param make_baseline Flag determining whether to make a baseline checkpoint
+     */
+    template<class ViewType, 
+             typename std::enable_if<Kokkos::is_view<ViewType>::value, int>::type = 0>
+    void checkpoint(const ViewType& view, 
+                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                    bool make_baseline) {
+      checkpoint_view(*this, chunk_size, view, diff_h, make_baseline);
+    }
+
+    /**
+     * Restart a checkpoint of a View of any rank and layout into a View with the same
+     * extents and layout.
+     *
+     * \param view       Device View to restart into
+     * \param chkpts     Vector of prior incremental checkpoints stored on the Host or
+     *                   filenames of prior incremental checkpoints
+     * \param logname    Filename for restart logs
+     * \param chkpt_id   ID of checkpoint to restart
+     */
+    template<class ViewType, class ChkptType, 
+             typename std::enable_if<Kokkos::is_view<ViewType>::value, int>::type = 0>
+    void restart(const ViewType& view, 
+                 std::vector<ChkptType>& chkpts, 
+                 std::string& logname, 
+                 uint32_t chkpt_id) {
+      restart_view(*this, chunk_size, view, chkpts, logname, chkpt_id);
+    }
+
     /**
      * Write logs for the checkpoint metadata/data breakdown, runtimes, and the overall summary.
      * The data breakdown log shows the proportion of data and metadata as well as how much 
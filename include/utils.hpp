@@ -36,6 +36,76 @@ typedef struct header_t {
   uint32_t num_shift_dupl;      // Number of duplicate entries
 } header_t;
 
+// Limits that trigger a new baseline automatically. A limit of 0 is disabled.
+typedef struct baseline_policy_t {
+  uint32_t max_chain_len;      // Max number of checkpoints in a chain (baseline included)
+  uint64_t max_restart_bytes;  // Max estimated bytes read to restart the next checkpoint
+  uint64_t max_index_entries;  // Max number of entries in the first occurrence index
+} baseline_policy_t;
+
+enum BaselineReason {
+  BaselineRequested,
+  BaselineChainLength,
+  BaselineRestartCost,
+  BaselineIndexSize
+};
+
+typedef struct baseline_event_t {
+  uint32_t chkpt_id;       // ID of the new baseline checkpoint
+  BaselineReason reason;   // Why the baseline was made
+  uint64_t value;          // Value that crossed the limit
+  uint64_t limit;          // Limit from the policy
+} baseline_event_t;
+
+typedef struct index_policy_t {
+  uint32_t max_age;            // Evict entries from checkpoints more than max_age checkpoints old
+  bool drop_unmatched;         // Drop interior tree entries never matched since their checkpoint
+} index_policy_t;
+
+// First occurrence index after a checkpoint
+typedef struct index_stats_t {
+  uint32_t chkpt_id;       // ID of the checkpoint
+  uint64_t num_entries;    // Number of entries in the index
+  uint64_t capacity;       // Number of slots in the index
+  uint64_t memory_bytes;   // Device memory used by the index
+  uint64_t num_evicted;    // Entries removed before the checkpoint
+} index_stats_t;
+
+// Digest filter lookups during a checkpoint
+typedef struct filter_stats_t {
+  uint32_t chkpt_id;         // ID of the checkpoint
+  uint64_t lookups;          // Index lookups that went through the filter
+  uint64_t rejected;         // Lookups answered by the filter without probing the index
+  uint64_t false_positives;  // Lookups passed by the filter that missed in the index
+  uint64_t memory_bytes;     // Memory used by the filter
+} filter_stats_t;
+
+// Header of a saved deduplicator state
+typedef struct state_header_t {
+  char magic[8];           // "DDSTATE" identifies state files
+  uint32_t version;        // Layout version
+  uint32_t mode;           // DedupMode of the deduplicator that saved the state
+  uint32_t chunk_size;     // Size of chunks
+  uint32_t current_id;     // ID of the next checkpoint
+  uint32_t baseline_id;    // ID of the baseline of the current chain
+  uint32_t chain_len;      // Number of checkpoints in the current chain
+  uint64_t chain_bytes;    // Bytes of the checkpoints in the current chain
+  uint64_t data_len;       // Length of the last checkpointed data
+  uint64_t num_digests;    // Number of digests in the list or tree
+  uint64_t num_entries;    // Number of first occurrence index entries
+} state_header_t;
+
+// Predicted checkpoint from a dry run
+typedef struct chkpt_plan_t {
+  header_t header;         // Header the checkpoint would be written with
+  bool make_baseline;      // Whether the checkpoint would start a new chain
+  uint64_t data_bytes;     // Bytes of chunk data
+  uint64_t metadata_bytes; // Bytes of header and metadata
+  uint64_t chkpt_bytes;    // Total size of the checkpoint
+  uint32_t chain_len;      // Number of checkpoints read to restart
+  uint64_t restart_bytes;  // Estimated bytes read to restart the checkpoint
+} chkpt_plan_t;
+
 enum DedupMode {
   Unknown,
   Full,
@@ -60,6 +130,8 @@ void print_mode_help();
 
 DedupMode get_mode(int argc, char** argv);
 
+const char* baseline_reason_name(BaselineReason reason);
+
 template <typename TeamMember>
 KOKKOS_FORCEINLINE_FUNCTION
 void team_memcpy(uint8_t* dst, uint8_t* src, size_t len, TeamMember& team_member) {
@@ -0,0 +1,242 @@
+#ifndef VIEW_LAYOUT_HPP
+#define VIEW_LAYOUT_HPP
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "region_map.hpp"
+
+/** \class ViewLayout
+ *  \brief Memory layout of a Kokkos View of any rank and layout
+ *
+ *  The elements of the View are laid out as logical checkpoint data in order of
+ *  increasing stride, so the fastest varying dimension is innermost whatever the
+ *  Kokkos layout is. Dimensions that follow each other in memory are merged, which
+ *  turns a contiguous View into a single run of bytes and a strided subview into one
+ *  run per contiguous innermost extent. Runs at least a chunk long are deduplicated in
+ *  place as regions of a multi-region checkpoint. Shorter runs would pad every run to
+ *  a chunk, so such Views are packed into a contiguous buffer instead.
+ */
+struct ViewLayout {
+  static const uint32_t max_rank = 8;
+  /// Pointer to the first element
+  uint8_t* ptr;
+  /// Size of an element in bytes
+  uint64_t elem_size;
+  /// Number of dimensions after merging
+  uint32_t rank;
+  /// Extents, fastest varying dimension first
+  uint64_t extents[max_rank];
+  /// Strides in elements, fastest varying dimension first
+  uint64_t strides[max_rank];
+
+  /**
+   * Read the layout of a View
+   *
+   * \param view Device View of any rank
+   */
+  template<class ViewType>
+  ViewLayout(const ViewType& view) {
+    using value_type = typename ViewType::value_type;
+    ptr = reinterpret_cast<uint8_t*>(const_cast<typename ViewType::non_const_value_type*>(view.data()));
+    elem_size = sizeof(value_type);
+    uint32_t view_rank = static_cast<uint32_t>(ViewType::rank);
+    rank = 0;
+    for(uint32_t d=0; d<view_rank; d++) {
+      if(view.extent(d) == 0) {
+        // Empty View, a single empty run
+        rank = 1;
+        extents[0] = 0;
+        strides[0] = 1;
+        return;
+      }
+      // Dimensions of extent one do not change the address
+      if(view.extent(d) > 1) {
+        extents[rank] = view.extent(d);
+        strides[rank] = view.stride(d);
+        rank += 1;
+      }
+    }
+    // Insertion sort by stride
+    for(uint32_t i=1; i<rank; i++) {
+      uint64_t extent = extents[i];
+      uint64_t stride = strides[i];
+      uint32_t j = i;
+      while(j > 0 && strides[j-1] > stride) {
+        extents[j] = extents[j-1];
+        strides[j] = strides[j-1];
+        j -= 1;
+      }
+      extents[j] = extent;
+      strides[j] = stride;
+    }
+    // Merge dimensions that follow each other in memory
+    uint32_t merged = 0;
+    for(uint32_t d=0; d<rank; d++) {
+      if(merged > 0 && strides[d] == strides[merged-1]*extents[merged-1]) {
+        extents[merged-1] *= extents[d];
+      } else {
+        extents[merged] = extents[d];
+        strides[merged] = strides[d];
+        merged += 1;
+      }
+    }
+    rank = merged;
+    if(rank == 0) {
+      // Rank 0 or a single element
+      rank = 1;
+      extents[0] = 1;
+      strides[0] = 1;
+    }
+  }
+
+  /// Number of elements in the View
+  uint64_t num_elems() const {
+    uint64_t n = 1;
+    for(uint32_t d=0; d<rank; d++) {
+      n *= extents[d];
+    }
+    return n;
+  }
+
+  /// Length of the View in bytes, once packed
+  uint64_t num_bytes() const {
+    return num_elems()*elem_size;
+  }
+
+  /// Number of elements in each contiguous run
+  uint64_t run_elems() const {
+    return (strides[0] == 1) ? extents[0] : 1;
+  }
+
+  /**
+   * Find an element of the View
+   *
+   * \param idx Index of the element in the logical layout
+   *
+   * \return Pointer to the element
+   */
+  KOKKOS_INLINE_FUNCTION uint8_t* elem_ptr(uint64_t idx) const {
+    uint64_t offset = 0;
+    for(uint32_t d=0; d<rank; d++) {
+      offset += (idx % extents[d])*strides[d];
+      idx /= extents[d];
+    }
+    return ptr + offset*elem_size;
+  }
+
+  /**
+   * Describe the View as regions of a multi-region checkpoint, one per contiguous run
+   *
+   * \param chunk_size Size of chunks
+   * \param regions    Output regions in logical order
+   *
+   * \return Whether the runs are at least a chunk long. Otherwise the View needs packing
+   *         and no regions are returned.
+   */
+  bool regions(uint32_t chunk_size, std::vector<region_t>& regions) const {
+    regions.clear();
+    uint64_t run = run_elems();
+    uint64_t num_runs = (run > 0) ? num_elems()/run : 1;
+    if((num_runs > 1) && (run*elem_size < chunk_size))
+      return false;
+    for(uint64_t i=0; i<num_runs; i++) {
+      region_t region;
+      region.ptr = elem_ptr(i*run);
+      region.len = run*elem_size;
+      region.name = std::string("run ") + std::to_string(i);
+      regions.push_back(region);
+    }
+    return true;
+  }
+
+  /**
+   * Copy the elements of the View into a contiguous buffer in logical order
+   *
+   * \param buffer_d Device buffer of num_bytes() bytes
+   */
+  void pack(Kokkos::View<uint8_t*>& buffer_d) const {
+    ViewLayout layout = *this;
+    Kokkos::parallel_for("Pack view", Kokkos::RangePolicy<>(0, num_elems()), KOKKOS_LAMBDA(const uint64_t i) {
+      const uint8_t* elem = layout.elem_ptr(i);
+      for(uint64_t j=0; j<layout.elem_size; j++) {
+        buffer_d(i*layout.elem_size+j) = elem[j];
+      }
+    });
+  }
+
+  /**
+   * Copy a contiguous buffer written by pack back into the View
+   *
+   * \param buffer_d Device buffer of num_bytes() bytes
+   */
+  void unpack(const Kokkos::View<uint8_t*>& buffer_d) const {
+    ViewLayout layout = *this;
+    Kokkos::parallel_for("Unpack view", Kokkos::RangePolicy<>(0, num_elems()), KOKKOS_LAMBDA(const uint64_t i) {
+      uint8_t* elem = layout.elem_ptr(i);
+      for(uint64_t j=0; j<layout.elem_size; j++) {
+        elem[j] = buffer_d(i*layout.elem_size+j);
+      }
+    });
+  }
+};
+
+/**
+ * Checkpoint a View of any rank and layout. The contiguous runs of the View are
+ * deduplicated in place when they are at least a chunk long, otherwise the View is
+ * packed into a scratch buffer first.
+ *
+ * \param dedup         Deduplicator with a multi-region checkpoint
+ * \param chunk_size    Chunk size of the deduplicator
+ * \param view          Device View to checkpoint
+ * \param diff_h        Host View to store incremental checkpoint
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+template<class Deduplicator, class ViewType>
+void checkpoint_view(Deduplicator& dedup,
+                     uint32_t chunk_size,
+                     const ViewType& view,
+                     Kokkos::View<uint8_t*>::HostMirror& diff_h,
+                     bool make_baseline) {
+  ViewLayout layout(view);
+  std::vector<region_t> regions;
+  if(layout.regions(chunk_size, regions)) {
+    dedup.checkpoint(regions, diff_h, make_baseline);
+  } else {
+    Kokkos::View<uint8_t*> packed_d("Packed view", layout.num_bytes());
+    layout.pack(packed_d);
+    dedup.checkpoint(packed_d.data(), packed_d.size(), diff_h, make_baseline);
+  }
+}
+
+/**
+ * Restart a checkpoint made by checkpoint_view into a View with the same extents and
+ * layout.
+ *
+ * \param dedup      Deduplicator with a multi-region restart
+ * \param chunk_size Chunk size of the deduplicator
+ * \param view       Device View to restart into
+ * \param chkpts     Prior incremental checkpoints, on the Host or as filenames
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+template<class Deduplicator, class ViewType, class ChkptType>
+void restart_view(Deduplicator& dedup,
+                  uint32_t chunk_size,
+                  const ViewType& view,
+                  std::vector<ChkptType>& chkpts,
+                  std::string& logname,
+                  uint32_t chkpt_id) {
+  ViewLayout layout(view);
+  std::vector<region_t> regions;
+  if(layout.regions(chunk_size, regions)) {
+    dedup.restart(regions, chkpts, logname, chkpt_id);
+  } else {
+    Kokkos::View<uint8_t*> packed_d("Packed view", layout.num_bytes());
+    dedup.restart(packed_d, chkpts, logname, chkpt_id);
+    layout.unpack(packed_d);
+  }
+}
+
+#endif // VIEW_LAYOUT_HPP
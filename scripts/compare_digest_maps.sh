@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+# Compare dedup_chkpt_files end to end with the digest table and with Kokkos::UnorderedMap
+# as the first occurrence map of the List and Tree approaches.
+#
+# Usage: compare_digest_maps.sh TABLE_BUILD MAP_BUILD CHUNK_SIZE FILE...
+#
+# TABLE_BUILD and MAP_BUILD are build directories configured as in
+# example_build_script.sh, the second one with -DDIGEST_UNORDERED_MAP=ON. Every FILE is
+# checkpointed RUNS times (default 3) with each build and approach. The fastest run's
+# wall time and its setup (map allocation and growth), comparison (hashing and map
+# lookups), and gather times summed over the checkpoint logs are printed.
+
+if [ $# -lt 4 ]; then
+  echo "Usage: $0 TABLE_BUILD MAP_BUILD CHUNK_SIZE FILE..."
+  exit 1
+fi
+table_build=$(realpath $1)
+map_build=$(realpath $2)
+chunk_size=$3
+shift 3
+files=()
+for f in "$@"; do
+  files+=($(realpath $f))
+done
+runs=${RUNS:-3}
+work_dir=$(mktemp -d)
+
+printf "%-8s %-14s %10s %12s %12s %12s\n" "Approach" "Map" "Wall (s)" "Setup (s)" "Compare (s)" "Gather (s)"
+for approach in --run-list-chkpt --run-tree-chkpt; do
+  for build in $table_build $map_build; do
+    name=$([ $build == $table_build ] && echo "DigestTable" || echo "UnorderedMap")
+    best=""
+    for run in $(seq $runs); do
+      rm -f $work_dir/*
+      start=$(date +%s.%N)
+      (cd $work_dir && $build/dedup_chkpt_files $chunk_size ${#files[@]} $approach "${files[@]}" > /dev/null)
+      end=$(date +%s.%N)
+      wall=$(awk "BEGIN {print $end - $start}")
+      if [ -z "$best" ] || awk "BEGIN {exit !($wall < $best)}"; then
+        best=$wall
+        # Setup, comparison, and gather times are the 8th to 10th columns of the logs
+        times=$(cat $work_dir/*.chunk_size.$chunk_size.csv | awk -F, '$1 != "Approach" {s+=$8; c+=$9; g+=$10}
+                END {printf "%12.6f %12.6f %12.6f", s, c, g}')
+      fi
+    done
+    printf "%-8s %-14s %10.3f %s\n" ${approach:6:4} $name $best "$times"
+  done
+done
+for f in "${files[@]}"; do
+  rm -f $f.hashlist.incr_chkpt $f.hashtree.incr_chkpt
+done
+rm -rf $work_dir
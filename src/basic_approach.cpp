@@ -48,6 +48,54 @@ BasicDeduplicator::dedup_data(const uint8_t* data_ptr, const size_t len) {
   STDOUT_PRINT("(Bitset): Number of changed chunks: %u\n", changes_bitset.count());
 }
 
+/**
+ * Set the data length and number of chunks for the next checkpoint. Allocate a new
+ * list of hashes for baselines and grow it as needed otherwise.
+ *
+ * \param len           Length of data to deduplicate
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void
+BasicDeduplicator::setup_dedup(const size_t len, bool make_baseline) {
+  // Set important values
+  data_len = len;
+  num_chunks = data_len/chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
+    num_chunks += 1;
+
+  // Allocate or resize necessary variables for each approach
+  if(make_baseline) {
+    list = HashList(num_chunks);
+    changes_bitset = Kokkos::Bitset<Kokkos::DefaultExecutionSpace>(num_chunks);
+  }
+  if(list.list_d.size() < num_chunks) {
+    Kokkos::resize(list.list_d, num_chunks);
+    Kokkos::resize(list.list_h, num_chunks);
+  }
+}
+
+/**
+ * Count the metadata of the incremental checkpoint identified by dedup_data without
+ * writing it. Fills in the header exactly as collect_diff would.
+ *
+ * \param header The checkpoint header
+ *
+ * \return Pair containing the number of bytes of data and of header and metadata
+ */
+std::pair<uint64_t,uint64_t> 
+BasicDeduplicator::count_diff(header_t& header) {
+  header.ref_id = baseline_id;
+  header.chkpt_id = current_id;
+  header.datalen = data_len;
+  header.chunk_size = chunk_size;
+  header.num_first_ocur = changes_bitset.count();
+  header.num_shift_dupl = 0;
+  header.num_prior_chkpts = 0;
+  uint64_t size_data = static_cast<uint64_t>(header.num_first_ocur)*static_cast<uint64_t>(chunk_size);
+  uint64_t size_metadata = sizeof(header_t) + static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t);
+  return std::make_pair(size_data, size_metadata);
+}
+
 std::pair<uint64_t,uint64_t> 
 BasicDeduplicator::collect_diff( const uint8_t* data_ptr, 
               const size_t len,
@@ -71,7 +119,7 @@ BasicDeduplicator::collect_diff( const uint8_t* data_ptr,
   // Calculate buffer size and resize buffer
   uint64_t buffer_size = sizeof(header_t);
   buffer_size += static_cast<uint64_t>(changes_bitset.count())*static_cast<uint64_t>(sizeof(uint32_t) + chunk_size);
-  Kokkos::resize(buffer_d, buffer_size);
+  alloc_diff_buffer(buffer_d, buffer_size);
 
   // Get offset for start of data section
   size_t data_offset = static_cast<size_t>(changes_bitset.count())*sizeof(uint32_t);
@@ -327,6 +375,7 @@ BasicDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   // Read main incremental checkpoint header
   std::ifstream file;
   file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  storage_metadata(chkpt_files[file_idx]);
   file.open(chkpt_files[file_idx], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
   size_t filesize = file.tellg();
   file.seekg(0);
@@ -334,6 +383,7 @@ BasicDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   DEBUG_PRINT("File size: %zd\n", filesize);
   header_t header;
   file.read((char*)&header, sizeof(header_t));
+  storage_transfer(chkpt_files[file_idx], sizeof(header_t), false);
   STDOUT_PRINT("Ref ID: %u\n",               header.ref_id);
   STDOUT_PRINT("Chkpt ID: %u\n",             header.chkpt_id);
   STDOUT_PRINT("Data len: %lu\n",            header.datalen);
@@ -344,10 +394,15 @@ BasicDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
 
   Kokkos::View<uint8_t*> buffer_d("Buffer", filesize);
   Kokkos::deep_copy(buffer_d, 0);
-  auto buffer_h = Kokkos::create_mirror_view(buffer_d);
-  Kokkos::deep_copy(buffer_h, 0);
   file.close();
 
+  // Checkpoints are read ahead on several threads while newer ones are restarted
+  std::vector<uint32_t> order;
+  for(int idx=static_cast<int>(file_idx); idx>=static_cast<int>(header.ref_id); idx--) {
+    order.push_back(static_cast<uint32_t>(idx));
+  }
+  ChkptPrefetcher prefetch(chkpt_files, order, writer_config);
+
   uint32_t num_chunks = header.datalen / header.chunk_size;
   if(num_chunks*header.chunk_size < header.datalen) {
     num_chunks += 1;
@@ -355,15 +410,14 @@ BasicDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   Kokkos::resize(data, header.datalen);
 
   // Main checkpoint
-  file.open(chkpt_files[file_idx], std::ifstream::in | std::ifstream::binary);
-  file.read((char*)(buffer_h.data()), filesize);
-  file.close();
+  auto buffer_h = prefetch.get(file_idx);
 
   Kokkos::fence();
   std::chrono::high_resolution_clock::time_point c1 = std::chrono::high_resolution_clock::now();
   Kokkos::deep_copy(buffer_d, buffer_h);
   Kokkos::fence();
   std::chrono::high_resolution_clock::time_point c2 = std::chrono::high_resolution_clock::now();
+  prefetch.release(file_idx);
 
   Kokkos::View<NodeID*> node_list("List of NodeIDs", num_chunks);
   Kokkos::deep_copy(node_list, NodeID());
@@ -402,19 +456,16 @@ BasicDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
 
   for(int idx=static_cast<int>(file_idx)-1; idx>=static_cast<int>(ref_id); idx--) {
     STDOUT_PRINT("Processing checkpoint %u\n", idx);
-    file.open(chkpt_files[idx], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
-    size_t chkpt_size = file.tellg();
+    auto chkpt_buffer_h = prefetch.get(idx);
+    size_t chkpt_size = chkpt_buffer_h.size();
     STDOUT_PRINT("Checkpoint size: %zd\n", chkpt_size);
-    file.seekg(0);
     Kokkos::View<uint8_t*> chkpt_buffer_d("Checkpoint buffer", chkpt_size);
-    auto chkpt_buffer_h = Kokkos::create_mirror_view(chkpt_buffer_d);
-    file.read((char*)(chkpt_buffer_h.data()), chkpt_size);
-    file.close();
     header_t chkpt_header;
     memcpy(&chkpt_header, chkpt_buffer_h.data(), sizeof(header_t));
     datalen = chkpt_header.datalen;
     chunk_size = chkpt_header.chunk_size;
     Kokkos::deep_copy(chkpt_buffer_d, chkpt_buffer_h);
+    prefetch.release(idx);
     ref_id = chkpt_header.ref_id;
     cur_id = chkpt_header.chkpt_id;
 
@@ -458,6 +509,7 @@ BasicDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   }
 
   Kokkos::fence();
+  STDOUT_PRINT("Time spent waiting for checkpoint reads: %f\n", prefetch.wait_time());
   std::chrono::high_resolution_clock::time_point c3 = std::chrono::high_resolution_clock::now();
   double copy_time = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(c2-c1).count());
   double restart_time = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(c3-c2).count());
@@ -480,21 +532,12 @@ BasicDeduplicator::checkpoint(header_t& header,
                                   std::to_string(current_id) + std::string(": Setup");
   Kokkos::Profiling::pushRegion(setup_region_name.c_str());
 
-  // Set important values
-  data_len = len;
-  num_chunks = data_len/chunk_size;
-  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
-    num_chunks += 1;
+  // Start a new chain if requested or if the current chain is too long or too large.
+  // The basic approach has no first occurrence index.
+  make_baseline = apply_baseline_policy(make_baseline, 0);
 
-  // Allocate or resize necessary variables for each approach
-  if(make_baseline) {
-    list = HashList(num_chunks);
-    changes_bitset = Kokkos::Bitset<Kokkos::DefaultExecutionSpace>(num_chunks);
-  }
-  if(list.list_d.size() < num_chunks) {
-    Kokkos::resize(list.list_d, num_chunks);
-    Kokkos::resize(list.list_h, num_chunks);
-  }
+  // Set important values and allocate or resize necessary variables
+  setup_dedup(len, make_baseline);
   Kokkos::Profiling::popRegion();
 
   // ==========================================================================================
@@ -535,13 +578,12 @@ BasicDeduplicator::checkpoint(header_t& header,
   // Copy diff to host 
   // ==========================================================================================
   Timer::time_point start_write = Timer::now();
-  Kokkos::resize(diff_h, diff.size());
   std::string write_region_name = std::string("Copy diff to host ") 
                                   + std::to_string(current_id);
   Kokkos::Profiling::pushRegion(write_region_name.c_str());
 
-  Kokkos::deep_copy(diff_h, diff);
-  memcpy(diff_h.data(), &header, sizeof(header_t));
+  diff_to_host(diff, diff_h, header);
+  update_chain(make_baseline, diff_h.size());
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_write = Timer::now();
@@ -556,15 +598,14 @@ BasicDeduplicator::checkpoint(uint8_t* data_ptr,
                               bool make_baseline) {
   Kokkos::View<uint8_t*>::HostMirror diff_h;
   header_t header;
+  ChkptSink out(filename, writer_config);
+  sink = &out;
   checkpoint(header, data_ptr, len, diff_h, make_baseline);
+  sink = NULL;
   write_chkpt_log(header, diff_h, logname);
-  // Write checkpoint to file
-  std::ofstream file;
-  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-  file.open(filename, std::ofstream::out | std::ofstream::binary);
-  file.write((const char*)(diff_h.data()), diff_h.size());
-  file.flush();
-  file.close();
+  // Write checkpoint to file unless it was gathered into the file
+  out.write(diff_h);
+  finish_file(filename, diff_h, true);
   current_id += 1;
 }
 
@@ -589,13 +630,129 @@ BasicDeduplicator::checkpoint(uint8_t* data_ptr,
   write_chkpt_log(header, diff_h, logname);
   current_id += 1;
 }
+
+chkpt_plan_t 
+BasicDeduplicator::plan(uint8_t* data_ptr, 
+                        size_t len, 
+                        bool make_baseline) {
+  chkpt_plan_t plan;
+  baseline_event_t event;
+  plan.make_baseline = check_baseline_policy(make_baseline, 0, event);
+
+  // Keep the current state so that the dry run does not affect the next checkpoint.
+  // Baselines allocate a new list, otherwise hash against a copy.
+  HashList saved_list = list;
+  uint32_t saved_baseline_id = baseline_id;
+  uint64_t saved_data_len = data_len;
+  uint32_t saved_num_chunks = num_chunks;
+  if(!plan.make_baseline) {
+    list = HashList(saved_list.list_d.size());
+    Kokkos::deep_copy(list.list_d, saved_list.list_d);
+  }
+
+  setup_dedup(len, plan.make_baseline);
+  if(plan.make_baseline) {
+    baseline_id = current_id;
+  }
+  dedup_data(data_ptr, len);
+  std::pair<uint64_t,uint64_t> sizes = count_diff(plan.header);
+  plan.data_bytes = sizes.first;
+  plan.metadata_bytes = sizes.second;
+  estimate_restart(plan);
+
+  list = saved_list;
+  baseline_id = saved_baseline_id;
+  data_len = saved_data_len;
+  num_chunks = saved_num_chunks;
+  return plan;
+}
                    
+void
+BasicDeduplicator::save_state(const std::string& filename) {
+  state_header_t header = fill_state_header(Basic);
+  uint32_t num_digests = (current_id > 0) ? num_chunks : 0;
+  write_dedup_state(filename, header, list.list_d, num_digests, DigestNodeIDDeviceMap());
+}
+
+bool
+BasicDeduplicator::load_state(const std::string& filename) {
+  state_header_t header;
+  Kokkos::View<HashDigest*> digests;
+  DigestNodeIDDeviceMap index;
+  if(!read_dedup_state(filename, Basic, chunk_size, header, digests, index))
+    return false;
+  restore_state_header(header);
+  num_chunks = header.num_digests;
+  list = HashList(num_chunks);
+  Kokkos::deep_copy(list.list_d, digests);
+  changes_bitset = Kokkos::Bitset<Kokkos::DefaultExecutionSpace>(num_chunks);
+  return true;
+}
+
+bool
+BasicDeduplicator::rebuild_state(Kokkos::View<uint8_t*> data,
+                                 std::vector<std::string>& chkpt_filenames,
+                                 uint32_t chkpt_id) {
+  std::vector<std::string> basiclist_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    basiclist_chkpt_files.push_back(chkpt_filenames[i]+".basic.incr_chkpt");
+  }
+  state_header_t header = fill_state_header(Basic);
+  if(!read_chain_state(basiclist_chkpt_files, chkpt_id, header))
+    return false;
+  if(header.chunk_size != chunk_size) {
+    printf("ERROR: Checkpoint %u uses %u byte chunks\n", chkpt_id, header.chunk_size);
+    return false;
+  }
+  restore_state_header(header);
+  setup_dedup(header.data_len, true);
+  uint8_t* data_ptr = data.data();
+  Kokkos::parallel_for("Rebuild list", Kokkos::RangePolicy<>(0, num_chunks), 
+  KOKKOS_CLASS_LAMBDA(const uint32_t idx) {
+    uint32_t num_bytes = chunk_size;
+    uint64_t offset = static_cast<uint64_t>(idx)*static_cast<uint64_t>(chunk_size);
+    if(idx == num_chunks-1)
+      num_bytes = data_len-offset;
+    hash(data_ptr+offset, num_bytes, list(idx).digest);
+  });
+  Kokkos::fence();
+  return true;
+}
+
+bool
+BasicDeduplicator::seed_reference(std::vector<std::string>& reference_files,
+                                  size_t len,
+                                  Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  ReferenceSet refs(reference_files);
+  if(!refs.valid())
+    return false;
+  Kokkos::View<uint8_t*> image_d("Reference image", len);
+  read_reference_image(refs, image_d);
+
+  // The reference checkpoint starts the chain in place of a baseline
+  setup_dedup(len, true);
+  baseline_id = current_id;
+  dedup_data(image_d.data(), len);
+  header_t header = {current_id, current_id, len, chunk_size, 0, 0, 0};
+  write_reference_chkpt(header, refs, chkpt_h);
+  update_chain(true, chkpt_h.size());
+  current_id += 1;
+  return true;
+}
+
 void 
 BasicDeduplicator::restart(Kokkos::View<uint8_t*> data, 
                            std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
                            std::string& logname, 
                            uint32_t chkpt_id) {
-  auto basic_list_times = restart_chkpt(chkpts, chkpt_id, data);
+  std::pair<double,double> basic_list_times;
+  ChkptChain chain(chkpts, false);
+  if(chain.reverse(chkpt_id) || chain.seeded(chkpt_id)) {
+    // Reverse deltas and reference datasets are resolved by the chain reader
+    basic_list_times = chain.restart(chkpt_id, data);
+  } else {
+    basic_list_times = restart_chkpt(chkpts, chkpt_id, data);
+  }
   restart_timers[0] = basic_list_times.first;
   restart_timers[1] = basic_list_times.second;
   std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
@@ -622,12 +779,76 @@ BasicDeduplicator::restart(Kokkos::View<uint8_t*> data,
   for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
     basiclist_chkpt_files.push_back(chkpt_filenames[i]+".basic.incr_chkpt");
   }
-  auto basic_list_times = restart_chkpt(basiclist_chkpt_files, chkpt_id, data);
+  std::pair<double,double> basic_list_times;
+  ChkptChain chain(basiclist_chkpt_files, false);
+  if(chain.reverse(chkpt_id) || chain.seeded(chkpt_id)) {
+    // Reverse deltas and reference datasets are resolved by the chain reader
+    basic_list_times = chain.restart(chkpt_id, data);
+  } else {
+    basic_list_times = restart_chkpt(basiclist_chkpt_files, chkpt_id, data);
+  }
   restart_timers[0] = basic_list_times.first;
   restart_timers[1] = basic_list_times.second;
   write_restart_log(chkpt_id, logname);
 }
 
+/**
+ * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+ * on the Host. Only chunks overlapping [offset, offset+length) are restarted.
+ *
+ * \param data       Data View to restart the range into, resized if shorter than the range
+ * \param offset     Byte offset of the range in the checkpointed data
+ * \param length     Length of the range in bytes
+ * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+BasicDeduplicator::restart_range(Kokkos::View<uint8_t*>& data, 
+                                 uint64_t offset,
+                                 uint64_t length,
+                                 std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                                 std::string& logname, 
+                                 uint32_t chkpt_id) {
+  ChkptChain chain(chkpts, false);
+  auto basiclist_times = chain.restart_range(chkpt_id, offset, length, data);
+  restart_timers[0] = basiclist_times.first;
+  restart_timers[1] = basiclist_times.second;
+  std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                ".restart_timing.csv";
+  write_restart_log(chkpt_id, restart_logname);
+}
+
+/**
+ * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+ * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+ * are read.
+ *
+ * \param data       Data View to restart the range into, resized if shorter than the range
+ * \param offset     Byte offset of the range in the checkpointed data
+ * \param length     Length of the range in bytes
+ * \param filenames  Vector of prior incremental checkpoints stored in files
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+BasicDeduplicator::restart_range(Kokkos::View<uint8_t*>& data, 
+                                 uint64_t offset,
+                                 uint64_t length,
+                                 std::vector<std::string>& chkpt_filenames, 
+                                 std::string& logname, 
+                                 uint32_t chkpt_id) {
+  std::vector<std::string> basiclist_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    basiclist_chkpt_files.push_back(chkpt_filenames[i]+".basic.incr_chkpt");
+  }
+  ChkptChain chain(basiclist_chkpt_files, false);
+  auto basiclist_times = chain.restart_range(chkpt_id, offset, length, data);
+  restart_timers[0] = basiclist_times.first;
+  restart_timers[1] = basiclist_times.second;
+  write_restart_log(chkpt_id, logname);
+}
+
 void 
 BasicDeduplicator::write_chkpt_log(header_t& header, 
                                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
@@ -0,0 +1,265 @@
+#include "chain_manifest.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <set>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "hash_functions.hpp"
+#include "storage_emulator.hpp"
+#include "striped_io.hpp"
+#include "utils.hpp"
+
+ChainManifest::ChainManifest(const std::string& file, DurabilityPolicy durability) {
+  filename = file;
+  policy = durability;
+  dirty = false;
+  std::ifstream in(filename);
+  if(!in.is_open())
+    return;
+  std::string magic;
+  uint32_t version = 0;
+  uint64_t num_entries = 0;
+  bool valid = (in >> magic >> version >> num_entries) && (magic.compare(MANIFEST_MAGIC) == 0) &&
+               (version == MANIFEST_VERSION);
+  std::string line;
+  std::getline(in, line);
+  for(uint64_t i=0; i<num_entries && valid; i++) {
+    // id ref_id offset length datalen digest num_prior [prior ...] path
+    valid = static_cast<bool>(std::getline(in, line));
+    if(!valid)
+      break;
+    std::istringstream fields(line);
+    manifest_entry_t entry;
+    uint32_t num_prior = 0;
+    valid = static_cast<bool>(fields >> entry.chkpt_id >> entry.ref_id >> entry.offset >> entry.length
+                                     >> entry.datalen >> entry.digest >> num_prior);
+    for(uint32_t j=0; j<num_prior && valid; j++) {
+      uint32_t prior = 0;
+      valid = static_cast<bool>(fields >> prior);
+      entry.prior_chkpts.push_back(prior);
+    }
+    // The path is the rest of the line and may hold spaces
+    if(valid) {
+      fields.get();
+      valid = static_cast<bool>(std::getline(fields, entry.path)) && (entry.path.size() > 0);
+    }
+    if(valid)
+      chkpts[entry.chkpt_id] = entry;
+  }
+  if(!valid)
+    throw std::ios_base::failure(filename + " is not a checkpoint manifest");
+}
+
+ChainManifest::~ChainManifest() {
+  try {
+    save();
+  } catch(const std::ios_base::failure& e) {
+    printf("ERROR: %s\n", e.what());
+  }
+}
+
+std::string
+ChainManifest::digest(const uint8_t* chkpt, uint64_t len) {
+  HashDigest dig;
+  memset(dig.digest, 0, sizeof(dig.digest));
+  hash(chkpt, len, dig.digest);
+  static const char hexchars[] = "0123456789abcdef";
+  std::string digest_str;
+  for(int k=0; k<16; k++) {
+    digest_str.push_back(hexchars[dig.digest[k] >> 4]);
+    digest_str.push_back(hexchars[dig.digest[k] & 0xF]);
+  }
+  return digest_str;
+}
+
+void
+ChainManifest::record(uint32_t chkpt_id, const uint8_t* chkpt, uint64_t len,
+                      const std::string& path, uint64_t offset, bool incremental) {
+  manifest_entry_t entry;
+  entry.chkpt_id = chkpt_id;
+  entry.ref_id = chkpt_id;
+  entry.path = path;
+  entry.offset = offset;
+  entry.length = len;
+  entry.datalen = len;
+  if(incremental && (len >= sizeof(header_t))) {
+    header_t header;
+    memcpy(&header, chkpt, sizeof(header_t));
+    entry.ref_id = header.ref_id;
+    entry.datalen = header.datalen;
+    // Prior table of (checkpoint, count) pairs after the first occurrences
+    uint64_t prior_offset = sizeof(header_t) + static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t);
+    uint64_t prior_len = static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t);
+    if(prior_offset+prior_len <= len) {
+      for(uint32_t i=0; i<header.num_prior_chkpts; i++) {
+        uint32_t prior = 0;
+        memcpy(&prior, chkpt+prior_offset+static_cast<uint64_t>(i)*2*sizeof(uint32_t), sizeof(uint32_t));
+        if(prior != chkpt_id)
+          entry.prior_chkpts.push_back(prior);
+      }
+    }
+  }
+  entry.digest = digest(chkpt, len);
+  std::lock_guard<std::mutex> lock(mutex);
+  chkpts[chkpt_id] = entry;
+  dirty = true;
+  if(policy == DurableChkpt)
+    save_locked();
+}
+
+void
+ChainManifest::record_file(uint32_t chkpt_id, const std::string& path, bool incremental) {
+  uint64_t len = striped_size(path);
+  std::vector<uint8_t> chkpt(len);
+  read_striped(path, 0, len, chkpt.data(), default_writer_config());
+  record(chkpt_id, chkpt.data(), len, path, 0, incremental);
+}
+
+void
+ChainManifest::save() {
+  std::lock_guard<std::mutex> lock(mutex);
+  save_locked();
+}
+
+void
+ChainManifest::save_locked() {
+  if(!dirty)
+    return;
+  std::ostringstream out;
+  out << MANIFEST_MAGIC << " " << MANIFEST_VERSION << " " << chkpts.size() << "\n";
+  for(auto it=chkpts.begin(); it!=chkpts.end(); it++) {
+    const manifest_entry_t& entry = it->second;
+    out << entry.chkpt_id << " " << entry.ref_id << " " << entry.offset << " " << entry.length << " "
+        << entry.datalen << " " << entry.digest << " " << entry.prior_chkpts.size();
+    for(uint32_t j=0; j<entry.prior_chkpts.size(); j++) {
+      out << " " << entry.prior_chkpts[j];
+    }
+    out << " " << entry.path << "\n";
+  }
+  std::string text = out.str();
+
+  // Write and sync a temporary file, then atomically replace the manifest
+  bool sync = (policy != DurableNone);
+  std::string tmp_file = filename + ".tmp";
+  int fd = storage_open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    throw std::ios_base::failure(std::string("Failed to create ") + tmp_file + ": " + strerror(errno));
+  bool written = pwrite_all(fd, (const uint8_t*)(text.data()), text.size(), 0) && (!sync || (fsync(fd) == 0));
+  int error = errno;
+  storage_close(fd);
+  if(!written || (storage_rename(tmp_file, filename) != 0)) {
+    if(written)
+      error = errno;
+    std::remove(tmp_file.c_str());
+    throw std::ios_base::failure(std::string("Failed to write ") + filename + ": " + strerror(error));
+  }
+  dirty = false;
+  if(!sync)
+    return;
+  // Sync the directory so the rename itself survives a crash
+  std::string dir(".");
+  size_t slash = filename.rfind('/');
+  if(slash != std::string::npos)
+    dir = (slash == 0) ? std::string("/") : filename.substr(0, slash);
+  int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if(dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+}
+
+bool
+ChainManifest::find(uint32_t chkpt_id, manifest_entry_t& entry) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = chkpts.find(chkpt_id);
+  if(it == chkpts.end())
+    return false;
+  entry = it->second;
+  return true;
+}
+
+std::vector<manifest_entry_t>
+ChainManifest::entries() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<manifest_entry_t> list;
+  for(auto it=chkpts.begin(); it!=chkpts.end(); it++) {
+    list.push_back(it->second);
+  }
+  return list;
+}
+
+uint32_t
+ChainManifest::num_chkpts() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if(chkpts.empty())
+    return 0;
+  return chkpts.rbegin()->first + 1;
+}
+
+std::vector<uint32_t>
+ChainManifest::restart_plan(uint32_t chkpt_id) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::set<uint32_t> needed;
+  std::vector<uint32_t> pending(1, chkpt_id);
+  while(!pending.empty()) {
+    uint32_t id = pending.back();
+    pending.pop_back();
+    if(!needed.insert(id).second)
+      continue;
+    auto it = chkpts.find(id);
+    if(it == chkpts.end())
+      throw std::ios_base::failure(filename + " has no checkpoint " + std::to_string(id));
+    pending.push_back(it->second.ref_id);
+    pending.insert(pending.end(), it->second.prior_chkpts.begin(), it->second.prior_chkpts.end());
+  }
+  // Restarts walk the chain from the reference, so every checkpoint in between is read
+  std::vector<uint32_t> plan;
+  for(uint32_t id=*needed.begin(); id<=*needed.rbegin(); id++) {
+    if(chkpts.find(id) == chkpts.end())
+      throw std::ios_base::failure(filename + " has no checkpoint " + std::to_string(id));
+    plan.push_back(id);
+  }
+  return plan;
+}
+
+std::vector<Kokkos::View<uint8_t*>::HostMirror>
+ChainManifest::read_plan(uint32_t chkpt_id, const writer_config_t& config, uint32_t num_threads) const {
+  std::vector<uint32_t> plan = restart_plan(chkpt_id);
+  std::vector<manifest_entry_t> planned(plan.size());
+  for(uint32_t i=0; i<plan.size(); i++) {
+    find(plan[i], planned[i]);
+  }
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> views(num_chkpts());
+  for(uint32_t i=0; i<views.size(); i++) {
+    views[i] = Kokkos::View<uint8_t*>::HostMirror("Chkpt", 0);
+  }
+  for(uint32_t i=0; i<plan.size(); i++) {
+    views[plan[i]] = Kokkos::View<uint8_t*>::HostMirror("Chkpt", planned[i].length);
+  }
+
+  // Each checkpoint is read by one thread, independently of the others
+  std::mutex error_mutex;
+  std::string error;
+  parallel_items(plan.size(), num_threads, [&](uint64_t i) {
+    const manifest_entry_t& entry = planned[i];
+    uint8_t* dst = views[entry.chkpt_id].data();
+    try {
+      read_striped(entry.path, entry.offset, entry.length, dst, config);
+      if(digest(dst, entry.length).compare(entry.digest) != 0) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        error = std::string("Checkpoint ") + std::to_string(entry.chkpt_id) + " in " + entry.path +
+                " does not match the manifest";
+      }
+    } catch(const std::ios_base::failure& e) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      error = e.what();
+    }
+  });
+  if(error.size() > 0)
+    throw std::ios_base::failure(error);
+  return views;
+}
@@ -0,0 +1,998 @@
+#include "chkpt_chain.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include "kokkos_merkle_tree.hpp"
+#include "hash_functions.hpp"
+#include "storage_emulator.hpp"
+
+struct DigestHasher {
+  size_t operator() (const HashDigest& digest) const {
+    uint64_t val;
+    memcpy(&val, digest.digest, sizeof(uint64_t));
+    return static_cast<size_t>(val);
+  }
+};
+
+ChkptChain::ChkptChain(std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, bool tree_layout) {
+  tree = tree_layout;
+  views = chkpts;
+  chain.resize(chkpts.size());
+  refs.resize(chkpts.size());
+  ref_chkpts.resize(chkpts.size());
+  for(uint32_t i=0; i<chain.size(); i++) {
+    chain[i].loaded = false;
+  }
+  num_bytes_read = 0;
+}
+
+ChkptChain::ChkptChain(std::vector<std::string>& chkpt_files, bool tree_layout) {
+  tree = tree_layout;
+  files = chkpt_files;
+  streams.resize(chkpt_files.size());
+  chain.resize(chkpt_files.size());
+  refs.resize(chkpt_files.size());
+  ref_chkpts.resize(chkpt_files.size());
+  for(uint32_t i=0; i<chain.size(); i++) {
+    chain[i].loaded = false;
+  }
+  num_bytes_read = 0;
+}
+
+ChkptChain::~ChkptChain() {
+  for(uint32_t i=0; i<streams.size(); i++) {
+    if(streams[i] && streams[i]->is_open())
+      streams[i]->close();
+  }
+}
+
+uint32_t
+ChkptChain::size() const {
+  return static_cast<uint32_t>(chain.size());
+}
+
+/**
+ * Read bytes from a checkpoint in the chain. Files are opened lazily and kept open
+ * so that repeated reads from the same checkpoint only pay for a seek. Reads from a
+ * loaded reference checkpoint are served from the reference image.
+ *
+ * \param chkpt_idx Index of the checkpoint in the chain
+ * \param offset    Byte offset in the checkpoint
+ * \param len       Number of bytes to read
+ * \param dst       Host buffer to read into
+ */
+void
+ChkptChain::read(uint32_t chkpt_idx, uint64_t offset, uint64_t len, uint8_t* dst) {
+  if(refs[chkpt_idx]) {
+    refs[chkpt_idx]->read(offset, len, dst);
+  } else if(files.size() > 0) {
+    if(!streams[chkpt_idx]) {
+      storage_metadata(files[chkpt_idx]);
+      streams[chkpt_idx].reset(new std::ifstream());
+      streams[chkpt_idx]->exceptions(std::ifstream::failbit | std::ifstream::badbit);
+      streams[chkpt_idx]->open(files[chkpt_idx], std::ifstream::in | std::ifstream::binary);
+    }
+    streams[chkpt_idx]->seekg(offset);
+    streams[chkpt_idx]->read((char*)(dst), len);
+    storage_transfer(files[chkpt_idx], len, false);
+  } else {
+    memcpy(dst, views[chkpt_idx].data()+offset, len);
+  }
+  num_bytes_read += len;
+}
+
+/**
+ * Read the header and raw metadata of a checkpoint with a single request. Shifted 
+ * duplicates are matched to their source checkpoint using the (checkpoint ID, # of entries)
+ * table, same as restart_chkpt.
+ *
+ * \param chkpt_idx  Index of the checkpoint in the chain
+ * \param header     Checkpoint header
+ * \param first_ocur First occurrence entries in the order they are stored
+ * \param shift_dupl Shifted duplicate (node, prev) pairs in the order they are stored
+ * \param shift_src  Source checkpoint for each shifted duplicate
+ */
+void
+ChkptChain::read_metadata(uint32_t chkpt_idx, 
+                          header_t& header,
+                          std::vector<uint32_t>& first_ocur, 
+                          std::vector<uint32_t>& shift_dupl, 
+                          std::vector<uint32_t>& shift_src) {
+  read(chkpt_idx, 0, sizeof(header_t), (uint8_t*)(&header));
+  uint64_t first_ocur_len = static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t);
+  uint64_t dupl_count_len = static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t);
+  uint64_t shift_dupl_len = static_cast<uint64_t>(header.num_shift_dupl)*2*sizeof(uint32_t);
+  uint64_t metadata_len = first_ocur_len + dupl_count_len + shift_dupl_len;
+  std::vector<uint8_t> buffer(metadata_len);
+  if(metadata_len > 0)
+    read(chkpt_idx, sizeof(header_t), metadata_len, buffer.data());
+
+  first_ocur.resize(header.num_first_ocur);
+  if(first_ocur_len > 0)
+    memcpy(first_ocur.data(), buffer.data(), first_ocur_len);
+  shift_dupl.resize(2*static_cast<uint64_t>(header.num_shift_dupl));
+  if(shift_dupl_len > 0)
+    memcpy(shift_dupl.data(), buffer.data()+first_ocur_len+dupl_count_len, shift_dupl_len);
+
+  // Shifted duplicates are sorted by source checkpoint
+  std::vector<std::pair<uint32_t,uint32_t>> dupl_counts(header.num_prior_chkpts);
+  for(uint32_t i=0; i<header.num_prior_chkpts; i++) {
+    uint64_t pos = first_ocur_len + static_cast<uint64_t>(i)*2*sizeof(uint32_t);
+    memcpy(&dupl_counts[i].first, buffer.data()+pos, sizeof(uint32_t));
+    memcpy(&dupl_counts[i].second, buffer.data()+pos+sizeof(uint32_t), sizeof(uint32_t));
+  }
+  std::sort(dupl_counts.begin(), dupl_counts.end());
+  shift_src.resize(header.num_shift_dupl);
+  uint32_t count_idx = 0, count_end = 0;
+  for(uint32_t i=0; i<header.num_shift_dupl; i++) {
+    while(count_idx < dupl_counts.size() && i >= count_end + dupl_counts[count_idx].second) {
+      count_end += dupl_counts[count_idx].second;
+      count_idx += 1;
+    }
+    shift_src[i] = count_idx < dupl_counts.size() ? dupl_counts[count_idx].first : header.chkpt_id;
+  }
+}
+
+/**
+ * Map the files named by a reference checkpoint. The reference image is presented as a
+ * baseline whose data section starts at offset 0 and holds every chunk in order.
+ *
+ * \param chkpt_idx Index of the checkpoint in the chain
+ * \param header    Checkpoint header
+ *
+ * \return Whether the checkpoint is a reference checkpoint and its files were mapped
+ */
+bool
+ChkptChain::load_reference(uint32_t chkpt_idx, const header_t& header) {
+  std::vector<uint8_t> chkpt(sizeof(header_t)+8+sizeof(uint32_t));
+  memcpy(chkpt.data(), &header, sizeof(header_t));
+  read(chkpt_idx, sizeof(header_t), chkpt.size()-sizeof(header_t), chkpt.data()+sizeof(header_t));
+  if(memcmp(chkpt.data()+sizeof(header_t), "DDREFSET", 8) != 0)
+    return false;
+  uint32_t num_files;
+  memcpy(&num_files, chkpt.data()+sizeof(header_t)+8, sizeof(uint32_t));
+  std::vector<std::string> names(num_files);
+  std::vector<uint64_t> sizes(num_files);
+  for(uint32_t i=0; i<num_files; i++) {
+    uint64_t pos = chkpt.size();
+    uint32_t name_len;
+    chkpt.resize(pos+sizeof(uint64_t)+sizeof(uint32_t));
+    read(chkpt_idx, pos, sizeof(uint64_t)+sizeof(uint32_t), chkpt.data()+pos);
+    memcpy(&sizes[i], chkpt.data()+pos, sizeof(uint64_t));
+    memcpy(&name_len, chkpt.data()+pos+sizeof(uint64_t), sizeof(uint32_t));
+    pos = chkpt.size();
+    chkpt.resize(pos+name_len);
+    read(chkpt_idx, pos, name_len, chkpt.data()+pos);
+    names[i] = std::string((const char*)(chkpt.data()+pos), name_len);
+  }
+
+  std::unique_ptr<ReferenceSet> set(new ReferenceSet(names));
+  if(!set->valid())
+    return false;
+  for(uint32_t i=0; i<num_files; i++) {
+    if(set->file_sizes()[i] != sizes[i]) {
+      printf("ERROR: Reference file %s changed size since checkpoint %u\n", 
+             names[i].c_str(), header.chkpt_id);
+      return false;
+    }
+  }
+  refs[chkpt_idx] = std::move(set);
+  ref_chkpts[chkpt_idx] = chkpt;
+
+  uint32_t num_chunks = header.datalen/header.chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(header.chunk_size) < header.datalen) {
+    num_chunks += 1;
+  }
+  ChkptMetadata& meta = chain[chkpt_idx];
+  meta.header = header;
+  meta.data_offset = 0;
+  meta.num_slots = num_chunks;
+  meta.regions.clear();
+  Region region = {0, num_chunks, 0, UINT_MAX};
+  meta.regions.push_back(region);
+  meta.loaded = true;
+  return true;
+}
+
+/**
+ * Load the header and metadata of a checkpoint and convert each metadata entry into
+ * the region of chunks it covers.
+ *
+ * \param chkpt_idx Index of the checkpoint in the chain
+ *
+ * \return Parsed metadata for the checkpoint
+ */
+ChkptChain::ChkptMetadata&
+ChkptChain::metadata(uint32_t chkpt_idx) {
+  ChkptMetadata& meta = chain[chkpt_idx];
+  if(meta.loaded)
+    return meta;
+
+  header_t& header = meta.header;
+  std::vector<uint32_t> first_ocur, shift_dupl, shift_src;
+  read_metadata(chkpt_idx, header, first_ocur, shift_dupl, shift_src);
+  if(maybe_reference_chkpt(header) && load_reference(chkpt_idx, header))
+    return meta;
+  meta.data_offset = sizeof(header_t) + 
+                     static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t) +
+                     static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t) +
+                     static_cast<uint64_t>(header.num_shift_dupl)*2*sizeof(uint32_t);
+
+  uint32_t num_chunks = header.datalen/header.chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(header.chunk_size) < header.datalen) {
+    num_chunks += 1;
+  }
+  uint32_t num_nodes = 2*num_chunks-1;
+
+  meta.regions.clear();
+  meta.regions.reserve(header.num_first_ocur + header.num_shift_dupl);
+
+  // First occurrences are stored in the data section in the same order as the metadata
+  uint32_t slot = 0;
+  for(uint32_t i=0; i<header.num_first_ocur; i++) {
+    uint32_t node = first_ocur[i];
+    Region region;
+    region.start = node;
+    region.len = 1;
+    if(tree) {
+      region.start = leftmost_leaf(node, num_nodes) - (num_chunks-1);
+      region.len = num_leaf_descendents(node, num_nodes);
+    }
+    region.src = slot;
+    region.src_chkpt = UINT_MAX;
+    meta.regions.push_back(region);
+    slot += region.len;
+  }
+  meta.num_slots = slot;
+
+  for(uint32_t i=0; i<header.num_shift_dupl; i++) {
+    uint32_t node = shift_dupl[2*i];
+    uint32_t prev = shift_dupl[2*i+1];
+    Region region;
+    region.start = node;
+    region.len = 1;
+    region.src = prev;
+    if(tree) {
+      region.start = leftmost_leaf(node, num_nodes) - (num_chunks-1);
+      region.len = num_leaf_descendents(node, num_nodes);
+      region.src = leftmost_leaf(prev, num_nodes) - (num_chunks-1);
+    }
+    region.src_chkpt = shift_src[i];
+    meta.regions.push_back(region);
+  }
+  std::sort(meta.regions.begin(), meta.regions.end(), [](const Region& a, const Region& b) {
+    return a.start < b.start;
+  });
+
+  meta.loaded = true;
+  return meta;
+}
+
+/**
+ * Follow the chain until the checkpoint holding the chunk data is found. Chunks not 
+ * covered by any region are unchanged since the previous checkpoint (forward chains)
+ * or identical to the next checkpoint (reverse deltas).
+ * Shifted duplicates redirect the search to the matching chunk of the source region.
+ *
+ * \param chkpt_idx Checkpoint to resolve the chunk for
+ * \param chunk     Chunk index
+ *
+ * \return Location of the chunk data. chkpt is UINT_MAX if the chunk could not be found
+ */
+ChunkLocation
+ChkptChain::locate(uint32_t chkpt_idx, uint32_t chunk) {
+  uint32_t idx = chkpt_idx;
+  // Each step either moves to another checkpoint or to a first occurrence in the same one
+  uint32_t max_steps = 2*size();
+  for(uint32_t step=0; step<max_steps && idx<size(); step++) {
+    ChkptMetadata& meta = metadata(idx);
+    auto it = std::upper_bound(meta.regions.begin(), meta.regions.end(), chunk,
+                               [](uint32_t c, const Region& r) { return c < r.start; });
+    if(it != meta.regions.begin()) {
+      --it;
+      if(chunk < it->start + it->len) {
+        if(it->src_chkpt == UINT_MAX) {
+          uint64_t slot = static_cast<uint64_t>(it->src) + static_cast<uint64_t>(chunk - it->start);
+          return ChunkLocation(idx, meta.data_offset + slot*static_cast<uint64_t>(meta.header.chunk_size));
+        }
+        chunk = it->src + (chunk - it->start);
+        idx = it->src_chkpt;
+        continue;
+      }
+    }
+    if(meta.header.ref_id > meta.header.chkpt_id) {
+      idx += 1;
+      continue;
+    }
+    if(idx == 0 || idx <= meta.header.ref_id)
+      break;
+    idx -= 1;
+  }
+  return ChunkLocation();
+}
+
+/**
+ * Resolve a byte range of a checkpoint into runs of bytes. Chunks overlapping the range
+ * are resolved through the chain and consecutive chunks stored contiguously in the same
+ * checkpoint are merged into a single run. Throws std::ios_base::failure if a chunk is
+ * not found in the chain.
+ *
+ * \param chkpt_idx Checkpoint to restart
+ * \param offset    Byte offset of the range in the restarted data
+ * \param length    Length of the range in bytes (must not run past the end of the data)
+ * \param runs      Output runs
+ */
+void
+ChkptChain::resolve(uint32_t chkpt_idx, uint64_t offset, uint64_t length, std::vector<ChunkRun>& runs) {
+  runs.clear();
+  if(length == 0)
+    return;
+  uint64_t chunk_size = metadata(chkpt_idx).header.chunk_size;
+  uint32_t first_chunk = static_cast<uint32_t>(offset/chunk_size);
+  uint32_t last_chunk = static_cast<uint32_t>((offset+length-1)/chunk_size);
+
+  // Pending run that consecutive chunks are merged into
+  ChunkRun run;
+  for(uint32_t chunk=first_chunk; chunk<=last_chunk; chunk++) {
+    ChunkLocation loc = locate(chkpt_idx, chunk);
+    if(loc.chkpt == UINT_MAX)
+      throw std::ios_base::failure(std::string("Failed to locate chunk ") + std::to_string(chunk) +
+                                   " of checkpoint " + std::to_string(chkpt_idx));
+    uint64_t chunk_start = static_cast<uint64_t>(chunk)*chunk_size;
+    uint64_t lo = std::max(offset, chunk_start);
+    uint64_t hi = std::min(offset+length, chunk_start+chunk_size);
+    uint64_t src = loc.offset + (lo-chunk_start);
+    if(loc.chkpt == run.chkpt && src == run.src+run.len && lo == run.dst+run.len) {
+      run.len += hi-lo;
+    } else {
+      if(run.len > 0)
+        runs.push_back(run);
+      run = ChunkRun(loc.chkpt, src, lo, hi-lo);
+    }
+  }
+  if(run.len > 0)
+    runs.push_back(run);
+}
+
+/**
+ * Gather a byte range of a checkpoint into a Host buffer, reading each resolved run
+ * with a single request.
+ *
+ * \param chkpt_idx Checkpoint to restart
+ * \param offset    Byte offset of the range in the restarted data
+ * \param length    Length of the range in bytes (must not run past the end of the data)
+ * \param dst       Host buffer to store the range in
+ */
+void
+ChkptChain::gather(uint32_t chkpt_idx, uint64_t offset, uint64_t length, uint8_t* dst) {
+  std::vector<ChunkRun> runs;
+  resolve(chkpt_idx, offset, length, runs);
+  for(uint64_t i=0; i<runs.size(); i++) {
+    read(runs[i].chkpt, runs[i].src, runs[i].len, dst+(runs[i].dst-offset));
+  }
+}
+
+/**
+ * Restart a byte range of a checkpoint. Only the chunks overlapping the range are
+ * resolved and only their bytes are read from the chain.
+ *
+ * \param chkpt_idx Checkpoint to restart
+ * \param offset    Byte offset of the range in the restarted data
+ * \param length    Length of the range in bytes
+ * \param data      Device View to store the range in
+ *
+ * \return Time spent copying the range from host to device and restarting the range
+ */
+std::pair<double,double>
+ChkptChain::restart_range(uint32_t chkpt_idx,
+                          uint64_t offset,
+                          uint64_t length,
+                          Kokkos::View<uint8_t*>& data) {
+  using Timer = std::chrono::high_resolution_clock;
+  using Nanoseconds = std::chrono::nanoseconds;
+  Timer::time_point t0 = Timer::now();
+
+  header_t& header = metadata(chkpt_idx).header;
+  uint64_t datalen = header.datalen;
+  if(offset >= datalen) {
+    length = 0;
+  } else if(offset+length > datalen) {
+    length = datalen-offset;
+  }
+  if(data.size() < length)
+    Kokkos::resize(data, length);
+  if(length == 0)
+    return std::make_pair(0.0, 0.0);
+
+  Kokkos::View<uint8_t*>::HostMirror range_h("Range buffer", length);
+  gather(chkpt_idx, offset, length, range_h.data());
+  STDOUT_PRINT("Read %lu bytes to restart range [%lu,%lu)\n", num_bytes_read, offset, offset+length);
+
+  // Copy range to the device
+  Timer::time_point c1 = Timer::now();
+  auto range_d = Kokkos::subview(data, std::make_pair(static_cast<uint64_t>(0), length));
+  Kokkos::deep_copy(range_d, range_h);
+  Kokkos::fence();
+  Timer::time_point c2 = Timer::now();
+  double copy_time = (1e-9)*(std::chrono::duration_cast<Nanoseconds>(c2-c1).count());
+  double restart_time = (1e-9)*(std::chrono::duration_cast<Nanoseconds>(c2-t0).count());
+  return std::make_pair(copy_time, restart_time);
+}
+
+/**
+ * Restart a multi-region checkpoint into the regions it was made from. Each region is
+ * restarted as a byte range of the logical data directly into its device buffer.
+ *
+ * \param chkpt_idx Checkpoint to restart
+ * \param regions   Regions to restart into, in the order they were checkpointed
+ *
+ * \return Time spent copying the regions from host to device and restarting them
+ */
+std::pair<double,double>
+ChkptChain::restart_regions(uint32_t chkpt_idx, std::vector<region_t>& regions) {
+  header_t& header = metadata(chkpt_idx).header;
+  RegionMap layout(regions, header.chunk_size);
+  if(layout.len != header.datalen) {
+    printf("ERROR: Regions cover %lu bytes but checkpoint %u holds %lu bytes\n", 
+           layout.len, header.chkpt_id, header.datalen);
+    return std::make_pair(0.0, 0.0);
+  }
+  double copy_time = 0.0, restart_time = 0.0;
+  for(uint32_t i=0; i<regions.size(); i++) {
+    if(regions[i].len == 0)
+      continue;
+    Kokkos::View<uint8_t*, Kokkos::MemoryTraits<Kokkos::Unmanaged> > region(regions[i].ptr, regions[i].len);
+    Kokkos::View<uint8_t*> data = region;
+    auto times = restart_range(chkpt_idx, layout.starts_h(i), regions[i].len, data);
+    copy_time += times.first;
+    restart_time += times.second;
+    STDOUT_PRINT("Restarted region %s (%lu bytes)\n", regions[i].name.c_str(), regions[i].len);
+  }
+  return std::make_pair(copy_time, restart_time);
+}
+
+/**
+ * Windows are gathered on the calling thread and written by one writer thread, which
+ * writes a window while the next one is gathered into the other buffer.
+ */
+uint64_t
+ChkptChain::restart_fd(uint32_t chkpt_idx, int fd, uint64_t budget) {
+  header_t& header = metadata(chkpt_idx).header;
+  uint64_t datalen = header.datalen;
+  uint64_t chunk_size = header.chunk_size;
+  uint64_t window_len = std::max(budget/2/chunk_size, static_cast<uint64_t>(1))*chunk_size;
+  window_len = std::min(window_len, datalen);
+  std::vector<uint8_t> windows[2];
+  windows[0].resize(window_len);
+  if(window_len < datalen)
+    windows[1].resize(window_len);
+
+  // Window handed to the writer thread
+  std::mutex mutex;
+  std::condition_variable cv;
+  const uint8_t* job_window = NULL;
+  uint64_t job_len = 0, job_offset = 0;
+  bool job_ready = false, stop = false;
+  uint64_t num_written = 0;
+  bool write_ok = true;
+  int write_errno = 0;
+  std::thread writer([&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+      cv.wait(lock, [&]() { return job_ready || stop; });
+      if(!job_ready)
+        break;
+      const uint8_t* window = job_window;
+      uint64_t len = job_len, offset = job_offset;
+      lock.unlock();
+      bool ok = pwrite_all(fd, window, len, offset);
+      int error = errno;
+      lock.lock();
+      if(ok) {
+        num_written += len;
+      } else {
+        write_ok = false;
+        write_errno = error;
+      }
+      job_ready = false;
+      cv.notify_all();
+    }
+  });
+  auto stop_writer = [&]() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return !job_ready; });
+      stop = true;
+    }
+    cv.notify_all();
+    writer.join();
+  };
+
+  try {
+    for(uint64_t offset=0, w=0; offset<datalen; offset+=window_len, w++) {
+      uint64_t len = std::min(window_len, datalen-offset);
+      uint8_t* window = windows[w%2].data();
+      gather(chkpt_idx, offset, len, window);
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return !job_ready; });
+        if(!write_ok)
+          break;
+        job_window = window;
+        job_len = len;
+        job_offset = offset;
+        job_ready = true;
+      }
+      cv.notify_all();
+    }
+  } catch(...) {
+    stop_writer();
+    throw;
+  }
+  stop_writer();
+  if(!write_ok)
+    printf("ERROR: Failed to write restarted data: %s\n", strerror(write_errno));
+  return num_written;
+}
+
+uint64_t
+ChkptChain::restart_file(uint32_t chkpt_idx, const std::string& output_file, uint64_t budget) {
+  if(writer_config.backend == WriterStream) {
+    int fd = storage_open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+      printf("ERROR: Failed to open %s: %s\n", output_file.c_str(), strerror(errno));
+      return 0;
+    }
+    uint64_t num_written = restart_fd(chkpt_idx, fd, budget);
+    storage_close(fd);
+    return num_written;
+  }
+  header_t& header = metadata(chkpt_idx).header;
+  uint64_t datalen = header.datalen;
+  uint64_t chunk_size = header.chunk_size;
+  uint64_t window_len = std::max(budget/chunk_size, static_cast<uint64_t>(1))*chunk_size;
+  window_len = std::min(window_len, datalen);
+  std::vector<uint8_t> window(window_len);
+  uint64_t num_written = 0;
+  try {
+    ChkptWriter writer(output_file, writer_config);
+    for(uint64_t offset=0; offset<datalen; offset+=window_len) {
+      uint64_t len = std::min(window_len, datalen-offset);
+      gather(chkpt_idx, offset, len, window.data());
+      writer.write(window.data(), len);
+    }
+    num_written = writer.close();
+  } catch(const std::ios_base::failure& e) {
+    printf("ERROR: Failed to write restarted data: %s\n", e.what());
+  }
+  return num_written;
+}
+
+/**
+ * Stream consecutive chunks of a checkpoint to an output stream through a bounded Host
+ * buffer. Every chunk occupies a full chunk_size slot, same as the data section written
+ * by collect_diff.
+ *
+ * \param chkpt_idx Checkpoint to resolve the chunks for
+ * \param start     First chunk
+ * \param len       Number of chunks
+ * \param out       Output stream
+ *
+ * \return Number of bytes written
+ */
+uint64_t
+ChkptChain::write_chunks(uint32_t chkpt_idx, uint32_t start, uint32_t len, std::ostream& out) {
+  header_t& header = metadata(chkpt_idx).header;
+  uint64_t chunk_size = header.chunk_size;
+  uint32_t window = static_cast<uint32_t>(std::max(static_cast<uint64_t>(1), 
+                                                   CHAIN_STREAM_BUFFER/chunk_size));
+  std::vector<uint8_t> buffer(static_cast<uint64_t>(std::min(window, len))*chunk_size);
+  for(uint32_t i=0; i<len; i+=window) {
+    uint32_t n = std::min(window, len-i);
+    uint64_t offset = static_cast<uint64_t>(start+i)*chunk_size;
+    uint64_t nbytes = static_cast<uint64_t>(n)*chunk_size;
+    uint64_t valid = nbytes;
+    if(offset+valid > header.datalen)
+      valid = header.datalen-offset;
+    memset(buffer.data(), 0, nbytes);
+    gather(chkpt_idx, offset, valid, buffer.data());
+    out.write((const char*)(buffer.data()), nbytes);
+  }
+  return static_cast<uint64_t>(len)*chunk_size;
+}
+
+/**
+ * Stream raw bytes of a checkpoint to an output stream through a bounded Host buffer.
+ *
+ * \param chkpt_idx Index of the checkpoint in the chain
+ * \param offset    Byte offset in the checkpoint
+ * \param len       Number of bytes to copy
+ * \param out       Output stream
+ *
+ * \return Number of bytes written
+ */
+uint64_t
+ChkptChain::copy_bytes(uint32_t chkpt_idx, uint64_t offset, uint64_t len, std::ostream& out) {
+  std::vector<uint8_t> buffer(std::min(static_cast<uint64_t>(CHAIN_STREAM_BUFFER), len));
+  for(uint64_t pos=0; pos<len; pos+=buffer.size()) {
+    uint64_t n = std::min(static_cast<uint64_t>(buffer.size()), len-pos);
+    read(chkpt_idx, offset+pos, n, buffer.data());
+    out.write((const char*)(buffer.data()), n);
+  }
+  return len;
+}
+
+/**
+ * Write a single checkpoint of the consolidated chain.
+ *   - The new baseline stores every chunk as a first occurrence. Tree checkpoints use the
+ *     largest complete subtrees so the metadata stays small.
+ *   - Later checkpoints keep their first occurrences and data. Shifted duplicates that 
+ *     reference checkpoints before the new baseline become first occurrences and their 
+ *     chunks are appended to the data section.
+ *
+ * \param baseline_idx Checkpoint that becomes the new baseline
+ * \param chkpt_idx    Checkpoint to write
+ * \param out          Output stream
+ *
+ * \return Number of bytes written
+ */
+uint64_t
+ChkptChain::write_consolidated(uint32_t baseline_idx, uint32_t chkpt_idx, std::ostream& out) {
+  ChkptMetadata& meta = metadata(chkpt_idx);
+  header_t header = meta.header;
+  uint32_t num_chunks = header.datalen/header.chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(header.chunk_size) < header.datalen) {
+    num_chunks += 1;
+  }
+  uint32_t num_nodes = 2*num_chunks-1;
+  uint64_t num_bytes = 0;
+
+  if((chkpt_idx != baseline_idx) && reference(chkpt_idx)) {
+    // Later chains seeded from references keep their reference checkpoint
+    std::vector<uint8_t>& chkpt = ref_chkpts[chkpt_idx];
+    out.write((const char*)(chkpt.data()), chkpt.size());
+    return chkpt.size();
+  }
+
+  if(chkpt_idx == baseline_idx) {
+    // Cover all chunks with entries whose leaves are consecutive chunks
+    std::vector<std::pair<uint32_t,uint32_t>> entries; // (first chunk, node)
+    if(tree) {
+      std::vector<uint32_t> stack(1, 0);
+      while(stack.size() > 0) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+        uint32_t left = node, right = node;
+        while(2*left+1 < num_nodes) {
+          left = 2*left+1;
+          right = 2*right+2;
+        }
+        if(right < num_nodes) {
+          entries.push_back(std::make_pair(left-(num_chunks-1), node));
+        } else {
+          stack.push_back(2*node+1);
+          stack.push_back(2*node+2);
+        }
+      }
+      std::sort(entries.begin(), entries.end());
+    } else {
+      for(uint32_t i=0; i<num_chunks; i++) {
+        entries.push_back(std::make_pair(i, i));
+      }
+    }
+    header.ref_id = baseline_idx;
+    header.num_first_ocur = entries.size();
+    header.num_prior_chkpts = 0;
+    header.num_shift_dupl = 0;
+    out.write((const char*)(&header), sizeof(header_t));
+    for(uint32_t i=0; i<entries.size(); i++) {
+      out.write((const char*)(&entries[i].second), sizeof(uint32_t));
+    }
+    num_bytes += sizeof(header_t) + entries.size()*sizeof(uint32_t);
+    num_bytes += write_chunks(chkpt_idx, 0, num_chunks, out);
+    return num_bytes;
+  }
+
+  std::vector<uint32_t> first_ocur, shift_dupl, shift_src;
+  read_metadata(chkpt_idx, header, first_ocur, shift_dupl, shift_src);
+
+  // Split shifted duplicates into entries that are kept and entries that need their data
+  std::vector<uint32_t> kept, converted;
+  std::vector<std::pair<uint32_t,uint32_t>> dupl_counts;
+  for(uint32_t i=0; i<header.num_shift_dupl; i++) {
+    if(shift_src[i] < baseline_idx) {
+      converted.push_back(i);
+    } else {
+      kept.push_back(i);
+      if(dupl_counts.size() == 0 || dupl_counts.back().first != shift_src[i])
+        dupl_counts.push_back(std::make_pair(shift_src[i], 0));
+      dupl_counts.back().second += 1;
+    }
+  }
+
+  header.ref_id = std::max(header.ref_id, baseline_idx);
+  header.num_first_ocur = first_ocur.size() + converted.size();
+  header.num_prior_chkpts = dupl_counts.size();
+  header.num_shift_dupl = kept.size();
+  out.write((const char*)(&header), sizeof(header_t));
+  out.write((const char*)(first_ocur.data()), first_ocur.size()*sizeof(uint32_t));
+  for(uint32_t i=0; i<converted.size(); i++) {
+    out.write((const char*)(&shift_dupl[2*converted[i]]), sizeof(uint32_t));
+  }
+  for(uint32_t i=0; i<dupl_counts.size(); i++) {
+    out.write((const char*)(&dupl_counts[i].first), sizeof(uint32_t));
+    out.write((const char*)(&dupl_counts[i].second), sizeof(uint32_t));
+  }
+  for(uint32_t i=0; i<kept.size(); i++) {
+    out.write((const char*)(&shift_dupl[2*kept[i]]), 2*sizeof(uint32_t));
+  }
+  num_bytes += sizeof(header_t) + 
+               static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t) +
+               static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t) +
+               static_cast<uint64_t>(header.num_shift_dupl)*2*sizeof(uint32_t);
+
+  // Existing first occurrences followed by the chunks of the converted duplicates
+  num_bytes += copy_bytes(chkpt_idx, meta.data_offset, 
+                          static_cast<uint64_t>(meta.num_slots)*header.chunk_size, out);
+  for(uint32_t i=0; i<converted.size(); i++) {
+    uint32_t node = shift_dupl[2*converted[i]];
+    uint32_t prev = shift_dupl[2*converted[i]+1];
+    uint32_t start = prev;
+    uint32_t len = 1;
+    if(tree) {
+      start = leftmost_leaf(prev, num_nodes) - (num_chunks-1);
+      len = num_leaf_descendents(node, num_nodes);
+    }
+    num_bytes += write_chunks(shift_src[converted[i]], start, len, out);
+  }
+  return num_bytes;
+}
+
+/**
+ * Write an output file through a stream, either a file stream or the selected writer
+ *
+ * \param filename Output file
+ * \param config   Writer configuration
+ * \param write    Writes the file contents to a stream and returns the number of bytes
+ *
+ * \return Number of bytes written
+ */
+template<class WriteFunc>
+static uint64_t
+write_output(const std::string& filename, const writer_config_t& config, WriteFunc write) {
+  uint64_t num_bytes = 0;
+  if(config.backend == WriterStream) {
+    storage_metadata(filename);
+    std::ofstream file;
+    file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    file.open(filename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    num_bytes = write(file);
+    file.flush();
+    file.close();
+    storage_transfer(filename, num_bytes, true);
+  } else {
+    ChkptWriter writer(filename, config);
+    WriterStreamBuf buffer(writer);
+    std::ostream out(&buffer);
+    num_bytes = write(out);
+    writer.close();
+  }
+  return num_bytes;
+}
+
+uint64_t
+ChkptChain::consolidate(uint32_t baseline_idx, std::vector<std::string>& output_files) {
+  uint64_t num_bytes = 0;
+  for(uint32_t i=baseline_idx; i<size(); i++) {
+    num_bytes += write_output(output_files[i], writer_config, [this, baseline_idx, i](std::ostream& out) {
+      return write_consolidated(baseline_idx, i, out);
+    });
+  }
+  return num_bytes;
+}
+
+uint64_t
+ChkptChain::consolidate(uint32_t baseline_idx, 
+                        std::vector<Kokkos::View<uint8_t*>::HostMirror>& output_chkpts) {
+  uint64_t num_bytes = 0;
+  if(output_chkpts.size() < size())
+    output_chkpts.resize(size());
+  for(uint32_t i=baseline_idx; i<size(); i++) {
+    std::stringstream stream;
+    uint64_t chkpt_size = write_consolidated(baseline_idx, i, stream);
+    Kokkos::View<uint8_t*>::HostMirror chkpt_h("Consolidated checkpoint", chkpt_size);
+    stream.read((char*)(chkpt_h.data()), chkpt_size);
+    output_chkpts[i] = chkpt_h;
+    num_bytes += chkpt_size;
+  }
+  return num_bytes;
+}
+
+bool
+ChkptChain::reverse(uint32_t chkpt_idx) {
+  header_t header;
+  if(chain[chkpt_idx].loaded) {
+    header = chain[chkpt_idx].header;
+  } else {
+    read(chkpt_idx, 0, sizeof(header_t), (uint8_t*)(&header));
+  }
+  return header.ref_id > header.chkpt_id;
+}
+
+bool
+ChkptChain::reference(uint32_t chkpt_idx) {
+  if(refs[chkpt_idx])
+    return true;
+  if(chain[chkpt_idx].loaded)
+    return false;
+  header_t header;
+  read(chkpt_idx, 0, sizeof(header_t), (uint8_t*)(&header));
+  return maybe_reference_chkpt(header) && load_reference(chkpt_idx, header);
+}
+
+bool
+ChkptChain::seeded(uint32_t chkpt_idx) {
+  header_t header;
+  if(chain[chkpt_idx].loaded) {
+    header = chain[chkpt_idx].header;
+  } else {
+    read(chkpt_idx, 0, sizeof(header_t), (uint8_t*)(&header));
+  }
+  if((header.ref_id > header.chkpt_id) || (header.ref_id >= size()))
+    return false;
+  return reference(header.ref_id);
+}
+
+std::pair<double,double>
+ChkptChain::restart(uint32_t chkpt_idx, Kokkos::View<uint8_t*>& data) {
+  uint64_t datalen = metadata(chkpt_idx).header.datalen;
+  return restart_range(chkpt_idx, 0, datalen, data);
+}
+
+/**
+ * Compute the digest of every chunk of a checkpoint. Chunks are gathered through
+ * the chain into a bounded Host buffer and hashed with the same hash function used
+ * for deduplication.
+ *
+ * \param chkpt_idx Checkpoint to hash
+ * \param digests   Output digest for each chunk
+ */
+void
+ChkptChain::digest_chunks(uint32_t chkpt_idx, std::vector<HashDigest>& digests) {
+  header_t& header = metadata(chkpt_idx).header;
+  uint64_t chunk_size = header.chunk_size;
+  uint32_t num_chunks = header.datalen/chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*chunk_size < header.datalen) {
+    num_chunks += 1;
+  }
+  digests.resize(num_chunks);
+  uint32_t window = static_cast<uint32_t>(std::max(static_cast<uint64_t>(1), 
+                                                   CHAIN_STREAM_BUFFER/chunk_size));
+  std::vector<uint8_t> buffer(static_cast<uint64_t>(std::min(window, num_chunks))*chunk_size);
+  for(uint32_t i=0; i<num_chunks; i+=window) {
+    uint32_t n = std::min(window, num_chunks-i);
+    uint64_t offset = static_cast<uint64_t>(i)*chunk_size;
+    uint64_t valid = std::min(static_cast<uint64_t>(n)*chunk_size, header.datalen-offset);
+    gather(chkpt_idx, offset, valid, buffer.data());
+    for(uint32_t j=0; j<n; j++) {
+      uint64_t num_bytes = std::min(chunk_size, valid-static_cast<uint64_t>(j)*chunk_size);
+      hash(buffer.data()+static_cast<uint64_t>(j)*chunk_size, num_bytes, digests[i+j].digest);
+    }
+  }
+}
+
+/**
+ * Write a checkpoint as a reverse delta against the next checkpoint in the chain.
+ * The checkpoint keeps its ID and uses the ID of the next checkpoint as reference.
+ * Tree checkpoints use leaf nodes for all entries.
+ *
+ * \param chkpt_idx Checkpoint to rewrite
+ * \param out       Output stream
+ *
+ * \return Number of bytes written
+ */
+uint64_t
+ChkptChain::write_reverse_delta(uint32_t chkpt_idx, std::ostream& out) {
+  header_t header = metadata(chkpt_idx).header;
+  header_t& next_header = metadata(chkpt_idx+1).header;
+  if(header.datalen != next_header.datalen || header.chunk_size != next_header.chunk_size) {
+    // Different layouts cannot be compared chunk by chunk, keep the checkpoint as is
+    uint64_t chkpt_len = metadata(chkpt_idx).data_offset + 
+                         static_cast<uint64_t>(metadata(chkpt_idx).num_slots)*header.chunk_size;
+    return copy_bytes(chkpt_idx, 0, chkpt_len, out);
+  }
+  uint32_t num_chunks = header.datalen/header.chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(header.chunk_size) < header.datalen) {
+    num_chunks += 1;
+  }
+  // Entries are chunks (Basic/List) or leaves (Tree)
+  uint32_t entry_offset = tree ? num_chunks-1 : 0;
+
+  std::vector<HashDigest> next_digests, digests;
+  digest_chunks(chkpt_idx+1, next_digests);
+  digest_chunks(chkpt_idx, digests);
+  std::unordered_map<HashDigest, uint32_t, DigestHasher, CompareHashDigest> next_map, first_ocur_map;
+  for(uint32_t i=0; i<num_chunks; i++) {
+    next_map.emplace(next_digests[i], i);
+  }
+
+  // Prefer duplicates in the same checkpoint so they resolve without leaving the file
+  std::vector<uint32_t> first_ocur, self_dupl, next_dupl;
+  for(uint32_t i=0; i<num_chunks; i++) {
+    if(digests_same(digests[i], next_digests[i]))
+      continue;
+    auto self = first_ocur_map.find(digests[i]);
+    if(self != first_ocur_map.end()) {
+      self_dupl.push_back(i+entry_offset);
+      self_dupl.push_back(self->second+entry_offset);
+      continue;
+    }
+    auto next = next_map.find(digests[i]);
+    if(next != next_map.end()) {
+      next_dupl.push_back(i+entry_offset);
+      next_dupl.push_back(next->second+entry_offset);
+      continue;
+    }
+    first_ocur_map.emplace(digests[i], i);
+    first_ocur.push_back(i);
+  }
+
+  std::vector<std::pair<uint32_t,uint32_t>> dupl_counts;
+  if(self_dupl.size() > 0)
+    dupl_counts.push_back(std::make_pair(header.chkpt_id, self_dupl.size()/2));
+  if(next_dupl.size() > 0)
+    dupl_counts.push_back(std::make_pair(next_header.chkpt_id, next_dupl.size()/2));
+
+  header.ref_id = next_header.chkpt_id;
+  header.num_first_ocur = first_ocur.size();
+  header.num_prior_chkpts = dupl_counts.size();
+  header.num_shift_dupl = (self_dupl.size()+next_dupl.size())/2;
+  out.write((const char*)(&header), sizeof(header_t));
+  for(uint32_t i=0; i<first_ocur.size(); i++) {
+    uint32_t entry = first_ocur[i]+entry_offset;
+    out.write((const char*)(&entry), sizeof(uint32_t));
+  }
+  for(uint32_t i=0; i<dupl_counts.size(); i++) {
+    out.write((const char*)(&dupl_counts[i].first), sizeof(uint32_t));
+    out.write((const char*)(&dupl_counts[i].second), sizeof(uint32_t));
+  }
+  out.write((const char*)(self_dupl.data()), self_dupl.size()*sizeof(uint32_t));
+  out.write((const char*)(next_dupl.data()), next_dupl.size()*sizeof(uint32_t));
+  uint64_t num_bytes = sizeof(header_t) + 
+                       static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t) +
+                       static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t) +
+                       static_cast<uint64_t>(header.num_shift_dupl)*2*sizeof(uint32_t);
+
+  // Write runs of consecutive first occurrences
+  uint32_t run_start = 0;
+  for(uint32_t i=1; i<=first_ocur.size(); i++) {
+    if(i == first_ocur.size() || first_ocur[i] != first_ocur[i-1]+1) {
+      num_bytes += write_chunks(chkpt_idx, first_ocur[run_start], i-run_start, out);
+      run_start = i;
+    }
+  }
+  return num_bytes;
+}
+
+uint64_t
+ChkptChain::reverse_delta(uint32_t chkpt_idx, std::string& output_file) {
+  return write_output(output_file, writer_config, [this, chkpt_idx](std::ostream& out) {
+    return write_reverse_delta(chkpt_idx, out);
+  });
+}
+
+uint64_t
+ChkptChain::reverse_delta(uint32_t chkpt_idx, Kokkos::View<uint8_t*>::HostMirror& output_chkpt) {
+  std::stringstream stream;
+  uint64_t chkpt_size = write_reverse_delta(chkpt_idx, stream);
+  Kokkos::View<uint8_t*>::HostMirror chkpt_h("Reverse delta checkpoint", chkpt_size);
+  stream.read((char*)(chkpt_h.data()), chkpt_size);
+  output_chkpt = chkpt_h;
+  return chkpt_size;
+}
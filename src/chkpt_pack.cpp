@@ -0,0 +1,269 @@
+#include "chkpt_pack.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ios>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chkpt_writer.hpp"
+#include "hash_functions.hpp"
+#include "storage_emulator.hpp"
+
+static_assert(sizeof(pack_record_t) <= PACK_RECORD_SIZE, "Pack records must fit their block");
+
+static void
+index_digest(const std::vector<pack_entry_t>& index, uint8_t* digest) {
+  HashDigest index_hash;
+  memset(index_hash.digest, 0, sizeof(index_hash.digest));
+  hash(index.data(), index.size()*sizeof(pack_entry_t), index_hash.digest);
+  memcpy(digest, index_hash.digest, PACK_INDEX_DIGEST_SIZE);
+}
+
+static uint64_t
+align_up(uint64_t value, uint64_t alignment) {
+  return (value+alignment-1)/alignment*alignment;
+}
+
+ChkptPack::ChkptPack(const std::string& file, bool can_write) {
+  filename = file;
+  writable = can_write;
+  data_end = 0;
+  file_len = 0;
+  has_torn = false;
+  torn_id = 0;
+  fd = storage_open(filename, writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+  if(fd < 0)
+    throw std::ios_base::failure(std::string("Failed to open ") + filename + ": " + strerror(errno));
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    storage_close(fd);
+    throw std::ios_base::failure(std::string("Failed to stat ") + filename + ": " + strerror(errno));
+  }
+  file_len = static_cast<uint64_t>(st.st_size);
+  // A new pack has no index yet
+  if(file_len == 0)
+    return;
+
+  pack_trailer_t trailer;
+  bool valid = (file_len >= sizeof(pack_trailer_t)) &&
+               pread_all(fd, (uint8_t*)(&trailer), sizeof(pack_trailer_t), file_len-sizeof(pack_trailer_t)) &&
+               (trailer.magic == PACK_MAGIC) && (trailer.version >= 1) && (trailer.version <= PACK_VERSION) &&
+               valid_index(trailer);
+  bool recovered = false;
+  if(valid) {
+    data_end = trailer.index_offset;
+    // Without a sync the trailer can reach the disk before the last checkpoint does
+    if(!index.empty() && (index.back().flags & PACK_ENTRY_RECORD)) {
+      pack_entry_t last = index.back();
+      pack_record_t record;
+      if(!read_record(last.offset-PACK_RECORD_SIZE, record) || (record.chkpt_id != last.chkpt_id) ||
+         !matches_record(record, last.offset)) {
+        has_torn = true;
+        torn_id = last.chkpt_id;
+        index.pop_back();
+        data_end = last.offset-PACK_RECORD_SIZE;
+      }
+    }
+  } else {
+    // An append interrupted by a crash overwrites the old index or its trailer
+    index.clear();
+    valid = recover();
+    recovered = valid;
+  }
+  if(!valid) {
+    storage_close(fd);
+    throw std::ios_base::failure(filename + " is not a checkpoint pack");
+  }
+  if(writable && (has_torn || recovered)) {
+    try {
+      write_index();
+    } catch(const std::ios_base::failure&) {
+      storage_close(fd);
+      throw;
+    }
+  }
+}
+
+/**
+ * Read the index located by a trailer and check it: the index must end at the trailer,
+ * match its digest, and list the checkpoints in order, each one ending before the index.
+ */
+bool
+ChkptPack::valid_index(const pack_trailer_t& trailer) {
+  uint64_t digest_len = (trailer.version >= 3) ? PACK_INDEX_DIGEST_SIZE : 0;
+  uint64_t index_len = static_cast<uint64_t>(trailer.num_entries)*sizeof(pack_entry_t);
+  if((trailer.index_offset > file_len) ||
+     (file_len-trailer.index_offset != index_len+digest_len+sizeof(pack_trailer_t)))
+    return false;
+  index.resize(trailer.num_entries);
+  if((index_len > 0) && !pread_all(fd, (uint8_t*)(index.data()), index_len, trailer.index_offset))
+    return false;
+  if(digest_len > 0) {
+    uint8_t stored[PACK_INDEX_DIGEST_SIZE], digest[PACK_INDEX_DIGEST_SIZE];
+    index_digest(index, digest);
+    if(!pread_all(fd, stored, PACK_INDEX_DIGEST_SIZE, trailer.index_offset+index_len) ||
+       (memcmp(stored, digest, PACK_INDEX_DIGEST_SIZE) != 0))
+      return false;
+  }
+  uint64_t end = 0;
+  for(uint64_t i=0; i<index.size(); i++) {
+    const pack_entry_t& entry = index[i];
+    uint64_t start = entry.offset;
+    if(entry.flags == PACK_ENTRY_RECORD) {
+      if(entry.offset < PACK_RECORD_SIZE)
+        return false;
+      start -= PACK_RECORD_SIZE;
+    } else if(entry.flags != 0) {
+      return false;
+    }
+    if((start < end) || (entry.offset > trailer.index_offset) ||
+       (entry.length > trailer.index_offset-entry.offset))
+      return false;
+    end = entry.offset+entry.length;
+  }
+  return true;
+}
+
+bool
+ChkptPack::read_record(uint64_t record_offset, pack_record_t& record) {
+  return (record_offset+PACK_RECORD_SIZE <= file_len) &&
+         pread_all(fd, (uint8_t*)(&record), sizeof(pack_record_t), record_offset) &&
+         (record.magic == PACK_RECORD_MAGIC);
+}
+
+bool
+ChkptPack::matches_record(const pack_record_t& record, uint64_t offset) {
+  if(offset+record.length > file_len)
+    return false;
+  std::vector<uint8_t> chkpt(record.length);
+  if(!pread_all(fd, chkpt.data(), chkpt.size(), offset))
+    return false;
+  HashDigest digest;
+  memset(digest.digest, 0, sizeof(digest.digest));
+  hash(chkpt.data(), chkpt.size(), digest.digest);
+  return memcmp(digest.digest, record.digest, sizeof(record.digest)) == 0;
+}
+
+/**
+ * Rebuild the index from the records of the checkpoints, up to the first checkpoint
+ * that does not match its record
+ *
+ * \return Whether the file starts with a record
+ */
+bool
+ChkptPack::recover() {
+  pack_record_t record;
+  if(!read_record(0, record))
+    return false;
+  uint64_t record_offset = 0;
+  while(read_record(record_offset, record)) {
+    uint64_t offset = record_offset+PACK_RECORD_SIZE;
+    if(!matches_record(record, offset)) {
+      has_torn = true;
+      torn_id = record.chkpt_id;
+      break;
+    }
+    pack_entry_t entry = {record.chkpt_id, PACK_ENTRY_RECORD, offset, record.length};
+    index.push_back(entry);
+    data_end = offset+record.length;
+    record_offset = align_up(data_end, PACK_ALIGNMENT);
+  }
+  return true;
+}
+
+ChkptPack::~ChkptPack() {
+  views.clear();
+  for(uint32_t i=0; i<maps.size(); i++) {
+    munmap(maps[i].first, maps[i].second);
+  }
+  if(fd >= 0)
+    storage_close(fd);
+}
+
+pack_entry_t
+ChkptPack::append(uint32_t chkpt_id, const uint8_t* data, uint64_t len) {
+  if(!writable)
+    throw std::ios_base::failure(filename + " was opened for reading");
+  uint64_t record_offset = align_up(data_end, PACK_ALIGNMENT);
+  uint64_t offset = record_offset+PACK_RECORD_SIZE;
+  pack_record_t record;
+  memset(&record, 0, sizeof(pack_record_t));
+  record.magic = PACK_RECORD_MAGIC;
+  record.chkpt_id = chkpt_id;
+  record.version = PACK_VERSION;
+  record.length = len;
+  HashDigest digest;
+  memset(digest.digest, 0, sizeof(digest.digest));
+  hash(data, len, digest.digest);
+  memcpy(record.digest, digest.digest, sizeof(record.digest));
+  uint8_t record_block[PACK_RECORD_SIZE];
+  memset(record_block, 0, PACK_RECORD_SIZE);
+  memcpy(record_block, &record, sizeof(pack_record_t));
+  // The record goes first, a checkpoint cut short by a crash does not match it
+  if(!pwrite_all(fd, record_block, PACK_RECORD_SIZE, record_offset) || !pwrite_all(fd, data, len, offset))
+    throw std::ios_base::failure(std::string("Failed to append to ") + filename + ": " + strerror(errno));
+  pack_entry_t entry = {chkpt_id, PACK_ENTRY_RECORD, offset, len};
+  index.push_back(entry);
+  views.erase(chkpt_id);
+  data_end = offset+len;
+  write_index();
+  return entry;
+}
+
+void
+ChkptPack::write_index() {
+  uint64_t index_offset = align_up(data_end, sizeof(uint64_t));
+  uint64_t index_len = index.size()*sizeof(pack_entry_t);
+  std::vector<uint8_t> buffer(index_len+PACK_INDEX_DIGEST_SIZE+sizeof(pack_trailer_t));
+  if(index_len > 0)
+    memcpy(buffer.data(), index.data(), index_len);
+  index_digest(index, buffer.data()+index_len);
+  pack_trailer_t trailer = {index_offset, static_cast<uint32_t>(index.size()), PACK_VERSION, PACK_MAGIC};
+  memcpy(buffer.data()+index_len+PACK_INDEX_DIGEST_SIZE, &trailer, sizeof(pack_trailer_t));
+  if(!pwrite_all(fd, buffer.data(), buffer.size(), index_offset))
+    throw std::ios_base::failure(std::string("Failed to write the index of ") + filename + ": " + strerror(errno));
+  file_len = index_offset+buffer.size();
+  // Drop what is left of a longer index
+  if(ftruncate(fd, static_cast<off_t>(file_len)) != 0)
+    throw std::ios_base::failure(std::string("Failed to truncate ") + filename + ": " + strerror(errno));
+}
+
+bool
+ChkptPack::find(uint32_t chkpt_id, pack_entry_t& entry) const {
+  for(size_t i=index.size(); i>0; i--) {
+    if(index[i-1].chkpt_id == chkpt_id) {
+      entry = index[i-1];
+      return true;
+    }
+  }
+  return false;
+}
+
+Kokkos::View<uint8_t*>::HostMirror
+ChkptPack::view(uint32_t chkpt_id) {
+  auto existing = views.find(chkpt_id);
+  if(existing != views.end())
+    return existing->second;
+  pack_entry_t entry;
+  if(!find(chkpt_id, entry))
+    throw std::ios_base::failure(filename + " has no checkpoint " + std::to_string(chkpt_id));
+  uint8_t* ptr = NULL;
+  if(entry.length > 0) {
+    // Map from the page holding the start of the checkpoint
+    uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t map_start = entry.offset/page_size*page_size;
+    uint64_t map_len = entry.offset+entry.length-map_start;
+    void* map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(map_start));
+    if(map == MAP_FAILED)
+      throw std::ios_base::failure(std::string("Failed to map checkpoint ") + std::to_string(chkpt_id) +
+                                   " of " + filename + ": " + strerror(errno));
+    maps.push_back(std::make_pair(map, map_len));
+    // The mapping reads the checkpoint from the file
+    storage_transfer_fd(fd, entry.length, false);
+    ptr = static_cast<uint8_t*>(map) + (entry.offset-map_start);
+  }
+  Kokkos::View<uint8_t*>::HostMirror chkpt(ptr, entry.length);
+  views[chkpt_id] = chkpt;
+  return chkpt;
+}
@@ -0,0 +1,165 @@
+#include "chkpt_prefetch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <ios>
+#include "striped_io.hpp"
+
+ChkptPrefetcher::ChkptPrefetcher(const std::vector<std::string>& chkpt_files,
+                                 const std::vector<uint32_t>& order,
+                                 const writer_config_t& writer_config,
+                                 uint64_t max_buffered) {
+  config = writer_config;
+  max_bytes = max_buffered;
+  next = 0;
+  demanded = 0;
+  buffered = 0;
+  num_read = 0;
+  wait_seconds = 0.0;
+  stop = false;
+  items.resize(order.size());
+  for(uint64_t i=0; i<order.size(); i++) {
+    // Each checkpoint has one buffer, released once
+    if(index.find(order[i]) != index.end())
+      throw std::ios_base::failure(std::string("Checkpoint ") + std::to_string(order[i]) +
+                                   " appears twice in the prefetch order");
+    Item& item = items[i];
+    item.chkpt_id = order[i];
+    item.size = 0;
+    item.ready = false;
+    item.released = false;
+    // Sizes are known up front so the budget can hold back reads before they start
+    stripe_layout_t layout;
+    if(order[i] >= chkpt_files.size()) {
+      item.error = std::make_exception_ptr(std::ios_base::failure(std::string("No file for checkpoint ") +
+                                                                  std::to_string(order[i])));
+      item.ready = true;
+    } else if(!read_stripe_layout(chkpt_files[order[i]], layout)) {
+      item.error = std::make_exception_ptr(std::ios_base::failure(std::string("Failed to find ") +
+                                                                  chkpt_files[order[i]]));
+      item.ready = true;
+    } else {
+      item.filename = chkpt_files[order[i]];
+      item.size = layout.total_len;
+    }
+    index[order[i]] = i;
+  }
+  uint32_t num_threads = std::max(config.stripe_threads, 1u);
+  num_threads = static_cast<uint32_t>(std::min(static_cast<uint64_t>(num_threads),
+                                               static_cast<uint64_t>(items.size())));
+  for(uint32_t t=0; t<num_threads; t++) {
+    threads.emplace_back(&ChkptPrefetcher::read_ahead, this);
+  }
+}
+
+ChkptPrefetcher::~ChkptPrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  can_read.notify_all();
+  for(uint32_t t=0; t<threads.size(); t++) {
+    threads[t].join();
+  }
+}
+
+/**
+ * Read checkpoints in order until all are read or the prefetcher stops. Reads are
+ * issued in order, so a checkpoint that does not fit the budget holds back the ones
+ * after it rather than being overtaken.
+ */
+void
+ChkptPrefetcher::read_ahead() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true) {
+    can_read.wait(lock, [this]() {
+      if(stop || (next >= items.size()))
+        return true;
+      const Item& item = items[next];
+      return item.ready || (buffered == 0) || (buffered+item.size <= max_bytes) || (next < demanded);
+    });
+    if(stop || (next >= items.size()))
+      return;
+    Item& item = items[next];
+    next += 1;
+    if(item.ready)
+      continue;
+    buffered += item.size;
+    lock.unlock();
+    // Any error, a failed allocation included, is handed to the get of the checkpoint
+    std::exception_ptr error;
+    std::unique_ptr<uint8_t[]> data;
+    try {
+      data.reset(new uint8_t[std::max(item.size, static_cast<uint64_t>(1))]);
+      read_striped(item.filename, 0, item.size, data.get(), config);
+    } catch(...) {
+      error = std::current_exception();
+      data.reset();
+    }
+    lock.lock();
+    if(!error) {
+      num_read += item.size;
+    } else {
+      buffered -= item.size;
+      can_read.notify_all();
+    }
+    item.data = std::move(data);
+    item.error = error;
+    item.ready = true;
+    item_ready.notify_all();
+  }
+}
+
+ChkptPrefetcher::HostBuffer
+ChkptPrefetcher::get(uint32_t chkpt_id) {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto it = index.find(chkpt_id);
+  if(it == index.end())
+    throw std::ios_base::failure(std::string("Checkpoint ") + std::to_string(chkpt_id) + " was not prefetched");
+  uint64_t pos = it->second;
+  Item& item = items[pos];
+  if(!item.ready) {
+    // The restart needs the checkpoint now, read it whether or not it fits
+    demanded = std::max(demanded, pos+1);
+    can_read.notify_all();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    item_ready.wait(lock, [&item]() { return item.ready; });
+    std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+    wait_seconds += waited.count();
+  }
+  if(item.error)
+    std::rethrow_exception(item.error);
+  if(item.released)
+    throw std::ios_base::failure(std::string("Checkpoint ") + std::to_string(chkpt_id) + " was released");
+  return HostBuffer(item.data.get(), item.size);
+}
+
+void
+ChkptPrefetcher::release(uint32_t chkpt_id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(chkpt_id);
+    if(it == index.end())
+      return;
+    Item& item = items[it->second];
+    if(!item.ready || item.released)
+      return;
+    item.released = true;
+    if(item.data)
+      buffered -= item.size;
+    item.data.reset();
+  }
+  can_read.notify_all();
+}
+
+double
+ChkptPrefetcher::wait_time() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return wait_seconds;
+}
+
+uint64_t
+ChkptPrefetcher::bytes_read() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return num_read;
+}
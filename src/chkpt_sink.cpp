@@ -0,0 +1,87 @@
+#include "chkpt_sink.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "storage_emulator.hpp"
+
+ChkptSink::ChkptSink(const std::string& file, const writer_config_t& config, bool split_files) {
+  filename = file;
+  writer_config = config;
+  split = split_files;
+  fd = -1;
+  map_ptr = NULL;
+  map_len = 0;
+}
+
+ChkptSink::~ChkptSink() {
+  if(map_ptr != NULL) {
+    munmap(map_ptr, map_len);
+    // The mapping wrote the checkpoint to the file
+    storage_transfer_fd(fd, map_len, true);
+  }
+  if(fd >= 0)
+    storage_close(fd);
+}
+
+uint8_t* 
+ChkptSink::map(uint64_t size) {
+  if(!zero_copy || (writer_config.backend != WriterStream) || (size == 0) || (map_ptr != NULL))
+    return NULL;
+  fd = storage_open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    return NULL;
+  // Reserve the blocks up front, file systems without fallocate only get the size.
+  // Any other failure, e.g. a full file system, would only show up as SIGBUS once
+  // the mapping is written.
+  int error = posix_fallocate(fd, 0, static_cast<off_t>(size));
+  bool unsupported = (error == EOPNOTSUPP) || (error == EINVAL);
+  bool sized = (error == 0) || (unsupported && (ftruncate(fd, static_cast<off_t>(size)) == 0));
+  if(!sized) {
+    storage_close(fd);
+    fd = -1;
+    if(!unsupported)
+      throw std::ios_base::failure(std::string("Failed to allocate ") + std::to_string(size) + 
+                                   " bytes for " + filename + ": " + strerror(error));
+    return NULL;
+  }
+  void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(ptr == MAP_FAILED) {
+    storage_close(fd);
+    fd = -1;
+    return NULL;
+  }
+  map_ptr = static_cast<uint8_t*>(ptr);
+  map_len = size;
+  return map_ptr;
+}
+
+void 
+ChkptSink::write(const Kokkos::View<uint8_t*>::HostMirror& diff_h) {
+  if(mapped())
+    return;
+  if(writer_config.backend == WriterStriped) {
+    write_striped(filename, diff_h.data(), diff_h.size(), writer_config, split);
+    return;
+  }
+  // A previous checkpoint split over several files must not shadow the new file
+  if(split)
+    remove_stripes(filename);
+  if(writer_config.backend != WriterStream) {
+    ChkptWriter writer(filename, writer_config);
+    writer.write(diff_h.data(), diff_h.size());
+    writer.close();
+    return;
+  }
+  storage_metadata(filename);
+  std::ofstream file;
+  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+  file.open(filename, std::ofstream::out | std::ofstream::binary);
+  file.write((const char*)(diff_h.data()), diff_h.size());
+  file.flush();
+  file.close();
+  storage_transfer(filename, diff_h.size(), true);
+}
@@ -0,0 +1,613 @@
+#include "chkpt_writer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <ios>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include "storage_emulator.hpp"
+
+writer_config_t default_writer_config() {
+  writer_config_t config = {WriterStream, false, 8, 1024*1024, 8, 4*1024*1024, 1, {}, DurableNone, 8, 1.0};
+  return config;
+}
+
+writer_config_t get_writer_config(int argc, char** argv) {
+  writer_config_t config = default_writer_config();
+  for(int i=0; i<argc; i++) {
+    if((strcmp(argv[i], "--writer") == 0) && (i+1 < argc)) {
+      if(strcmp(argv[i+1], "threads") == 0) {
+        config.backend = WriterThreads;
+      } else if(strcmp(argv[i+1], "uring") == 0) {
+        config.backend = WriterUring;
+      } else if(strcmp(argv[i+1], "striped") == 0) {
+        config.backend = WriterStriped;
+      } else if(strcmp(argv[i+1], "stream") == 0) {
+        config.backend = WriterStream;
+      } else {
+        printf("Unknown writer %s, writing with a stream\n", argv[i+1]);
+      }
+    } else if(strcmp(argv[i], "--direct-io") == 0) {
+      config.direct = true;
+    } else if((strcmp(argv[i], "--io-depth") == 0) && (i+1 < argc)) {
+      config.queue_depth = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+    } else if((strcmp(argv[i], "--io-block") == 0) && (i+1 < argc)) {
+      config.block_size = strtoull(argv[i+1], NULL, 0);
+    } else if((strcmp(argv[i], "--stripe-threads") == 0) && (i+1 < argc)) {
+      config.stripe_threads = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+    } else if((strcmp(argv[i], "--stripe-size") == 0) && (i+1 < argc)) {
+      config.stripe_size = strtoull(argv[i+1], NULL, 0);
+    } else if((strcmp(argv[i], "--stripe-files") == 0) && (i+1 < argc)) {
+      config.stripe_files = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+    } else if((strcmp(argv[i], "--stripe-dir") == 0) && (i+1 < argc)) {
+      config.stripe_dirs.push_back(std::string(argv[i+1]));
+    } else if((strcmp(argv[i], "--durability") == 0) && (i+1 < argc)) {
+      if(strcmp(argv[i+1], "none") == 0) {
+        config.durability = DurableNone;
+      } else if(strcmp(argv[i+1], "chkpt") == 0) {
+        config.durability = DurableChkpt;
+      } else if(strcmp(argv[i+1], "group") == 0) {
+        config.durability = DurableGroup;
+      } else {
+        printf("Unknown durability policy %s, checkpoints are not synced\n", argv[i+1]);
+      }
+    } else if((strcmp(argv[i], "--group-chkpts") == 0) && (i+1 < argc)) {
+      config.group_chkpts = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+    } else if((strcmp(argv[i], "--group-seconds") == 0) && (i+1 < argc)) {
+      config.group_seconds = strtod(argv[i+1], NULL);
+    }
+  }
+  return config;
+}
+
+const char* writer_backend_name(WriterBackend backend) {
+  switch(backend) {
+    case WriterStream:  return "stream";
+    case WriterThreads: return "threads";
+    case WriterUring:   return "io_uring";
+    case WriterStriped: return "striped";
+  }
+  return "unknown";
+}
+
+const char* durability_name(DurabilityPolicy policy) {
+  switch(policy) {
+    case DurableNone:  return "none";
+    case DurableChkpt: return "chkpt";
+    case DurableGroup: return "group";
+  }
+  return "unknown";
+}
+
+bool
+pwrite_all(int fd, const uint8_t* buf, uint64_t len, uint64_t offset) {
+  storage_transfer_fd(fd, len, true);
+  while(len > 0) {
+    ssize_t n = pwrite(fd, buf, len, static_cast<off_t>(offset));
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    if(n == 0) {
+      errno = EIO;
+      return false;
+    }
+    buf += n;
+    len -= static_cast<uint64_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+bool
+pread_all(int fd, uint8_t* buf, uint64_t len, uint64_t offset) {
+  storage_transfer_fd(fd, len, false);
+  while(len > 0) {
+    ssize_t n = pread(fd, buf, len, static_cast<off_t>(offset));
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    if(n == 0) {
+      errno = EIO;
+      return false;
+    }
+    buf += n;
+    len -= static_cast<uint64_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+void
+replace_file(const std::string& filename, const uint8_t* data, uint64_t len, bool sync) {
+  std::string tmp_file = filename + ".tmp";
+  int fd = storage_open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    throw std::ios_base::failure(std::string("Failed to create ") + tmp_file + ": " + strerror(errno));
+  bool written = pwrite_all(fd, data, len, 0) && (!sync || (fsync(fd) == 0));
+  int error = errno;
+  storage_close(fd);
+  if(!written || (storage_rename(tmp_file, filename) != 0)) {
+    if(written)
+      error = errno;
+    std::remove(tmp_file.c_str());
+    throw std::ios_base::failure(std::string("Failed to write ") + filename + ": " + strerror(error));
+  }
+  if(!sync)
+    return;
+  // Sync the directory so the rename itself survives a crash
+  std::string dir(".");
+  size_t slash = filename.rfind('/');
+  if(slash != std::string::npos)
+    dir = (slash == 0) ? std::string("/") : filename.substr(0, slash);
+  int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if(dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+}
+
+/** \class WriteQueue
+ *  \brief Writes buffers of a ChkptWriter asynchronously
+ */
+class WriteQueue {
+  public:
+    virtual ~WriteQueue() {}
+
+    /**
+     * Start writing a pool buffer
+     *
+     * \param slot   Index of the buffer in the pool
+     * \param buf    Buffer
+     * \param len    Number of bytes to write
+     * \param offset Offset in the file
+     */
+    virtual void submit(uint32_t slot, const uint8_t* buf, uint64_t len, uint64_t offset) = 0;
+
+    /**
+     * Wait for a write to finish
+     *
+     * \param err Set to 0 or to the errno value of a failed write
+     *
+     * \return Slot of the finished write
+     */
+    virtual uint32_t reap(int& err) = 0;
+};
+
+/** \class ThreadQueue
+ *  \brief Pool of threads writing buffers with pwrite
+ */
+class ThreadQueue : public WriteQueue {
+  public:
+    ThreadQueue(int file, uint32_t num_threads) : fd(file), stop(false) {
+      for(uint32_t i=0; i<num_threads; i++) {
+        workers.push_back(std::thread(&ThreadQueue::work, this));
+      }
+    }
+
+    ~ThreadQueue() override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      pending_cv.notify_all();
+      for(uint32_t i=0; i<workers.size(); i++) {
+        workers[i].join();
+      }
+    }
+
+    void submit(uint32_t slot, const uint8_t* buf, uint64_t len, uint64_t offset) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back({slot, buf, len, offset});
+      }
+      pending_cv.notify_one();
+    }
+
+    uint32_t reap(int& err) override {
+      std::unique_lock<std::mutex> lock(mutex);
+      done_cv.wait(lock, [this]() { return !done.empty(); });
+      std::pair<uint32_t,int> result = done.front();
+      done.pop_front();
+      err = result.second;
+      return result.first;
+    }
+
+  private:
+    struct Request {
+      uint32_t slot;
+      const uint8_t* buf;
+      uint64_t len;
+      uint64_t offset;
+    };
+
+    void work() {
+      while(true) {
+        Request req;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          pending_cv.wait(lock, [this]() { return stop || !pending.empty(); });
+          if(pending.empty())
+            return;
+          req = pending.front();
+          pending.pop_front();
+        }
+        // errno is per thread, record it here
+        int err = pwrite_all(fd, req.buf, req.len, req.offset) ? 0 : errno;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          done.push_back(std::make_pair(req.slot, err));
+        }
+        done_cv.notify_one();
+      }
+    }
+
+    int fd;
+    bool stop;
+    std::vector<std::thread> workers;
+    std::deque<Request> pending;
+    std::deque<std::pair<uint32_t,int>> done;
+    std::mutex mutex;
+    std::condition_variable pending_cv;
+    std::condition_variable done_cv;
+};
+
+/** \class UringQueue
+ *  \brief io_uring submission and completion rings driven through the raw system calls
+ */
+class UringQueue : public WriteQueue {
+  public:
+    /**
+     * Set up a ring for a file and register the buffer pool with it
+     *
+     * \return Queue, or NULL if io_uring is not available
+     */
+    static UringQueue* create(int file, std::vector<uint8_t*>& buffers, uint64_t block_size) {
+      UringQueue* queue = new UringQueue(file, buffers, block_size);
+      if(queue->ring_fd < 0) {
+        delete queue;
+        return NULL;
+      }
+      return queue;
+    }
+
+    ~UringQueue() override {
+      if(sqes != NULL)
+        munmap(sqes, sqes_size);
+      if((cq_ptr != NULL) && (cq_ptr != sq_ptr))
+        munmap(cq_ptr, cq_size);
+      if(sq_ptr != NULL)
+        munmap(sq_ptr, sq_size);
+      if(ring_fd >= 0)
+        ::close(ring_fd);
+    }
+
+    void submit(uint32_t slot, const uint8_t* buf, uint64_t len, uint64_t offset) override {
+      requests[slot] = {buf, len, offset};
+      unsigned tail = *sq_tail;
+      unsigned idx = tail & *sq_mask;
+      struct io_uring_sqe* sqe = &sqes[idx];
+      memset(sqe, 0, sizeof(struct io_uring_sqe));
+      sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+      sqe->fd = fd;
+      sqe->addr = reinterpret_cast<uint64_t>(buf);
+      sqe->len = static_cast<uint32_t>(len);
+      sqe->off = offset;
+      if(fixed)
+        sqe->buf_index = static_cast<uint16_t>(slot);
+      sqe->user_data = slot;
+      sq_array[idx] = idx;
+      __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+      long ret;
+      do {
+        ret = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, NULL, 0);
+      } while((ret < 0) && (errno == EINTR));
+      if(ret < 0) {
+        int err = errno;
+        // An entry the kernel did not consume stays queued and would be submitted by
+        // the next call, after its slot was reused. Take it back before failing the slot.
+        if(__atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == tail) {
+          __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+          failed.push_back(std::make_pair(slot, err));
+        }
+      }
+    }
+
+    uint32_t reap(int& err) override {
+      if(!failed.empty()) {
+        std::pair<uint32_t,int> result = failed.front();
+        failed.pop_front();
+        err = result.second;
+        return result.first;
+      }
+      while(true) {
+        unsigned head = *cq_head;
+        if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+          syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+          continue;
+        }
+        struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+        uint32_t slot = static_cast<uint32_t>(cqe->user_data);
+        int res = cqe->res;
+        __atomic_store_n(cq_head, head+1, __ATOMIC_RELEASE);
+        err = 0;
+        const Request& req = requests[slot];
+        if(res < 0) {
+          err = -res;
+        } else if(static_cast<uint64_t>(res) < req.len) {
+          if(!finish_write(req, static_cast<uint64_t>(res)))
+            err = errno;
+        }
+        return slot;
+      }
+    }
+
+  private:
+    struct Request {
+      const uint8_t* buf;
+      uint64_t len;
+      uint64_t offset;
+    };
+
+    /**
+     * Finish a short write synchronously. Writes restart from the last aligned offset
+     * written, so they stay valid on an O_DIRECT file; rewriting a few bytes is harmless.
+     *
+     * \param req  Write request
+     * \param done Bytes already written
+     *
+     * \return Whether the rest of the request was written, errno is set otherwise
+     */
+    bool finish_write(const Request& req, uint64_t done) {
+      storage_transfer_fd(fd, req.len-done, true);
+      done = done/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+      while(done < req.len) {
+        ssize_t n = pwrite(fd, req.buf+done, req.len-done, static_cast<off_t>(req.offset+done));
+        if(n < 0) {
+          if(errno == EINTR)
+            continue;
+          return false;
+        }
+        uint64_t next = (done+static_cast<uint64_t>(n) >= req.len) ? req.len :
+                        (done+static_cast<uint64_t>(n))/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+        if(next == done) {
+          errno = EIO;
+          return false;
+        }
+        done = next;
+      }
+      return true;
+    }
+
+    /**
+     * Check that the kernel supports an opcode. IORING_OP_WRITE needs Linux 5.6, older
+     * kernels reject IORING_REGISTER_PROBE and the ring is not used at all.
+     */
+    static bool supported(const std::vector<uint8_t>& probe_buf, uint8_t opcode) {
+      const struct io_uring_probe* probe = reinterpret_cast<const struct io_uring_probe*>(probe_buf.data());
+      return (opcode < probe->ops_len) && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    UringQueue(int file, std::vector<uint8_t*>& buffers, uint64_t block_size)
+      : fd(file), ring_fd(-1), fixed(false), sq_ptr(NULL), cq_ptr(NULL), sqes(NULL) {
+      requests.resize(buffers.size());
+      struct io_uring_params params;
+      memset(&params, 0, sizeof(params));
+      int ring = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(buffers.size()), &params));
+      if(ring < 0)
+        return;
+      sq_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+      cq_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+      bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+      if(single_mmap)
+        sq_size = cq_size = std::max(sq_size, cq_size);
+      sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+      void* sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+      void* cq = single_mmap ? sq :
+                 mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+      void* entries = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+      sq_ptr = (sq == MAP_FAILED) ? NULL : static_cast<uint8_t*>(sq);
+      cq_ptr = (cq == MAP_FAILED) ? NULL : static_cast<uint8_t*>(cq);
+      sqes = (entries == MAP_FAILED) ? NULL : static_cast<struct io_uring_sqe*>(entries);
+      if((sq_ptr == NULL) || (cq_ptr == NULL) || (sqes == NULL)) {
+        ::close(ring);
+        return;
+      }
+      // Probe the opcodes before using the ring, the writer falls back to threads without them
+      const unsigned num_ops = 256;
+      std::vector<uint8_t> probe_buf(sizeof(struct io_uring_probe)+num_ops*sizeof(struct io_uring_probe_op), 0);
+      if((syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe_buf.data(), num_ops) != 0) ||
+         !supported(probe_buf, IORING_OP_WRITE)) {
+        ::close(ring);
+        return;
+      }
+      ring_fd = ring;
+      sq_head = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.head);
+      sq_tail = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+      sq_mask = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+      sq_array = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+      cq_head = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+      cq_tail = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+      cq_mask = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+      cqes = reinterpret_cast<struct io_uring_cqe*>(cq_ptr + params.cq_off.cqes);
+
+      // Registered buffers are pinned once instead of on every write
+      std::vector<struct iovec> iovs(buffers.size());
+      for(uint32_t i=0; i<buffers.size(); i++) {
+        iovs[i].iov_base = buffers[i];
+        iovs[i].iov_len = block_size;
+      }
+      fixed = supported(probe_buf, IORING_OP_WRITE_FIXED) &&
+              (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS,
+                       iovs.data(), static_cast<unsigned>(iovs.size())) == 0);
+    }
+
+    int fd;
+    int ring_fd;
+    bool fixed;
+    uint8_t* sq_ptr;
+    uint8_t* cq_ptr;
+    struct io_uring_sqe* sqes;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    std::vector<Request> requests;
+    std::deque<std::pair<uint32_t,int>> failed;
+};
+
+ChkptWriter::ChkptWriter(const std::string& file, const writer_config_t& config) {
+  filename = file;
+  active_backend = config.backend;
+  // Data written piece by piece cannot be striped up front, the pool writes it in parallel
+  if(active_backend == WriterStriped)
+    active_backend = WriterThreads;
+  direct_io = config.direct;
+  block_size = std::max(config.block_size, static_cast<uint64_t>(WRITER_ALIGNMENT));
+  block_size = (block_size+WRITER_ALIGNMENT-1)/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+  uint32_t depth = std::max(config.queue_depth, static_cast<uint32_t>(1));
+  if(active_backend == WriterStream)
+    depth = 2;
+  in_flight = 0;
+  cur_slot = UINT32_MAX;
+  cur_fill = 0;
+  file_offset = 0;
+  error = 0;
+
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+  fd = -1;
+  if(direct_io) {
+    fd = storage_open(filename, flags | O_DIRECT, 0644);
+    if((fd < 0) && (errno == EINVAL))
+      direct_io = false;
+  }
+  if(fd < 0)
+    fd = storage_open(filename, flags, 0644);
+  if(fd < 0)
+    throw std::ios_base::failure(std::string("Failed to open ") + filename + ": " + strerror(errno));
+
+  for(uint32_t i=0; i<depth; i++) {
+    void* buf = NULL;
+    if(posix_memalign(&buf, WRITER_ALIGNMENT, block_size) != 0)
+      break;
+    buffers.push_back(static_cast<uint8_t*>(buf));
+    free_slots.push_back(i);
+  }
+  if(buffers.empty()) {
+    storage_close(fd);
+    throw std::ios_base::failure(std::string("Failed to allocate write buffers for ") + filename);
+  }
+  // The emulated storage is only reached through pwrite_all, which the ring bypasses
+  if((active_backend == WriterUring) && storage_fd_emulated(fd))
+    active_backend = WriterThreads;
+  if(active_backend == WriterUring) {
+    queue.reset(UringQueue::create(fd, buffers, block_size));
+    if(!queue)
+      active_backend = WriterThreads;
+  }
+  if(!queue)
+    queue.reset(new ThreadQueue(fd, (active_backend == WriterStream) ? 1 : buffers.size()));
+}
+
+ChkptWriter::~ChkptWriter() {
+  while(in_flight > 0) {
+    reap_one();
+  }
+  queue.reset();
+  for(uint32_t i=0; i<buffers.size(); i++) {
+    free(buffers[i]);
+  }
+  if(fd >= 0)
+    storage_close(fd);
+}
+
+void
+ChkptWriter::write(const uint8_t* data, uint64_t len) {
+  while(len > 0) {
+    if(cur_slot == UINT32_MAX) {
+      while(free_slots.empty()) {
+        reap_one();
+      }
+      cur_slot = free_slots.back();
+      free_slots.pop_back();
+      cur_fill = 0;
+    }
+    uint64_t n = std::min(len, block_size-cur_fill);
+    memcpy(buffers[cur_slot]+cur_fill, data, n);
+    cur_fill += n;
+    data += n;
+    len -= n;
+    if(cur_fill == block_size)
+      submit_current();
+  }
+}
+
+void
+ChkptWriter::submit_current() {
+  if(cur_slot == UINT32_MAX)
+    return;
+  if(cur_fill == 0) {
+    free_slots.push_back(cur_slot);
+    cur_slot = UINT32_MAX;
+    return;
+  }
+  uint64_t len = cur_fill;
+  if(direct_io) {
+    // Only the last buffer is partial, pad it to the alignment
+    len = (cur_fill+WRITER_ALIGNMENT-1)/WRITER_ALIGNMENT*WRITER_ALIGNMENT;
+    memset(buffers[cur_slot]+cur_fill, 0, len-cur_fill);
+  }
+  queue->submit(cur_slot, buffers[cur_slot], len, file_offset);
+  in_flight += 1;
+  file_offset += cur_fill;
+  cur_slot = UINT32_MAX;
+  cur_fill = 0;
+}
+
+void
+ChkptWriter::reap_one() {
+  int err = 0;
+  uint32_t slot = queue->reap(err);
+  in_flight -= 1;
+  if((err != 0) && (error == 0))
+    error = err;
+  free_slots.push_back(slot);
+}
+
+uint64_t
+ChkptWriter::close() {
+  submit_current();
+  while(in_flight > 0) {
+    reap_one();
+  }
+  // Drop the padding of the last O_DIRECT write
+  if(direct_io && (error == 0) && (ftruncate(fd, static_cast<off_t>(file_offset)) != 0))
+    error = errno;
+  if((storage_close(fd) != 0) && (error == 0))
+    error = errno;
+  fd = -1;
+  if(error != 0)
+    throw std::ios_base::failure(std::string("Failed to write ") + filename + ": " + strerror(error));
+  return file_offset;
+}
@@ -0,0 +1,179 @@
+#include <Kokkos_Core.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "stdio.h"
+#include "deduplicator.hpp"
+
+// Consolidate a chain of incremental checkpoints into a new baseline without restarting
+// the data. The selected checkpoint is rewritten as a self-contained baseline and every
+// later checkpoint is rewritten to only reference the new baseline or its successors.
+// The new checkpoints are written next to the chain and renamed over it once all of
+// them are written. Each rename is atomic, but the chain is only replaced as a whole
+// through a marker file, BASELINE_FILE.consolidating, listing the checkpoints being
+// replaced. It is written before the first rename and removed after the last. A run
+// interrupted while replacing the chain is finished by the next run with the same
+// files, and restart_chkpt_files refuses to restart a chain with a marker.
+// Checkpoints before the new baseline are no longer needed to restart later checkpoints.
+// Input filenames should be the same as those supplied to dedup_chkpt_files.
+// Usage:
+//   ./consolidate_chkpt_files baseline_id num_chkpts [approach] [chkpt files]
+// Possible approaches
+//   --run-basic-chkpt  :   Basic approach
+//   --run-list-chkpt   :   List approach
+//   --run-tree-chkpt   :   Tree approach (applies to any variation)
+// Optional flags
+//   --writer threads|uring :  Write the new files with a pool of threads or with io_uring
+//   --direct-io            :  Bypass the page cache when writing the new files
+//   --io-depth N           :  Number of writes in flight (default 8)
+//   --io-block B           :  Size of each write in bytes (default 1MB)
+//   --durability none|chkpt|group : Sync the new files before they replace the chain
+//   --manifest FILE        :  Record the rewritten checkpoints in the chain manifest FILE
+//   --emulate-dir DIR      :  Emulate slower storage for the files in DIR, with the
+//                             --emulate-* flags of dedup_chkpt_files
+/**
+ * Finish replacing a chain whose consolidation was interrupted. Every new checkpoint was
+ * written before the marker, so the ones not renamed yet are renamed and the marker is
+ * removed.
+ *
+ * \param marker Marker file listing the checkpoints being replaced
+ *
+ * \return Whether the chain was replaced
+ */
+static bool
+finish_consolidation(const std::string& marker) {
+  std::ifstream in(marker);
+  std::string chkpt_file;
+  bool replaced = in.is_open();
+  while(std::getline(in, chkpt_file)) {
+    std::string tmp_file = chkpt_file + ".consolidate";
+    std::ifstream tmp(tmp_file);
+    if(tmp.is_open() && (storage_rename(tmp_file, chkpt_file) != 0)) {
+      printf("ERROR: Failed to replace %s\n", chkpt_file.c_str());
+      replaced = false;
+    }
+  }
+  if(replaced)
+    std::remove(marker.c_str());
+  return replaced;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t baseline_id = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    DedupMode mode = get_mode(argc, argv);
+    if(mode == Unknown) {
+      printf("ERROR: Incorrect mode\n");
+      print_mode_help();
+    }
+    uint32_t arg_offset = 1;
+    std::string extension = ".hashtree.incr_chkpt";
+    if(mode == Basic) {
+      extension = ".basic.incr_chkpt";
+    } else if(mode == List) {
+      extension = ".hashlist.incr_chkpt";
+    }
+    storage_model_t storage_model = get_storage_model(argc, argv);
+    set_storage_model(storage_model);
+    std::vector<std::string> chkpt_files;
+    std::vector<std::string> tmp_files;
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      chkpt_files.push_back(std::string(argv[3+arg_offset+i])+extension);
+      tmp_files.push_back(chkpt_files[i]+".consolidate");
+    }
+
+    // Finish an earlier consolidation of the chain before consolidating it again
+    for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+      std::string marker = chkpt_files[i] + CONSOLIDATE_MARKER_EXT;
+      std::ifstream exists(marker);
+      if(!exists.is_open())
+        continue;
+      exists.close();
+      if(finish_consolidation(marker)) {
+        printf("Finished the interrupted consolidation of %s\n", chkpt_files[i].c_str());
+      } else {
+        res = -1;
+      }
+    }
+
+    if(res != 0) {
+      printf("ERROR: Failed to finish an interrupted consolidation\n");
+    } else if(mode == Full || mode == Unknown) {
+      printf("ERROR: Full checkpoints are already self-contained\n");
+      res = -1;
+    } else if(baseline_id >= num_chkpts) {
+      printf("ERROR: Baseline %u is not in the chain of %u checkpoints\n", baseline_id, num_chkpts);
+      res = -1;
+    } else {
+      std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+      uint64_t num_bytes = 0, bytes_read = 0;
+      writer_config_t writer_config = get_writer_config(argc, argv);
+      {
+        ChkptChain chain(chkpt_files, mode != Basic && mode != List);
+        chain.set_writer_config(writer_config);
+        num_bytes = chain.consolidate(baseline_id, tmp_files);
+        bytes_read = chain.bytes_read();
+      }
+      // Replace the chain once all checkpoints are written and, with a durability
+      // policy, synced, then sync the replaced names
+      GroupCommit commits(writer_config);
+      try {
+        for(uint32_t i=baseline_id; i<num_chkpts; i++) {
+          commits.written(tmp_files[i]);
+        }
+        commits.commit();
+        std::string marker = chkpt_files[baseline_id] + CONSOLIDATE_MARKER_EXT;
+        std::string replaced;
+        for(uint32_t i=baseline_id; i<num_chkpts; i++) {
+          replaced += chkpt_files[i] + "\n";
+        }
+        replace_file(marker, (const uint8_t*)(replaced.data()), replaced.size(),
+                     writer_config.durability != DurableNone);
+        for(uint32_t i=baseline_id; i<num_chkpts; i++) {
+          if(storage_rename(tmp_files[i], chkpt_files[i]) != 0) {
+            printf("ERROR: Failed to replace %s\n", chkpt_files[i].c_str());
+            res = -1;
+          }
+          commits.written(chkpt_files[i]);
+        }
+        commits.commit();
+        // A marker left by a failed rename makes the next run retry the renames
+        if(res == 0)
+          std::remove(marker.c_str());
+      } catch(const std::ios_base::failure& e) {
+        printf("ERROR: %s\n", e.what());
+        res = -1;
+      }
+      // Rewritten checkpoints have a new reference, size, and digest
+      for(int i=0; i<argc && res == 0; i++) {
+        if((strcmp(argv[i], "--manifest") == 0) && (i+1 < argc)) {
+          ChainManifest manifest(argv[i+1], writer_config.durability);
+          for(uint32_t j=baseline_id; j<num_chkpts; j++) {
+            manifest.record_file(j, chkpt_files[j], true);
+          }
+          manifest.save();
+        }
+      }
+      std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+      double elapsed = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count());
+      printf("Consolidated checkpoints %u-%u: read %lu bytes, wrote %lu bytes in %f seconds\n",
+             baseline_id, num_chkpts-1, bytes_read, num_bytes, elapsed);
+    }
+    if(!storage_model.dir.empty()) {
+      storage_stats_t storage_stats = get_storage_stats();
+      printf("Emulated storage: %lu bytes written, %lu bytes read, %lu transfers, %lu metadata operations, %f seconds of delay\n",
+             storage_stats.bytes_written, storage_stats.bytes_read, storage_stats.num_transfers,
+             storage_stats.num_metadata_ops, storage_stats.delay);
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
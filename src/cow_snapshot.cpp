@@ -0,0 +1,258 @@
+#include "cow_snapshot.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Snapshots with write protected pages
+static std::atomic<CowSnapshot*> active_snapshots[MAX_COW_SNAPSHOTS];
+// Fault handlers currently looking at the table of snapshots
+static std::atomic<uint32_t> faults_in_flight(0);
+static std::mutex handler_mutex;
+static bool handler_installed = false;
+static uint32_t handler_users = 0;
+static struct sigaction prev_action;
+
+/**
+ * SIGSEGV handler. Write faults on protected snapshot pages are resolved by copying the
+ * page. Any other fault goes to the handler that was installed before.
+ */
+static void
+cow_fault_handler(int sig, siginfo_t* info, void* context) {
+  uintptr_t addr = reinterpret_cast<uintptr_t>(info->si_addr);
+  faults_in_flight.fetch_add(1);
+  bool handled = false;
+  for(uint32_t i=0; i<MAX_COW_SNAPSHOTS && !handled; i++) {
+    CowSnapshot* snapshot = active_snapshots[i].load();
+    if(snapshot != NULL)
+      handled = snapshot->handle_fault(addr);
+  }
+  faults_in_flight.fetch_sub(1);
+  if(handled)
+    return;
+  if(prev_action.sa_flags & SA_SIGINFO) {
+    prev_action.sa_sigaction(sig, info, context);
+  } else if((prev_action.sa_handler == SIG_DFL) || (prev_action.sa_handler == SIG_IGN)) {
+    // Faulting again with the default action terminates the process as usual
+    signal(sig, SIG_DFL);
+  } else {
+    prev_action.sa_handler(sig);
+  }
+}
+
+/**
+ * Install the fault handler for a snapshot, if no other snapshot has installed it
+ */
+static bool
+acquire_handler() {
+  std::lock_guard<std::mutex> lock(handler_mutex);
+  if(!handler_installed) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = cow_fault_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    handler_installed = (sigaction(SIGSEGV, &action, &prev_action) == 0);
+  }
+  if(handler_installed)
+    handler_users += 1;
+  return handler_installed;
+}
+
+/**
+ * Restore the previous handler once no snapshot uses the fault handler. A handler
+ * installed over it since is left in place, along with the fault handler it may call.
+ */
+static void
+release_handler() {
+  std::lock_guard<std::mutex> lock(handler_mutex);
+  handler_users -= 1;
+  if(handler_users > 0)
+    return;
+  struct sigaction current;
+  if((sigaction(SIGSEGV, NULL, &current) == 0) && (current.sa_flags & SA_SIGINFO) &&
+     (current.sa_sigaction == cow_fault_handler)) {
+    if(sigaction(SIGSEGV, &prev_action, NULL) == 0)
+      handler_installed = false;
+  }
+}
+
+CowSnapshot::CowSnapshot(uint8_t* ptr, uint64_t len) : num_copied(0) {
+  data_ptr = ptr;
+  data_len = len;
+  page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = reinterpret_cast<uintptr_t>(ptr)/page_size*page_size;
+  uintptr_t end = (reinterpret_cast<uintptr_t>(ptr)+len+page_size-1)/page_size*page_size;
+  pages_begin = reinterpret_cast<uint8_t*>(begin);
+  num_pages = (len > 0) ? (end-begin)/page_size : 0;
+  slot = MAX_COW_SNAPSHOTS;
+  shadow = NULL;
+  states.reset(new std::atomic<uint8_t>[num_pages]);
+  for(uint64_t i=0; i<num_pages; i++) {
+    states[i].store(PROTECTED);
+  }
+  if(num_pages == 0)
+    return;
+
+  // Reserve the shadow pages without committing memory
+  void* map = mmap(NULL, num_pages*page_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if(map == MAP_FAILED) {
+    printf("ERROR: Failed to reserve %lu bytes for the snapshot\n", num_pages*page_size);
+    for(uint64_t i=0; i<num_pages; i++) {
+      states[i].store(RELEASED);
+    }
+    return;
+  }
+  shadow = static_cast<uint8_t*>(map);
+
+  bool registered = false;
+  bool handler = acquire_handler();
+  if(handler) {
+    for(uint32_t i=0; i<MAX_COW_SNAPSHOTS && !registered; i++) {
+      CowSnapshot* expected = NULL;
+      if(active_snapshots[i].compare_exchange_strong(expected, this)) {
+        slot = i;
+        registered = true;
+      }
+    }
+  }
+  if(registered && (mprotect(pages_begin, num_pages*page_size, PROT_READ) == 0))
+    return;
+
+  // Without write protection the snapshot is copied right away
+  printf("Failed to write protect the snapshot, copying %lu bytes\n", len);
+  if(registered) {
+    active_snapshots[slot].store(NULL);
+    slot = MAX_COW_SNAPSHOTS;
+  }
+  if(handler)
+    release_handler();
+  memcpy(shadow, pages_begin, num_pages*page_size);
+  for(uint64_t i=0; i<num_pages; i++) {
+    states[i].store(COPIED);
+  }
+  num_copied.store(num_pages);
+}
+
+CowSnapshot::~CowSnapshot() {
+  if(slot < MAX_COW_SNAPSHOTS) {
+    // Pages that were not read are still protected
+    uint64_t first = 0;
+    while(first < num_pages) {
+      uint8_t state = PROTECTED;
+      if(!states[first].compare_exchange_strong(state, RELEASED)) {
+        first += 1;
+        continue;
+      }
+      uint64_t last = first+1;
+      state = PROTECTED;
+      while(last < num_pages && states[last].compare_exchange_strong(state, RELEASED)) {
+        last += 1;
+      }
+      unprotect(first, last-first);
+      first = last;
+    }
+    active_snapshots[slot].store(NULL);
+    // Wait for handlers that may still look at this snapshot
+    while(faults_in_flight.load() > 0) {
+      std::this_thread::yield();
+    }
+    release_handler();
+  }
+  if(shadow != NULL)
+    munmap(shadow, num_pages*page_size);
+}
+
+void
+CowSnapshot::unprotect(uint64_t first_page, uint64_t pages) {
+  if(pages > 0)
+    mprotect(pages_begin+first_page*page_size, pages*page_size, PROT_READ | PROT_WRITE);
+}
+
+bool
+CowSnapshot::handle_fault(uintptr_t addr) {
+  uintptr_t begin = reinterpret_cast<uintptr_t>(pages_begin);
+  if((addr < begin) || (addr >= begin+num_pages*page_size))
+    return false;
+  uint64_t page = (addr-begin)/page_size;
+  while(true) {
+    uint8_t state = states[page].load();
+    if(state == PROTECTED) {
+      // A read of the page going on at the same time reads the copy afterwards
+      if(states[page].compare_exchange_strong(state, COPYING)) {
+        memcpy(shadow+page*page_size, pages_begin+page*page_size, page_size);
+        unprotect(page, 1);
+        num_copied.fetch_add(1);
+        states[page].store(COPIED);
+        return true;
+      }
+    } else if(state == RELEASED) {
+      // The page has been read and its protection is being lifted
+      unprotect(page, 1);
+      return true;
+    } else if(state == COPIED) {
+      return true;
+    }
+    // Another fault is copying the page, which takes one page copy
+  }
+}
+
+void
+CowSnapshot::read(uint64_t offset, uint64_t len, uint8_t* dst) {
+  if(len == 0)
+    return;
+  uint64_t end = std::min(offset+len, data_len);
+  uint64_t start_addr = reinterpret_cast<uint64_t>(data_ptr)-reinterpret_cast<uint64_t>(pages_begin);
+  uint64_t first_page = (start_addr+offset)/page_size;
+  uint64_t last_page = (start_addr+end-1)/page_size;
+  for(uint64_t page=first_page; page<=last_page; page++) {
+    // Bytes of the page in the part being read
+    uint64_t page_start = page*page_size-start_addr;
+    if(page*page_size < start_addr)
+      page_start = 0;
+    uint64_t page_end = std::min((page+1)*page_size-start_addr, data_len);
+    uint64_t copy_start = std::max(page_start, offset);
+    uint64_t copy_end = std::min(page_end, end);
+    uint64_t src_offset = start_addr+copy_start;
+    while(true) {
+      uint8_t state = states[page].load();
+      if(state == COPIED) {
+        memcpy(dst+copy_start-offset, shadow+src_offset, copy_end-copy_start);
+        break;
+      } else if(state == COPYING) {
+        std::this_thread::yield();
+        continue;
+      }
+      memcpy(dst+copy_start-offset, pages_begin+src_offset, copy_end-copy_start);
+      // Unless a fault started copying the page during the read, the page was not
+      // written. RELEASED pages were never protected since the snapshot failed.
+      if((state == RELEASED) || (states[page].load() == PROTECTED))
+        break;
+    }
+  }
+  // Lift the protection of pages that have been read completely, in runs
+  uint64_t page = first_page;
+  while(page <= last_page) {
+    uint64_t page_end = std::min((page+1)*page_size-start_addr, data_len);
+    uint8_t state = PROTECTED;
+    if((page_end > end) || !states[page].compare_exchange_strong(state, RELEASED)) {
+      page += 1;
+      continue;
+    }
+    uint64_t run_end = page+1;
+    while(run_end <= last_page) {
+      page_end = std::min((run_end+1)*page_size-start_addr, data_len);
+      state = PROTECTED;
+      if((page_end > end) || !states[run_end].compare_exchange_strong(state, RELEASED))
+        break;
+      run_end += 1;
+    }
+    unprotect(page, run_end-page);
+    page = run_end;
+  }
+}
@@ -3,6 +3,10 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <thread>
+#include <memory>
+#include <cstdio>
+#include <cstring>
 #include "stdio.h"
 #include "deduplicator.hpp"
 
@@ -20,6 +24,100 @@
 //   --run-tree-chkpt   :   Our deduplication approach. Takes into account time and space
 //                          dimension for deduplication. Compacts metadata using forests of 
 //                          Merkle trees
+// Optional flags
+//   --reverse-chain    :   Store the newest checkpoint complete and rewrite the previous one
+//                          as a reverse delta against it in the background
+//                          (Basic, List, and Tree approaches)
+//   --max-chain-len K        :  Make a new baseline once the chain has K checkpoints
+//   --max-restart-bytes B    :  Make a new baseline once restarting the next checkpoint
+//                               is estimated to read more than B bytes
+//   --max-index-entries N    :  Make a new baseline once the first occurrence index
+//                               has more than N entries (List and Tree approaches)
+//   --index-max-age A        :  Evict first occurrences of checkpoints more than A
+//                               checkpoints old from the index (List and Tree approaches)
+//   --drop-unmatched-interior:  Drop interior node entries of the Tree approach that
+//                               were never matched by a later checkpoint
+//   --digest-filter B        :  Check index lookups of the Tree approaches against a
+//                               Bloom filter with B bits per entry first
+//   --load-state FILE        :  Continue the chain of a previous run from its saved
+//                               deduplicator state instead of starting with a baseline
+//   --save-state FILE        :  Save the deduplicator state after the last checkpoint
+//   --reference FILE         :  Seed the index from a reference dataset before the first
+//                               checkpoint. Repeat for several files. The reference
+//                               checkpoint is written next to the first input with the
+//                               extension .reference and restarts need it as the first file
+//   --stream-window B        :  Read each file in windows of B bytes so that only one
+//                               window is on the device at a time (List approach)
+//   --writer threads|uring   :  Write checkpoint files with a pool of threads or with
+//                               io_uring instead of a single stream
+//   --direct-io              :  Bypass the page cache when writing checkpoint files
+//   --io-depth N             :  Number of writes in flight (default 8)
+//   --io-block B             :  Size of each write in bytes (default 1MB)
+//   --pack FILE              :  Append the checkpoints to the pack file FILE instead of
+//                               writing one file per checkpoint. An existing pack is
+//                               appended to. Not available with --reverse-chain or
+//                               --stream-window
+//   --writer striped         :  Write each checkpoint in stripes with several threads
+//   --stripe-threads N       :  Threads writing stripes (default 8)
+//   --stripe-size B          :  Size of each stripe in bytes (default 4MB)
+//   --stripe-files N         :  Spread the stripes of Full checkpoints over N files
+//   --stripe-dir DIR         :  Put stripe files of Full checkpoints in DIR as well as next
+//                               to the checkpoint. Repeat for several directories
+//   --manifest FILE          :  Record every checkpoint in the chain manifest FILE so that
+//                               restarts can plan from it. An existing manifest is
+//                               extended, rewritten checkpoints are recorded again
+//   --ring K                 :  Keep the last K checkpoints in Host memory and write the
+//                               files in the background. Not available with --pack,
+//                               --reverse-chain, or --stream-window
+//   --ring-dir DIR           :  Keep the ring as files in DIR (e.g. /dev/shm) instead
+//   --flush-dir DIR          :  Write the checkpoint files of the ring to DIR instead of
+//                               next to the inputs
+//   --flush-bandwidth B      :  Write the checkpoint files of the ring at no more than B
+//                               bytes per second
+//   --durability none|chkpt|group: Sync no checkpoints (default), every checkpoint before
+//                               the next one, or checkpoints in groups
+//   --group-chkpts N         :  Sync a group once N checkpoints are pending (default 8)
+//   --group-seconds T        :  Sync a group once T seconds passed since the last one
+//                               (default 1)
+//   --emulate-dir DIR        :  Emulate slower storage for the files in DIR
+//   --emulate-write-bw B     :  Write bandwidth of the emulated storage in bytes per second
+//   --emulate-read-bw B      :  Read bandwidth of the emulated storage in bytes per second
+//   --emulate-latency US     :  Microseconds added to every read and write of the
+//                               emulated storage
+//   --emulate-metadata US    :  Microseconds of every open, create, and rename of the
+//                               emulated storage
+//   --emulate-concurrency N  :  Reads and writes the emulated storage serves at once
+
+// Rewrite a checkpoint as a reverse delta against the next checkpoint and replace the file
+void write_reverse_delta(std::vector<std::string> chkpt_files, uint32_t idx, bool tree_layout,
+                         writer_config_t writer_config) {
+  std::string tmp_file = chkpt_files[idx] + ".reverse";
+  {
+    ChkptChain chain(chkpt_files, tree_layout);
+    chain.set_writer_config(writer_config);
+    chain.reverse_delta(idx, tmp_file);
+  }
+  if(storage_rename(tmp_file, chkpt_files[idx]) != 0)
+    printf("ERROR: Failed to replace %s\n", chkpt_files[idx].c_str());
+}
+
+// Read a whole file into a device View
+void read_input(const std::string& path, Kokkos::View<uint8_t*>& current) {
+  storage_metadata(path);
+  std::ifstream f;
+  f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  f.open(path, std::ifstream::in | std::ifstream::binary);
+  f.seekg(0, f.end);
+  size_t data_len = f.tellg();
+  f.seekg(0, f.beg);
+  current = Kokkos::View<uint8_t*>("Current region", data_len);
+  Kokkos::View<uint8_t*>::HostMirror current_h("Current region mirror", data_len);
+  f.read((char*)(current_h.data()), data_len);
+  storage_transfer(path, data_len, false);
+  Kokkos::deep_copy(current, current_h);
+  f.close();
+}
+
 int main(int argc, char** argv) {
   Kokkos::initialize(argc, argv);
   {
@@ -36,6 +134,71 @@ int main(int argc, char** argv) {
       print_mode_help();
     }
     uint32_t arg_offset = 1;
+    bool reverse_chain = false;
+    baseline_policy_t policy = {0, 0, 0};
+    index_policy_t index_policy = {0, false};
+    uint32_t filter_bits = 0;
+    std::string load_state_file, save_state_file;
+    std::vector<std::string> reference_files;
+    uint64_t stream_window = 0;
+    std::string pack_file;
+    std::string manifest_file;
+    for(int i=0; i<argc; i++) {
+      if(strcmp(argv[i], "--reverse-chain") == 0) {
+        reverse_chain = (mode != Full);
+      } else if((strcmp(argv[i], "--max-chain-len") == 0) && (i+1 < argc)) {
+        policy.max_chain_len = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+      } else if((strcmp(argv[i], "--max-restart-bytes") == 0) && (i+1 < argc)) {
+        policy.max_restart_bytes = strtoull(argv[i+1], NULL, 0);
+      } else if((strcmp(argv[i], "--max-index-entries") == 0) && (i+1 < argc)) {
+        policy.max_index_entries = strtoull(argv[i+1], NULL, 0);
+      } else if((strcmp(argv[i], "--index-max-age") == 0) && (i+1 < argc)) {
+        index_policy.max_age = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+      } else if(strcmp(argv[i], "--drop-unmatched-interior") == 0) {
+        index_policy.drop_unmatched = true;
+      } else if((strcmp(argv[i], "--digest-filter") == 0) && (i+1 < argc)) {
+        filter_bits = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+      } else if((strcmp(argv[i], "--load-state") == 0) && (i+1 < argc)) {
+        load_state_file = std::string(argv[i+1]);
+      } else if((strcmp(argv[i], "--save-state") == 0) && (i+1 < argc)) {
+        save_state_file = std::string(argv[i+1]);
+      } else if((strcmp(argv[i], "--reference") == 0) && (i+1 < argc)) {
+        reference_files.push_back(std::string(argv[i+1]));
+      } else if((strcmp(argv[i], "--stream-window") == 0) && (i+1 < argc)) {
+        stream_window = strtoull(argv[i+1], NULL, 0);
+      } else if((strcmp(argv[i], "--pack") == 0) && (i+1 < argc)) {
+        pack_file = std::string(argv[i+1]);
+      } else if((strcmp(argv[i], "--manifest") == 0) && (i+1 < argc)) {
+        manifest_file = std::string(argv[i+1]);
+      }
+    }
+    // Packs are append-only, checkpoints cannot be rewritten or written in windows
+    if((pack_file.size() > 0) && (reverse_chain || (stream_window > 0))) {
+      printf("ERROR: --pack cannot be combined with --reverse-chain or --stream-window\n");
+      Kokkos::finalize();
+      return -1;
+    }
+    // Checkpoints in the ring are whole Host checkpoints written to their files later
+    tier_config_t tier_config = get_tier_config(argc, argv);
+    if((tier_config.capacity > 0) && ((pack_file.size() > 0) || reverse_chain || (stream_window > 0))) {
+      printf("ERROR: --ring cannot be combined with --pack, --reverse-chain, or --stream-window\n");
+      Kokkos::finalize();
+      return -1;
+    }
+    storage_model_t storage_model = get_storage_model(argc, argv);
+    set_storage_model(storage_model);
+    // Streamed checkpoints keep the digests on the Host and cannot share the chain with
+    // a saved state or a reference checkpoint
+    if(stream_window > 0) {
+      if(mode != List) {
+        printf("Streaming is only available for the List approach, reading whole files\n");
+        stream_window = 0;
+      } else if((load_state_file.size() > 0) || (save_state_file.size() > 0) || (reference_files.size() > 0)) {
+        printf("ERROR: --stream-window cannot be combined with --load-state, --save-state, or --reference\n");
+        Kokkos::finalize();
+        return -1;
+      }
+    }
     // Read checkpoint files and store full paths and file names 
     std::vector<std::string> chkpt_files;
     std::vector<std::string> full_chkpt_files;
@@ -61,47 +224,207 @@ int main(int argc, char** argv) {
     } else {
       deduplicator = reinterpret_cast<BaseDeduplicator*>(new TreeDeduplicator(chunk_size));
     }
+    deduplicator->set_baseline_policy(policy);
+    deduplicator->set_index_policy(index_policy);
+    deduplicator->set_digest_filter(filter_bits);
+    writer_config_t writer_config = get_writer_config(argc, argv);
+    deduplicator->set_writer_config(writer_config);
+    std::unique_ptr<ChkptPack> pack;
+    if(pack_file.size() > 0)
+      pack.reset(new ChkptPack(pack_file, true));
+    std::unique_ptr<ChainManifest> manifest;
+    if(manifest_file.size() > 0)
+      manifest.reset(new ChainManifest(manifest_file, writer_config.durability));
+    deduplicator->set_manifest(manifest.get());
+    GroupCommit commits(writer_config);
+    commits.set_manifest(manifest.get());
+    deduplicator->set_group_commit(&commits);
+    std::unique_ptr<TieredStore> store;
+    if(tier_config.capacity > 0) {
+      store.reset(new TieredStore(tier_config));
+      store->set_manifest(manifest.get());
+      store->set_group_commit(&commits);
+    }
+    // Continue the chain of a previous run without making a new baseline
+    bool warm_start = false;
+    if(load_state_file.size() > 0) {
+      warm_start = deduplicator->load_state(load_state_file);
+      if(warm_start) {
+        printf("Loaded deduplicator state from %s, next checkpoint %u\n", 
+               load_state_file.c_str(), deduplicator->get_current_id());
+      }
+    }
+    // Seed the index from the reference datasets in place of a baseline
+    bool seeded = false;
+    if(reference_files.size() > 0) {
+      if(reverse_chain || warm_start) {
+        printf("Reference datasets are ignored when continuing a chain or writing reverse deltas\n");
+      } else {
+        std::ifstream f;
+        f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        f.open(full_chkpt_files[0], std::ifstream::in | std::ifstream::binary);
+        f.seekg(0, f.end);
+        size_t data_len = f.tellg();
+        f.close();
+        Kokkos::View<uint8_t*>::HostMirror ref_chkpt_h("Reference checkpoint", 1);
+        seeded = deduplicator->seed_reference(reference_files, data_len, ref_chkpt_h);
+        if(seeded && pack) {
+          pack_entry_t entry = pack->append(0, ref_chkpt_h.data(), ref_chkpt_h.size());
+          commits.written(pack_file);
+          if(manifest)
+            manifest->record(0, ref_chkpt_h.data(), ref_chkpt_h.size(), pack_file, entry.offset, true);
+          printf("Seeded deduplicator from %zu reference files, reference checkpoint 0 of %s\n",
+                 reference_files.size(), pack_file.c_str());
+        } else if(seeded) {
+          std::string ref_filename = full_chkpt_files[0] + ".reference";
+          if(mode == Basic) {
+            ref_filename = ref_filename + ".basic.incr_chkpt";
+          } else if(mode == List) {
+            ref_filename = ref_filename + ".hashlist.incr_chkpt";
+          } else {
+            ref_filename = ref_filename + ".hashtree.incr_chkpt";
+          }
+          ChkptSink ref_file(ref_filename, writer_config);
+          ref_file.write(ref_chkpt_h);
+          commits.written(ref_filename);
+          if(manifest)
+            manifest->record(0, ref_chkpt_h.data(), ref_chkpt_h.size(), ref_filename, 0, true);
+          printf("Seeded deduplicator from %zu reference files, reference checkpoint %s\n",
+                 reference_files.size(), ref_filename.c_str());
+        }
+      }
+    }
+    std::vector<std::string> incr_chkpt_files;
+    std::vector<uint32_t> chkpt_ids;
+    std::thread reverse_thread;
+    uint32_t reverse_idx = 0;
     // Iterate through num_chkpts
     for(uint32_t idx=0; idx<num_chkpts; idx++) {
-      // Open file and read/calc important values
-      std::ifstream f;
-      f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-      f.open(full_chkpt_files[idx], std::ifstream::in | std::ifstream::binary);
-      f.seekg(0, f.end);
-      size_t data_len = f.tellg();
-      f.seekg(0, f.beg);
-      uint32_t num_chunks = data_len/chunk_size;
-      if(num_chunks*chunk_size < data_len)
-        num_chunks += 1;
-
-      // Read checkpoint file and load it into the device
-      Kokkos::View<uint8_t*> current("Current region", data_len);
-      Kokkos::View<uint8_t*>::HostMirror current_h("Current region mirror", data_len);
-      f.read((char*)(current_h.data()), data_len);
-      Kokkos::deep_copy(current, current_h);
-      f.close();
-
+      bool make_baseline = (idx==0) && !warm_start && !seeded;
       std::string logname = chkpt_filenames[idx];
       std::string filename = full_chkpt_files[idx];
-      if(mode == Full) {
+      // Read checkpoint file and load it into the device. Streamed files are read in windows
+      Kokkos::View<uint8_t*> current;
+      if(stream_window == 0)
+        read_input(full_chkpt_files[idx], current);
+
+      uint32_t chkpt_id = deduplicator->get_current_id();
+      if(pack) {
+        // Checkpoints are appended to the pack in place of their own files
+        Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+        deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), diff_h, logname, make_baseline);
+        pack_entry_t entry = pack->append(chkpt_id, diff_h.data(), diff_h.size());
+        commits.written(pack_file);
+        if(manifest)
+          manifest->record(chkpt_id, diff_h.data(), diff_h.size(), pack_file, entry.offset, mode != Full);
+      } else if(store) {
+        // Checkpoints go to the ring and their files are written in the background
+        Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+        deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), diff_h, logname, make_baseline);
+        if(mode == Full) {
+          filename = filename + ".full_chkpt";
+        } else if(mode == Basic) {
+          filename = filename + ".basic.incr_chkpt";
+        } else if(mode == List) {
+          filename = filename + ".hashlist.incr_chkpt";
+        } else {
+          filename = filename + ".hashtree.incr_chkpt";
+        }
+        store->put(chkpt_id, filename, diff_h, mode != Full);
+      } else if(stream_window > 0) {
+        filename = filename + ".hashlist.incr_chkpt";
+        ListDeduplicator* list_deduplicator = reinterpret_cast<ListDeduplicator*>(deduplicator);
+        list_deduplicator->checkpoint_stream(full_chkpt_files[idx], stream_window, filename, logname, make_baseline || reverse_chain);
+      } else if(mode == Full) {
         filename = filename + ".full_chkpt";
         FullDeduplicator* full_deduplicator = reinterpret_cast<FullDeduplicator*>(deduplicator);
-        full_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, idx==0);
+        full_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, make_baseline);
       } else if(mode == Basic) {
         filename = filename + ".basic.incr_chkpt";
         BasicDeduplicator* basic_deduplicator = reinterpret_cast<BasicDeduplicator*>(deduplicator);
-        basic_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, idx==0);
+        basic_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, make_baseline || reverse_chain);
       } else if(mode == List) {
         filename = filename + ".hashlist.incr_chkpt";
         ListDeduplicator* list_deduplicator = reinterpret_cast<ListDeduplicator*>(deduplicator);
-        list_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, idx==0);
+        list_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, make_baseline || reverse_chain);
       } else {
         filename = filename + ".hashtree.incr_chkpt";
         TreeDeduplicator* tree_deduplicator = reinterpret_cast<TreeDeduplicator*>(deduplicator);
-        tree_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, idx==0);
+        tree_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, make_baseline || reverse_chain);
       }
 //      deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, idx==0);
       Kokkos::fence();
+      incr_chkpt_files.push_back(filename);
+      chkpt_ids.push_back(chkpt_id);
+
+      // Previous checkpoint becomes a reverse delta while the next file is processed
+      if(reverse_chain && idx > 0) {
+        if(reverse_thread.joinable()) {
+          reverse_thread.join();
+          commits.written(incr_chkpt_files[reverse_idx]);
+          if(manifest)
+            manifest->record_file(chkpt_ids[reverse_idx], incr_chkpt_files[reverse_idx], true);
+        }
+        reverse_idx = idx-1;
+        reverse_thread = std::thread(write_reverse_delta, incr_chkpt_files, idx-1, 
+                                     mode != Basic && mode != List, writer_config);
+      }
+    }
+    if(reverse_thread.joinable()) {
+      reverse_thread.join();
+      commits.written(incr_chkpt_files[reverse_idx]);
+      if(manifest)
+        manifest->record_file(chkpt_ids[reverse_idx], incr_chkpt_files[reverse_idx], true);
+    }
+    if(save_state_file.size() > 0)
+      deduplicator->save_state(save_state_file);
+    if(store) {
+      store->drain();
+      printf("Flushed %lu bytes from the ring, checkpoints waited %f seconds for the ring\n",
+             store->bytes_flushed(), store->stall_time());
+    }
+    commits.commit();
+    if(writer_config.durability != DurableNone) {
+      printf("Durability %s: %lu checkpoints synced in %lu commits, %lu syncs, %f seconds syncing\n",
+             durability_name(writer_config.durability), commits.num_chkpts(), commits.num_commits(),
+             commits.num_syncs(), commits.sync_time());
+    }
+    if(!storage_model.dir.empty()) {
+      storage_stats_t storage_stats = get_storage_stats();
+      printf("Emulated storage: %lu bytes written, %lu bytes read, %lu transfers, %lu metadata operations, %f seconds of delay\n",
+             storage_stats.bytes_written, storage_stats.bytes_read, storage_stats.num_transfers,
+             storage_stats.num_metadata_ops, storage_stats.delay);
+    }
+
+    // Report when and why each baseline was made
+    const std::vector<baseline_event_t>& events = deduplicator->get_baseline_events();
+    for(uint32_t i=0; i<events.size(); i++) {
+      if(events[i].reason == BaselineRequested) {
+        printf("Baseline checkpoint %u: requested\n", events[i].chkpt_id);
+      } else {
+        printf("Baseline checkpoint %u: %s %lu (limit %lu)\n", events[i].chkpt_id, 
+               baseline_reason_name(events[i].reason), events[i].value, events[i].limit);
+      }
+    }
+
+    // Report the size of the first occurrence index after each checkpoint
+    const std::vector<index_stats_t>& index_stats = deduplicator->get_index_stats();
+    for(uint32_t i=0; i<index_stats.size(); i++) {
+      printf("Index checkpoint %u: %lu entries, %lu slots, %lu bytes, %lu evicted\n",
+             index_stats[i].chkpt_id, index_stats[i].num_entries, index_stats[i].capacity,
+             index_stats[i].memory_bytes, index_stats[i].num_evicted);
+    }
+
+    // Report how many index probes the digest filter avoided
+    const std::vector<filter_stats_t>& filter_stats = deduplicator->get_filter_stats();
+    for(uint32_t i=0; i<filter_stats.size(); i++) {
+      uint64_t negatives = filter_stats[i].rejected + filter_stats[i].false_positives;
+      double fp_rate = negatives > 0 ? static_cast<double>(filter_stats[i].false_positives)/negatives : 0.0;
+      double reduction = filter_stats[i].lookups > 0 ? 
+                         static_cast<double>(filter_stats[i].rejected)/filter_stats[i].lookups : 0.0;
+      printf("Filter checkpoint %u: %lu lookups, %lu probes avoided (%.1f%%), false positive rate %.4f, %lu bytes\n",
+             filter_stats[i].chkpt_id, filter_stats[i].lookups, filter_stats[i].rejected, 100.0*reduction,
+             fp_rate, filter_stats[i].memory_bytes);
     }
   }
   Kokkos::finalize();
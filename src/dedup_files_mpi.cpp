@@ -5,6 +5,8 @@
 #include <fstream>
 #include <libgen.h>
 #include <iostream>
+#include <memory>
+#include <cstring>
 #include "stdio.h"
 #include "mpi.h"
 #include "deduplicator.hpp"
@@ -23,6 +25,11 @@
 //   --run-tree-chkpt   :   Our deduplication approach. Takes into account time and space
 //                          dimension for deduplication. Compacts metadata using forests of 
 //                          Merkle trees
+// Optional flags
+//   --pack FILE        :   Append the checkpoints of each rank to the pack file
+//                          FILE.Rank<rank> instead of writing one file per checkpoint
+//   --manifest FILE    :   Record the checkpoints of each rank in the chain manifest
+//                          FILE.Rank<rank>
 int main(int argc, char** argv) {
   DEBUG_PRINT("Sanity check\n");
   MPI_Init(&argc, &argv);
@@ -68,6 +75,19 @@ int main(int argc, char** argv) {
     DEBUG_PRINT("Read checkpoint files\n");
     DEBUG_PRINT("Number of checkpoints: %u\n", num_chkpts);
 
+    // Each rank appends to its own pack and records its own manifest
+    std::unique_ptr<ChkptPack> pack;
+    std::unique_ptr<ChainManifest> manifest;
+    std::string pack_file;
+    for(int i=0; i<argc; i++) {
+      if((strcmp(argv[i], "--pack") == 0) && (i+1 < argc)) {
+        pack_file = std::string(argv[i+1]) + ".Rank" + std::to_string(rank);
+        pack.reset(new ChkptPack(pack_file, true));
+      } else if((strcmp(argv[i], "--manifest") == 0) && (i+1 < argc)) {
+        manifest.reset(new ChainManifest(std::string(argv[i+1]) + ".Rank" + std::to_string(rank)));
+      }
+    }
+
 //    Deduplicator deduplicator(chunk_size);
     BaseDeduplicator* deduplicator;
     if(mode == Full) {
@@ -79,6 +99,7 @@ int main(int argc, char** argv) {
     } else {
       deduplicator = reinterpret_cast<BaseDeduplicator*>(new TreeDeduplicator(chunk_size));
     }
+    deduplicator->set_manifest(manifest.get());
     // Iterate through num_chkpts
     for(uint32_t idx=0; idx<num_chkpts; idx++) {
       // Open file and read/calc important values
@@ -101,7 +122,14 @@ int main(int argc, char** argv) {
 
       std::string logname = chkpt_filenames[idx];
       std::string filename = full_chkpt_files[idx];
-      if(mode == Full) {
+      if(pack) {
+        Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+        uint32_t chkpt_id = deduplicator->get_current_id();
+        deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), diff_h, logname, idx==0);
+        pack_entry_t entry = pack->append(chkpt_id, diff_h.data(), diff_h.size());
+        if(manifest)
+          manifest->record(chkpt_id, diff_h.data(), diff_h.size(), pack_file, entry.offset, mode != Full);
+      } else if(mode == Full) {
         filename = filename + ".full_chkpt";
         FullDeduplicator* full_deduplicator = reinterpret_cast<FullDeduplicator*>(deduplicator);
         full_deduplicator->checkpoint((uint8_t*)(current.data()), current.size(), filename, logname, idx==0);
@@ -0,0 +1,144 @@
+#include "dedup_state.hpp"
+#include <cerrno>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <ios>
+#include "storage_emulator.hpp"
+
+void write_dedup_state(const std::string& filename,
+                       state_header_t& header,
+                       const Kokkos::View<HashDigest*>& digests,
+                       uint64_t num_digests,
+                       const DigestNodeIDDeviceMap& index) {
+  // Pack the index entries into contiguous arrays
+  DigestNodeIDDeviceMap map = index;
+  uint32_t num_slots = map_num_slots(map);
+  uint32_t num_entries = 0;
+  Kokkos::parallel_reduce("State: Count index entries", Kokkos::RangePolicy<>(0, num_slots),
+                          KOKKOS_LAMBDA(const uint32_t i, uint32_t& sum) {
+    if(map.valid_at(i))
+      sum += 1;
+  }, Kokkos::Sum<uint32_t>(num_entries));
+  Kokkos::View<HashDigest*> keys("State index keys", num_entries);
+  Kokkos::View<NodeID*> values("State index values", num_entries);
+  Kokkos::parallel_scan("State: Pack index entries", Kokkos::RangePolicy<>(0, num_slots),
+                        KOKKOS_LAMBDA(const uint32_t i, uint32_t& pos, const bool is_final) {
+    if(map.valid_at(i)) {
+      if(is_final) {
+        keys(pos) = map.key_at(i);
+        values(pos) = map.value_at(i);
+      }
+      pos += 1;
+    }
+  });
+  auto keys_h = Kokkos::create_mirror_view(keys);
+  auto values_h = Kokkos::create_mirror_view(values);
+  Kokkos::deep_copy(keys_h, keys);
+  Kokkos::deep_copy(values_h, values);
+  auto digests_sub = Kokkos::subview(digests, std::make_pair(static_cast<uint64_t>(0), num_digests));
+  Kokkos::View<HashDigest*>::HostMirror digests_h("State digests", num_digests);
+  Kokkos::deep_copy(digests_h, digests_sub);
+
+  memcpy(header.magic, "DDSTATE", 8);
+  header.version = DEDUP_STATE_VERSION;
+  header.num_digests = num_digests;
+  header.num_entries = num_entries;
+
+  // Write a temporary file renamed over the old state so a failed save keeps it
+  std::string tmp_file = filename + ".tmp";
+  try {
+    std::ofstream f;
+    f.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    f.open(tmp_file, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    f.write((const char*)(&header), sizeof(state_header_t));
+    f.write((const char*)(digests_h.data()), num_digests*sizeof(HashDigest));
+    f.write((const char*)(keys_h.data()), static_cast<uint64_t>(num_entries)*sizeof(HashDigest));
+    f.write((const char*)(values_h.data()), static_cast<uint64_t>(num_entries)*sizeof(NodeID));
+    f.close();
+  } catch(const std::ios_base::failure& e) {
+    std::remove(tmp_file.c_str());
+    throw;
+  }
+  if(storage_rename(tmp_file, filename) != 0) {
+    std::string error = strerror(errno);
+    std::remove(tmp_file.c_str());
+    throw std::ios_base::failure(std::string("Failed to replace ") + filename + ": " + error);
+  }
+}
+
+bool read_dedup_state(const std::string& filename,
+                      DedupMode mode,
+                      uint32_t chunk_size,
+                      state_header_t& header,
+                      Kokkos::View<HashDigest*>& digests,
+                      DigestNodeIDDeviceMap& index) {
+  std::ifstream f;
+  f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  f.open(filename, std::ifstream::in | std::ifstream::binary);
+  f.read((char*)(&header), sizeof(state_header_t));
+  if((memcmp(header.magic, "DDSTATE", 8) != 0) || (header.version != DEDUP_STATE_VERSION)) {
+    printf("ERROR: %s is not a deduplicator state file\n", filename.c_str());
+    return false;
+  }
+  if((header.mode != static_cast<uint32_t>(mode)) || (header.chunk_size != chunk_size)) {
+    printf("ERROR: %s was saved with a different approach or chunk size (%u bytes)\n",
+           filename.c_str(), header.chunk_size);
+    return false;
+  }
+
+  Kokkos::View<HashDigest*>::HostMirror digests_h("State digests", header.num_digests);
+  Kokkos::View<HashDigest*>::HostMirror keys_h("State index keys", header.num_entries);
+  Kokkos::View<NodeID*>::HostMirror values_h("State index values", header.num_entries);
+  f.read((char*)(digests_h.data()), header.num_digests*sizeof(HashDigest));
+  f.read((char*)(keys_h.data()), header.num_entries*sizeof(HashDigest));
+  f.read((char*)(values_h.data()), header.num_entries*sizeof(NodeID));
+  f.close();
+
+  digests = Kokkos::View<HashDigest*>("State digests", header.num_digests);
+  Kokkos::deep_copy(digests, digests_h);
+  Kokkos::View<HashDigest*> keys("State index keys", header.num_entries);
+  Kokkos::View<NodeID*> values("State index values", header.num_entries);
+  Kokkos::deep_copy(keys, keys_h);
+  Kokkos::deep_copy(values, values_h);
+  index = DigestNodeIDDeviceMap(header.num_entries);
+  DigestNodeIDDeviceMap map = index;
+  Kokkos::parallel_for("State: Insert index entries", Kokkos::RangePolicy<>(0, header.num_entries),
+                       KOKKOS_LAMBDA(const uint32_t i) {
+    map.insert(keys(i), values(i));
+  });
+  Kokkos::fence();
+  return true;
+}
+
+bool read_chain_state(std::vector<std::string>& chkpt_files,
+                      uint32_t chkpt_id,
+                      state_header_t& header) {
+  if(chkpt_id >= chkpt_files.size()) {
+    printf("ERROR: Checkpoint %u is not in the chain of %zu files\n", chkpt_id, chkpt_files.size());
+    return false;
+  }
+  header_t chkpt_header;
+  std::ifstream f;
+  f.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  f.open(chkpt_files[chkpt_id], std::ifstream::in | std::ifstream::binary);
+  f.read((char*)(&chkpt_header), sizeof(header_t));
+  f.close();
+  if((chkpt_header.chkpt_id != chkpt_id) || (chkpt_header.ref_id > chkpt_id)) {
+    printf("ERROR: %s is not checkpoint %u of a forward chain\n", chkpt_files[chkpt_id].c_str(), chkpt_id);
+    return false;
+  }
+  header.current_id = chkpt_id+1;
+  header.baseline_id = chkpt_header.ref_id;
+  header.chunk_size = chkpt_header.chunk_size;
+  header.data_len = chkpt_header.datalen;
+  header.chain_len = chkpt_id - chkpt_header.ref_id + 1;
+  header.chain_bytes = 0;
+  for(uint32_t i=chkpt_header.ref_id; i<=chkpt_id; i++) {
+    f.open(chkpt_files[i], std::ifstream::in | std::ifstream::binary);
+    f.seekg(0, f.end);
+    header.chain_bytes += static_cast<uint64_t>(f.tellg());
+    f.close();
+  }
+  return true;
+}
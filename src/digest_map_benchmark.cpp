@@ -0,0 +1,116 @@
+#include <Kokkos_Core.hpp>
+#include <Kokkos_UnorderedMap.hpp>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include "stdio.h"
+#include "map_helpers.hpp"
+
+// Compare the first occurrence map used by the List and Tree approaches with
+// Kokkos::UnorderedMap. Each map runs the same passes:
+//   Insert : insert every digest of a checkpoint, a fraction of them duplicates
+//   Find   : look up every digest, as done when labeling and restarting chunks
+//   Grow   : insert several checkpoints, growing the map before each one as the
+//            setup of each checkpoint does
+// Usage:
+//   ./digest_map_benchmark num_digests [duplicate_percent] [num_chkpts] [num_trials]
+using UnorderedDigestMap = Kokkos::UnorderedMap<HashDigest, NodeID, Kokkos::DefaultExecutionSpace, digest_hash, digest_equal_to>;
+using TableDigestMap     = DigestTable<HashDigest, NodeID, Kokkos::DefaultExecutionSpace, digest_hash64, digest_equal_to>;
+
+/**
+ * Fill digests for one checkpoint. Each digest is the hash of an ID. A fraction of the
+ * digests repeat IDs of the checkpoint to emulate duplicate chunks.
+ *
+ * \param digests     View to fill
+ * \param chkpt       Checkpoint ID, checkpoints have distinct digests
+ * \param dupl_percent Percentage of digests that are duplicates
+ */
+void fill_digests(Kokkos::View<HashDigest*>& digests, uint32_t chkpt, uint32_t dupl_percent) {
+  uint32_t num_digests = digests.size();
+  uint32_t num_distinct = static_cast<uint32_t>((static_cast<uint64_t>(num_digests)*(100-dupl_percent))/100);
+  if(num_distinct == 0)
+    num_distinct = 1;
+  Kokkos::parallel_for("Fill digests", Kokkos::RangePolicy<>(0, num_digests), KOKKOS_LAMBDA(const uint32_t i) {
+    uint64_t id = (static_cast<uint64_t>(chkpt) << 32) | (i % num_distinct);
+    uint64_t* digest_ptr = (uint64_t*)(digests(i).digest);
+    digest_ptr[0] = digest_hash64::fmix64(id);
+    digest_ptr[1] = digest_hash64::fmix64(id ^ 0x9e3779b97f4a7c15ULL);
+  });
+  Kokkos::fence();
+}
+
+double seconds_since(std::chrono::high_resolution_clock::time_point t0) {
+  std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+  return (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count());
+}
+
+template<class Map>
+void run_benchmark(const char* name, Kokkos::View<HashDigest*>& digests, uint32_t dupl_percent,
+                   uint32_t num_chkpts, uint32_t num_trials) {
+  uint32_t num_digests = digests.size();
+  double insert_time = 0.0, find_time = 0.0, grow_time = 0.0;
+  uint32_t num_found = 0, map_size = 0, grown_size = 0;
+  for(uint32_t trial=0; trial<num_trials; trial++) {
+    fill_digests(digests, 0, dupl_percent);
+    Map map(num_digests);
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    Kokkos::parallel_for("Insert digests", Kokkos::RangePolicy<>(0, num_digests), KOKKOS_LAMBDA(const uint32_t i) {
+      map.insert(digests(i), NodeID(i, 0));
+    });
+    Kokkos::fence();
+    insert_time += seconds_since(t0);
+    map_size = map.size();
+
+    t0 = std::chrono::high_resolution_clock::now();
+    uint32_t found = 0;
+    Kokkos::parallel_reduce("Find digests", Kokkos::RangePolicy<>(0, num_digests), KOKKOS_LAMBDA(const uint32_t i, uint32_t& sum) {
+      uint32_t idx = map.find(digests(i));
+      if(map.valid_at(idx) && map.value_at(idx).node <= i)
+        sum += 1;
+    }, Kokkos::Sum<uint32_t>(found));
+    Kokkos::fence();
+    find_time += seconds_since(t0);
+    num_found = found;
+
+    Map grown(num_digests);
+    t0 = std::chrono::high_resolution_clock::now();
+    for(uint32_t chkpt=0; chkpt<num_chkpts; chkpt++) {
+      fill_digests(digests, chkpt, dupl_percent);
+      std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+      reserve_entries(grown, grown.size()+num_digests);
+      Kokkos::parallel_for("Insert checkpoint digests", Kokkos::RangePolicy<>(0, num_digests), KOKKOS_LAMBDA(const uint32_t i) {
+        grown.insert(digests(i), NodeID(i, chkpt));
+      });
+      Kokkos::fence();
+      grow_time += seconds_since(t1);
+    }
+    grown_size = grown.size();
+  }
+  printf("%-14s: size %u, found %u, grown size %u, insert %f s, find %f s, grow %f s\n",
+         name, map_size, num_found, grown_size,
+         insert_time/num_trials, find_time/num_trials, grow_time/num_trials);
+}
+
+int main(int argc, char** argv) {
+  Kokkos::initialize(argc, argv);
+  {
+    if(argc < 2) {
+      printf("Usage: %s num_digests [duplicate_percent] [num_chkpts] [num_trials]\n", argv[0]);
+    } else {
+      uint32_t num_digests = static_cast<uint32_t>(strtoul(argv[1], NULL, 0));
+      uint32_t dupl_percent = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 10;
+      uint32_t num_chkpts = argc > 3 ? static_cast<uint32_t>(atoi(argv[3])) : 5;
+      uint32_t num_trials = argc > 4 ? static_cast<uint32_t>(atoi(argv[4])) : 5;
+      if(dupl_percent > 100)
+        dupl_percent = 100;
+      Kokkos::View<HashDigest*> digests("Digests", num_digests);
+      printf("%u digests, %u%% duplicates, %u checkpoints, %u trials\n",
+             num_digests, dupl_percent, num_chkpts, num_trials);
+      run_benchmark<UnorderedDigestMap>("UnorderedMap", digests, dupl_percent, num_chkpts, num_trials);
+      run_benchmark<TableDigestMap>("DigestTable", digests, dupl_percent, num_chkpts, num_trials);
+    }
+  }
+  Kokkos::finalize();
+  return 0;
+}
@@ -86,13 +86,10 @@ FullDeduplicator::checkpoint(uint8_t* data_ptr,
   header_t header;
   checkpoint(header, data_ptr, len, diff_h, make_baseline);
   write_chkpt_log(header, diff_h, logname);
-  // Write checkpoint to file
-  std::ofstream file;
-  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-  file.open(filename, std::ofstream::out | std::ofstream::binary);
-  file.write((const char*)(diff_h.data()), diff_h.size());
-  file.flush();
-  file.close();
+  // Write checkpoint to file, Full checkpoints are always read whole and can be split
+  ChkptSink out(filename, writer_config, true);
+  out.write(diff_h);
+  finish_file(filename, diff_h, false);
   current_id += 1;
 }
 
@@ -117,7 +114,63 @@ FullDeduplicator::checkpoint(uint8_t* data_ptr,
   write_chkpt_log(header, diff_h, logname);
   current_id += 1;
 }
+
+chkpt_plan_t 
+FullDeduplicator::plan(uint8_t* data_ptr, 
+                       size_t len, 
+                       bool make_baseline) {
+  // Full checkpoints are the data itself and are always self-contained
+  chkpt_plan_t plan;
+  plan.header.ref_id = current_id;
+  plan.header.chkpt_id = current_id;
+  plan.header.datalen = len;
+  plan.header.chunk_size = chunk_size;
+  plan.header.num_first_ocur = 0;
+  plan.header.num_prior_chkpts = 0;
+  plan.header.num_shift_dupl = 0;
+  plan.make_baseline = true;
+  plan.data_bytes = len;
+  plan.metadata_bytes = 0;
+  estimate_restart(plan);
+  return plan;
+}
                    
+void
+FullDeduplicator::save_state(const std::string& filename) {
+  state_header_t header = fill_state_header(Full);
+  write_dedup_state(filename, header, Kokkos::View<HashDigest*>(), 0, DigestNodeIDDeviceMap());
+}
+
+bool
+FullDeduplicator::load_state(const std::string& filename) {
+  state_header_t header;
+  Kokkos::View<HashDigest*> digests;
+  DigestNodeIDDeviceMap index;
+  if(!read_dedup_state(filename, Full, chunk_size, header, digests, index))
+    return false;
+  restore_state_header(header);
+  return true;
+}
+
+bool
+FullDeduplicator::rebuild_state(Kokkos::View<uint8_t*> data,
+                                std::vector<std::string>& chkpt_filenames,
+                                uint32_t chkpt_id) {
+  state_header_t header = fill_state_header(Full);
+  if(!read_chain_state(chkpt_filenames, chkpt_id, header))
+    return false;
+  restore_state_header(header);
+  return true;
+}
+
+bool
+FullDeduplicator::seed_reference(std::vector<std::string>& reference_files,
+                                 size_t len,
+                                 Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  printf("ERROR: Full checkpoints cannot be seeded with reference datasets\n");
+  return false;
+}
+
 void 
 FullDeduplicator::restart(Kokkos::View<uint8_t*> data, 
                            std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
@@ -157,18 +210,13 @@ FullDeduplicator::restart(Kokkos::View<uint8_t*> data,
                            uint32_t chkpt_id) {
   using Timer = std::chrono::high_resolution_clock;
   using Nanoseconds = std::chrono::nanoseconds;
-  // Full checkpoint
-  std::fstream file;
-  auto fileflags = std::ifstream::in | std::ifstream::binary | std::ifstream::ate;
-  file.open(chkpt_filenames[chkpt_id], fileflags);
-  size_t filesize = file.tellg();
-  file.seekg(0);
+  // Full checkpoint, possibly in stripes over several files
+  size_t filesize = striped_size(chkpt_filenames[chkpt_id]);
   Kokkos::resize(data, filesize);
   auto data_h = Kokkos::create_mirror_view(data);
   // Read checkpoint
   //Timer::time_point r1 = Timer::now();
-  file.read((char*)(data_h.data()), filesize);
-  file.close();
+  read_striped(chkpt_filenames[chkpt_id], 0, filesize, data_h.data(), writer_config);
   //Timer::time_point r2 = Timer::now();
   // Total time
   //Timer::time_point t1 = Timer::now();
@@ -183,6 +231,69 @@ FullDeduplicator::restart(Kokkos::View<uint8_t*> data,
   write_restart_log(chkpt_id, logname);
 }
 
+void
+FullDeduplicator::restart_range(Kokkos::View<uint8_t*>& data,
+                                uint64_t offset,
+                                uint64_t length,
+                                std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts,
+                                std::string& logname,
+                                uint32_t chkpt_id) {
+  using Nanoseconds = std::chrono::nanoseconds;
+  using Timer = std::chrono::high_resolution_clock;
+  // Clamp range to the checkpoint
+  uint64_t chkpt_len = chkpts[chkpt_id].size();
+  if(offset >= chkpt_len) {
+    length = 0;
+  } else if(offset+length > chkpt_len) {
+    length = chkpt_len-offset;
+  }
+  if(data.size() < length)
+    Kokkos::resize(data, length);
+  // Copy range to GPU
+  Timer::time_point c1 = Timer::now();
+  auto range_h = Kokkos::subview(chkpts[chkpt_id], std::make_pair(offset, offset+length));
+  auto range_d = Kokkos::subview(data, std::make_pair(static_cast<uint64_t>(0), length));
+  Kokkos::deep_copy(range_d, range_h);
+  Timer::time_point c2 = Timer::now();
+  // Update timers
+  restart_timers[0] = (1e-9)*(std::chrono::duration_cast<Nanoseconds>(c2-c1).count());
+  restart_timers[1] = 0.0;
+  std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                ".restart_timing.csv";
+  write_restart_log(chkpt_id, restart_logname);
+}
+
+void
+FullDeduplicator::restart_range(Kokkos::View<uint8_t*>& data,
+                                uint64_t offset,
+                                uint64_t length,
+                                std::vector<std::string>& chkpt_filenames,
+                                std::string& logname,
+                                uint32_t chkpt_id) {
+  using Timer = std::chrono::high_resolution_clock;
+  using Nanoseconds = std::chrono::nanoseconds;
+  // Full checkpoint, only read the requested range
+  uint64_t filesize = striped_size(chkpt_filenames[chkpt_id]);
+  if(offset >= filesize) {
+    length = 0;
+  } else if(offset+length > filesize) {
+    length = filesize-offset;
+  }
+  if(data.size() < length)
+    Kokkos::resize(data, length);
+  auto range_d = Kokkos::subview(data, std::make_pair(static_cast<uint64_t>(0), length));
+  auto range_h = Kokkos::create_mirror_view(range_d);
+  read_striped(chkpt_filenames[chkpt_id], offset, length, range_h.data(), writer_config);
+  // Copy range to GPU
+  Timer::time_point c1 = Timer::now();
+  Kokkos::deep_copy(range_d, range_h);
+  Timer::time_point c2 = Timer::now();
+  // Update timers
+  restart_timers[0] = (1e-9)*(std::chrono::duration_cast<Nanoseconds>(c2-c1).count());
+  restart_timers[1] = 0.0;
+  write_restart_log(chkpt_id, logname);
+}
+
 void 
 FullDeduplicator::write_chkpt_log(header_t& header, 
                                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
@@ -0,0 +1,222 @@
+#include "group_commit.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <ios>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "storage_emulator.hpp"
+#include "striped_io.hpp"
+
+/**
+ * Sync the data of a file, or of a directory entry when dir is set
+ *
+ * \return Result of the sync, errno set on failure
+ */
+static int
+sync_path(const std::string& path, bool dir) {
+  int fd = dir ? open(path.c_str(), O_RDONLY | O_DIRECTORY) : storage_open(path, O_RDONLY);
+  if(fd < 0)
+    return -1;
+  int res = dir ? fsync(fd) : fdatasync(fd);
+  int error = errno;
+  if(dir) {
+    close(fd);
+  } else {
+    storage_close(fd);
+  }
+  errno = error;
+  return res;
+}
+
+static std::string
+dir_name(const std::string& path) {
+  size_t slash = path.rfind('/');
+  if(slash == std::string::npos)
+    return std::string(".");
+  return (slash == 0) ? std::string("/") : path.substr(0, slash);
+}
+
+GroupCommit::GroupCommit(const writer_config_t& writer_config) {
+  config = writer_config;
+  manifest = NULL;
+  num_pending = 0;
+  last_commit = std::chrono::steady_clock::now();
+  chkpts = 0;
+  commits = 0;
+  syncs = 0;
+  sync_seconds = 0.0;
+  stop = false;
+  if((config.durability == DurableGroup) && (config.group_seconds > 0.0))
+    timer = std::thread(&GroupCommit::timer_loop, this);
+}
+
+GroupCommit::~GroupCommit() {
+  if(timer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    timer_cv.notify_all();
+    timer.join();
+  }
+  try {
+    commit();
+  } catch(const std::ios_base::failure& e) {
+    printf("ERROR: %s\n", e.what());
+  }
+}
+
+void
+GroupCommit::set_manifest(ChainManifest* chain_manifest) {
+  std::lock_guard<std::mutex> lock(mutex);
+  manifest = chain_manifest;
+}
+
+/**
+ * Commit the group once group_seconds have passed since the last commit, so the last
+ * checkpoints of a run do not wait for the next one to be reported
+ */
+void
+GroupCommit::timer_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while(!stop) {
+    if(num_pending == 0) {
+      timer_cv.wait(lock);
+      continue;
+    }
+    std::chrono::steady_clock::time_point deadline = last_commit +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(config.group_seconds));
+    timer_cv.wait_until(lock, deadline);
+    if(stop || (num_pending == 0) || (std::chrono::steady_clock::now() < deadline))
+      continue;
+    try {
+      commit_locked();
+    } catch(const std::ios_base::failure&) {
+      if(!timer_error)
+        timer_error = std::current_exception();
+    }
+  }
+}
+
+/// Throw the error of a failed commit of the timer once, with the mutex held
+void
+GroupCommit::raise_timer_error() {
+  if(!timer_error)
+    return;
+  std::exception_ptr error = timer_error;
+  timer_error = nullptr;
+  std::rethrow_exception(error);
+}
+
+void
+GroupCommit::written(const std::string& filename) {
+  std::lock_guard<std::mutex> lock(mutex);
+  raise_timer_error();
+  chkpts += 1;
+  if(config.durability == DurableNone)
+    return;
+  pending.insert(filename);
+  num_pending += 1;
+  if(num_pending == 1)
+    timer_cv.notify_all();
+  if(config.durability == DurableGroup) {
+    std::chrono::duration<double> since = std::chrono::steady_clock::now() - last_commit;
+    bool full = (config.group_chkpts > 0) && (num_pending >= config.group_chkpts);
+    bool due = (config.group_seconds > 0.0) && (since.count() >= config.group_seconds);
+    bool unbounded = (config.group_chkpts == 0) && (config.group_seconds <= 0.0);
+    if(!full && !due && !unbounded)
+      return;
+  }
+  commit_locked();
+}
+
+void
+GroupCommit::commit() {
+  std::lock_guard<std::mutex> lock(mutex);
+  raise_timer_error();
+  commit_locked();
+}
+
+void
+GroupCommit::commit_locked() {
+  num_pending = 0;
+  last_commit = std::chrono::steady_clock::now();
+  // Entries recorded since the last commit are for checkpoints synced by now
+  if(pending.empty()) {
+    if(manifest != NULL)
+      manifest->save();
+    return;
+  }
+  std::set<std::string> files;
+  std::set<std::string> dirs;
+  for(auto it=pending.begin(); it!=pending.end(); it++) {
+    bool created = committed.insert(*it).second;
+    // Checkpoints split over several files are synced with their layout
+    stripe_layout_t layout;
+    if(read_stripe_layout(*it, layout) && (layout.files.size() > 1)) {
+      files.insert(*it + STRIPE_LAYOUT_EXT);
+      if(created)
+        dirs.insert(dir_name(*it + STRIPE_LAYOUT_EXT));
+    } else {
+      layout.files.assign(1, *it);
+    }
+    for(uint32_t i=0; i<layout.files.size(); i++) {
+      files.insert(layout.files[i]);
+      if(created)
+        dirs.insert(dir_name(layout.files[i]));
+    }
+  }
+  pending.clear();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::string failed;
+  int error = 0;
+  for(auto it=files.begin(); it!=files.end(); it++) {
+    if(sync_path(*it, false) != 0 && failed.empty()) {
+      failed = *it;
+      error = errno;
+    }
+    syncs += 1;
+  }
+  for(auto it=dirs.begin(); it!=dirs.end(); it++) {
+    if(sync_path(*it, true) != 0 && failed.empty()) {
+      failed = *it;
+      error = errno;
+    }
+    syncs += 1;
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  sync_seconds += elapsed.count();
+  commits += 1;
+  if(!failed.empty())
+    throw std::ios_base::failure(std::string("Failed to sync ") + failed + ": " + strerror(error));
+  if(manifest != NULL)
+    manifest->save();
+}
+
+uint64_t
+GroupCommit::num_chkpts() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return chkpts;
+}
+
+uint64_t
+GroupCommit::num_commits() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return commits;
+}
+
+uint64_t
+GroupCommit::num_syncs() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return syncs;
+}
+
+double
+GroupCommit::sync_time() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return sync_seconds;
+}
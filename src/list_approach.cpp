@@ -22,7 +22,19 @@ ListDeduplicator::~ListDeduplicator() {}
 void 
 ListDeduplicator::dedup_data(const uint8_t* data_ptr, 
                              const size_t len) {
+  dedup_data(RegionMap(data_ptr, len));
+}
+
+/**
+ * Deduplicate the regions of a multi-region checkpoint. Chunks are hashed in place in
+ * their regions and identical chunks in different regions are deduplicated.
+ *
+ * \param regions       Layout of the regions in the logical buffer
+ */
+void 
+ListDeduplicator::dedup_data(const RegionMap& regions) {
   // Calculate useful constants
+  size_t len = regions.len;
   data_len = len;
   num_chunks = len/chunk_size;
   if(num_chunks*chunk_size < len)
@@ -42,11 +54,9 @@ ListDeduplicator::dedup_data(const uint8_t* data_ptr,
     uint32_t block_idx = i*team_member.team_size()+j;
     if(block_idx < num_chunks) {
       uint32_t num_bytes = chunk_size;
-      uint64_t offset = static_cast<uint64_t>(block_idx)*static_cast<uint64_t>(chunk_size);
-      if(block_idx == num_chunks-1)
-        num_bytes = len-offset;
+      const uint8_t* chunk_ptr = regions.chunk_ptr(block_idx, chunk_size, num_bytes);
       HashDigest new_hash;
-      hash(data_ptr+offset, num_bytes, new_hash.digest); /// Compute hash
+      hash(chunk_ptr, num_bytes, new_hash.digest); /// Compute hash
       if(!digests_same(list(block_idx), new_hash)) { /// Test if hash is different
         NodeID info(block_idx, current_id);
         auto result = first_ocur_d.insert(new_hash, info);
@@ -75,11 +85,97 @@ ListDeduplicator::dedup_data(const uint8_t* data_ptr,
  *
  * \return Pair containing amount of data and metadata in the checkpoint
  */
+/**
+ * Set the data length and number of chunks for the next checkpoint. Allocate a new
+ * list and first occurrence map for baselines and grow them as needed otherwise.
+ * First occurrences that can no longer be referenced under the index policy are evicted
+ * and the map is compacted before it grows.
+ *
+ * \param len           Length of data to deduplicate
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void
+ListDeduplicator::setup_dedup(const size_t len, bool make_baseline) {
+  // Kernels of a background checkpoint must not run at the same time
+  wait_async();
+  // Set important values
+  data_len = len;
+  num_chunks = data_len/chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
+    num_chunks += 1;
+
+  // Allocate or resize necessary variables for each approach
+  if(make_baseline) {
+    list = HashList(num_chunks);
+    first_ocur_d = DigestNodeIDDeviceMap(num_chunks);
+    first_ocur_vec = Vector<uint32_t>(num_chunks);
+    shift_dupl_vec = Vector<uint32_t>(num_chunks);
+  }
+  first_ocur_vec.clear();
+  shift_dupl_vec.clear();
+  if(list.list_d.size() < num_chunks) {
+    Kokkos::resize(list.list_d, num_chunks);
+    Kokkos::resize(list.list_h, num_chunks);
+  }
+  index_evicted = 0;
+  if(!make_baseline) {
+    uint32_t min_chkpt = index_min_reachable();
+    uint32_t unmatched_chkpt = (index_policy.drop_unmatched && (current_id > 0)) ? current_id-1 : 0;
+    if((min_chkpt > baseline_id) || (unmatched_chkpt > baseline_id)) {
+      KeepFirstOcur keep = {min_chkpt, unmatched_chkpt, 0};
+      index_evicted = compact_entries(first_ocur_d, keep, num_chunks);
+    }
+  }
+  reserve_entries(first_ocur_d, first_ocur_d.size()+num_chunks);
+}
+
+/**
+ * Count the metadata of the incremental checkpoint identified by dedup_data without
+ * writing it. Fills in the header exactly as collect_diff would.
+ *
+ * \param header The checkpoint header
+ *
+ * \return Pair containing the number of bytes of data and of header and metadata
+ */
+std::pair<uint64_t,uint64_t> 
+ListDeduplicator::count_diff(header_t& header) {
+  // Small bitset to record which checkpoints are necessary for restart
+  Kokkos::Bitset<Kokkos::DefaultExecutionSpace> chkpts_needed(current_id+1);
+  chkpts_needed.reset();
+  Kokkos::parallel_for("Count prior chkpts", Kokkos::RangePolicy<>(0, shift_dupl_vec.size()), 
+                       KOKKOS_CLASS_LAMBDA(const uint32_t i) {
+    NodeID entry = first_ocur_d.value_at(first_ocur_d.find(list.list_d(shift_dupl_vec(i))));
+    chkpts_needed.set(entry.tree);
+  });
+  Kokkos::fence();
+
+  header.ref_id = baseline_id;
+  header.chkpt_id = current_id;
+  header.datalen = data_len;
+  header.chunk_size = chunk_size;
+  header.num_first_ocur = first_ocur_vec.size();
+  header.num_shift_dupl = shift_dupl_vec.size();
+  header.num_prior_chkpts = chkpts_needed.count();
+  uint64_t size_data = static_cast<uint64_t>(header.num_first_ocur)*static_cast<uint64_t>(chunk_size);
+  uint64_t size_metadata = sizeof(header_t) + 
+                           static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t) + 
+                           static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t) + 
+                           static_cast<uint64_t>(header.num_shift_dupl)*2*sizeof(uint32_t);
+  return std::make_pair(size_data, size_metadata);
+}
+
 std::pair<uint64_t,uint64_t> 
 ListDeduplicator::collect_diff( const uint8_t* data_ptr, 
                                 const size_t len,
                                 Kokkos::View<uint8_t*>& buffer_d, 
                                 header_t& header) {
+  return collect_diff(RegionMap(data_ptr, len), buffer_d, header);
+}
+
+std::pair<uint64_t,uint64_t> 
+ListDeduplicator::collect_diff( const RegionMap& regions,
+                                Kokkos::View<uint8_t*>& buffer_d, 
+                                header_t& header) {
   // Calculate number of chunks
   num_chunks = data_len/chunk_size;
   if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len) {
@@ -127,7 +223,7 @@ ListDeduplicator::collect_diff( const uint8_t* data_ptr,
   buffer_size += num_first_ocur*(sizeof(uint32_t)+static_cast<uint64_t>(chunk_size)); // First occurrence metadata
   buffer_size += num_chkpts*2*sizeof(uint32_t); // Shifted duplicate counts metadata
   buffer_size += num_shift_dupl*2*sizeof(uint32_t); // Shifted duplicate metadata
-  Kokkos::resize(buffer_d, buffer_size);
+  alloc_diff_buffer(buffer_d, buffer_size);
   STDOUT_PRINT("Resized buffer\n");
   Kokkos::View<uint64_t[1]> dupl_map_offset_d("Dupl map offset");
   Kokkos::deep_copy(dupl_map_offset_d, shift_dupl_count_offset);
@@ -211,13 +307,9 @@ ListDeduplicator::collect_diff( const uint8_t* data_ptr,
     uint32_t i = team_member.league_rank();
     uint32_t chunk = first_ocur_vec(i);
     uint32_t writesize = chunk_size;
-    uint64_t src_offset = static_cast<uint64_t>(chunk_size)*static_cast<uint64_t>(chunk);
     uint64_t dst_offset = data_offset+static_cast<uint64_t>(i)*static_cast<uint64_t>(chunk_size);
-    if(chunk == num_chunks-1) {
-      writesize = data_len-src_offset;
-    }
 
-    uint8_t* src = (uint8_t*)(data_ptr+src_offset);
+    uint8_t* src = (uint8_t*)(regions.chunk_ptr(chunk, chunk_size, writesize));
     uint8_t* dst = (uint8_t*)(buffer_d.data()+dst_offset);
     team_memcpy(dst, src, writesize, team_member);
   });
@@ -589,6 +681,7 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   // Read main incremental checkpoint header
   std::ifstream file;
   file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  storage_metadata(chkpt_files[file_idx]);
   file.open(chkpt_files[file_idx], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
   size_t filesize = file.tellg();
   file.seekg(0);
@@ -596,6 +689,7 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   DEBUG_PRINT("File size: %zd\n", filesize);
   header_t header;
   file.read((char*)&header, sizeof(header_t));
+  storage_transfer(chkpt_files[file_idx], sizeof(header_t), false);
   STDOUT_PRINT("Ref ID: %u\n",               header.ref_id);
   STDOUT_PRINT("Chkpt ID: %u\n",             header.chkpt_id);
   STDOUT_PRINT("Data len: %lu\n",            header.datalen);
@@ -606,10 +700,15 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
 
   Kokkos::View<uint8_t*> buffer_d("Buffer", filesize);
   Kokkos::deep_copy(buffer_d, 0);
-  auto buffer_h = Kokkos::create_mirror_view(buffer_d);
-  Kokkos::deep_copy(buffer_h, 0);
   file.close();
 
+  // Checkpoints are read ahead on several threads while newer ones are restarted
+  std::vector<uint32_t> order;
+  for(int idx=static_cast<int>(file_idx); idx>=static_cast<int>(header.ref_id); idx--) {
+    order.push_back(static_cast<uint32_t>(idx));
+  }
+  ChkptPrefetcher prefetch(chkpt_files, order, writer_config);
+
   uint32_t num_chunks = static_cast<uint32_t>(header.datalen / static_cast<uint64_t>(header.chunk_size));
   if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(header.chunk_size) < header.datalen) {
     num_chunks += 1;
@@ -617,14 +716,13 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   Kokkos::resize(data, header.datalen);
 
   // Main checkpoint
-  file.open(chkpt_files[file_idx], std::ifstream::in | std::ifstream::binary);
-  file.read((char*)(buffer_h.data()), filesize);
-  file.close();
+  auto buffer_h = prefetch.get(file_idx);
   Kokkos::fence();
   std::chrono::high_resolution_clock::time_point c1 = std::chrono::high_resolution_clock::now();
   Kokkos::deep_copy(buffer_d, buffer_h);
   Kokkos::fence();
   std::chrono::high_resolution_clock::time_point c2 = std::chrono::high_resolution_clock::now();
+  prefetch.release(file_idx);
   Kokkos::View<NodeID*> node_list("List of NodeIDs", num_chunks);
   Kokkos::deep_copy(node_list, NodeID());
   uint32_t ref_id = header.ref_id;
@@ -700,9 +798,9 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
         tree = j;
       }
     }
-    size_t offset = first_ocur_map.value_at(first_ocur_map.find(NodeID(prev, tree)));
     node_list(node) = NodeID(prev, tree);
     if(tree == cur_id) {
+      size_t offset = first_ocur_map.value_at(first_ocur_map.find(NodeID(prev, tree)));
       uint32_t copysize = chunk_size;
       if(node == num_chunks-1)
         copysize = data.size() - chunk_size*node;
@@ -720,20 +818,17 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
 
   for(int idx=static_cast<int>(file_idx)-1; idx>=static_cast<int>(ref_id); idx--) {
     STDOUT_PRINT("Processing checkpoint %u\n", idx);
-    file.open(chkpt_files[idx], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
-    size_t chkpt_size = file.tellg();
+    auto chkpt_buffer_h = prefetch.get(idx);
+    size_t chkpt_size = chkpt_buffer_h.size();
     STDOUT_PRINT("Checkpoint size: %zd\n", chkpt_size);
-    file.seekg(0);
     Kokkos::View<uint8_t*> chkpt_buffer_d("Checkpoint buffer", chkpt_size);
-    auto chkpt_buffer_h = Kokkos::create_mirror_view(chkpt_buffer_d);
-    file.read((char*)(chkpt_buffer_h.data()), chkpt_size);
-    file.close();
     header_t chkpt_header;
     memcpy(&chkpt_header, chkpt_buffer_h.data(), sizeof(header_t));
     uint32_t current_id = chkpt_header.chkpt_id;
     datalen = chkpt_header.datalen;
     chunk_size = chkpt_header.chunk_size;
     Kokkos::deep_copy(chkpt_buffer_d, chkpt_buffer_h);
+    prefetch.release(idx);
 
     ref_id = chkpt_header.ref_id;
     cur_id = chkpt_header.chkpt_id;
@@ -755,12 +850,12 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
     dupl_count_offset = first_ocur_offset + num_first_ocur*sizeof(uint32_t);
     dupl_map_offset = dupl_count_offset + num_prior_chkpts*2*sizeof(uint32_t);
     data_offset = dupl_map_offset + num_shift_dupl*2*sizeof(uint32_t);
-    first_ocur_subview = Kokkos::subview(buffer_d,std::make_pair(first_ocur_offset,dupl_count_offset));
-    dupl_count_subview = Kokkos::subview(buffer_d,std::make_pair(dupl_count_offset,dupl_map_offset));
-    shift_dupl_subview = Kokkos::subview(buffer_d,std::make_pair(dupl_map_offset, data_offset));
-    data_subview  = Kokkos::subview(buffer_d, std::make_pair(data_offset, filesize));
+    first_ocur_subview = Kokkos::subview(chkpt_buffer_d,std::make_pair(first_ocur_offset,dupl_count_offset));
+    dupl_count_subview = Kokkos::subview(chkpt_buffer_d,std::make_pair(dupl_count_offset,dupl_map_offset));
+    shift_dupl_subview = Kokkos::subview(chkpt_buffer_d,std::make_pair(dupl_map_offset, data_offset));
+    data_subview  = Kokkos::subview(chkpt_buffer_d, std::make_pair(data_offset, chkpt_size));
     STDOUT_PRINT("Checkpoint %u\n", chkpt_header.chkpt_id);
-    STDOUT_PRINT("Checkpoint size: %lu\n", filesize);
+    STDOUT_PRINT("Checkpoint size: %lu\n", chkpt_size);
     STDOUT_PRINT("First ocur offset: %lu\n", sizeof(header_t));
     STDOUT_PRINT("Dupl count offset: %lu\n", dupl_count_offset);
     STDOUT_PRINT("Dupl map offset: %lu\n", dupl_map_offset);
@@ -833,6 +928,7 @@ ListDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   }
 
   Kokkos::fence();
+  STDOUT_PRINT("Time spent waiting for checkpoint reads: %f\n", prefetch.wait_time());
   std::chrono::high_resolution_clock::time_point c3 = std::chrono::high_resolution_clock::now();
   double copy_time = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(c2-c1).count());
   double restart_time = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(c3-c2).count());
@@ -845,6 +941,15 @@ ListDeduplicator::checkpoint( header_t& header,
                               size_t len,
                               Kokkos::View<uint8_t*>::HostMirror& diff_h, 
                               bool make_baseline) {
+  checkpoint(header, RegionMap(data_ptr, len), diff_h, make_baseline);
+}
+
+void 
+ListDeduplicator::checkpoint( header_t& header, 
+                              const RegionMap& regions, 
+                              Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                              bool make_baseline) {
+  size_t len = regions.len;
   using Timer = std::chrono::high_resolution_clock;
   using Duration = std::chrono::duration<double>;
   // ==========================================================================================
@@ -855,27 +960,11 @@ ListDeduplicator::checkpoint( header_t& header,
                                   std::to_string(current_id) + std::string(": Setup");
   Kokkos::Profiling::pushRegion(setup_region_name.c_str());
 
-  // Set important values
-  data_len = len;
-  num_chunks = data_len/chunk_size;
-  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
-    num_chunks += 1;
+  // Start a new chain if requested or if the current chain is too long or too large
+  make_baseline = apply_baseline_policy(make_baseline, first_ocur_d.size());
 
-  // Allocate or resize necessary variables for each approach
-  if(make_baseline) {
-    list = HashList(num_chunks);
-    first_ocur_d = DigestNodeIDDeviceMap(num_chunks);
-    first_ocur_vec = Vector<uint32_t>(num_chunks);
-    shift_dupl_vec = Vector<uint32_t>(num_chunks);
-  }
-  first_ocur_vec.clear();
-  shift_dupl_vec.clear();
-  if(list.list_d.size() < num_chunks) {
-    Kokkos::resize(list.list_d, num_chunks);
-    Kokkos::resize(list.list_h, num_chunks);
-  }
-  if(first_ocur_d.capacity() < first_ocur_d.size()+num_chunks)
-    first_ocur_d.rehash(first_ocur_d.size()+num_chunks);
+  // Set important values and allocate or resize necessary variables
+  setup_dedup(len, make_baseline);
 
   Kokkos::Profiling::popRegion();
 
@@ -892,7 +981,7 @@ ListDeduplicator::checkpoint( header_t& header,
   if((current_id == 0) || make_baseline) {
     baseline_id = current_id;
   }
-  dedup_data(data_ptr, len);
+  dedup_data(regions);
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_create_tree0 = Timer::now();
@@ -907,7 +996,7 @@ ListDeduplicator::checkpoint( header_t& header,
   Timer::time_point start_collect = Timer::now();
   Kokkos::Profiling::pushRegion(collect_region_name.c_str());
 
-  datasizes = collect_diff(data_ptr, data_len, diff, header);
+  datasizes = collect_diff(regions, diff, header);
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_collect = Timer::now();
@@ -917,13 +1006,13 @@ ListDeduplicator::checkpoint( header_t& header,
   // Copy diff to host 
   // ==========================================================================================
   Timer::time_point start_write = Timer::now();
-  Kokkos::resize(diff_h, diff.size());
   std::string write_region_name = std::string("Copy diff to host ") 
                                   + std::to_string(current_id);
   Kokkos::Profiling::pushRegion(write_region_name.c_str());
 
-  Kokkos::deep_copy(diff_h, diff);
-  memcpy(diff_h.data(), &header, sizeof(header_t));
+  diff_to_host(diff, diff_h, header);
+  update_chain(make_baseline, diff_h.size());
+  record_index_stats(first_ocur_d.size(), first_ocur_d.capacity(), map_memory_bytes(first_ocur_d));
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_write = Timer::now();
@@ -938,15 +1027,14 @@ ListDeduplicator::checkpoint(uint8_t* data_ptr,
                               bool make_baseline) {
   Kokkos::View<uint8_t*>::HostMirror diff_h;
   header_t header;
+  ChkptSink out(filename, writer_config);
+  sink = &out;
   checkpoint(header, data_ptr, len, diff_h, make_baseline);
+  sink = NULL;
   write_chkpt_log(header, diff_h, logname);
-  // Write checkpoint to file
-  std::ofstream file;
-  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-  file.open(filename, std::ofstream::out | std::ofstream::binary);
-  file.write((const char*)(diff_h.data()), diff_h.size());
-  file.flush();
-  file.close();
+  // Write checkpoint to file unless it was gathered into the file
+  out.write(diff_h);
+  finish_file(filename, diff_h, true);
   current_id += 1;
 }
 
@@ -971,13 +1059,547 @@ ListDeduplicator::checkpoint(uint8_t* data_ptr,
   write_chkpt_log(header, diff_h, logname);
   current_id += 1;
 }
+
+void 
+ListDeduplicator::checkpoint(std::vector<region_t>& regions, 
+                             Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                             bool make_baseline) {
+  header_t header;
+  checkpoint(header, RegionMap(regions, chunk_size), diff_h, make_baseline);
+  current_id += 1;
+}
+
+void 
+ListDeduplicator::checkpoint(std::vector<region_t>& regions, 
+                             std::string& filename, 
+                             std::string& logname, 
+                             bool make_baseline) {
+  Kokkos::View<uint8_t*>::HostMirror diff_h;
+  header_t header;
+  ChkptSink out(filename, writer_config);
+  sink = &out;
+  checkpoint(header, RegionMap(regions, chunk_size), diff_h, make_baseline);
+  sink = NULL;
+  write_chkpt_log(header, diff_h, logname);
+  // Write checkpoint to file unless it was gathered into the file
+  out.write(diff_h);
+  finish_file(filename, diff_h, true);
+  current_id += 1;
+}
+
+/**
+ * Set up a checkpoint streamed in windows. Only the digests of one window are kept on
+ * the device. The digests of the whole data are kept in the host list between windows
+ * and checkpoints.
+ *
+ * \param len           Length of the data in bytes
+ * \param window_chunks Number of chunks in a window
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void
+ListDeduplicator::setup_stream(const size_t len, uint32_t window_chunks, bool make_baseline) {
+  data_len = len;
+  num_chunks = data_len/chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
+    num_chunks += 1;
+
+  if(make_baseline) {
+    first_ocur_d = DigestNodeIDDeviceMap(window_chunks);
+    list.list_h = Kokkos::View<HashDigest*>::HostMirror("Hash list", num_chunks);
+  }
+  if(list.list_h.size() < num_chunks)
+    Kokkos::resize(list.list_h, num_chunks);
+  if(list.list_d.size() != window_chunks)
+    list.list_d = Kokkos::View<HashDigest*>("Hash list window", window_chunks);
+  if(first_ocur_vec.capacity() != window_chunks) {
+    first_ocur_vec = Vector<uint32_t>(window_chunks);
+    shift_dupl_vec = Vector<uint32_t>(window_chunks);
+  }
+  first_ocur_vec.clear();
+  shift_dupl_vec.clear();
+  index_evicted = 0;
+  if(!make_baseline) {
+    uint32_t min_chkpt = index_min_reachable();
+    uint32_t unmatched_chkpt = (index_policy.drop_unmatched && (current_id > 0)) ? current_id-1 : 0;
+    if((min_chkpt > baseline_id) || (unmatched_chkpt > baseline_id)) {
+      KeepFirstOcur keep = {min_chkpt, unmatched_chkpt, 0};
+      index_evicted = compact_entries(first_ocur_d, keep, window_chunks);
+    }
+  }
+}
+
+/**
+ * Deduplicate one window of a streamed checkpoint. The digests of the window must be in
+ * the device list. First occurrences and shifted duplicates are recorded by their chunk
+ * index in the whole data.
+ *
+ * \param window_ptr  Device pointer to the window
+ * \param window_len  Length of the window in bytes
+ * \param first_chunk Index of the first chunk of the window in the whole data
+ */
+void
+ListDeduplicator::dedup_window(const uint8_t* window_ptr, 
+                               uint64_t window_len, 
+                               uint32_t first_chunk) {
+  uint32_t window_chunks = static_cast<uint32_t>((window_len+chunk_size-1)/chunk_size);
+  first_ocur_vec.clear();
+  shift_dupl_vec.clear();
+  reserve_entries(first_ocur_d, first_ocur_d.size()+window_chunks);
+  Kokkos::parallel_for("Dedup window", Kokkos::RangePolicy<>(0, window_chunks), 
+  KOKKOS_CLASS_LAMBDA(const uint32_t i) {
+    uint64_t offset = static_cast<uint64_t>(i)*static_cast<uint64_t>(chunk_size);
+    uint32_t num_bytes = chunk_size;
+    if(offset+num_bytes > window_len)
+      num_bytes = static_cast<uint32_t>(window_len-offset);
+    HashDigest new_hash;
+    hash(window_ptr+offset, num_bytes, new_hash.digest);
+    if(!digests_same(list(i), new_hash)) {
+      NodeID info(first_chunk+i, current_id);
+      auto result = first_ocur_d.insert(new_hash, info);
+      if(result.success()) {
+        first_ocur_vec.push(first_chunk+i);
+      } else if(result.existing()) {
+        shift_dupl_vec.push(first_chunk+i);
+      }
+      list(i) = new_hash;
+    }
+  });
+  Kokkos::fence();
+}
+
+/**
+ * Read part of a file into a host buffer
+ */
+static void 
+read_file_window(std::ifstream* file, uint64_t offset, uint64_t len, uint8_t* buffer) {
+  file->seekg(offset, file->beg);
+  file->read((char*)(buffer), len);
+}
+
+void 
+ListDeduplicator::checkpoint_stream(std::string& data_file, 
+                                    uint64_t window_len, 
+                                    std::string& filename, 
+                                    std::string& logname, 
+                                    bool make_baseline) {
+  wait_async();
+  std::ifstream in;
+  in.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  in.open(data_file, std::ifstream::in | std::ifstream::binary);
+  in.seekg(0, in.end);
+  uint64_t len = static_cast<uint64_t>(in.tellg());
+  std::ifstream* file = &in;
+  checkpoint_windows(len, [file](uint64_t offset, uint64_t n, uint8_t* buffer) {
+                       read_file_window(file, offset, n, buffer);
+                     }, window_len, filename, logname, make_baseline);
+  in.close();
+}
+
+void 
+ListDeduplicator::checkpoint_async(uint8_t* data_ptr, 
+                                   size_t len, 
+                                   uint64_t window_len, 
+                                   std::string& filename, 
+                                   std::string& logname, 
+                                   bool make_baseline) {
+  wait_async();
+  async_chkpt = std::make_shared<AsyncChkpt>();
+  async_chkpt->snapshot.reset(new CowSnapshot(data_ptr, len));
+  CowSnapshot* snap = async_chkpt->snapshot.get();
+  std::string chkpt_name = filename;
+  std::string log_name = logname;
+  AsyncChkpt* chkpt = async_chkpt.get();
+  async_chkpt->thread = std::thread([this, chkpt, snap, len, window_len, chkpt_name, log_name, make_baseline]() {
+    std::string name = chkpt_name;
+    std::string log = log_name;
+    try {
+      checkpoint_windows(len, [snap](uint64_t offset, uint64_t n, uint8_t* buffer) {
+                           snap->read(offset, n, buffer);
+                         }, window_len, name, log, make_baseline);
+    } catch(...) {
+      chkpt->error = std::current_exception();
+    }
+  });
+}
+
+uint64_t 
+ListDeduplicator::wait_async() {
+  uint64_t pages = 0;
+  if(async_chkpt) {
+    if(async_chkpt->thread.joinable())
+      async_chkpt->thread.join();
+    pages = async_chkpt->snapshot->pages_copied();
+    std::exception_ptr error = async_chkpt->error;
+    async_chkpt.reset();
+    if(error)
+      std::rethrow_exception(error);
+  }
+  return pages;
+}
+
+/**
+ * Checkpoint data read in windows. The next window is read on a separate thread while
+ * the current one is deduplicated. Windows are read in order. Errors of the reader are
+ * rethrown once it is joined. Throws std::ios_base::failure if the data cannot be read
+ * or written, or has more chunks than 32-bit chunk indices can address.
+ *
+ * \param len           Length of the data in bytes
+ * \param read_window   Reads (offset, length) of the data into a Host buffer
+ * \param window_len    Length of a window in bytes
+ * \param filename      Filename to save checkpoint
+ * \param logname       Base filename for logs
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void 
+ListDeduplicator::checkpoint_windows(uint64_t len, 
+                                     const std::function<void(uint64_t,uint64_t,uint8_t*)>& read_window,
+                                     uint64_t window_len, 
+                                     std::string& filename, 
+                                     std::string& logname, 
+                                     bool make_baseline) {
+  using Timer = std::chrono::high_resolution_clock;
+  using Duration = std::chrono::duration<double>;
+  Timer::time_point beg_chkpt = Timer::now();
+  // Chunk indices in the list and the metadata are 32-bit
+  if((len+chunk_size-1)/chunk_size > static_cast<uint64_t>(UINT32_MAX))
+    throw std::ios_base::failure(std::string("Cannot checkpoint ") + std::to_string(len) + 
+                                 " bytes in more than " + std::to_string(UINT32_MAX) + " chunks");
+  window_len = std::max(window_len/chunk_size, static_cast<uint64_t>(1))*chunk_size;
+  if(window_len > len)
+    window_len = std::max((len+chunk_size-1)/chunk_size, static_cast<uint64_t>(1))*chunk_size;
+  uint32_t window_chunks = static_cast<uint32_t>(window_len/chunk_size);
+  uint64_t num_windows = (len+window_len-1)/window_len;
+
+  make_baseline = apply_baseline_policy(make_baseline, first_ocur_d.size());
+  setup_stream(len, window_chunks, make_baseline);
+  if((current_id == 0) || make_baseline) {
+    baseline_id = current_id;
+  }
+  timers[0] = std::chrono::duration_cast<Duration>(Timer::now() - beg_chkpt).count();
+  timers[1] = 0.0;
+  timers[2] = 0.0;
+
+  // Chunk data is staged in a temporary file until the size of the metadata is known
+  std::string data_filename = filename + ".data";
+  std::fstream data_out;
+  data_out.exceptions(std::fstream::failbit | std::fstream::badbit);
+  data_out.open(data_filename, std::fstream::in | std::fstream::out | 
+                               std::fstream::binary | std::fstream::trunc);
+
+  // The next window is read while the current one is deduplicated
+  Kokkos::View<uint8_t*>::HostMirror window_h[2] = {
+    Kokkos::View<uint8_t*>::HostMirror("Window buffer 0", window_len),
+    Kokkos::View<uint8_t*>::HostMirror("Window buffer 1", window_len)};
+  Kokkos::View<uint8_t*> window_d("Window", window_len);
+  Kokkos::View<uint8_t*> gather_d("Window first occurrences", window_len);
+  Kokkos::View<uint32_t*> dupl_d("Window shifted duplicates", 3*static_cast<uint64_t>(window_chunks));
+  std::vector<uint32_t> first_ocur;
+  std::vector<uint32_t> shift_dupl; // (node, prev node, prev checkpoint) triples
+  std::thread reader;
+  std::exception_ptr read_error;
+  try {
+    if(num_windows > 0)
+      read_window(0, std::min(window_len, len), window_h[0].data());
+    for(uint64_t w=0; w<num_windows; w++) {
+      uint64_t offset = w*window_len;
+      uint64_t cur_len = std::min(window_len, len-offset);
+      uint32_t first_chunk = static_cast<uint32_t>(offset/chunk_size);
+      uint32_t cur_chunks = static_cast<uint32_t>((cur_len+chunk_size-1)/chunk_size);
+      Kokkos::deep_copy(window_d, window_h[w%2]);
+      if(w+1 < num_windows) {
+        uint64_t next_offset = offset+window_len;
+        uint64_t next_len = std::min(window_len, len-next_offset);
+        uint8_t* next_buffer = window_h[(w+1)%2].data();
+        reader = std::thread([&read_window, &read_error, next_offset, next_len, next_buffer]() {
+          try {
+            read_window(next_offset, next_len, next_buffer);
+          } catch(...) {
+            read_error = std::current_exception();
+          }
+        });
+      }
+
+      Timer::time_point start_dedup = Timer::now();
+      auto list_window_h = Kokkos::subview(list.list_h, std::make_pair(first_chunk, first_chunk+cur_chunks));
+      auto list_window_d = Kokkos::subview(list.list_d, std::make_pair(static_cast<uint32_t>(0), cur_chunks));
+      Kokkos::deep_copy(list_window_d, list_window_h);
+      dedup_window(window_d.data(), cur_len, first_chunk);
+      Timer::time_point start_collect = Timer::now();
+      timers[1] += std::chrono::duration_cast<Duration>(start_collect - start_dedup).count();
+
+      // Look up the first occurrence of each shifted duplicate while its digest is on the device
+      uint32_t num_first_ocur = first_ocur_vec.size();
+      uint32_t num_shift_dupl = shift_dupl_vec.size();
+      Kokkos::parallel_for("Find window duplicates", Kokkos::RangePolicy<>(0, num_shift_dupl), 
+                           KOKKOS_CLASS_LAMBDA(const uint32_t i) {
+        uint32_t node = shift_dupl_vec(i);
+        NodeID prev = first_ocur_d.value_at(first_ocur_d.find(list(node-first_chunk)));
+        dupl_d(3*i) = node;
+        dupl_d(3*i+1) = prev.node;
+        dupl_d(3*i+2) = prev.tree;
+      });
+      // Gather first occurrences
+      Kokkos::parallel_for("Gather window chunks", Kokkos::TeamPolicy<>(num_first_ocur, Kokkos::AUTO()), 
+                           KOKKOS_CLASS_LAMBDA(const Kokkos::TeamPolicy<>::member_type& team_member) {
+        uint32_t i = team_member.league_rank();
+        uint64_t src_offset = static_cast<uint64_t>(first_ocur_vec(i)-first_chunk)*chunk_size;
+        uint32_t writesize = chunk_size;
+        if(src_offset+writesize > cur_len)
+          writesize = static_cast<uint32_t>(cur_len-src_offset);
+        uint8_t* src = window_d.data()+src_offset;
+        uint8_t* dst = gather_d.data()+static_cast<uint64_t>(i)*chunk_size;
+        team_memcpy(dst, src, writesize, team_member);
+      });
+      Kokkos::fence();
+      auto gather_h = Kokkos::create_mirror_view(gather_d);
+      Kokkos::deep_copy(gather_h, gather_d);
+      auto dupl_h = Kokkos::create_mirror_view(dupl_d);
+      Kokkos::deep_copy(dupl_h, dupl_d);
+      Kokkos::deep_copy(first_ocur_vec.vector_h, first_ocur_vec.vector_d);
+      Kokkos::deep_copy(list_window_h, list_window_d);
+      first_ocur.insert(first_ocur.end(), first_ocur_vec.vector_h.data(), 
+                        first_ocur_vec.vector_h.data()+num_first_ocur);
+      shift_dupl.insert(shift_dupl.end(), dupl_h.data(), dupl_h.data()+3*static_cast<uint64_t>(num_shift_dupl));
+      data_out.write((const char*)(gather_h.data()), static_cast<uint64_t>(num_first_ocur)*chunk_size);
+      timers[2] += std::chrono::duration_cast<Duration>(Timer::now() - start_collect).count();
+      if(reader.joinable())
+        reader.join();
+      if(read_error)
+        std::rethrow_exception(read_error);
+    }
+  } catch(...) {
+    // The reader still uses the window buffers
+    if(reader.joinable())
+      reader.join();
+    data_out.exceptions(std::fstream::goodbit);
+    data_out.close();
+    std::remove(data_filename.c_str());
+    throw;
+  }
+
+  // Sort shifted duplicates by the checkpoint of their first occurrence
+  Timer::time_point start_write = Timer::now();
+  uint64_t num_shift_dupl = shift_dupl.size()/3;
+  std::vector<uint64_t> order(num_shift_dupl);
+  for(uint64_t i=0; i<num_shift_dupl; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&shift_dupl](uint64_t a, uint64_t b) {
+    return shift_dupl[3*a+2] < shift_dupl[3*b+2];
+  });
+  std::vector<uint32_t> prior_counts; // (checkpoint, count) pairs
+  for(uint64_t i=0; i<num_shift_dupl; i++) {
+    uint32_t tree = shift_dupl[3*order[i]+2];
+    if(prior_counts.empty() || prior_counts[prior_counts.size()-2] != tree) {
+      prior_counts.push_back(tree);
+      prior_counts.push_back(0);
+    }
+    prior_counts.back() += 1;
+  }
+
+  header_t header;
+  header.ref_id = baseline_id;
+  header.chkpt_id = current_id;
+  header.datalen = len;
+  header.chunk_size = chunk_size;
+  header.num_first_ocur = static_cast<uint32_t>(first_ocur.size());
+  header.num_shift_dupl = static_cast<uint32_t>(num_shift_dupl);
+  header.num_prior_chkpts = static_cast<uint32_t>(prior_counts.size()/2);
+  uint64_t metadata_size = sizeof(header_t) + first_ocur.size()*sizeof(uint32_t) + 
+                           prior_counts.size()*sizeof(uint32_t) + num_shift_dupl*2*sizeof(uint32_t);
+  Kokkos::View<uint8_t*>::HostMirror metadata_h("Streamed checkpoint metadata", metadata_size);
+  uint8_t* pos = metadata_h.data();
+  memcpy(pos, &header, sizeof(header_t));
+  pos += sizeof(header_t);
+  memcpy(pos, first_ocur.data(), first_ocur.size()*sizeof(uint32_t));
+  pos += first_ocur.size()*sizeof(uint32_t);
+  memcpy(pos, prior_counts.data(), prior_counts.size()*sizeof(uint32_t));
+  pos += prior_counts.size()*sizeof(uint32_t);
+  for(uint64_t i=0; i<num_shift_dupl; i++) {
+    memcpy(pos, &shift_dupl[3*order[i]], 2*sizeof(uint32_t));
+    pos += 2*sizeof(uint32_t);
+  }
+
+  // Write the metadata followed by the staged chunk data
+  uint64_t data_size = static_cast<uint64_t>(header.num_first_ocur)*chunk_size;
+  storage_metadata(filename);
+  std::ofstream file;
+  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+  file.open(filename, std::ofstream::out | std::ofstream::binary);
+  file.write((const char*)(metadata_h.data()), metadata_size);
+  data_out.seekg(0, data_out.beg);
+  for(uint64_t copied=0; copied<data_size; copied+=window_len) {
+    uint64_t n = std::min(window_len, data_size-copied);
+    data_out.read((char*)(window_h[0].data()), n);
+    file.write((const char*)(window_h[0].data()), n);
+  }
+  file.flush();
+  file.close();
+  storage_transfer(filename, metadata_size+data_size, true);
+  data_out.close();
+  std::remove(data_filename.c_str());
+
+  datasizes = std::make_pair(data_size, metadata_size);
+  update_chain(make_baseline, metadata_size+data_size);
+  record_index_stats(first_ocur_d.size(), first_ocur_d.capacity(), map_memory_bytes(first_ocur_d));
+  timers[3] = std::chrono::duration_cast<Duration>(Timer::now() - start_write).count();
+  write_chkpt_log(header, metadata_h, logname);
+  if(commits != NULL)
+    commits->written(filename);
+  // The checkpoint was never whole on the Host, it is read back from the file
+  if(manifest != NULL)
+    manifest->record_file(current_id, filename, true);
+  current_id += 1;
+}
+
+chkpt_plan_t 
+ListDeduplicator::plan(uint8_t* data_ptr, 
+                       size_t len, 
+                       bool make_baseline) {
+  chkpt_plan_t plan;
+  baseline_event_t event;
+  plan.make_baseline = check_baseline_policy(make_baseline, first_ocur_d.size(), event);
+
+  // Keep the current state so that the dry run does not affect the next checkpoint.
+  // Baselines allocate new structures, otherwise deduplicate against copies.
+  HashList saved_list = list;
+  DigestNodeIDDeviceMap saved_first_ocur_d = first_ocur_d;
+  Vector<uint32_t> saved_first_ocur_vec = first_ocur_vec;
+  Vector<uint32_t> saved_shift_dupl_vec = shift_dupl_vec;
+  uint32_t saved_baseline_id = baseline_id;
+  uint64_t saved_data_len = data_len;
+  uint32_t saved_num_chunks = num_chunks;
+  if(!plan.make_baseline) {
+    list = HashList(saved_list.list_d.size());
+    Kokkos::deep_copy(list.list_d, saved_list.list_d);
+    first_ocur_d = DigestNodeIDDeviceMap(saved_first_ocur_d.capacity());
+    Kokkos::deep_copy(first_ocur_d, saved_first_ocur_d);
+    first_ocur_vec = Vector<uint32_t>(saved_first_ocur_vec.capacity());
+    shift_dupl_vec = Vector<uint32_t>(saved_shift_dupl_vec.capacity());
+  }
+
+  setup_dedup(len, plan.make_baseline);
+  if(plan.make_baseline) {
+    baseline_id = current_id;
+  }
+  dedup_data(data_ptr, len);
+  std::pair<uint64_t,uint64_t> sizes = count_diff(plan.header);
+  plan.data_bytes = sizes.first;
+  plan.metadata_bytes = sizes.second;
+  estimate_restart(plan);
+
+  list = saved_list;
+  first_ocur_d = saved_first_ocur_d;
+  first_ocur_vec = saved_first_ocur_vec;
+  shift_dupl_vec = saved_shift_dupl_vec;
+  baseline_id = saved_baseline_id;
+  data_len = saved_data_len;
+  num_chunks = saved_num_chunks;
+  return plan;
+}
                    
+void
+ListDeduplicator::save_state(const std::string& filename) {
+  wait_async();
+  state_header_t header = fill_state_header(List);
+  uint32_t num_digests = (current_id > 0) ? num_chunks : 0;
+  write_dedup_state(filename, header, list.list_d, num_digests, first_ocur_d);
+}
+
+bool
+ListDeduplicator::load_state(const std::string& filename) {
+  wait_async();
+  state_header_t header;
+  Kokkos::View<HashDigest*> digests;
+  DigestNodeIDDeviceMap index;
+  if(!read_dedup_state(filename, List, chunk_size, header, digests, index))
+    return false;
+  restore_state_header(header);
+  num_chunks = header.num_digests;
+  list = HashList(num_chunks);
+  Kokkos::deep_copy(list.list_d, digests);
+  first_ocur_d = index;
+  first_ocur_vec = Vector<uint32_t>(num_chunks);
+  shift_dupl_vec = Vector<uint32_t>(num_chunks);
+  return true;
+}
+
+bool
+ListDeduplicator::rebuild_state(Kokkos::View<uint8_t*> data,
+                                std::vector<std::string>& chkpt_filenames,
+                                uint32_t chkpt_id) {
+  std::vector<std::string> hashlist_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    hashlist_chkpt_files.push_back(chkpt_filenames[i]+".hashlist.incr_chkpt");
+  }
+  state_header_t header = fill_state_header(List);
+  if(!read_chain_state(hashlist_chkpt_files, chkpt_id, header))
+    return false;
+  if(header.chunk_size != chunk_size) {
+    printf("ERROR: Checkpoint %u uses %u byte chunks\n", chkpt_id, header.chunk_size);
+    return false;
+  }
+  restore_state_header(header);
+  setup_dedup(header.data_len, true);
+  // Every chunk of the restarted data can be referenced as it was in checkpoint chkpt_id.
+  // Duplicate chunks reference the lowest offset.
+  uint8_t* data_ptr = data.data();
+  Kokkos::parallel_for("Rebuild list", Kokkos::RangePolicy<>(0, num_chunks), 
+  KOKKOS_CLASS_LAMBDA(const uint32_t idx) {
+    uint32_t num_bytes = chunk_size;
+    uint64_t offset = static_cast<uint64_t>(idx)*static_cast<uint64_t>(chunk_size);
+    if(idx == num_chunks-1)
+      num_bytes = data_len-offset;
+    HashDigest digest;
+    hash(data_ptr+offset, num_bytes, digest.digest);
+    list(idx) = digest;
+    auto result = first_ocur_d.insert(digest, NodeID(idx, chkpt_id));
+    if(result.existing()) {
+      auto& info = first_ocur_d.value_at(result.index());
+      Kokkos::atomic_min(&info.node, idx);
+    }
+  });
+  Kokkos::fence();
+  return true;
+}
+
+bool
+ListDeduplicator::seed_reference(std::vector<std::string>& reference_files,
+                                 size_t len,
+                                 Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  wait_async();
+  ReferenceSet refs(reference_files);
+  if(!refs.valid())
+    return false;
+  Kokkos::View<uint8_t*> image_d("Reference image", len);
+  read_reference_image(refs, image_d);
+
+  // The reference checkpoint starts the chain in place of a baseline
+  setup_dedup(len, true);
+  baseline_id = current_id;
+  dedup_data(image_d.data(), len);
+  header_t header = {current_id, current_id, len, chunk_size, 0, 0, 0};
+  write_reference_chkpt(header, refs, chkpt_h);
+  update_chain(true, chkpt_h.size());
+  record_index_stats(first_ocur_d.size(), first_ocur_d.capacity(), map_memory_bytes(first_ocur_d));
+  current_id += 1;
+  return true;
+}
+
 void 
 ListDeduplicator::restart(Kokkos::View<uint8_t*> data, 
                            std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
                            std::string& logname, 
                            uint32_t chkpt_id) {
-  auto basic_list_times = restart_chkpt(chkpts, chkpt_id, data);
+  wait_async();
+  std::pair<double,double> basic_list_times;
+  ChkptChain chain(chkpts, false);
+  if(chain.reverse(chkpt_id) || chain.seeded(chkpt_id)) {
+    // Reverse deltas and reference datasets are resolved by the chain reader
+    basic_list_times = chain.restart(chkpt_id, data);
+  } else {
+    basic_list_times = restart_chkpt(chkpts, chkpt_id, data);
+  }
   restart_timers[0] = basic_list_times.first;
   restart_timers[1] = basic_list_times.second;
   std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
@@ -1000,16 +1622,133 @@ ListDeduplicator::restart(Kokkos::View<uint8_t*> data,
                            std::vector<std::string>& chkpt_filenames, 
                            std::string& logname, 
                            uint32_t chkpt_id) {
+  wait_async();
   std::vector<std::string> hashlist_chkpt_files;
   for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
     hashlist_chkpt_files.push_back(chkpt_filenames[i]+".hashlist.incr_chkpt");
   }
-  auto list_times = restart_chkpt(hashlist_chkpt_files, chkpt_id, data);
+  std::pair<double,double> list_times;
+  ChkptChain chain(hashlist_chkpt_files, false);
+  if(chain.reverse(chkpt_id) || chain.seeded(chkpt_id)) {
+    // Reverse deltas and reference datasets are resolved by the chain reader
+    list_times = chain.restart(chkpt_id, data);
+  } else {
+    list_times = restart_chkpt(hashlist_chkpt_files, chkpt_id, data);
+  }
   restart_timers[0] = list_times.first;
   restart_timers[1] = list_times.second;
   write_restart_log(chkpt_id, logname);
 }
 
+/**
+ * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+ * on the Host. Only chunks overlapping [offset, offset+length) are restarted.
+ *
+ * \param data       Data View to restart the range into, resized if shorter than the range
+ * \param offset     Byte offset of the range in the checkpointed data
+ * \param length     Length of the range in bytes
+ * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+ListDeduplicator::restart_range(Kokkos::View<uint8_t*>& data, 
+                                uint64_t offset,
+                                uint64_t length,
+                                std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                                std::string& logname, 
+                                uint32_t chkpt_id) {
+  wait_async();
+  ChkptChain chain(chkpts, false);
+  auto hashlist_times = chain.restart_range(chkpt_id, offset, length, data);
+  restart_timers[0] = hashlist_times.first;
+  restart_timers[1] = hashlist_times.second;
+  std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                ".restart_timing.csv";
+  write_restart_log(chkpt_id, restart_logname);
+}
+
+/**
+ * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+ * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+ * are read.
+ *
+ * \param data       Data View to restart the range into, resized if shorter than the range
+ * \param offset     Byte offset of the range in the checkpointed data
+ * \param length     Length of the range in bytes
+ * \param filenames  Vector of prior incremental checkpoints stored in files
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+ListDeduplicator::restart_range(Kokkos::View<uint8_t*>& data, 
+                                uint64_t offset,
+                                uint64_t length,
+                                std::vector<std::string>& chkpt_filenames, 
+                                std::string& logname, 
+                                uint32_t chkpt_id) {
+  wait_async();
+  std::vector<std::string> hashlist_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    hashlist_chkpt_files.push_back(chkpt_filenames[i]+".hashlist.incr_chkpt");
+  }
+  ChkptChain chain(hashlist_chkpt_files, false);
+  auto hashlist_times = chain.restart_range(chkpt_id, offset, length, data);
+  restart_timers[0] = hashlist_times.first;
+  restart_timers[1] = hashlist_times.second;
+  write_restart_log(chkpt_id, logname);
+}
+
+/**
+ * Restart a multi-region checkpoint from vector of incremental checkpoints loaded on the
+ * Host. Each region is restarted in place through the chain.
+ *
+ * \param regions    Regions to restart into, in the order they were checkpointed
+ * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+ListDeduplicator::restart(std::vector<region_t>& regions, 
+                          std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                          std::string& logname, 
+                          uint32_t chkpt_id) {
+  wait_async();
+  ChkptChain chain(chkpts, false);
+  auto hashlist_times = chain.restart_regions(chkpt_id, regions);
+  restart_timers[0] = hashlist_times.first;
+  restart_timers[1] = hashlist_times.second;
+  std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                ".restart_timing.csv";
+  write_restart_log(chkpt_id, restart_logname);
+}
+
+/**
+ * Restart a multi-region checkpoint from checkpoint files. Each region is restarted in
+ * place through the chain.
+ *
+ * \param regions    Regions to restart into, in the order they were checkpointed
+ * \param filenames  Vector of prior incremental checkpoints stored in files
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+ListDeduplicator::restart(std::vector<region_t>& regions, 
+                          std::vector<std::string>& chkpt_filenames, 
+                          std::string& logname, 
+                          uint32_t chkpt_id) {
+  wait_async();
+  std::vector<std::string> hashlist_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    hashlist_chkpt_files.push_back(chkpt_filenames[i]+".hashlist.incr_chkpt");
+  }
+  ChkptChain chain(hashlist_chkpt_files, false);
+  auto hashlist_times = chain.restart_regions(chkpt_id, regions);
+  restart_timers[0] = hashlist_times.first;
+  restart_timers[1] = hashlist_times.second;
+  write_restart_log(chkpt_id, logname);
+}
+
 void 
 ListDeduplicator::write_chkpt_log(header_t& header, 
                                    Kokkos::View<uint8_t*>::HostMirror& diff_h, 
@@ -0,0 +1,108 @@
+#include "reference_set.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ReferenceSet::ReferenceSet(const std::vector<std::string>& reference_files) {
+  names = reference_files;
+  total_size = 0;
+  ok = true;
+  for(uint32_t i=0; i<names.size(); i++) {
+    uint8_t* map = NULL;
+    uint64_t size = 0;
+    int fd = open(names[i].c_str(), O_RDONLY);
+    struct stat st;
+    if((fd < 0) || (fstat(fd, &st) != 0)) {
+      printf("ERROR: Failed to open reference file %s\n", names[i].c_str());
+      ok = false;
+    } else {
+      size = static_cast<uint64_t>(st.st_size);
+      if(size > 0) {
+        void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(ptr == MAP_FAILED) {
+          printf("ERROR: Failed to map reference file %s\n", names[i].c_str());
+          ok = false;
+          size = 0;
+        } else {
+          map = static_cast<uint8_t*>(ptr);
+        }
+      }
+    }
+    if(fd >= 0)
+      close(fd);
+    maps.push_back(map);
+    sizes.push_back(size);
+    offsets.push_back(total_size);
+    total_size += size;
+  }
+}
+
+ReferenceSet::~ReferenceSet() {
+  for(uint32_t i=0; i<maps.size(); i++) {
+    if(maps[i] != NULL)
+      munmap(maps[i], sizes[i]);
+  }
+}
+
+void
+ReferenceSet::read(uint64_t offset, uint64_t len, uint8_t* dst) const {
+  uint64_t end = offset+len;
+  for(uint32_t i=0; i<maps.size() && offset<end; i++) {
+    uint64_t file_end = offsets[i]+sizes[i];
+    if(offset >= file_end)
+      continue;
+    uint64_t n = std::min(end, file_end) - offset;
+    memcpy(dst, maps[i]+(offset-offsets[i]), n);
+    dst += n;
+    offset += n;
+  }
+  if(offset < end)
+    memset(dst, 0, end-offset);
+}
+
+void
+read_reference_image(const ReferenceSet& refs, Kokkos::View<uint8_t*>& image_d) {
+  auto image_h = Kokkos::create_mirror_view(image_d);
+  refs.read(0, image_d.size(), image_h.data());
+  Kokkos::deep_copy(image_d, image_h);
+}
+
+void
+write_reference_chkpt(const header_t& header,
+                      const ReferenceSet& refs,
+                      Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  const std::vector<std::string>& names = refs.files();
+  const std::vector<uint64_t>& sizes = refs.file_sizes();
+  uint64_t chkpt_size = sizeof(header_t) + 8 + sizeof(uint32_t);
+  for(uint32_t i=0; i<names.size(); i++) {
+    chkpt_size += sizeof(uint64_t) + sizeof(uint32_t) + names[i].size();
+  }
+  Kokkos::resize(chkpt_h, chkpt_size);
+  uint8_t* pos = chkpt_h.data();
+  memcpy(pos, &header, sizeof(header_t));
+  pos += sizeof(header_t);
+  memcpy(pos, "DDREFSET", 8);
+  pos += 8;
+  uint32_t num_files = static_cast<uint32_t>(names.size());
+  memcpy(pos, &num_files, sizeof(uint32_t));
+  pos += sizeof(uint32_t);
+  for(uint32_t i=0; i<names.size(); i++) {
+    uint32_t name_len = static_cast<uint32_t>(names[i].size());
+    memcpy(pos, &sizes[i], sizeof(uint64_t));
+    pos += sizeof(uint64_t);
+    memcpy(pos, &name_len, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    memcpy(pos, names[i].data(), name_len);
+    pos += name_len;
+  }
+}
+
+bool
+maybe_reference_chkpt(const header_t& header) {
+  return (header.ref_id == header.chkpt_id) && (header.datalen > 0) &&
+         (header.num_first_ocur == 0) && (header.num_prior_chkpts == 0) &&
+         (header.num_shift_dupl == 0);
+}
@@ -12,10 +12,88 @@
 #include <chrono>
 #include <utility>
 #include <openssl/md5.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <memory>
+#include <cstring>
 //#include "utils.hpp"
 
 #define VERIFY_OUTPUT
 
+// Restart a checkpoint from the Host Views of a manifest or pack, or else from its files.
+// Files are read by the deduplicator, which reads only the checkpoints of the chain of
+// chkpt_id and reads each one ahead of the restart kernels that decode it.
+template<typename Deduplicator>
+void restart_chkpt(Deduplicator& deduplicator,
+                   Kokkos::View<uint8_t*> data,
+                   std::vector<Kokkos::View<uint8_t*>::HostMirror>* chkpts,
+                   std::vector<std::string>& chkpt_files,
+                   const writer_config_t& config,
+                   std::string& logname,
+                   uint32_t chunk_size,
+                   uint32_t chkpt_id) {
+  if(chkpts != NULL) {
+    deduplicator.restart(data, *chkpts, logname, chkpt_id);
+  } else {
+    // Logs of restarts from files are not named by the deduplicator
+    std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                  ".restart_timing.csv";
+    deduplicator.set_writer_config(config);
+    deduplicator.restart(data, chkpt_files, restart_logname, chkpt_id);
+  }
+}
+
+// Names of the checkpoint files without the extension that the deduplicators append
+std::vector<std::string> strip_extension(const std::vector<std::string>& files, const std::string& extension) {
+  std::vector<std::string> names;
+  for(uint32_t i=0; i<files.size(); i++) {
+    names.push_back(files[i].substr(0, files[i].size()-extension.size()));
+  }
+  return names;
+}
+
+// Optional flags
+//   --restart-to FILE    :  Write the restarted data to FILE instead of restarting it on
+//                           the device. The data is streamed through the Host in windows
+//                           (Basic, List, and Tree approaches)
+//   --memory-budget B    :  Host memory used for the windows with --restart-to
+//                           (default CHAIN_STREAM_BUFFER bytes)
+//   --writer threads|uring:  Write the --restart-to file with a pool of threads or with
+//                           io_uring instead of a single stream
+//   --direct-io          :  Bypass the page cache when writing the --restart-to file
+//   --io-depth N         :  Number of writes in flight (default 8)
+//   --io-block B         :  Size of each write in bytes (default 1MB)
+//   --pack FILE          :  Restart from the checkpoints appended to the pack file FILE.
+//                           The checkpoints are mapped from the pack and the file names
+//                           are only used to name the logs. A last checkpoint torn by a
+//                           crash is reported and ignored
+//   --writer striped     :  Read checkpoints in stripes on several threads. Checkpoints
+//                           split over several files are always read through their layout
+//   --stripe-threads N   :  Threads reading stripes (default 8)
+//   --stripe-size B      :  Size of each stripe read by a thread (default 4MB)
+//   --manifest FILE      :  Plan the restart from the chain manifest FILE. Only the
+//                           checkpoints needed by the restart are read, on
+//                           --stripe-threads threads, from the files and offsets in the
+//                           manifest and checked against their digests. Pass 0
+//                           checkpoints and no file names
+//   --plan-cache         :  With --manifest, cache the resolved restart in FILE.plan.ID.
+//                           Later restarts of the checkpoint copy the bytes of the
+//                           restarted data straight from the checkpoint files, without
+//                           reading headers or metadata, until the manifest changes
+//                           (Basic, List, and Tree approaches)
+//   --ring-dir DIR       :  Read each checkpoint from the ring directory of
+//                           dedup_chkpt_files --ring-dir if it is still there
+//   --flush-dir DIR      :  Read the checkpoints flushed to DIR by dedup_chkpt_files
+//                           --flush-dir when they are not in the ring directory
+//   --emulate-dir DIR    :  Emulate slower storage for the files in DIR
+//   --emulate-write-bw B :  Write bandwidth of the emulated storage in bytes per second
+//   --emulate-read-bw B  :  Read bandwidth of the emulated storage in bytes per second
+//   --emulate-latency US :  Microseconds added to every read and write of the emulated
+//                           storage
+//   --emulate-metadata US:  Microseconds of every open, create, and rename of the
+//                           emulated storage
+//   --emulate-concurrency N: Reads and writes the emulated storage serves at once
+
 int main(int argc, char** argv) {
   DEBUG_PRINT("Sanity check\n");
   Kokkos::initialize(argc, argv);
@@ -58,49 +136,186 @@ int main(int argc, char** argv) {
     for(uint32_t i=0; i<num_chkpts; i++) {
       hashtree_chkpt_files.push_back(chkpt_files[i]+".hashtree.incr_chkpt");
     }
+    // Checkpoints still in the ring directory or flushed elsewhere are read from the
+    // fastest tier that holds them
+    tier_config_t tier_config = get_tier_config(argc, argv);
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      full_chkpt_files[i] = TieredStore::locate(tier_config, full_chkpt_files[i]);
+      basic_chkpt_files[i] = TieredStore::locate(tier_config, basic_chkpt_files[i]);
+      hashlist_chkpt_files[i] = TieredStore::locate(tier_config, hashlist_chkpt_files[i]);
+      hashtree_chkpt_files[i] = TieredStore::locate(tier_config, hashtree_chkpt_files[i]);
+    }
     STDOUT_PRINT("Read checkpoint files\n");
     STDOUT_PRINT("Number of checkpoints: %u\n", num_chkpts);
 
+    writer_config_t writer_config = get_writer_config(argc, argv);
+    storage_model_t storage_model = get_storage_model(argc, argv);
+    set_storage_model(storage_model);
+    std::string restart_file;
+    std::string pack_file;
+    std::string manifest_file;
+    uint64_t memory_budget = CHAIN_STREAM_BUFFER;
+    bool plan_cache = false;
+    for(int i=0; i<argc; i++) {
+      if((strcmp(argv[i], "--restart-to") == 0) && (i+1 < argc)) {
+        restart_file = std::string(argv[i+1]);
+      } else if((strcmp(argv[i], "--memory-budget") == 0) && (i+1 < argc)) {
+        memory_budget = strtoull(argv[i+1], NULL, 0);
+      } else if((strcmp(argv[i], "--pack") == 0) && (i+1 < argc)) {
+        pack_file = std::string(argv[i+1]);
+      } else if((strcmp(argv[i], "--manifest") == 0) && (i+1 < argc)) {
+        manifest_file = std::string(argv[i+1]);
+      } else if(strcmp(argv[i], "--plan-cache") == 0) {
+        plan_cache = true;
+      }
+    }
+    // A chain partly replaced by an interrupted consolidation mixes old and new checkpoints
+    if(mode != Full) {
+      std::string extension = (mode == Basic) ? ".basic.incr_chkpt" : 
+                              (mode == List) ? ".hashlist.incr_chkpt" : ".hashtree.incr_chkpt";
+      for(uint32_t i=0; i<num_chkpts; i++) {
+        std::ifstream marker(chkpt_files[i] + extension + CONSOLIDATE_MARKER_EXT);
+        if(marker.is_open()) {
+          printf("ERROR: Consolidation of %s was interrupted, run consolidate_chkpt_files again to finish it\n",
+                 (chkpt_files[i] + extension).c_str());
+          restart_file.clear();
+          num_tests = 0;
+        }
+      }
+    }
+    // Checkpoints of a pack are mapped in place of reading their files
+    std::unique_ptr<ChkptPack> pack;
+    std::vector<Kokkos::View<uint8_t*>::HostMirror> pack_chkpts;
+    if(pack_file.size() > 0) {
+      pack.reset(new ChkptPack(pack_file, false));
+      // A checkpoint torn by a crash is not in the pack, restarts before it still work
+      uint32_t torn_id = 0;
+      if(pack->torn(torn_id))
+        printf("WARNING: Checkpoint %u of %s was torn and is ignored\n", torn_id, pack_file.c_str());
+      for(uint32_t i=0; i<num_chkpts; i++) {
+        pack_entry_t entry;
+        pack_chkpts.push_back(pack->find(i, entry) ? pack->view(i) : Kokkos::View<uint8_t*>::HostMirror());
+      }
+      pack_entry_t entry;
+      if(!pack->find(restart_id, entry)) {
+        printf("ERROR: %s has no checkpoint %u\n", pack_file.c_str(), restart_id);
+        restart_file.clear();
+        num_tests = 0;
+      }
+    }
+    // Checkpoints needed by the restart are found through the manifest and read in parallel
+    std::unique_ptr<ChainManifest> manifest;
+    std::vector<Kokkos::View<uint8_t*>::HostMirror> manifest_chkpts;
+    std::unique_ptr<RestartPlanCache> plans;
+    if(plan_cache && ((manifest_file.size() == 0) || (mode == Full))) {
+      printf("ERROR: --plan-cache needs --manifest and is not available for the Full approach\n");
+      plan_cache = false;
+    }
+    if(manifest_file.size() > 0) {
+      try {
+        manifest.reset(new ChainManifest(manifest_file));
+        // Checkpoints are only read when the restart has no cached plan
+        restart_plan_t plan;
+        if(plan_cache)
+          plans.reset(new RestartPlanCache(*manifest, manifest_file));
+        if(!plans || (restart_file.size() > 0) || !plans->find(restart_id, plan))
+          manifest_chkpts = manifest->read_plan(restart_id, writer_config, writer_config.stripe_threads);
+        num_chkpts = manifest->num_chkpts();
+        chkpt_files_trim.clear();
+        for(uint32_t i=0; i<num_chkpts; i++) {
+          manifest_entry_t entry;
+          std::string path = manifest->find(i, entry) ? entry.path : std::to_string(i);
+          chkpt_files_trim.push_back(path.substr(path.rfind('/') + 1));
+        }
+      } catch(const std::ios_base::failure& e) {
+        printf("ERROR: %s\n", e.what());
+        restart_file.clear();
+        num_tests = 0;
+      }
+    }
+    // Stream the restarted data to a file without holding it in memory
+    if(restart_file.size() > 0) {
+      if(mode == Full) {
+        printf("ERROR: --restart-to is not available for the Full approach\n");
+      } else {
+        std::vector<std::string>& incr_chkpt_files = (mode == Basic) ? basic_chkpt_files : 
+                                                     (mode == List) ? hashlist_chkpt_files : 
+                                                                      hashtree_chkpt_files;
+        bool tree_layout = mode != Basic && mode != List;
+        std::unique_ptr<ChkptChain> chain(manifest ? new ChkptChain(manifest_chkpts, tree_layout) : 
+                                          pack ? new ChkptChain(pack_chkpts, tree_layout) : 
+                                                 new ChkptChain(incr_chkpt_files, tree_layout));
+        chain->set_writer_config(writer_config);
+        uint64_t datalen = chain->metadata(restart_id).header.datalen;
+        uint64_t num_written = chain->restart_file(restart_id, restart_file, memory_budget);
+        printf("Restarted checkpoint %u to %s: %lu of %lu bytes, %lu bytes read\n", restart_id, 
+               restart_file.c_str(), num_written, datalen, chain->bytes_read());
+      }
+      num_tests = 0;
+    }
+
 
     uint32_t select_chkpt = restart_id;
 
     for(uint32_t j=0; j<num_tests; j++) {
+      // Restarts with a cached plan copy the restarted data without the restart kernels,
+      // the first restart of a checkpoint resolves the plan for the later ones
+      if(plans) {
+        restart_plan_t plan;
+        if(plans->find(select_chkpt, plan)) {
+          Kokkos::View<uint8_t*> reference_d("Reference View", plan.datalen);
+          std::pair<double,double> times = plans->restart(plan, writer_config, reference_d);
+          printf("Restarted checkpoint %u from its cached plan: %zu runs, %f seconds\n", select_chkpt,
+                 plan.runs.size(), times.second);
+#ifdef VERIFY_OUTPUT
+          auto reference_h = Kokkos::create_mirror_view(reference_d);
+          Kokkos::deep_copy(reference_h, reference_d);
+          std::string digest = calculate_digest_host(reference_h);
+          std::cout << "Cached plan digest:    " << digest << std::endl;
+#endif
+          continue;
+        }
+        ChkptChain chain(manifest_chkpts, mode != Basic && mode != List);
+        if(plans->resolve(chain, select_chkpt, plan)) {
+          printf("Cached the plan of checkpoint %u in %s\n", select_chkpt, plans->plan_file(select_chkpt).c_str());
+        } else {
+          printf("WARNING: Checkpoint %u reads a reference set and is not cached\n", select_chkpt);
+        }
+      }
       std::ifstream file;
       file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
       // Full checkpoint
-      file.open(chkpt_files[select_chkpt], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
-      size_t filesize = file.tellg();
-      file.seekg(0);
+      size_t filesize = 0;
+      if(manifest) {
+        manifest_entry_t entry;
+        manifest->find(select_chkpt, entry);
+        filesize = entry.datalen;
+      } else if(pack) {
+        // Data length from the header of the checkpoint, Full checkpoints are the data
+        header_t header;
+        memcpy(&header, pack_chkpts[select_chkpt].data(), sizeof(header_t));
+        filesize = (mode == Full) ? pack_chkpts[select_chkpt].size() : header.datalen;
+      } else {
+        file.open(chkpt_files[select_chkpt], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+        filesize = file.tellg();
+        file.seekg(0);
+        file.close();
+      }
       Kokkos::View<uint8_t*> reference_d("Reference View", filesize);
       Kokkos::deep_copy(reference_d, 0);
       auto reference_h = Kokkos::create_mirror_view(reference_d);
-      file.close();
 
+      // Views of the checkpoints if they were mapped from a pack or read through the manifest
+      std::vector<Kokkos::View<uint8_t*>::HostMirror>* chkpts = manifest ? &manifest_chkpts : 
+                                                                pack ? &pack_chkpts : NULL;
+      std::string logname = chkpt_files_trim[select_chkpt];
       if(mode == Full) {
         //====================================================================
         // Full checkpoint
         //====================================================================
-        std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts;
-//        std::vector<Kokkos::View<uint8_t*, Kokkos::DefaultHostExecutionSpace>> chkpts;
-        for(uint32_t i=0; i<num_chkpts; i++) {
-          std::fstream file;
-          auto fileflags = std::ifstream::in | std::ifstream::binary | std::ifstream::ate;
-          file.open(full_chkpt_files[i], fileflags);
-          size_t filesize = file.tellg();
-          file.seekg(0);
-//          Kokkos::View<uint8_t*, Kokkos::DefaultHostExecutionSpace> chkpt("Chkpt", filesize);
-          Kokkos::View<uint8_t*>::HostMirror chkpt("Chkpt", filesize);
-          Kokkos::deep_copy(chkpt, 0);
-          file.read((char*)(chkpt.data()), filesize);
-          file.close();
-          chkpts.push_back(chkpt);
-        }
-        std::string logname = chkpt_files_trim[select_chkpt];
-//        Deduplicator deduplicator(chunk_size);
-//        deduplicator.restart(Full, reference_d, chkpts, logname, select_chkpt);
         FullDeduplicator deduplicator(chunk_size);
-        deduplicator.restart(reference_d, chkpts, logname, select_chkpt);
+        restart_chkpt(deduplicator, reference_d, chkpts, full_chkpt_files, writer_config, logname, chunk_size, select_chkpt);
 #ifdef VERIFY_OUTPUT
         Kokkos::deep_copy(reference_h, reference_d);
         std::string digest = calculate_digest_host(reference_h);
@@ -110,26 +325,9 @@ int main(int argc, char** argv) {
         //====================================================================
         // Basic Incremental checkpoint 
         //====================================================================
-        std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts;
-        for(uint32_t i=0; i<num_chkpts; i++) {
-          std::fstream file;
-          auto fileflags = std::ifstream::in | std::ifstream::binary | std::ifstream::ate;
-          file.open(basic_chkpt_files[i], fileflags);
-          size_t filesize = file.tellg();
-          file.seekg(0);
-//          Kokkos::View<uint8_t*, Kokkos::DefaultHostExecutionSpace> chkpt("Chkpt", filesize);
-          Kokkos::View<uint8_t*>::HostMirror chkpt("Chkpt", filesize);
-          Kokkos::deep_copy(chkpt, 0);
-          file.read((char*)(chkpt.data()), filesize);
-          file.close();
-          chkpts.push_back(chkpt);
-        }
-
-        std::string logname = chkpt_files_trim[select_chkpt];
-//        Deduplicator deduplicator(chunk_size);
-//        deduplicator.restart(Basic, reference_d, chkpts, logname, select_chkpt);
+        std::vector<std::string> names = strip_extension(basic_chkpt_files, ".basic.incr_chkpt");
         BasicDeduplicator deduplicator(chunk_size);
-        deduplicator.restart(reference_d, chkpts, logname, select_chkpt);
+        restart_chkpt(deduplicator, reference_d, chkpts, names, writer_config, logname, chunk_size, select_chkpt);
 #ifdef VERIFY_OUTPUT
         Kokkos::deep_copy(reference_h, reference_d);
         std::string digest = calculate_digest_host(reference_h);
@@ -139,26 +337,9 @@ int main(int argc, char** argv) {
         //====================================================================
         // Incremental checkpoint (Hash list)
         //====================================================================
-        std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts;
-        for(uint32_t i=0; i<num_chkpts; i++) {
-          std::fstream file;
-          auto fileflags = std::ifstream::in | std::ifstream::binary | std::ifstream::ate;
-          file.open(hashlist_chkpt_files[i], fileflags);
-          size_t filesize = file.tellg();
-          file.seekg(0);
-//          Kokkos::View<uint8_t*, Kokkos::DefaultHostExecutionSpace> chkpt("Chkpt", filesize);
-          Kokkos::View<uint8_t*>::HostMirror chkpt("Chkpt", filesize);
-          Kokkos::deep_copy(chkpt, 0);
-          file.read((char*)(chkpt.data()), filesize);
-          file.close();
-          chkpts.push_back(chkpt);
-        }
-
-        std::string logname = chkpt_files_trim[select_chkpt];
-//        Deduplicator deduplicator(chunk_size);
-//        deduplicator.restart(List, reference_d, chkpts, logname, select_chkpt);
+        std::vector<std::string> names = strip_extension(hashlist_chkpt_files, ".hashlist.incr_chkpt");
         ListDeduplicator deduplicator(chunk_size);
-        deduplicator.restart(reference_d, chkpts, logname, select_chkpt);
+        restart_chkpt(deduplicator, reference_d, chkpts, names, writer_config, logname, chunk_size, select_chkpt);
 #ifdef VERIFY_OUTPUT
         Kokkos::deep_copy(reference_h, reference_d);
         std::string digest = calculate_digest_host(reference_h);
@@ -168,26 +349,9 @@ int main(int argc, char** argv) {
         //====================================================================
         // Incremental checkpoint (Hash tree)
         //====================================================================
-        std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts;
-        for(uint32_t i=0; i<num_chkpts; i++) {
-          std::fstream file;
-          auto fileflags = std::ifstream::in | std::ifstream::binary | std::ifstream::ate;
-          file.open(hashtree_chkpt_files[i], fileflags);
-          size_t filesize = file.tellg();
-          file.seekg(0);
-//          Kokkos::View<uint8_t*, Kokkos::DefaultHostExecutionSpace> chkpt("Chkpt", filesize);
-          Kokkos::View<uint8_t*>::HostMirror chkpt("Chkpt", filesize);
-          Kokkos::deep_copy(chkpt, 0);
-          file.read((char*)(chkpt.data()), filesize);
-          file.close();
-          chkpts.push_back(chkpt);
-        }
-
-        std::string logname = chkpt_files_trim[select_chkpt];
-//        Deduplicator deduplicator(chunk_size);
-//        deduplicator.restart(mode, reference_d, chkpts, logname, select_chkpt);
+        std::vector<std::string> names = strip_extension(hashtree_chkpt_files, ".hashtree.incr_chkpt");
         TreeDeduplicator deduplicator(chunk_size);
-        deduplicator.restart(reference_d, chkpts, logname, select_chkpt);
+        restart_chkpt(deduplicator, reference_d, chkpts, names, writer_config, logname, chunk_size, select_chkpt);
 #ifdef VERIFY_OUTPUT
         Kokkos::deep_copy(reference_h, reference_d);
         std::string digest = calculate_digest_host(reference_h);
@@ -196,6 +360,12 @@ int main(int argc, char** argv) {
       }
       STDOUT_PRINT("Restarted checkpoint\n");
     }
+    if(!storage_model.dir.empty()) {
+      storage_stats_t storage_stats = get_storage_stats();
+      printf("Emulated storage: %lu bytes written, %lu bytes read, %lu transfers, %lu metadata operations, %f seconds of delay\n",
+             storage_stats.bytes_written, storage_stats.bytes_read, storage_stats.num_transfers,
+             storage_stats.num_metadata_ops, storage_stats.delay);
+    }
   }
   Kokkos::finalize();
 }
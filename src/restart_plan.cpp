@@ -0,0 +1,257 @@
+#include "restart_plan.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <mutex>
+#include <sstream>
+#include <fcntl.h>
+#include "storage_emulator.hpp"
+#include "striped_io.hpp"
+
+RestartPlanCache::RestartPlanCache(const ChainManifest& chain_manifest, const std::string& manifest_file)
+    : manifest(chain_manifest) {
+  prefix = manifest_file + ".plan.";
+  hits = 0;
+  misses = 0;
+}
+
+std::string
+RestartPlanCache::plan_file(uint32_t chkpt_id) const {
+  return prefix + std::to_string(chkpt_id);
+}
+
+/**
+ * Check that the runs of a plan restart every byte once: they follow each other in the
+ * restarted data from offset 0 up to its length
+ */
+static bool
+covers(const restart_plan_t& plan) {
+  uint64_t end = 0;
+  for(uint64_t i=0; i<plan.runs.size(); i++) {
+    const ChunkRun& run = plan.runs[i];
+    if((run.dst != end) || (run.len > plan.datalen-end))
+      return false;
+    end += run.len;
+  }
+  return end == plan.datalen;
+}
+
+uint64_t
+RestartPlanCache::num_hits() const {
+  return hits;
+}
+
+uint64_t
+RestartPlanCache::num_misses() const {
+  return misses;
+}
+
+/**
+ * Check that a plan was resolved from the checkpoints currently in the manifest: the
+ * restart still needs the same checkpoints and none of them was recorded again.
+ */
+bool
+RestartPlanCache::valid(const restart_plan_t& plan) const {
+  manifest_entry_t entry;
+  if(!manifest.find(plan.chkpt_id, entry) || (entry.datalen != plan.datalen))
+    return false;
+  std::vector<uint32_t> needed;
+  try {
+    needed = manifest.restart_plan(plan.chkpt_id);
+  } catch(const std::ios_base::failure& e) {
+    return false;
+  }
+  if(needed.size() != plan.digests.size())
+    return false;
+  for(uint32_t i=0; i<needed.size(); i++) {
+    auto it = plan.digests.find(needed[i]);
+    if((it == plan.digests.end()) || !manifest.find(needed[i], entry) || (entry.digest.compare(it->second) != 0))
+      return false;
+  }
+  return true;
+}
+
+bool
+RestartPlanCache::find(uint32_t chkpt_id, restart_plan_t& plan) {
+  auto it = plans.find(chkpt_id);
+  if(it != plans.end() && valid(it->second)) {
+    plan = it->second;
+    hits += 1;
+    return true;
+  }
+  restart_plan_t loaded;
+  if(load(chkpt_id, loaded) && valid(loaded)) {
+    plans[chkpt_id] = loaded;
+    plan = loaded;
+    hits += 1;
+    return true;
+  }
+  plans.erase(chkpt_id);
+  misses += 1;
+  return false;
+}
+
+bool
+RestartPlanCache::resolve(ChkptChain& chain, uint32_t chkpt_id, restart_plan_t& plan) {
+  plan.chkpt_id = chkpt_id;
+  plan.datalen = chain.metadata(chkpt_id).header.datalen;
+  plan.digests.clear();
+  chain.resolve(chkpt_id, 0, plan.datalen, plan.runs);
+  if(!covers(plan))
+    throw std::ios_base::failure(std::string("Runs resolved for checkpoint ") + std::to_string(chkpt_id) +
+                                 " do not cover its data");
+  // Bytes of a reference set are not stored in the checkpoint files
+  for(uint64_t i=0; i<plan.runs.size(); i++) {
+    if(chain.reference(plan.runs[i].chkpt))
+      return false;
+  }
+  std::vector<uint32_t> needed = manifest.restart_plan(chkpt_id);
+  for(uint32_t i=0; i<needed.size(); i++) {
+    manifest_entry_t entry;
+    manifest.find(needed[i], entry);
+    plan.digests[needed[i]] = entry.digest;
+  }
+  plans[chkpt_id] = plan;
+  try {
+    save(plan);
+  } catch(const std::ios_base::failure& e) {
+    printf("WARNING: %s\n", e.what());
+  }
+  return true;
+}
+
+/**
+ * Read a plan file. Files that are missing, not a complete plan, or whose runs do not
+ * cover the data or reach past their checkpoint in the manifest are ignored.
+ */
+bool
+RestartPlanCache::load(uint32_t chkpt_id, restart_plan_t& plan) const {
+  std::ifstream in(plan_file(chkpt_id));
+  if(!in.is_open())
+    return false;
+  std::string magic;
+  uint32_t version = 0;
+  uint64_t num_digests = 0, num_runs = 0;
+  bool ok = (in >> magic >> version >> plan.chkpt_id >> plan.datalen >> num_digests >> num_runs) &&
+            (magic.compare(RESTART_PLAN_MAGIC) == 0) && (version == RESTART_PLAN_VERSION) &&
+            (plan.chkpt_id == chkpt_id);
+  plan.digests.clear();
+  for(uint64_t i=0; i<num_digests && ok; i++) {
+    uint32_t id = 0;
+    std::string digest;
+    ok = static_cast<bool>(in >> id >> digest);
+    plan.digests[id] = digest;
+  }
+  plan.runs.clear();
+  if(ok)
+    plan.runs.reserve(num_runs);
+  for(uint64_t i=0; i<num_runs && ok; i++) {
+    ChunkRun run;
+    manifest_entry_t entry;
+    ok = static_cast<bool>(in >> run.chkpt >> run.src >> run.dst >> run.len) &&
+         (plan.digests.find(run.chkpt) != plan.digests.end()) && manifest.find(run.chkpt, entry) &&
+         (run.len <= entry.length) && (run.src <= entry.length-run.len);
+    plan.runs.push_back(run);
+  }
+  return ok && covers(plan);
+}
+
+/**
+ * Write a plan to a temporary file renamed over the plan file, so a plan file is
+ * either complete or missing. Plans are not synced, a plan lost in a crash is
+ * resolved again.
+ */
+void
+RestartPlanCache::save(const restart_plan_t& plan) const {
+  std::ostringstream out;
+  out << RESTART_PLAN_MAGIC << " " << RESTART_PLAN_VERSION << " " << plan.chkpt_id << " " << plan.datalen
+      << " " << plan.digests.size() << " " << plan.runs.size() << "\n";
+  for(auto it=plan.digests.begin(); it!=plan.digests.end(); it++) {
+    out << it->first << " " << it->second << "\n";
+  }
+  for(uint64_t i=0; i<plan.runs.size(); i++) {
+    const ChunkRun& run = plan.runs[i];
+    out << run.chkpt << " " << run.src << " " << run.dst << " " << run.len << "\n";
+  }
+  std::string text = out.str();
+
+  std::string filename = plan_file(plan.chkpt_id);
+  std::string tmp_file = filename + ".tmp";
+  int fd = storage_open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    throw std::ios_base::failure(std::string("Failed to create ") + tmp_file + ": " + strerror(errno));
+  bool written = pwrite_all(fd, (const uint8_t*)(text.data()), text.size(), 0);
+  int error = errno;
+  storage_close(fd);
+  if(!written || (storage_rename(tmp_file, filename) != 0)) {
+    if(written)
+      error = errno;
+    std::remove(tmp_file.c_str());
+    throw std::ios_base::failure(std::string("Failed to write ") + filename + ": " + strerror(error));
+  }
+}
+
+std::pair<double,double>
+RestartPlanCache::restart(const restart_plan_t& plan,
+                          const writer_config_t& config,
+                          Kokkos::View<uint8_t*>& data) const {
+  using Timer = std::chrono::high_resolution_clock;
+  using Nanoseconds = std::chrono::nanoseconds;
+  Timer::time_point t0 = Timer::now();
+  if(data.size() < plan.datalen)
+    Kokkos::resize(data, plan.datalen);
+
+  // Each checkpoint is read with one request spanning all of its runs
+  std::map<uint32_t, std::vector<uint64_t>> chkpt_runs;
+  for(uint64_t i=0; i<plan.runs.size(); i++) {
+    chkpt_runs[plan.runs[i].chkpt].push_back(i);
+  }
+  std::vector<uint32_t> sources;
+  std::vector<manifest_entry_t> entries;
+  for(auto it=chkpt_runs.begin(); it!=chkpt_runs.end(); it++) {
+    manifest_entry_t entry;
+    if(!manifest.find(it->first, entry))
+      throw std::ios_base::failure(std::string("No checkpoint ") + std::to_string(it->first) + " in the manifest");
+    sources.push_back(it->first);
+    entries.push_back(entry);
+  }
+  Kokkos::View<uint8_t*>::HostMirror data_h("Restart buffer", plan.datalen);
+  std::mutex error_mutex;
+  std::string error;
+  parallel_items(sources.size(), config.stripe_threads, [&](uint64_t i) {
+    const std::vector<uint64_t>& runs = chkpt_runs.at(sources[i]);
+    uint64_t lo = UINT64_MAX, hi = 0;
+    for(uint64_t r=0; r<runs.size(); r++) {
+      lo = std::min(lo, plan.runs[runs[r]].src);
+      hi = std::max(hi, plan.runs[runs[r]].src+plan.runs[runs[r]].len);
+    }
+    std::vector<uint8_t> extent(hi-lo);
+    try {
+      read_striped(entries[i].path, entries[i].offset+lo, hi-lo, extent.data(), config);
+    } catch(const std::ios_base::failure& e) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      error = e.what();
+      return;
+    }
+    for(uint64_t r=0; r<runs.size(); r++) {
+      const ChunkRun& run = plan.runs[runs[r]];
+      memcpy(data_h.data()+run.dst, extent.data()+(run.src-lo), run.len);
+    }
+  });
+  if(error.size() > 0)
+    throw std::ios_base::failure(error);
+
+  // Copy data to the device
+  Timer::time_point c1 = Timer::now();
+  auto data_d = Kokkos::subview(data, std::make_pair(static_cast<uint64_t>(0), plan.datalen));
+  Kokkos::deep_copy(data_d, data_h);
+  Kokkos::fence();
+  Timer::time_point c2 = Timer::now();
+  double copy_time = (1e-9)*(std::chrono::duration_cast<Nanoseconds>(c2-c1).count());
+  double restart_time = (1e-9)*(std::chrono::duration_cast<Nanoseconds>(c2-t0).count());
+  return std::make_pair(copy_time, restart_time);
+}
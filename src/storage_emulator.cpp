@@ -0,0 +1,212 @@
+#include "storage_emulator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock EmulatorClock;
+
+// Process wide state of the emulated storage
+typedef struct emulator_state_t {
+  storage_model_t model;
+  std::string dir;                        // Absolute directory with a trailing slash
+  std::set<int> fds;                      // Descriptors of emulated files
+  EmulatorClock::time_point write_free;   // When the write bandwidth is next free
+  EmulatorClock::time_point read_free;    // When the read bandwidth is next free
+  EmulatorClock::time_point metadata_free;// When the metadata server is next free
+  uint32_t in_service;
+  storage_stats_t stats;
+  std::mutex mutex;
+  std::condition_variable slot_free;
+} emulator_state_t;
+
+static emulator_state_t&
+emulator() {
+  static emulator_state_t state;
+  return state;
+}
+
+static std::string
+absolute_path(const std::string& path) {
+  if(!path.empty() && path[0] == '/')
+    return path;
+  char cwd[PATH_MAX];
+  if(getcwd(cwd, sizeof(cwd)) == NULL)
+    return path;
+  return std::string(cwd) + "/" + path;
+}
+
+storage_model_t default_storage_model() {
+  storage_model_t model = {"", 0, 0, 0.0, 0.0, 0};
+  return model;
+}
+
+storage_model_t get_storage_model(int argc, char** argv) {
+  storage_model_t model = default_storage_model();
+  for(int i=0; i<argc; i++) {
+    if((strcmp(argv[i], "--emulate-dir") == 0) && (i+1 < argc)) {
+      model.dir = std::string(argv[i+1]);
+    } else if((strcmp(argv[i], "--emulate-write-bw") == 0) && (i+1 < argc)) {
+      model.write_bandwidth = strtoull(argv[i+1], NULL, 0);
+    } else if((strcmp(argv[i], "--emulate-read-bw") == 0) && (i+1 < argc)) {
+      model.read_bandwidth = strtoull(argv[i+1], NULL, 0);
+    } else if((strcmp(argv[i], "--emulate-latency") == 0) && (i+1 < argc)) {
+      model.latency = 1e-6*strtod(argv[i+1], NULL);
+    } else if((strcmp(argv[i], "--emulate-metadata") == 0) && (i+1 < argc)) {
+      model.metadata_cost = 1e-6*strtod(argv[i+1], NULL);
+    } else if((strcmp(argv[i], "--emulate-concurrency") == 0) && (i+1 < argc)) {
+      model.max_concurrency = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+    }
+  }
+  return model;
+}
+
+void set_storage_model(const storage_model_t& model) {
+  emulator_state_t& state = emulator();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.model = model;
+  state.dir.clear();
+  if(!model.dir.empty()) {
+    char resolved[PATH_MAX];
+    state.dir = (realpath(model.dir.c_str(), resolved) != NULL) ? std::string(resolved) :
+                                                                 absolute_path(model.dir);
+    if(state.dir[state.dir.size()-1] != '/')
+      state.dir += "/";
+  }
+  state.fds.clear();
+  EmulatorClock::time_point now = EmulatorClock::now();
+  state.write_free = now;
+  state.read_free = now;
+  state.metadata_free = now;
+  state.in_service = 0;
+  state.stats = {0, 0, 0, 0, 0.0};
+}
+
+storage_stats_t get_storage_stats() {
+  emulator_state_t& state = emulator();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.stats;
+}
+
+bool storage_emulated(const std::string& path) {
+  emulator_state_t& state = emulator();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if(state.dir.empty())
+    return false;
+  return absolute_path(path).compare(0, state.dir.size(), state.dir) == 0;
+}
+
+/**
+ * Hold the caller back until an emulated read or write of len bytes would finish. The
+ * transfer waits for a free slot, takes its turn on the shared bandwidth, and finishes
+ * after its share of the bandwidth plus the latency.
+ */
+static void
+emulate_transfer(uint64_t len, bool write) {
+  emulator_state_t& state = emulator();
+  EmulatorClock::time_point now = EmulatorClock::now();
+  EmulatorClock::time_point done;
+  {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if(state.model.max_concurrency > 0) {
+      state.slot_free.wait(lock, [&state]() {
+        return state.in_service < state.model.max_concurrency;
+      });
+    }
+    state.in_service += 1;
+    uint64_t bandwidth = write ? state.model.write_bandwidth : state.model.read_bandwidth;
+    EmulatorClock::time_point& link_free = write ? state.write_free : state.read_free;
+    EmulatorClock::time_point start = std::max(EmulatorClock::now(), link_free);
+    std::chrono::duration<double> transfer(bandwidth > 0 ? static_cast<double>(len)/bandwidth : 0.0);
+    link_free = start + std::chrono::duration_cast<EmulatorClock::duration>(transfer);
+    done = link_free + std::chrono::duration_cast<EmulatorClock::duration>(
+                         std::chrono::duration<double>(state.model.latency));
+    if(write) {
+      state.stats.bytes_written += len;
+    } else {
+      state.stats.bytes_read += len;
+    }
+    state.stats.num_transfers += 1;
+  }
+  std::this_thread::sleep_until(done);
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.in_service -= 1;
+  state.stats.delay += std::chrono::duration<double>(EmulatorClock::now() - now).count();
+  state.slot_free.notify_one();
+}
+
+// Hold the caller back until the metadata server has served one more request
+static void
+emulate_metadata() {
+  emulator_state_t& state = emulator();
+  EmulatorClock::time_point now = EmulatorClock::now();
+  EmulatorClock::time_point done;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    EmulatorClock::time_point start = std::max(now, state.metadata_free);
+    state.metadata_free = start + std::chrono::duration_cast<EmulatorClock::duration>(
+                                    std::chrono::duration<double>(state.model.metadata_cost));
+    done = state.metadata_free;
+    state.stats.num_metadata_ops += 1;
+  }
+  std::this_thread::sleep_until(done);
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.stats.delay += std::chrono::duration<double>(EmulatorClock::now() - now).count();
+}
+
+int storage_open(const std::string& path, int flags, mode_t mode) {
+  bool emulated = storage_emulated(path);
+  if(emulated)
+    emulate_metadata();
+  int fd = open(path.c_str(), flags, mode);
+  if(emulated && (fd >= 0)) {
+    emulator_state_t& state = emulator();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.fds.insert(fd);
+  }
+  return fd;
+}
+
+int storage_close(int fd) {
+  {
+    emulator_state_t& state = emulator();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.fds.erase(fd);
+  }
+  return close(fd);
+}
+
+int storage_rename(const std::string& from, const std::string& to) {
+  if(storage_emulated(from) || storage_emulated(to))
+    emulate_metadata();
+  return std::rename(from.c_str(), to.c_str());
+}
+
+void storage_metadata(const std::string& path) {
+  if(storage_emulated(path))
+    emulate_metadata();
+}
+
+void storage_transfer(const std::string& path, uint64_t len, bool write) {
+  if(storage_emulated(path))
+    emulate_transfer(len, write);
+}
+
+bool storage_fd_emulated(int fd) {
+  emulator_state_t& state = emulator();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.fds.find(fd) != state.fds.end();
+}
+
+void storage_transfer_fd(int fd, uint64_t len, bool write) {
+  if(storage_fd_emulated(fd))
+    emulate_transfer(len, write);
+}
@@ -0,0 +1,193 @@
+#include "striped_io.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "storage_emulator.hpp"
+
+uint64_t
+write_striped(const std::string& filename,
+              const uint8_t* data,
+              uint64_t len,
+              const writer_config_t& config,
+              bool split_files) {
+  remove_stripes(filename);
+  uint64_t stripe_size = std::max(config.stripe_size, static_cast<uint64_t>(1));
+  uint64_t num_stripes = (len+stripe_size-1)/stripe_size;
+  uint64_t num_files = 1;
+  if(split_files) {
+    num_files = std::max(static_cast<uint64_t>(config.stripe_files),
+                         static_cast<uint64_t>(config.stripe_dirs.size()+1));
+    num_files = std::max(std::min(num_files, num_stripes), static_cast<uint64_t>(1));
+  }
+
+  // Extra files go to the directory of the checkpoint and the stripe directories in turn
+  std::string dir(".");
+  std::string base = filename;
+  size_t slash = filename.rfind('/');
+  if(slash != std::string::npos) {
+    dir = filename.substr(0, slash);
+    base = filename.substr(slash+1);
+  }
+  std::vector<std::string> targets(1, dir);
+  targets.insert(targets.end(), config.stripe_dirs.begin(), config.stripe_dirs.end());
+  std::vector<std::string> files(1, filename);
+  for(uint64_t i=1; i<num_files; i++) {
+    files.push_back(targets[i % targets.size()] + "/" + base + ".stripe" + std::to_string(i));
+  }
+
+  std::vector<int> fds(num_files, -1);
+  int error = 0;
+  for(uint64_t i=0; i<num_files && error == 0; i++) {
+    fds[i] = storage_open(files[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fds[i] < 0) {
+      error = errno;
+      continue;
+    }
+    // Size each file up front so concurrent writes do not keep extending it
+    uint64_t file_len = (num_stripes/num_files)*stripe_size;
+    if(i < num_stripes % num_files)
+      file_len += stripe_size;
+    if((len % stripe_size != 0) && ((num_stripes-1) % num_files == i))
+      file_len -= stripe_size - len % stripe_size;
+    if(ftruncate(fds[i], static_cast<off_t>(file_len)) != 0)
+      error = errno;
+  }
+
+  std::atomic<int> write_error(error);
+  if(error == 0) {
+    parallel_items(num_stripes, config.stripe_threads, [&](uint64_t stripe) {
+      uint64_t offset = stripe*stripe_size;
+      uint64_t n = std::min(stripe_size, len-offset);
+      uint64_t file_offset = (stripe/num_files)*stripe_size;
+      if(!pwrite_all(fds[stripe % num_files], data+offset, n, file_offset)) {
+        int expected = 0;
+        write_error.compare_exchange_strong(expected, errno);
+      }
+    });
+  }
+  error = write_error.load();
+  for(uint64_t i=0; i<num_files; i++) {
+    if((fds[i] >= 0) && (storage_close(fds[i]) != 0) && (error == 0))
+      error = errno;
+  }
+  if(error != 0)
+    throw std::ios_base::failure(std::string("Failed to write ") + filename + ": " + strerror(error));
+
+  // The layout is written last so a partially written checkpoint is never read as split
+  if(num_files > 1) {
+    storage_metadata(filename + STRIPE_LAYOUT_EXT);
+    std::ofstream layout;
+    layout.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    layout.open(filename + STRIPE_LAYOUT_EXT, std::ofstream::out | std::ofstream::trunc);
+    layout << stripe_size << " " << len << " " << num_files << "\n";
+    for(uint64_t i=0; i<num_files; i++) {
+      layout << files[i] << "\n";
+    }
+    layout.close();
+  }
+  return len;
+}
+
+bool
+read_stripe_layout(const std::string& filename, stripe_layout_t& layout) {
+  std::ifstream in(filename + STRIPE_LAYOUT_EXT);
+  uint64_t num_files = 0;
+  if(in.is_open() && (in >> layout.stripe_size >> layout.total_len >> num_files) &&
+     (layout.stripe_size > 0)) {
+    layout.files.clear();
+    std::string file;
+    std::getline(in, file);
+    while((layout.files.size() < num_files) && std::getline(in, file)) {
+      layout.files.push_back(file);
+    }
+    if(layout.files.size() == num_files)
+      return true;
+    printf("ERROR: Incomplete stripe layout %s%s\n", filename.c_str(), STRIPE_LAYOUT_EXT);
+    return false;
+  }
+  struct stat st;
+  if(stat(filename.c_str(), &st) != 0)
+    return false;
+  layout.total_len = static_cast<uint64_t>(st.st_size);
+  layout.stripe_size = std::max(layout.total_len, static_cast<uint64_t>(1));
+  layout.files.assign(1, filename);
+  return true;
+}
+
+uint64_t
+striped_size(const std::string& filename) {
+  stripe_layout_t layout;
+  if(!read_stripe_layout(filename, layout))
+    return 0;
+  return layout.total_len;
+}
+
+void
+read_striped(const std::string& filename,
+             uint64_t offset,
+             uint64_t len,
+             uint8_t* dst,
+             const writer_config_t& config) {
+  if(len == 0)
+    return;
+  stripe_layout_t layout;
+  if(!read_stripe_layout(filename, layout))
+    throw std::ios_base::failure(std::string("Failed to find ") + filename);
+  if(offset+len > layout.total_len)
+    throw std::ios_base::failure(std::string("Read past the end of ") + filename);
+  uint64_t num_files = layout.files.size();
+  std::vector<int> fds(num_files, -1);
+  int error = 0;
+  for(uint64_t i=0; i<num_files && error == 0; i++) {
+    fds[i] = storage_open(layout.files[i], O_RDONLY);
+    if(fds[i] < 0)
+      error = errno;
+  }
+
+  // Pieces never cross a stripe of a split checkpoint
+  uint64_t piece_size = (num_files > 1) ? layout.stripe_size :
+                                          std::max(config.stripe_size, static_cast<uint64_t>(1));
+  uint64_t first_piece = offset/piece_size;
+  uint64_t num_pieces = (offset+len+piece_size-1)/piece_size - first_piece;
+  uint32_t num_threads = (config.backend == WriterStriped) ? config.stripe_threads : 1;
+  std::atomic<int> read_error(error);
+  if(error == 0) {
+    parallel_items(num_pieces, num_threads, [&](uint64_t piece) {
+      uint64_t start = std::max(offset, (first_piece+piece)*piece_size);
+      uint64_t end = std::min(offset+len, (first_piece+piece+1)*piece_size);
+      uint64_t stripe = start/layout.stripe_size;
+      uint64_t file_offset = (stripe/num_files)*layout.stripe_size + start%layout.stripe_size;
+      if(!pread_all(fds[stripe % num_files], dst+start-offset, end-start, file_offset)) {
+        int expected = 0;
+        read_error.compare_exchange_strong(expected, errno);
+      }
+    });
+  }
+  for(uint64_t i=0; i<num_files; i++) {
+    if(fds[i] >= 0)
+      storage_close(fds[i]);
+  }
+  error = read_error.load();
+  if(error != 0)
+    throw std::ios_base::failure(std::string("Failed to read ") + filename + ": " + strerror(error));
+}
+
+void
+remove_stripes(const std::string& filename) {
+  std::string layout_file = filename + STRIPE_LAYOUT_EXT;
+  struct stat st;
+  if(stat(layout_file.c_str(), &st) != 0)
+    return;
+  stripe_layout_t layout;
+  if(read_stripe_layout(filename, layout)) {
+    for(uint64_t i=1; i<layout.files.size(); i++) {
+      std::remove(layout.files[i].c_str());
+    }
+  }
+  std::remove(layout_file.c_str());
+}
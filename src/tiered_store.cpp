@@ -0,0 +1,297 @@
+#include "tiered_store.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <ios>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "chkpt_writer.hpp"
+#include "striped_io.hpp"
+#include "storage_emulator.hpp"
+
+// Size of each throttled write of the flush
+#define FLUSH_BLOCK (1024*1024)
+
+tier_config_t default_tier_config() {
+  tier_config_t config = {0, "", "", 0};
+  return config;
+}
+
+tier_config_t get_tier_config(int argc, char** argv) {
+  tier_config_t config = default_tier_config();
+  for(int i=0; i<argc; i++) {
+    if((strcmp(argv[i], "--ring") == 0) && (i+1 < argc)) {
+      config.capacity = static_cast<uint32_t>(strtoul(argv[i+1], NULL, 0));
+    } else if((strcmp(argv[i], "--ring-dir") == 0) && (i+1 < argc)) {
+      config.fast_dir = std::string(argv[i+1]);
+    } else if((strcmp(argv[i], "--flush-dir") == 0) && (i+1 < argc)) {
+      config.slow_dir = std::string(argv[i+1]);
+    } else if((strcmp(argv[i], "--flush-bandwidth") == 0) && (i+1 < argc)) {
+      config.flush_bandwidth = strtoull(argv[i+1], NULL, 0);
+    }
+  }
+  return config;
+}
+
+static std::string
+base_name(const std::string& name) {
+  size_t slash = name.rfind('/');
+  return (slash == std::string::npos) ? name : name.substr(slash+1);
+}
+
+static std::string
+fast_path(const tier_config_t& config, const std::string& name) {
+  return config.fast_dir + "/" + base_name(name);
+}
+
+static std::string
+slow_path(const tier_config_t& config, const std::string& name) {
+  return config.slow_dir.empty() ? name : config.slow_dir + "/" + base_name(name);
+}
+
+static bool
+file_exists(const std::string& filename) {
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0;
+}
+
+/**
+ * Write a checkpoint under a temporary name and rename it, so the file is never seen
+ * partially written. Writes are spread out to at most bandwidth bytes per second.
+ */
+static void
+write_file(const std::string& filename, const uint8_t* data, uint64_t len, uint64_t bandwidth) {
+  using Timer = std::chrono::steady_clock;
+  std::string tmp_file = filename + ".flush";
+  int fd = storage_open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    throw std::ios_base::failure(std::string("Failed to create ") + tmp_file + ": " + strerror(errno));
+  Timer::time_point start = Timer::now();
+  bool written = true;
+  for(uint64_t offset=0; offset<len && written; offset+=FLUSH_BLOCK) {
+    uint64_t n = std::min(static_cast<uint64_t>(FLUSH_BLOCK), len-offset);
+    written = pwrite_all(fd, data+offset, n, offset);
+    if(bandwidth > 0) {
+      std::chrono::duration<double> target(static_cast<double>(offset+n)/bandwidth);
+      std::chrono::duration<double> elapsed = Timer::now() - start;
+      if(target > elapsed)
+        std::this_thread::sleep_for(target - elapsed);
+    }
+  }
+  int error = errno;
+  if((storage_close(fd) != 0) && written) {
+    written = false;
+    error = errno;
+  }
+  if(written && (storage_rename(tmp_file, filename) != 0)) {
+    written = false;
+    error = errno;
+  }
+  if(!written) {
+    std::remove(tmp_file.c_str());
+    throw std::ios_base::failure(std::string("Failed to write ") + filename + ": " + strerror(error));
+  }
+}
+
+TieredStore::TieredStore(const tier_config_t& tier_config) {
+  config = tier_config;
+  config.capacity = std::max(config.capacity, 1u);
+  manifest = NULL;
+  commits = NULL;
+  stop = false;
+  num_flushed_bytes = 0;
+  stall_seconds = 0.0;
+  flusher = std::thread(&TieredStore::flush_loop, this);
+}
+
+TieredStore::~TieredStore() {
+  try {
+    drain();
+  } catch(const std::exception& e) {
+    printf("ERROR: %s\n", e.what());
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  changed.notify_all();
+  flusher.join();
+}
+
+void
+TieredStore::set_manifest(ChainManifest* chain_manifest) {
+  std::lock_guard<std::mutex> lock(mutex);
+  manifest = chain_manifest;
+}
+
+void
+TieredStore::set_group_commit(GroupCommit* group_commit) {
+  std::lock_guard<std::mutex> lock(mutex);
+  commits = group_commit;
+}
+
+void
+TieredStore::put(uint32_t chkpt_id, const std::string& name,
+                 const Kokkos::View<uint8_t*>::HostMirror& chkpt, bool incremental) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    raise_flush_error();
+  }
+  if(!config.fast_dir.empty())
+    write_file(fast_path(config, name), chkpt.data(), chkpt.size(), 0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  // The oldest checkpoint leaves the ring once it is safe in the slow tier
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  changed.wait(lock, [this]() {
+    return (ring.size() < config.capacity) || ring.front().flushed || flush_error;
+  });
+  std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+  stall_seconds += waited.count();
+  raise_flush_error();
+  while((ring.size() >= config.capacity) && ring.front().flushed) {
+    if(!config.fast_dir.empty() && (base_name(ring.front().name).compare(base_name(name)) != 0))
+      std::remove(fast_path(config, ring.front().name).c_str());
+    ring.pop_front();
+  }
+  slot_t slot = {chkpt_id, name, chkpt, incremental, false};
+  ring.push_back(slot);
+  changed.notify_all();
+}
+
+bool
+TieredStore::get(uint32_t chkpt_id, Kokkos::View<uint8_t*>::HostMirror& chkpt) {
+  std::string path;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto it=ring.begin(); it!=ring.end(); it++) {
+      if(it->chkpt_id != chkpt_id)
+        continue;
+      if(it->chkpt.data() != NULL) {
+        chkpt = it->chkpt;
+        return true;
+      }
+      path = fast_path(config, it->name);
+    }
+    auto flushed = slow_paths.find(chkpt_id);
+    if(path.empty() && (flushed != slow_paths.end()))
+      path = flushed->second;
+  }
+  if(path.empty() || !file_exists(path))
+    return false;
+  uint64_t len = striped_size(path);
+  chkpt = Kokkos::View<uint8_t*>::HostMirror("Chkpt", len);
+  read_striped(path, 0, len, chkpt.data(), default_writer_config());
+  return true;
+}
+
+void
+TieredStore::drain() {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this]() {
+    return ring.empty() || ring.back().flushed || flush_error;
+  });
+  raise_flush_error();
+}
+
+uint64_t
+TieredStore::bytes_flushed() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return num_flushed_bytes;
+}
+
+double
+TieredStore::stall_time() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stall_seconds;
+}
+
+std::string
+TieredStore::locate(const tier_config_t& config, const std::string& name) {
+  if(!config.fast_dir.empty() && file_exists(fast_path(config, name)))
+    return fast_path(config, name);
+  if(file_exists(slow_path(config, name)))
+    return slow_path(config, name);
+  return name;
+}
+
+void
+TieredStore::flush_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true) {
+    // Checkpoints are flushed in order, so the unflushed ones are at the back
+    auto next = std::find_if(ring.begin(), ring.end(), [](const slot_t& slot) {
+      return !slot.flushed;
+    });
+    // A failed flush is retried once put or drain has reported it
+    if((next == ring.end()) || flush_error) {
+      if(stop)
+        break;
+      changed.wait(lock);
+      continue;
+    }
+    slot_t slot = *next;
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      flush(slot);
+    } catch(...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if(error) {
+      flush_error = error;
+      changed.notify_all();
+      continue;
+    }
+    // Slots are only removed once flushed, so the checkpoint is still in the ring
+    for(auto it=ring.begin(); it!=ring.end(); it++) {
+      if(it->chkpt_id == slot.chkpt_id && !it->flushed) {
+        it->flushed = true;
+        // Checkpoints in a fast directory are read back from there
+        if(!config.fast_dir.empty())
+          it->chkpt = Kokkos::View<uint8_t*>::HostMirror();
+        break;
+      }
+    }
+    slow_paths[slot.chkpt_id] = slow_path(config, slot.name);
+    num_flushed_bytes += slot.chkpt.size();
+    changed.notify_all();
+  }
+}
+
+void
+TieredStore::flush(const slot_t& slot) {
+  std::string path = slow_path(config, slot.name);
+  write_file(path, slot.chkpt.data(), slot.chkpt.size(), config.flush_bandwidth);
+  ChainManifest* chain_manifest = NULL;
+  GroupCommit* group_commit = NULL;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    chain_manifest = manifest;
+    group_commit = commits;
+  }
+  if(group_commit != NULL)
+    group_commit->written(path);
+  if(chain_manifest != NULL)
+    chain_manifest->record(slot.chkpt_id, slot.chkpt.data(), slot.chkpt.size(), path, 0, slot.incremental);
+}
+
+/**
+ * Throw the error of a failed flush once, with the mutex held. The flush thread then
+ * retries the checkpoint, which stays in the ring until it is flushed.
+ */
+void
+TieredStore::raise_flush_error() {
+  if(!flush_error)
+    return;
+  std::exception_ptr error = flush_error;
+  flush_error = nullptr;
+  changed.notify_all();
+  std::rethrow_exception(error);
+}
@@ -13,6 +13,11 @@ TreeDeduplicator::~TreeDeduplicator() {}
 void 
 TreeDeduplicator::dedup_data_baseline(const uint8_t* data_ptr, 
                                       const size_t data_size) {
+  dedup_data_baseline(RegionMap(data_ptr, data_size));
+}
+
+void 
+TreeDeduplicator::dedup_data_baseline(const RegionMap& regions) {
   // Get number of chunks and nodes
   num_chunks = (tree.tree_h.extent(0)+1)/2;
   num_nodes = tree.tree_h.extent(0);
@@ -65,14 +70,14 @@ TreeDeduplicator::dedup_data_baseline(const uint8_t* data_ptr,
       auto region_counters_sa = region_counters_sv.access();
 #endif
       uint32_t num_bytes = chunk_size;
-      uint64_t offset = static_cast<uint64_t>(leaf-num_chunks+1)*static_cast<uint64_t>(chunk_size);
-      if(leaf == num_nodes-1) // Calculate how much data to hash
-        num_bytes = data_size-offset;
+      const uint8_t* chunk_ptr = regions.chunk_ptr(leaf-num_chunks+1, chunk_size, num_bytes);
       // Hash chunk
       HashDigest digest;
-      hash(data_ptr+offset, num_bytes, digest.digest);
+      hash(chunk_ptr, num_bytes, digest.digest);
       // Insert into table
       auto result = first_ocur_d.insert(digest, NodeID(leaf, current_id)); 
+      if(result.success())
+        first_ocur_filter.insert(digest);
       if(digests_same(digest, tree(leaf))) { // Fixed duplicate chunk
         labels(leaf) = FIXED_DUPL;
       } else if(result.success()) { // First occurrence chunk
@@ -129,7 +134,8 @@ TreeDeduplicator::dedup_data_baseline(const uint8_t* data_ptr,
         if(labels(child_l) == FIRST_OCUR && labels(child_r) == FIRST_OCUR) {
           labels(node) = FIRST_OCUR;
           hash((uint8_t*)&tree(child_l), 2*sizeof(HashDigest), tree(node).digest);
-          first_ocur_d.insert(tree(node), NodeID(node, current_id));
+          if(first_ocur_d.insert(tree(node), NodeID(node, current_id)).success())
+            first_ocur_filter.insert(tree(node));
         }
         if(node == 0 && labels(0) == FIRST_OCUR) {
           first_ocur_vec.push(node);
@@ -199,7 +205,7 @@ TreeDeduplicator::dedup_data_baseline(const uint8_t* data_ptr,
         } else if(labels(child_l) == FIXED_DUPL) { // Children are both fixed duplicates
           labels(node) = FIXED_DUPL;
         } else if(labels(child_l) == SHIFT_DUPL) { // Children are both shifted duplicates
-          if(first_ocur_d.exists(tree(node))) { // This node is also a shifted duplicate
+          if(match_first_ocur(tree(node))) { // This node is also a shifted duplicate
             labels(node) = SHIFT_DUPL;
           } else { // Node is not a shifted duplicate. Save child trees
             labels(node) = DONE; // Add children to tree root maps
@@ -219,7 +225,8 @@ TreeDeduplicator::dedup_data_baseline(const uint8_t* data_ptr,
       if(node < num_chunks-1) {
         uint32_t child_l = 2*node+1;
         hash((uint8_t*)&tree(child_l), 2*sizeof(HashDigest), tree(node).digest);
-        first_ocur_d.insert(tree(node), NodeID(node, current_id));
+        if(first_ocur_d.insert(tree(node), NodeID(node, current_id)).success())
+          first_ocur_filter.insert(tree(node));
       }
     });
     level_beg = (level_beg-1)/2;
@@ -261,6 +268,11 @@ TreeDeduplicator::dedup_data_baseline(const uint8_t* data_ptr,
 void 
 TreeDeduplicator::dedup_data(const uint8_t* data_ptr, 
                              const size_t data_size) {
+  dedup_data(RegionMap(data_ptr, data_size));
+}
+
+void 
+TreeDeduplicator::dedup_data(const RegionMap& regions) {
   // Get number of chunks and nodes
   std::string setup_label = std::string("Deduplicate Checkpoint ") + std::to_string(current_id) + std::string(": Setup");
   Kokkos::Profiling::pushRegion(setup_label);
@@ -315,37 +327,41 @@ TreeDeduplicator::dedup_data(const uint8_t* data_ptr,
     uint64_t leaf = num_chunks-1+i*team_member.team_size()+j;
     if(leaf < num_nodes) {
       uint32_t num_bytes = chunk_size;
-      uint64_t offset = static_cast<uint64_t>(leaf-(num_chunks-1))*static_cast<uint64_t>(chunk_size);
-      if(leaf == num_nodes-1) // Calculate how much data to hash
-        num_bytes = data_size-offset;
+      const uint8_t* chunk_ptr = regions.chunk_ptr(leaf-(num_chunks-1), chunk_size, num_bytes);
       // Hash chunk
       HashDigest digest;
-      hash(data_ptr+offset, num_bytes, digest.digest);
-      // Insert into table
-      auto result = first_ocur_d.insert(digest, NodeID(leaf, current_id)); 
+      hash(chunk_ptr, num_bytes, digest.digest);
       if(digests_same(digest, tree(leaf))) { // Fixed duplicate chunk
+        // Not inserted since the chunk is not stored in this checkpoint. The digest is
+        // already in the table unless its entry was evicted.
         labels(leaf) = FIXED_DUPL;
 #ifdef STATS
       chunk_counters_sa(labels(leaf)) += 1;
 #endif
-      } else if(result.success()) { // First occurrence chunk
-        labels(leaf) = FIRST_OCUR;
-        tree(leaf) = digest;
+      } else {
+        // Insert into table
+        auto result = first_ocur_d.insert(digest, NodeID(leaf, current_id)); 
+        if(result.success())
+          first_ocur_filter.insert(digest);
+        if(result.success()) { // First occurrence chunk
+          labels(leaf) = FIRST_OCUR;
+          tree(leaf) = digest;
 #ifdef STATS
       chunk_counters_sa(labels(leaf)) += 1;
 #endif
-      } else if(result.existing()) { // Shifted duplicate chunk
-        auto& info = first_ocur_d.value_at(result.index());
-        if(info.tree == current_id) {
-          Kokkos::atomic_min(&info.node, leaf);
-          labels(leaf) = FIRST_OCUR;
-        } else {
-          labels(leaf) = SHIFT_DUPL;
+        } else if(result.existing()) { // Shifted duplicate chunk
+          auto& info = first_ocur_d.value_at(result.index());
+          if(info.tree == current_id) {
+            Kokkos::atomic_min(&info.node, leaf);
+            labels(leaf) = FIRST_OCUR;
+          } else {
+            labels(leaf) = SHIFT_DUPL;
 #ifdef STATS
       chunk_counters_sa(labels(leaf)) += 1;
 #endif
+          }
+          tree(leaf) = digest;
         }
-        tree(leaf) = digest;
       }
     }
   });
@@ -387,7 +403,8 @@ TreeDeduplicator::dedup_data(const uint8_t* data_ptr,
         if(labels(child_l) == FIRST_OCUR && labels(child_r) == FIRST_OCUR) {
           labels(node) = FIRST_OCUR;
           hash((uint8_t*)&tree(child_l), 2*sizeof(HashDigest), tree(node).digest);
-          first_ocur_d.insert(tree(node), NodeID(node, current_id));
+          if(first_ocur_d.insert(tree(node), NodeID(node, current_id)).success())
+            first_ocur_filter.insert(tree(node));
         }
         if(node == 0 && labels(0) == FIRST_OCUR) { // Handle case where all chunks are new
           first_ocur_vec.push(node);
@@ -457,7 +474,7 @@ TreeDeduplicator::dedup_data(const uint8_t* data_ptr,
           labels(node) = FIXED_DUPL;
         } else if(labels(child_l) == SHIFT_DUPL) { // Children are both shifted duplicates
           hash((uint8_t*)&tree(child_l), 2*sizeof(HashDigest), tree(node).digest);
-          if(first_ocur_d.exists(tree(node))) { // This node is also a shifted duplicate
+          if(match_first_ocur(tree(node))) { // This node is also a shifted duplicate
             labels(node) = SHIFT_DUPL;
           } else { // Node is not a shifted duplicate. Save child trees
             labels(node) = DONE; // Add children to tree root maps
@@ -508,11 +525,165 @@ TreeDeduplicator::dedup_data(const uint8_t* data_ptr,
   return;
 }
 
+/**
+ * Set the data length, number of chunks, and number of nodes for the next checkpoint.
+ * Allocate a new tree and first occurrence map for baselines and grow them as needed
+ * otherwise. First occurrences that can no longer be referenced under the index policy
+ * are evicted and the map is compacted before it grows.
+ *
+ * \param data_size     Length of data to deduplicate
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void
+TreeDeduplicator::setup_dedup(const size_t data_size, bool make_baseline) {
+  // Set important values
+  data_len = data_size;
+  num_chunks = data_len/chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
+    num_chunks += 1;
+  num_nodes = 2*num_chunks-1;
+
+  // Allocate or resize necessary variables for each approach
+  if(make_baseline) {
+    tree = MerkleTree(num_chunks);
+    first_ocur_d = DigestNodeIDDeviceMap(num_nodes);
+    first_ocur_vec = Vector<uint32_t>(num_chunks);
+    shift_dupl_vec = Vector<uint32_t>(num_chunks);
+  }
+  first_ocur_vec.clear();
+  shift_dupl_vec.clear();
+  std::string resize_tree_label = std::string("Deduplication chkpt ") + 
+                                  std::to_string(current_id) + 
+                                  std::string(": Setup: Resize Tree");
+  Kokkos::Profiling::pushRegion(resize_tree_label.c_str());
+  if(tree.tree_d.size() < num_nodes) {
+    Kokkos::resize(tree.tree_d, num_nodes);
+    Kokkos::resize(tree.tree_h, num_nodes);
+  }
+  Kokkos::Profiling::popRegion();
+  std::string resize_map_label = std::string("Deduplication chkpt ") + 
+                                 std::to_string(current_id) + 
+                                 std::string(": Setup: Resize First Ocur Map");
+  Kokkos::Profiling::pushRegion(resize_map_label.c_str());
+  index_evicted = 0;
+  if(!make_baseline) {
+    uint32_t min_chkpt = index_min_reachable();
+    uint32_t unmatched_chkpt = (index_policy.drop_unmatched && (current_id > 0)) ? current_id-1 : 0;
+    if((min_chkpt > baseline_id) || (unmatched_chkpt > baseline_id)) {
+      KeepFirstOcur keep = {min_chkpt, unmatched_chkpt, num_chunks-1};
+      index_evicted = compact_entries(first_ocur_d, keep, num_nodes);
+    }
+  }
+  reserve_entries(first_ocur_d, first_ocur_d.size()+num_nodes);
+  setup_filter(make_baseline);
+  Kokkos::Profiling::popRegion();
+  std::string resize_updates_label = std::string("Deduplication chkpt ") + 
+                                     std::to_string(current_id) + 
+                                     std::string(": Setup: Resize Update Map");
+  Kokkos::Profiling::pushRegion(resize_updates_label.c_str());
+  Kokkos::Profiling::popRegion();
+  std::string clear_updates_label = std::string("Deduplication chkpt ") + 
+                                    std::to_string(current_id) + 
+                                    std::string(": Setup: Clear Update Map");
+  Kokkos::Profiling::pushRegion(clear_updates_label.c_str());
+  Kokkos::Profiling::popRegion();
+}
+
+/**
+ * Size the digest filter for the entries of the first occurrence map plus the nodes of
+ * the next checkpoint. The filter is rebuilt from the map when it is too small or when
+ * entries were evicted, since Bloom filters cannot remove digests.
+ *
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void
+TreeDeduplicator::setup_filter(bool make_baseline) {
+  if(filter_bits == 0) {
+    first_ocur_filter = DigestFilter();
+    return;
+  }
+  uint64_t num_entries = static_cast<uint64_t>(first_ocur_d.size())+num_nodes;
+  if(make_baseline || (index_evicted > 0) || (first_ocur_filter.capacity() < num_entries)) {
+    // Leave room for the next few checkpoints before rebuilding again
+    first_ocur_filter = DigestFilter(2*num_entries, filter_bits);
+    if(!make_baseline) {
+      DigestFilter filter = first_ocur_filter;
+      DigestNodeIDDeviceMap map = first_ocur_d;
+      Kokkos::parallel_for("Rebuild digest filter", Kokkos::RangePolicy<>(0, map_num_slots(map)), 
+                           KOKKOS_LAMBDA(const uint32_t i) {
+        if(map.valid_at(i))
+          filter.insert(map.key_at(i));
+      });
+    }
+  }
+  if(!filter_counters.is_allocated())
+    filter_counters = Kokkos::View<uint64_t[3]>("Digest filter counters");
+  Kokkos::deep_copy(filter_counters, 0);
+}
+
+/**
+ * Count the metadata and chunks of the incremental checkpoint identified by the
+ * deduplication without writing it. Fills in the header exactly as collect_diff would.
+ *
+ * \param data_size Length of data in bytes
+ * \param header    The checkpoint header
+ *
+ * \return Pair containing the number of bytes of data and of header and metadata
+ */
+std::pair<uint64_t,uint64_t> 
+TreeDeduplicator::count_diff(const size_t data_size, 
+                             header_t& header) {
+  uint32_t num_chunks = data_size/chunk_size;
+  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_size) {
+    num_chunks += 1;
+  }
+  uint32_t num_nodes = 2*num_chunks-1;
+
+  // Each first occurrence region contributes every leaf below it
+  uint64_t num_first_ocur_chunks = 0;
+  Kokkos::parallel_reduce("Count first ocur chunks", Kokkos::RangePolicy<>(0, first_ocur_vec.size()), 
+  KOKKOS_CLASS_LAMBDA(const uint32_t i, uint64_t& sum) {
+    sum += num_leaf_descendents(first_ocur_vec(i), num_nodes);
+  }, num_first_ocur_chunks);
+
+  // Small bitset to record which checkpoints are necessary for restart
+  Kokkos::Bitset<Kokkos::DefaultExecutionSpace> chkpts_needed(current_id+1);
+  chkpts_needed.reset();
+  Kokkos::parallel_for("Count prior chkpts", Kokkos::RangePolicy<>(0, shift_dupl_vec.size()), 
+                       KOKKOS_CLASS_LAMBDA(const uint32_t i) {
+    NodeID prev = first_ocur_d.value_at(first_ocur_d.find(tree(shift_dupl_vec(i))));
+    chkpts_needed.set(prev.tree);
+  });
+  Kokkos::fence();
+
+  header.ref_id = baseline_id;
+  header.chkpt_id = current_id;
+  header.datalen = data_size;
+  header.chunk_size = chunk_size;
+  header.num_first_ocur = first_ocur_vec.size();
+  header.num_shift_dupl = shift_dupl_vec.size();
+  header.num_prior_chkpts = chkpts_needed.count();
+  uint64_t size_data = num_first_ocur_chunks*static_cast<uint64_t>(chunk_size);
+  uint64_t size_metadata = sizeof(header_t) + 
+                           static_cast<uint64_t>(header.num_first_ocur)*sizeof(uint32_t) + 
+                           static_cast<uint64_t>(header.num_prior_chkpts)*2*sizeof(uint32_t) + 
+                           static_cast<uint64_t>(header.num_shift_dupl)*2*sizeof(uint32_t);
+  return std::make_pair(size_data, size_metadata);
+}
+
 std::pair<uint64_t,uint64_t> 
 TreeDeduplicator::collect_diff( const uint8_t* data_ptr, 
                                 const size_t data_size,
                                 Kokkos::View<uint8_t*>& buffer_d, 
                                 header_t& header) {
+  return collect_diff(RegionMap(data_ptr, data_size), buffer_d, header);
+}
+
+std::pair<uint64_t,uint64_t> 
+TreeDeduplicator::collect_diff( const RegionMap& regions,
+                                Kokkos::View<uint8_t*>& buffer_d, 
+                                header_t& header) {
+  size_t data_size = regions.len;
   std::string setup_label = std::string("Checkpoint ") + std::to_string(current_id) + std::string(": Gather: Setup");
   Kokkos::Profiling::pushRegion(setup_label);
 
@@ -620,7 +791,7 @@ TreeDeduplicator::collect_diff( const uint8_t* data_ptr,
   Kokkos::Profiling::pushRegion(alloc_buffer_label);
   Kokkos::deep_copy(chunk_counter_h, chunk_counter_d);
   uint64_t buffer_len = sizeof(header_t)+first_ocur_vec.size()*sizeof(uint32_t)+2*sizeof(uint32_t)*static_cast<uint64_t>(chkpts_needed.count())+shift_dupl_vec.size()*2*sizeof(uint32_t)+chunk_counter_h(0)*static_cast<uint64_t>(chunk_size);
-  Kokkos::resize(buffer_d, buffer_len);
+  alloc_diff_buffer(buffer_d, buffer_len);
 
   Kokkos::deep_copy(counter_d, sizeof(uint32_t)*num_distinct);
 
@@ -639,13 +810,9 @@ TreeDeduplicator::collect_diff( const uint8_t* data_ptr,
     uint32_t chunk = region_leaves(i);
     uint32_t writesize = chunk_size;
     uint64_t dst_offset = sizeof(header_t)+data_offset+static_cast<uint64_t>(i)*static_cast<uint64_t>(chunk_size);
-    uint64_t src_offset = static_cast<uint64_t>(chunk)*static_cast<uint64_t>(chunk_size);
-    if(chunk == num_chunks-1) {
-      writesize = data_size-src_offset;
-    }
 
     uint8_t* dst = (uint8_t*)(buffer_d.data()+dst_offset);
-    uint8_t* src = (uint8_t*)(data_ptr+src_offset);
+    uint8_t* src = (uint8_t*)(regions.chunk_ptr(chunk, chunk_size, writesize));
     team_memcpy(dst, src, writesize, team_member);
   });
 
@@ -983,9 +1150,9 @@ DEBUG_PRINT("Start: %u, end: %u\n", chkpt_idx-1, ref_id);
       first_ocur_subview = Kokkos::subview(chkpt_buffer_d, std::make_pair(first_ocur_offset, dupl_count_offset));
       dupl_count_subview = Kokkos::subview(chkpt_buffer_d, std::make_pair(dupl_count_offset, dupl_map_offset));
       shift_dupl_subview = Kokkos::subview(chkpt_buffer_d, std::make_pair(dupl_map_offset, data_offset));
-      data_subview       = Kokkos::subview(chkpt_buffer_d, std::make_pair(data_offset, size));
+      data_subview       = Kokkos::subview(chkpt_buffer_d, std::make_pair(data_offset, chkpt_size));
       STDOUT_PRINT("Checkpoint %u\n", chkpt_header.chkpt_id);
-      STDOUT_PRINT("Checkpoint size: %lu\n", size);
+      STDOUT_PRINT("Checkpoint size: %lu\n", chkpt_size);
       STDOUT_PRINT("First ocur offset: %lu\n", sizeof(header_t));
       STDOUT_PRINT("Dupl count offset: %lu\n", dupl_count_offset);
       STDOUT_PRINT("Dupl map offset: %lu\n", dupl_map_offset);
@@ -1134,12 +1301,14 @@ TreeDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   // Read main incremental checkpoint header
   std::ifstream file;
   file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  storage_metadata(chkpt_files[file_idx]);
   file.open(chkpt_files[file_idx], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
   size_t filesize = file.tellg();
   file.seekg(0);
 
   header_t header;
   file.read((char*)&header, sizeof(header_t));
+  storage_transfer(chkpt_files[file_idx], sizeof(header_t), false);
   file.close();
   STDOUT_PRINT("Ref ID: %u\n",               header.ref_id);
   STDOUT_PRINT("Chkpt ID: %u\n",             header.chkpt_id);
@@ -1149,24 +1318,15 @@ TreeDeduplicator::restart_chkpt( std::vector<std::string>& chkpt_files,
   STDOUT_PRINT("Num prior chkpts: %u\n",      header.num_prior_chkpts);
   STDOUT_PRINT("Num shift dupl: %u\n",        header.num_shift_dupl);
 
-  std::vector<Kokkos::View<uint8_t*>> chkpts_d;
-  std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts_h;
-  for(uint32_t i=0; i<chkpt_files.size(); i++) {
-    file.open(chkpt_files[i], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
-    size_t filesize = file.tellg();
-    file.seekg(0);
-    Kokkos::View<uint8_t*> chkpt_d("Checkpoint", filesize);
-    auto chkpt_h = Kokkos::create_mirror_view(chkpt_d);;
-    file.read((char*)(chkpt_h.data()), filesize);
-    file.close();
-    chkpts_d.push_back(chkpt_d);
-    chkpts_h.push_back(chkpt_h);
+  // Checkpoints are read ahead on several threads while newer ones are restarted
+  std::vector<uint32_t> order;
+  for(int idx=static_cast<int>(file_idx); idx>=static_cast<int>(header.ref_id); idx--) {
+    order.push_back(static_cast<uint32_t>(idx));
   }
+  ChkptPrefetcher prefetch(chkpt_files, order, writer_config);
 
   Kokkos::View<uint8_t*> buffer_d("Buffer", filesize);
   Kokkos::deep_copy(buffer_d, 0);
-  auto buffer_h = Kokkos::create_mirror_view(buffer_d);
-  Kokkos::deep_copy(buffer_h, 0);
 
   uint32_t num_chunks = header.datalen / header.chunk_size;
   if(num_chunks*header.chunk_size < header.datalen) {
@@ -1184,12 +1344,9 @@ Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(file_idx)+":Read chec
     std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
     std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
     Kokkos::resize(buffer_d, filesize);
-    Kokkos::resize(buffer_h, filesize);
-    file.open(chkpt_files[file_idx], std::ifstream::in | std::ifstream::binary);
-    file.read((char*)(buffer_h.data()), filesize);
-    file.close();
+    auto buffer_h = prefetch.get(file_idx);
     std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-    STDOUT_PRINT("Time spent reading checkpoint %u from file: %f\n", file_idx, (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count()));
+    STDOUT_PRINT("Time spent waiting for checkpoint %u to be read: %f\n", file_idx, (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count()));
     Kokkos::fence();
 Kokkos::Profiling::popRegion();
 Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(file_idx)+" Setup");
@@ -1197,6 +1354,7 @@ Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(file_idx)+" Setup");
     Kokkos::deep_copy(buffer_d, buffer_h);
     Kokkos::fence();
     std::chrono::high_resolution_clock::time_point c2 = std::chrono::high_resolution_clock::now();
+    prefetch.release(file_idx);
     Kokkos::View<NodeID*> node_list("List of NodeIDs", num_chunks);
     Kokkos::deep_copy(node_list, NodeID());
     uint32_t ref_id = header.ref_id;
@@ -1324,7 +1482,6 @@ Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(file_idx)+" Restart r
           tree = j;
         }
       }
-      size_t offset = distinct_map.value_at(distinct_map.find(NodeID(prev, tree)));
       uint32_t node_start = leftmost_leaf(node, num_nodes);
       uint32_t prev_start = leftmost_leaf(prev, num_nodes);
       uint32_t len = num_leaf_descendents(prev, num_nodes);
@@ -1333,6 +1490,7 @@ Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(file_idx)+" Restart r
       }
       if(tree == cur_id) {
 Kokkos::atomic_add(&total_region_size(0), len);
+        size_t offset = distinct_map.value_at(distinct_map.find(NodeID(prev, tree)));
         uint32_t copysize = chunk_size*len;
         if(node_start+len-1 == num_nodes-1)
           copysize = data.size() - chunk_size*(node_start-num_chunks+1);
@@ -1360,17 +1518,12 @@ Kokkos::Profiling::popRegion();
       Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(idx)+":Read checkpoint");
       DEBUG_PRINT("Processing checkpoint %u\n", idx);
       t1 = std::chrono::high_resolution_clock::now();
-      file.open(chkpt_files[idx], std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
-      size_t chkpt_size = file.tellg();
-      file.seekg(0);
+      auto chkpt_buffer_h = prefetch.get(idx);
+      size_t chkpt_size = chkpt_buffer_h.size();
       auto chkpt_buffer_d = buffer_d;
-      auto chkpt_buffer_h = buffer_h;
       Kokkos::resize(chkpt_buffer_d, chkpt_size);
-      Kokkos::resize(chkpt_buffer_h, chkpt_size);
-      file.read((char*)(chkpt_buffer_h.data()), chkpt_size);
-      file.close();
       t2 = std::chrono::high_resolution_clock::now();
-      STDOUT_PRINT("Time spent reading checkpoint %d from file: %f\n", idx, (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count()));
+      STDOUT_PRINT("Time spent waiting for checkpoint %d to be read: %f\n", idx, (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count()));
       Kokkos::Profiling::popRegion();
       Kokkos::Profiling::pushRegion("Checkpoint "+std::to_string(idx)+" Setup");
       header_t chkpt_header;
@@ -1379,6 +1532,7 @@ Kokkos::Profiling::popRegion();
       datalen = chkpt_header.datalen;
       chunk_size = chkpt_header.chunk_size;
       Kokkos::deep_copy(chkpt_buffer_d, chkpt_buffer_h);
+      prefetch.release(idx);
       ref_id = chkpt_header.ref_id;
       cur_id = chkpt_header.chkpt_id;
       datalen = chkpt_header.datalen;
@@ -1402,9 +1556,9 @@ Kokkos::Profiling::popRegion();
       first_ocur_subview = Kokkos::subview(chkpt_buffer_d, std::make_pair(first_ocur_offset, dupl_count_offset));
       dupl_count_subview = Kokkos::subview(chkpt_buffer_d, std::make_pair(dupl_count_offset, dupl_map_offset));
       shift_dupl_subview = Kokkos::subview(chkpt_buffer_d, std::make_pair(dupl_map_offset, data_offset));
-      data_subview  = Kokkos::subview(chkpt_buffer_d, std::make_pair(data_offset, filesize));
+      data_subview  = Kokkos::subview(chkpt_buffer_d, std::make_pair(data_offset, chkpt_size));
       STDOUT_PRINT("Checkpoint %u\n", chkpt_header.chkpt_id);
-      STDOUT_PRINT("Checkpoint size: %lu\n", filesize);
+      STDOUT_PRINT("Checkpoint size: %lu\n", chkpt_size);
       STDOUT_PRINT("First ocur offset: %lu\n", sizeof(header_t));
       STDOUT_PRINT("Dupl count offset: %lu\n", dupl_count_offset);
       STDOUT_PRINT("Dupl map offset: %lu\n", dupl_map_offset);
@@ -1554,6 +1708,7 @@ Kokkos::atomic_add(&base_identical_counter(0), 1);
     Kokkos::fence();
 Kokkos::Profiling::popRegion();
 Kokkos::Profiling::popRegion();
+    STDOUT_PRINT("Time spent waiting for checkpoint reads: %f\n", prefetch.wait_time());
     std::chrono::high_resolution_clock::time_point c3 = std::chrono::high_resolution_clock::now();
     double copy_time = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(c2-c1).count());
     double restart_time = (1e-9)*(std::chrono::duration_cast<std::chrono::nanoseconds>(c3-t0).count());
@@ -1580,6 +1735,15 @@ TreeDeduplicator::checkpoint(header_t& header,
                              size_t data_size,
                              Kokkos::View<uint8_t*>::HostMirror& diff_h, 
                              bool make_baseline) {
+  checkpoint(header, RegionMap(data_ptr, data_size), diff_h, make_baseline);
+}
+
+void 
+TreeDeduplicator::checkpoint(header_t& header, 
+                             const RegionMap& regions, 
+                             Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                             bool make_baseline) {
+  size_t data_size = regions.len;
   using Timer = std::chrono::high_resolution_clock;
   using Duration = std::chrono::duration<double>;
   // ==========================================================================================
@@ -1590,48 +1754,11 @@ TreeDeduplicator::checkpoint(header_t& header,
                                   std::to_string(current_id) + std::string(": Setup");
   Kokkos::Profiling::pushRegion(setup_region_name.c_str());
 
-  // Set important values
-  data_len = data_size;
-  num_chunks = data_len/chunk_size;
-  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
-    num_chunks += 1;
-  num_nodes = 2*num_chunks-1;
+  // Start a new chain if requested or if the current chain is too long or too large
+  make_baseline = apply_baseline_policy(make_baseline, first_ocur_d.size());
 
-  // Allocate or resize necessary variables for each approach
-  if(make_baseline) {
-    tree = MerkleTree(num_chunks);
-    first_ocur_d = DigestNodeIDDeviceMap(num_nodes);
-    first_ocur_vec = Vector<uint32_t>(num_chunks);
-    shift_dupl_vec = Vector<uint32_t>(num_chunks);
-  }
-  first_ocur_vec.clear();
-  shift_dupl_vec.clear();
-  std::string resize_tree_label = std::string("Deduplication chkpt ") + 
-                                  std::to_string(current_id) + 
-                                  std::string(": Setup: Resize Tree");
-  Kokkos::Profiling::pushRegion(resize_tree_label.c_str());
-  if(tree.tree_d.size() < num_nodes) {
-    Kokkos::resize(tree.tree_d, num_nodes);
-    Kokkos::resize(tree.tree_h, num_nodes);
-  }
-  Kokkos::Profiling::popRegion();
-  std::string resize_map_label = std::string("Deduplication chkpt ") + 
-                                 std::to_string(current_id) + 
-                                 std::string(": Setup: Resize First Ocur Map");
-  Kokkos::Profiling::pushRegion(resize_map_label.c_str());
-  if(first_ocur_d.capacity() < first_ocur_d.size()+num_nodes)
-    first_ocur_d.rehash(first_ocur_d.size()+num_nodes);
-  Kokkos::Profiling::popRegion();
-  std::string resize_updates_label = std::string("Deduplication chkpt ") + 
-                                     std::to_string(current_id) + 
-                                     std::string(": Setup: Resize Update Map");
-  Kokkos::Profiling::pushRegion(resize_updates_label.c_str());
-  Kokkos::Profiling::popRegion();
-  std::string clear_updates_label = std::string("Deduplication chkpt ") + 
-                                    std::to_string(current_id) + 
-                                    std::string(": Setup: Clear Update Map");
-  Kokkos::Profiling::pushRegion(clear_updates_label.c_str());
-  Kokkos::Profiling::popRegion();
+  // Set important values and allocate or resize necessary variables
+  setup_dedup(data_size, make_baseline);
   Kokkos::Profiling::popRegion();
 
   std::string dedup_region_name = std::string("Deduplication chkpt ") + 
@@ -1645,11 +1772,11 @@ TreeDeduplicator::checkpoint(header_t& header,
     baseline_id = current_id;
   }
   if((current_id == 0) || make_baseline) {
-    dedup_data_baseline(data_ptr, data_size);
+    dedup_data_baseline(regions);
     baseline_id = current_id;
   } else {
     // Use the lowest offset to determine which node is the first occurrence
-    dedup_data(data_ptr, data_size);
+    dedup_data(regions);
   }
 
   Kokkos::Profiling::popRegion();
@@ -1665,7 +1792,7 @@ TreeDeduplicator::checkpoint(header_t& header,
   Timer::time_point start_collect = Timer::now();
   Kokkos::Profiling::pushRegion(collect_region_name.c_str());
 
-  datasizes = collect_diff(data_ptr, data_size, diff, header);
+  datasizes = collect_diff(regions, diff, header);
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_collect = Timer::now();
@@ -1675,13 +1802,19 @@ TreeDeduplicator::checkpoint(header_t& header,
   // Copy diff to host 
   // ==========================================================================================
   Timer::time_point start_write = Timer::now();
-  Kokkos::resize(diff_h, diff.size());
   std::string write_region_name = std::string("Copy diff to host ") 
                                   + std::to_string(current_id);
   Kokkos::Profiling::pushRegion(write_region_name.c_str());
 
-  Kokkos::deep_copy(diff_h, diff);
-  memcpy(diff_h.data(), &header, sizeof(header_t));
+  diff_to_host(diff, diff_h, header);
+  update_chain(make_baseline, diff_h.size());
+  record_index_stats(first_ocur_d.size(), first_ocur_d.capacity(), map_memory_bytes(first_ocur_d));
+  if(first_ocur_filter.enabled()) {
+    auto filter_counters_h = Kokkos::create_mirror_view(filter_counters);
+    Kokkos::deep_copy(filter_counters_h, filter_counters);
+    record_filter_stats(filter_counters_h(0), filter_counters_h(1), filter_counters_h(2), 
+                        first_ocur_filter.memory_bytes());
+  }
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_write = Timer::now();
@@ -1711,15 +1844,14 @@ TreeDeduplicator::checkpoint(uint8_t* data_ptr,
   Kokkos::View<uint8_t*, Kokkos::MemoryTraits<Kokkos::Unmanaged> > data(data_ptr, len);
   Kokkos::View<uint8_t*>::HostMirror diff_h;
   header_t header;
+  ChkptSink out(filename, writer_config);
+  sink = &out;
   checkpoint(header, data_ptr, len, diff_h, make_baseline);
+  sink = NULL;
   write_chkpt_log(header, diff_h, logname);
-  // Write checkpoint to file
-  std::ofstream file;
-  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-  file.open(filename, std::ofstream::out | std::ofstream::binary);
-  file.write((const char*)(diff_h.data()), diff_h.size());
-  file.flush();
-  file.close();
+  // Write checkpoint to file unless it was gathered into the file
+  out.write(diff_h);
+  finish_file(filename, diff_h, true);
   current_id += 1;
 }
 
@@ -1775,6 +1907,223 @@ TreeDeduplicator::checkpoint(uint8_t* data_ptr,
   current_id += 1;
 }
 
+/**
+ * Checkpoint several device buffers as one logical checkpoint. Chunks are hashed and
+ * copied in place and identical chunks or subtrees in different regions are deduplicated.
+ * Save checkpoint to host view.
+ *
+ * \param regions       Regions to checkpoint, in order
+ * \param diff_h        Host View to store incremental checkpoint
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void 
+TreeDeduplicator::checkpoint(std::vector<region_t>& regions, 
+                             Kokkos::View<uint8_t*>::HostMirror& diff_h, 
+                             bool make_baseline) {
+  header_t header;
+  checkpoint(header, RegionMap(regions, chunk_size), diff_h, make_baseline);
+  current_id += 1;
+}
+
+/**
+ * Checkpoint several device buffers as one logical checkpoint and save it to a file.
+ *
+ * \param regions       Regions to checkpoint, in order
+ * \param filename      Filename to save checkpoint
+ * \param logname       Base filename for logs
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ */
+void 
+TreeDeduplicator::checkpoint(std::vector<region_t>& regions, 
+                             std::string& filename, 
+                             std::string& logname, 
+                             bool make_baseline) {
+  Kokkos::View<uint8_t*>::HostMirror diff_h;
+  header_t header;
+  ChkptSink out(filename, writer_config);
+  sink = &out;
+  checkpoint(header, RegionMap(regions, chunk_size), diff_h, make_baseline);
+  sink = NULL;
+  write_chkpt_log(header, diff_h, logname);
+  // Write checkpoint to file unless it was gathered into the file
+  out.write(diff_h);
+  finish_file(filename, diff_h, true);
+  current_id += 1;
+}
+
+/**
+ * Dry run of a checkpoint. Deduplicates the data against copies of the tree and first
+ * occurrence map and counts the resulting metadata without gathering chunks or copying
+ * the checkpoint to the Host. The state used by the next checkpoint is left unchanged.
+ *
+ * \param data_ptr      Raw data pointer that needs to be deduplicated
+ * \param len           Length of data
+ * \param make_baseline Flag determining whether to make a baseline checkpoint
+ *
+ * \return Predicted header, data and metadata sizes, and restart read volume
+ */
+chkpt_plan_t 
+TreeDeduplicator::plan(uint8_t* data_ptr, 
+                       size_t len, 
+                       bool make_baseline) {
+  chkpt_plan_t plan;
+  baseline_event_t event;
+  plan.make_baseline = check_baseline_policy(make_baseline, first_ocur_d.size(), event);
+
+  // Keep the current state so that the dry run does not affect the next checkpoint.
+  // Baselines allocate new structures, otherwise deduplicate against copies.
+  MerkleTree saved_tree = tree;
+  DigestNodeIDDeviceMap saved_first_ocur_d = first_ocur_d;
+  DigestFilter saved_first_ocur_filter = first_ocur_filter;
+  Vector<uint32_t> saved_first_ocur_vec = first_ocur_vec;
+  Vector<uint32_t> saved_shift_dupl_vec = shift_dupl_vec;
+  uint32_t saved_baseline_id = baseline_id;
+  uint64_t saved_data_len = data_len;
+  uint32_t saved_num_chunks = num_chunks;
+  uint32_t saved_num_nodes = num_nodes;
+  if(!plan.make_baseline) {
+    tree = MerkleTree((saved_tree.tree_d.size()+1)/2);
+    Kokkos::deep_copy(tree.tree_d, saved_tree.tree_d);
+    first_ocur_d = DigestNodeIDDeviceMap(saved_first_ocur_d.capacity());
+    Kokkos::deep_copy(first_ocur_d, saved_first_ocur_d);
+    first_ocur_filter = saved_first_ocur_filter.clone();
+    first_ocur_vec = Vector<uint32_t>(saved_first_ocur_vec.capacity());
+    shift_dupl_vec = Vector<uint32_t>(saved_shift_dupl_vec.capacity());
+  }
+
+  setup_dedup(len, plan.make_baseline);
+  if(plan.make_baseline) {
+    baseline_id = current_id;
+    dedup_data_baseline(data_ptr, len);
+  } else {
+    dedup_data(data_ptr, len);
+  }
+  std::pair<uint64_t,uint64_t> sizes = count_diff(len, plan.header);
+  plan.data_bytes = sizes.first;
+  plan.metadata_bytes = sizes.second;
+  estimate_restart(plan);
+
+  tree = saved_tree;
+  first_ocur_d = saved_first_ocur_d;
+  first_ocur_filter = saved_first_ocur_filter;
+  first_ocur_vec = saved_first_ocur_vec;
+  shift_dupl_vec = saved_shift_dupl_vec;
+  baseline_id = saved_baseline_id;
+  data_len = saved_data_len;
+  num_chunks = saved_num_chunks;
+  num_nodes = saved_num_nodes;
+  return plan;
+}
+
+void
+TreeDeduplicator::save_state(const std::string& filename) {
+  state_header_t header = fill_state_header(Tree);
+  uint32_t num_digests = (current_id > 0) ? num_nodes : 0;
+  write_dedup_state(filename, header, tree.tree_d, num_digests, first_ocur_d);
+}
+
+bool
+TreeDeduplicator::load_state(const std::string& filename) {
+  state_header_t header;
+  Kokkos::View<HashDigest*> digests;
+  DigestNodeIDDeviceMap index;
+  if(!read_dedup_state(filename, Tree, chunk_size, header, digests, index))
+    return false;
+  restore_state_header(header);
+  num_nodes = header.num_digests;
+  num_chunks = (num_nodes+1)/2;
+  tree = MerkleTree(num_chunks);
+  Kokkos::deep_copy(tree.tree_d, digests);
+  first_ocur_d = index;
+  // The filter is rebuilt from the map before the next checkpoint
+  first_ocur_filter = DigestFilter();
+  first_ocur_vec = Vector<uint32_t>(num_chunks);
+  shift_dupl_vec = Vector<uint32_t>(num_chunks);
+  return true;
+}
+
+bool
+TreeDeduplicator::rebuild_state(Kokkos::View<uint8_t*> data,
+                                std::vector<std::string>& chkpt_filenames,
+                                uint32_t chkpt_id) {
+  std::vector<std::string> hashtree_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    hashtree_chkpt_files.push_back(chkpt_filenames[i]+".hashtree.incr_chkpt");
+  }
+  state_header_t header = fill_state_header(Tree);
+  if(!read_chain_state(hashtree_chkpt_files, chkpt_id, header))
+    return false;
+  if(header.chunk_size != chunk_size) {
+    printf("ERROR: Checkpoint %u uses %u byte chunks\n", chkpt_id, header.chunk_size);
+    return false;
+  }
+  restore_state_header(header);
+  setup_dedup(header.data_len, true);
+
+  // Hash the leaves, then each level of interior nodes from the bottom up
+  uint8_t* data_ptr = data.data();
+  Kokkos::parallel_for("Rebuild tree: Leaves", Kokkos::RangePolicy<>(num_chunks-1, num_nodes), 
+  KOKKOS_CLASS_LAMBDA(const uint32_t leaf) {
+    uint32_t num_bytes = chunk_size;
+    uint64_t offset = static_cast<uint64_t>(leaf-num_chunks+1)*static_cast<uint64_t>(chunk_size);
+    if(leaf == num_nodes-1)
+      num_bytes = data_len-offset;
+    hash(data_ptr+offset, num_bytes, tree(leaf).digest);
+  });
+  if(num_chunks > 1) {
+    uint32_t level_beg = 0;
+    while(2*level_beg+1 < num_chunks-1)
+      level_beg = 2*level_beg+1;
+    while(true) {
+      uint32_t level_end = 2*level_beg+1 < num_chunks-1 ? 2*level_beg+1 : num_chunks-1;
+      Kokkos::parallel_for("Rebuild tree: Interior", Kokkos::RangePolicy<>(level_beg, level_end), 
+      KOKKOS_CLASS_LAMBDA(const uint32_t node) {
+        hash((uint8_t*)&tree(2*node+1), 2*sizeof(HashDigest), tree(node).digest);
+      });
+      if(level_beg == 0)
+        break;
+      level_beg = (level_beg-1)/2;
+    }
+  }
+
+  // Every node of the restarted data can be referenced as it was in checkpoint chkpt_id.
+  // Duplicate nodes reference the lowest offset.
+  Kokkos::parallel_for("Rebuild tree: Index", Kokkos::RangePolicy<>(0, num_nodes), 
+  KOKKOS_CLASS_LAMBDA(const uint32_t node) {
+    auto result = first_ocur_d.insert(tree(node), NodeID(node, chkpt_id));
+    if(result.success()) {
+      first_ocur_filter.insert(tree(node));
+    } else if(result.existing()) {
+      auto& info = first_ocur_d.value_at(result.index());
+      Kokkos::atomic_min(&info.node, node);
+    }
+  });
+  Kokkos::fence();
+  return true;
+}
+
+bool
+TreeDeduplicator::seed_reference(std::vector<std::string>& reference_files,
+                                 size_t len,
+                                 Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  ReferenceSet refs(reference_files);
+  if(!refs.valid())
+    return false;
+  Kokkos::View<uint8_t*> image_d("Reference image", len);
+  read_reference_image(refs, image_d);
+
+  // The reference checkpoint starts the chain in place of a baseline
+  setup_dedup(len, true);
+  baseline_id = current_id;
+  dedup_data_baseline(image_d.data(), len);
+  header_t header = {current_id, current_id, len, chunk_size, 0, 0, 0};
+  write_reference_chkpt(header, refs, chkpt_h);
+  update_chain(true, chkpt_h.size());
+  record_index_stats(first_ocur_d.size(), first_ocur_d.capacity(), map_memory_bytes(first_ocur_d));
+  current_id += 1;
+  return true;
+}
+
 /**
  * Restart checkpoint from vector of incremental checkpoints loaded on the Host.
  *
@@ -1788,7 +2137,14 @@ TreeDeduplicator::restart(Kokkos::View<uint8_t*> data,
                           std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
                           std::string& logname, 
                           uint32_t chkpt_id) {
-  auto tree_times = restart_chkpt(chkpts, chkpt_id, data);
+  std::pair<double,double> tree_times;
+  ChkptChain chain(chkpts, true);
+  if(chain.reverse(chkpt_id) || chain.seeded(chkpt_id)) {
+    // Reverse deltas and reference datasets are resolved by the chain reader
+    tree_times = chain.restart(chkpt_id, data);
+  } else {
+    tree_times = restart_chkpt(chkpts, chkpt_id, data);
+  }
   restart_timers[0] = tree_times.first;
   restart_timers[1] = tree_times.second;
   std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
@@ -1833,12 +2189,124 @@ TreeDeduplicator::restart(Kokkos::View<uint8_t*> data,
   for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
     hashtree_chkpt_files.push_back(chkpt_filenames[i]+".hashtree.incr_chkpt");
   }
-  auto tree_times = restart_chkpt(hashtree_chkpt_files, chkpt_id, data);
+  std::pair<double,double> tree_times;
+  ChkptChain chain(hashtree_chkpt_files, true);
+  if(chain.reverse(chkpt_id) || chain.seeded(chkpt_id)) {
+    // Reverse deltas and reference datasets are resolved by the chain reader
+    tree_times = chain.restart(chkpt_id, data);
+  } else {
+    tree_times = restart_chkpt(hashtree_chkpt_files, chkpt_id, data);
+  }
   restart_timers[0] = tree_times.first;
   restart_timers[1] = tree_times.second;
   write_restart_log(chkpt_id, logname);
 }
 
+/**
+ * Restart a byte range of a checkpoint from vector of incremental checkpoints loaded
+ * on the Host. Only chunks overlapping [offset, offset+length) are restarted.
+ *
+ * \param data       Data View to restart the range into, resized if shorter than the range
+ * \param offset     Byte offset of the range in the checkpointed data
+ * \param length     Length of the range in bytes
+ * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+TreeDeduplicator::restart_range(Kokkos::View<uint8_t*>& data, 
+                                uint64_t offset,
+                                uint64_t length,
+                                std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                                std::string& logname, 
+                                uint32_t chkpt_id) {
+  ChkptChain chain(chkpts, true);
+  auto hashtree_times = chain.restart_range(chkpt_id, offset, length, data);
+  restart_timers[0] = hashtree_times.first;
+  restart_timers[1] = hashtree_times.second;
+  std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                ".restart_timing.csv";
+  write_restart_log(chkpt_id, restart_logname);
+}
+
+/**
+ * Restart a byte range of a checkpoint from checkpoint files. Only the metadata of
+ * the checkpoints in the chain and the chunks overlapping [offset, offset+length)
+ * are read.
+ *
+ * \param data       Data View to restart the range into, resized if shorter than the range
+ * \param offset     Byte offset of the range in the checkpointed data
+ * \param length     Length of the range in bytes
+ * \param filenames  Vector of prior incremental checkpoints stored in files
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+TreeDeduplicator::restart_range(Kokkos::View<uint8_t*>& data, 
+                                uint64_t offset,
+                                uint64_t length,
+                                std::vector<std::string>& chkpt_filenames, 
+                                std::string& logname, 
+                                uint32_t chkpt_id) {
+  std::vector<std::string> hashtree_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    hashtree_chkpt_files.push_back(chkpt_filenames[i]+".hashtree.incr_chkpt");
+  }
+  ChkptChain chain(hashtree_chkpt_files, true);
+  auto hashtree_times = chain.restart_range(chkpt_id, offset, length, data);
+  restart_timers[0] = hashtree_times.first;
+  restart_timers[1] = hashtree_times.second;
+  write_restart_log(chkpt_id, logname);
+}
+
+/**
+ * Restart a multi-region checkpoint from vector of incremental checkpoints loaded on the
+ * Host. Each region is restarted in place through the chain.
+ *
+ * \param regions    Regions to restart into, in the order they were checkpointed
+ * \param chkpts     Vector of prior incremental checkpoints stored on the Host
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+TreeDeduplicator::restart(std::vector<region_t>& regions, 
+                          std::vector<Kokkos::View<uint8_t*>::HostMirror>& chkpts, 
+                          std::string& logname, 
+                          uint32_t chkpt_id) {
+  ChkptChain chain(chkpts, true);
+  auto hashtree_times = chain.restart_regions(chkpt_id, regions);
+  restart_timers[0] = hashtree_times.first;
+  restart_timers[1] = hashtree_times.second;
+  std::string restart_logname = logname + ".chunk_size." + std::to_string(chunk_size) +
+                                ".restart_timing.csv";
+  write_restart_log(chkpt_id, restart_logname);
+}
+
+/**
+ * Restart a multi-region checkpoint from checkpoint files. Each region is restarted in
+ * place through the chain.
+ *
+ * \param regions    Regions to restart into, in the order they were checkpointed
+ * \param filenames  Vector of prior incremental checkpoints stored in files
+ * \param logname    Filename for restart logs
+ * \param chkpt_id   ID of checkpoint to restart
+ */
+void 
+TreeDeduplicator::restart(std::vector<region_t>& regions, 
+                          std::vector<std::string>& chkpt_filenames, 
+                          std::string& logname, 
+                          uint32_t chkpt_id) {
+  std::vector<std::string> hashtree_chkpt_files;
+  for(uint32_t i=0; i<chkpt_filenames.size(); i++) {
+    hashtree_chkpt_files.push_back(chkpt_filenames[i]+".hashtree.incr_chkpt");
+  }
+  ChkptChain chain(hashtree_chkpt_files, true);
+  auto hashtree_times = chain.restart_regions(chkpt_id, regions);
+  restart_timers[0] = hashtree_times.first;
+  restart_timers[1] = hashtree_times.second;
+  write_restart_log(chkpt_id, logname);
+}
+
 /**
  * Write logs for the checkpoint metadata/data breakdown, runtimes, and the overall summary.
  * The data breakdown log shows the proportion of data and metadata as well as how much 
@@ -64,7 +64,7 @@ TreeLowRootDeduplicator::dedup_data_low_root(const uint8_t* data_ptr,
     if(digests_same(tree(leaf), digest)) {
       labels(leaf) = FIXED_DUPL;
       chunk_counters_sa(labels(leaf)) += 1;
-    } else if(first_ocur_d.exists(digest)) {
+    } else if(match_first_ocur(digest)) {
       labels(leaf) = SHIFT_DUPL;
       chunk_counters_sa(labels(leaf)) += 1;
     } else {
@@ -209,7 +209,8 @@ TreeLowRootDeduplicator::dedup_data_low_root(const uint8_t* data_ptr,
       }
       labels(select) = FIRST_OCUR;
       chunk_counters_sa(FIRST_OCUR) += 1;
-      first_ocur_d.insert(tree(select), NodeID(select, current_id));
+      if(first_ocur_d.insert(tree(select), NodeID(select, current_id)).success())
+        first_ocur_filter.insert(tree(select));
     }
   });
 
@@ -228,7 +229,8 @@ TreeLowRootDeduplicator::dedup_data_low_root(const uint8_t* data_ptr,
         if(labels(child_l) == FIRST_OCUR && labels(child_r) == FIRST_OCUR) {
           labels(node) = FIRST_OCUR;
           hash((uint8_t*)&tree(child_l), 2*sizeof(HashDigest), tree(node).digest);
-          first_ocur_d.insert(tree(node), NodeID(node, current_id));
+          if(first_ocur_d.insert(tree(node), NodeID(node, current_id)).success())
+            first_ocur_filter.insert(tree(node));
         }
         if(node == 0 && labels(0) == FIRST_OCUR)
           tree_roots.push(0);
@@ -263,7 +265,7 @@ TreeLowRootDeduplicator::dedup_data_low_root(const uint8_t* data_ptr,
           labels(node) = FIXED_DUPL;
         } else if(labels(child_l) == SHIFT_DUPL) { // Children are both shifted duplicates
           hash((uint8_t*)&tree(child_l), 2*sizeof(HashDigest), tree(node).digest);
-          if(first_ocur_d.exists(tree(node))) { // This node is also a shifted duplicate
+          if(match_first_ocur(tree(node))) { // This node is also a shifted duplicate
             labels(node) = SHIFT_DUPL;
           } else { // Node is not a shifted duplicate. Save child trees
             labels(node) = DONE; // Add children to tree root maps
@@ -336,48 +338,11 @@ TreeLowRootDeduplicator::checkpoint(header_t& header,
                                   std::to_string(current_id) + std::string(": Setup");
   Kokkos::Profiling::pushRegion(setup_region_name.c_str());
 
-  // Set important values
-  data_len = data_size;
-  num_chunks = data_len/chunk_size;
-  if(static_cast<uint64_t>(num_chunks)*static_cast<uint64_t>(chunk_size) < data_len)
-    num_chunks += 1;
-  num_nodes = 2*num_chunks-1;
-
-  // Allocate or resize necessary variables for each approach
-  if(make_baseline) {
-    tree = MerkleTree(num_chunks);
-    first_ocur_d = DigestNodeIDDeviceMap(num_nodes);
-    first_ocur_vec = Vector<uint32_t>(num_chunks);
-    shift_dupl_vec = Vector<uint32_t>(num_chunks);
-  }
-  first_ocur_vec.clear();
-  shift_dupl_vec.clear();
-  std::string resize_tree_label = std::string("Deduplication chkpt ") + 
-                                  std::to_string(current_id) + 
-                                  std::string(": Setup: Resize Tree");
-  Kokkos::Profiling::pushRegion(resize_tree_label.c_str());
-  if(tree.tree_d.size() < num_nodes) {
-    Kokkos::resize(tree.tree_d, num_nodes);
-    Kokkos::resize(tree.tree_h, num_nodes);
-  }
-  Kokkos::Profiling::popRegion();
-  std::string resize_map_label = std::string("Deduplication chkpt ") + 
-                                 std::to_string(current_id) + 
-                                 std::string(": Setup: Resize First Ocur Map");
-  Kokkos::Profiling::pushRegion(resize_map_label.c_str());
-  if(first_ocur_d.capacity() < first_ocur_d.size()+num_nodes)
-    first_ocur_d.rehash(first_ocur_d.size()+num_nodes);
-  Kokkos::Profiling::popRegion();
-  std::string resize_updates_label = std::string("Deduplication chkpt ") + 
-                                     std::to_string(current_id) + 
-                                     std::string(": Setup: Resize Update Map");
-  Kokkos::Profiling::pushRegion(resize_updates_label.c_str());
-  Kokkos::Profiling::popRegion();
-  std::string clear_updates_label = std::string("Deduplication chkpt ") + 
-                                    std::to_string(current_id) + 
-                                    std::string(": Setup: Clear Update Map");
-  Kokkos::Profiling::pushRegion(clear_updates_label.c_str());
-  Kokkos::Profiling::popRegion();
+  // Start a new chain if requested or if the current chain is too long or too large
+  make_baseline = apply_baseline_policy(make_baseline, first_ocur_d.size());
+
+  // Set important values and allocate or resize necessary variables
+  setup_dedup(data_size, make_baseline);
   Kokkos::Profiling::popRegion();
 
   std::string dedup_region_name = std::string("Deduplication chkpt ") + 
@@ -421,13 +386,19 @@ TreeLowRootDeduplicator::checkpoint(header_t& header,
   // Copy diff to host 
   // ==========================================================================================
   Timer::time_point start_write = Timer::now();
-  Kokkos::resize(diff_h, diff.size());
   std::string write_region_name = std::string("Copy diff to host ") 
                                   + std::to_string(current_id);
   Kokkos::Profiling::pushRegion(write_region_name.c_str());
 
-  Kokkos::deep_copy(diff_h, diff);
-  memcpy(diff_h.data(), &header, sizeof(header_t));
+  diff_to_host(diff, diff_h, header);
+  update_chain(make_baseline, diff_h.size());
+  record_index_stats(first_ocur_d.size(), first_ocur_d.capacity(), map_memory_bytes(first_ocur_d));
+  if(first_ocur_filter.enabled()) {
+    auto filter_counters_h = Kokkos::create_mirror_view(filter_counters);
+    Kokkos::deep_copy(filter_counters_h, filter_counters);
+    record_filter_stats(filter_counters_h(0), filter_counters_h(1), filter_counters_h(2), 
+                        first_ocur_filter.memory_bytes());
+  }
 
   Kokkos::Profiling::popRegion();
   Timer::time_point end_write = Timer::now();
@@ -457,15 +428,14 @@ TreeLowRootDeduplicator::checkpoint(uint8_t* data_ptr,
   Kokkos::View<uint8_t*, Kokkos::MemoryTraits<Kokkos::Unmanaged> > data(data_ptr, len);
   Kokkos::View<uint8_t*>::HostMirror diff_h;
   header_t header;
+  ChkptSink out(filename, writer_config);
+  sink = &out;
   checkpoint(header, data_ptr, len, diff_h, make_baseline);
+  sink = NULL;
   write_chkpt_log(header, diff_h, logname);
-  // Write checkpoint to file
-  std::ofstream file;
-  file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-  file.open(filename, std::ofstream::out | std::ofstream::binary);
-  file.write((const char*)(diff_h.data()), diff_h.size());
-  file.flush();
-  file.close();
+  // Write checkpoint to file unless it was gathered into the file
+  out.write(diff_h);
+  finish_file(filename, diff_h, true);
   current_id += 1;
 }
 
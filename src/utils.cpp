@@ -35,6 +35,17 @@ DedupMode get_mode(int argc, char** argv) {
   return Unknown;
 }
 
+const char* baseline_reason_name(BaselineReason reason) {
+  if(reason == BaselineChainLength) {
+    return "chain length";
+  } else if(reason == BaselineRestartCost) {
+    return "restart cost";
+  } else if(reason == BaselineIndexSize) {
+    return "index size";
+  }
+  return "requested";
+}
+
 void write_metadata_breakdown(std::fstream& fs, 
                               DedupMode mode,
                               header_t& header, 
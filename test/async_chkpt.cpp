@@ -0,0 +1,74 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include <signal.h>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoint Host data in the background while the data keeps changing. Every
+// checkpoint must restart to the data as it was when the checkpoint started.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    uint64_t window_len = 1000*static_cast<uint64_t>(chunk_size)+chunk_size/2;
+    ListDeduplicator deduplicator(chunk_size);
+    TestData data(data_len);
+    Kokkos::View<uint8_t*>::HostMirror data_h = data.data_h;
+
+    std::vector<std::string> chkpt_files;
+    std::string null("/dev/null/");
+    uint64_t total_copied = 0;
+    struct sigaction handler_before;
+    sigaction(SIGSEGV, NULL, &handler_before);
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      data.update(i, chunk_size);
+
+      chkpt_files.push_back(std::string("async_chkpt_test.") + std::to_string(i));
+      std::string filename = chkpt_files[i] + ".hashlist.incr_chkpt";
+      deduplicator.checkpoint_async(data_h.data(), data_len, window_len, filename, null, i==0);
+      // Keep writing while the checkpoint runs, starting with the pages read last
+      for(uint64_t j=data_len; j>data_len/2; j-=1024) {
+        data_h(j-1) = static_cast<uint8_t>(rand() % 256);
+      }
+      data_h(0) = static_cast<uint8_t>(data_h(0)+1);
+      uint64_t copied = deduplicator.wait_async();
+      total_copied += copied;
+      std::cout << "Checkpoint " << i << ": " << copied << " pages copied" << std::endl;
+    }
+    if(total_copied == 0) {
+      std::cout << "No page was written during a checkpoint!\n";
+      res = -1;
+    }
+    // The fault handler is removed once no snapshot is active
+    struct sigaction handler_after;
+    sigaction(SIGSEGV, NULL, &handler_after);
+    if((handler_after.sa_flags & SA_SIGINFO) != (handler_before.sa_flags & SA_SIGINFO) ||
+       (handler_after.sa_handler != handler_before.sa_handler)) {
+      std::cout << "The SIGSEGV handler was not restored!\n";
+      res = -1;
+    }
+
+    if(res == 0)
+      res = check_restarts(deduplicator, chkpt_files, 0, data, "Async");
+    for(uint32_t i=0; i<chkpt_files.size(); i++) {
+      std::remove((chkpt_files[i] + ".hashlist.incr_chkpt").c_str());
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
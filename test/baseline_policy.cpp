@@ -0,0 +1,84 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoint with a baseline policy and check that new baselines are made automatically
+// when the chain length or estimated restart cost crosses the limit. Every checkpoint
+// must still restart correctly from its own chain.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    uint32_t max_chain_len = 3;
+    std::vector<std::string> approaches = {"Basic", "List", "Tree"};
+    std::vector<DedupMode> modes = {Basic, List, Tree};
+    for(uint32_t test=0; test<2*approaches.size() && res == 0; test++) {
+      uint32_t mode = test % approaches.size();
+      bool limit_length = test < approaches.size();
+      BaseDeduplicator* deduplicator = make_deduplicator(modes[mode], chunk_size);
+      baseline_policy_t policy = {0, 0, 0};
+      if(limit_length) {
+        policy.max_chain_len = max_chain_len;
+      } else {
+        policy.max_restart_bytes = data_len + data_len/2;
+      }
+      deduplicator->set_baseline_policy(policy);
+
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      TestData data(data_len);
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        Kokkos::View<uint8_t*>::HostMirror diff_h = next_chkpt(*deduplicator, data, incr_chkpts, chunk_size);
+
+        header_t header;
+        memcpy(&header, diff_h.data(), sizeof(header_t));
+        if(limit_length && (header.ref_id != (i/max_chain_len)*max_chain_len)) {
+          std::cout << approaches[mode] << " checkpoint " << i
+                    << " references checkpoint " << header.ref_id << std::endl;
+          res = -1;
+        }
+      }
+
+      // Every baseline must be recorded with the limit that triggered it
+      const std::vector<baseline_event_t>& events = deduplicator->get_baseline_events();
+      for(uint32_t e=0; e<events.size() && res == 0; e++) {
+        header_t header;
+        memcpy(&header, incr_chkpts[events[e].chkpt_id].data(), sizeof(header_t));
+        BaselineReason expected = limit_length ? BaselineChainLength : BaselineRestartCost;
+        if(events[e].chkpt_id == 0)
+          expected = BaselineRequested;
+        if((header.ref_id != header.chkpt_id) || (events[e].reason != expected)) {
+          std::cout << approaches[mode] << " baseline " << events[e].chkpt_id
+                    << " has reason " << baseline_reason_name(events[e].reason) << std::endl;
+          res = -1;
+        }
+      }
+      if(res == 0 && events.size() < 2) {
+        std::cout << approaches[mode] << " made no automatic baselines" << std::endl;
+        res = -1;
+      }
+
+      if(res == 0) {
+        std::string name = approaches[mode] + (limit_length ? " chain length" : " restart cost") + " policy";
+        res = check_restarts(*deduplicator, incr_chkpts, 0, data, name);
+      }
+      delete deduplicator;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,242 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+bool file_exists(const std::string& filename) {
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0;
+}
+
+// Checkpoints written to files must be recorded in the manifest with their reference,
+// size, and digest, and must restart from the checkpoints read through the manifest
+// alone. The chain starts over halfway so later restarts skip the first half. A corrupted
+// checkpoint must be caught by its digest.
+template<typename Deduplicator>
+int test_chain_manifest(std::string name, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  bool is_full = std::is_same<Deduplicator, FullDeduplicator>::value;
+  std::string manifest_file("chain_manifest_test.manifest");
+  std::remove(manifest_file.c_str());
+  std::vector<std::string> chkpt_files;
+  std::string null("/dev/null/");
+  uint32_t half = num_chkpts/2;
+  {
+    ChainManifest manifest(manifest_file);
+    Deduplicator deduplicator(chunk_size);
+    deduplicator.set_manifest(&manifest);
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      data.update(i, chunk_size, false);
+      chkpt_files.push_back(std::string("chain_manifest_test.") + std::to_string(i) + ".chkpt");
+      deduplicator.checkpoint(data.data(), data_len, chkpt_files[i], null, (i==0) || (i==half));
+      Kokkos::fence();
+    }
+  }
+  if(file_exists(manifest_file + ".tmp")) {
+    std::cout << "Temporary manifest was left behind!\n";
+    res = -1;
+  }
+
+  // Entries of the reopened manifest describe the files
+  ChainManifest manifest(manifest_file);
+  std::vector<manifest_entry_t> entries = manifest.entries();
+  if(entries.size() != num_chkpts) {
+    std::cout << "Manifest has " << entries.size() << " checkpoints!\n";
+    res = -1;
+  }
+  for(uint32_t i=0; i<entries.size() && res == 0; i++) {
+    std::vector<uint8_t> chkpt(striped_size(chkpt_files[i]));
+    read_striped(chkpt_files[i], 0, chkpt.size(), chkpt.data(), default_writer_config());
+    if((entries[i].chkpt_id != i) || (entries[i].path.compare(chkpt_files[i]) != 0) ||
+       (entries[i].length != chkpt.size()) || (entries[i].datalen != data_len) ||
+       (entries[i].ref_id != (is_full ? i : (i < half ? 0 : half))) ||
+       (entries[i].digest.compare(ChainManifest::digest(chkpt.data(), chkpt.size())) != 0)) {
+      std::cout << "Entry of checkpoint " << i << " doesn't match the file!\n";
+      res = -1;
+    }
+  }
+
+  // Restart every checkpoint from the checkpoints in its plan only
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    std::vector<uint32_t> plan = manifest.restart_plan(i);
+    uint32_t first = is_full ? i : (i < half ? 0 : half);
+    if((plan.front() != first) || (plan.back() != i) || (plan.size() != i-first+1)) {
+      std::cout << "Wrong restart plan for checkpoint " << i << "!\n";
+      res = -1;
+      break;
+    }
+    std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts = manifest.read_plan(i, default_writer_config(), 4);
+    Deduplicator restarter(chunk_size);
+    res = check_restart(restarter, chkpts, i, data, name);
+  }
+  std::cout << name << ": " << entries.size() << " checkpoints, plan of the last checkpoint has "
+            << manifest.restart_plan(num_chkpts-1).size() << " checkpoints" << std::endl;
+
+  // Flip a byte of the last checkpoint
+  if(res == 0) {
+    std::fstream f(chkpt_files[num_chkpts-1], std::fstream::in | std::fstream::out | std::fstream::binary);
+    f.seekg(entries.back().length/2);
+    char byte = static_cast<char>(f.get());
+    f.seekp(entries.back().length/2);
+    f.put(static_cast<char>(byte ^ 0x1));
+    f.close();
+    try {
+      manifest.read_plan(num_chkpts-1, default_writer_config(), 4);
+      std::cout << "Corrupted checkpoint was not detected!\n";
+      res = -1;
+    } catch(const std::ios_base::failure& e) {
+      std::cout << "Rejected: " << e.what() << std::endl;
+    }
+  }
+
+  for(uint32_t i=0; i<chkpt_files.size(); i++) {
+    std::remove(chkpt_files[i].c_str());
+  }
+  std::remove(manifest_file.c_str());
+  return res;
+}
+
+// A partial manifest left by a crash is never read, a corrupted one is rejected
+int test_manifest_recovery() {
+  std::string filename("chain_manifest_test.recovery");
+  std::vector<uint8_t> chkpt(1000, 7);
+  {
+    ChainManifest manifest(filename);
+    manifest.record(0, chkpt.data(), chkpt.size(), "chain_manifest_test.data", 0, false);
+  }
+  // Crash while the next version of the manifest was being written
+  std::ofstream tmp(filename + ".tmp", std::ofstream::out | std::ofstream::trunc);
+  tmp << "DEDUP_MANIFEST 1 2\n0 0 0 10";
+  tmp.close();
+  int res = 0;
+  {
+    ChainManifest manifest(filename);
+    manifest_entry_t entry;
+    if(!manifest.find(0, entry) || (entry.length != chkpt.size()) || (manifest.num_chkpts() != 1)) {
+      std::cout << "Manifest changed by a partial write!\n";
+      res = -1;
+    }
+  }
+  std::ofstream bad(filename, std::ofstream::out | std::ofstream::trunc);
+  bad << "This is not a checkpoint manifest";
+  bad.close();
+  try {
+    ChainManifest manifest(filename);
+    std::cout << "Opened a file that is not a manifest!\n";
+    res = -1;
+  } catch(const std::ios_base::failure& e) {
+    std::cout << "Rejected: " << e.what() << std::endl;
+  }
+  std::remove(filename.c_str());
+  std::remove((filename + ".tmp").c_str());
+  return res;
+}
+
+// Without a sync the manifest must only be written when it is saved, and with group
+// commits it must be saved by the commit that syncs the checkpoints of its entries
+int test_manifest_durability() {
+  std::string filename("chain_manifest_test.durability");
+  std::vector<std::string> files;
+  std::vector<uint8_t> chkpt(1000, 7);
+  for(uint32_t i=0; i<2; i++) {
+    files.push_back("chain_manifest_test.durability." + std::to_string(i));
+    std::ofstream f(files[i], std::ofstream::out | std::ofstream::binary);
+    f.write((const char*)(chkpt.data()), chkpt.size());
+  }
+  std::remove(filename.c_str());
+  int res = 0;
+  {
+    ChainManifest manifest(filename, DurableNone);
+    manifest.record(0, chkpt.data(), chkpt.size(), files[0], 0, false);
+    if(file_exists(filename)) {
+      std::cout << "Manifest without durability was written for every checkpoint!\n";
+      res = -1;
+    }
+    manifest.save();
+    if(!file_exists(filename)) {
+      std::cout << "Manifest without durability was not saved!\n";
+      res = -1;
+    }
+  }
+  std::remove(filename.c_str());
+
+  writer_config_t config = default_writer_config();
+  config.durability = DurableGroup;
+  config.group_chkpts = 2;
+  config.group_seconds = 0.0;
+  {
+    ChainManifest manifest(filename, config.durability);
+    GroupCommit commits(config);
+    commits.set_manifest(&manifest);
+    for(uint32_t i=0; i<2 && res == 0; i++) {
+      commits.written(files[i]);
+      // The second checkpoint committed the group, with the first one recorded
+      if(file_exists(filename) != (i == 1)) {
+        std::cout << "Manifest was not saved by the group commit!\n";
+        res = -1;
+      }
+      manifest.record(i, chkpt.data(), chkpt.size(), files[i], 0, false);
+    }
+    if(res == 0) {
+      ChainManifest saved(filename);
+      if(saved.num_chkpts() != 1) {
+        std::cout << "Group commit saved " << saved.num_chkpts() << " of 1 synced checkpoints!\n";
+        res = -1;
+      }
+    }
+    commits.commit();
+    if(res == 0) {
+      ChainManifest saved(filename);
+      if(saved.num_chkpts() != 2) {
+        std::cout << "Commit saved " << saved.num_chkpts() << " of 2 checkpoints!\n";
+        res = -1;
+      }
+    }
+  }
+  if(res == 0)
+    std::cout << "Manifest saved per durability policy" << std::endl;
+  for(uint32_t i=0; i<files.size(); i++) {
+    std::remove(files[i].c_str());
+  }
+  std::remove(filename.c_str());
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_manifest_recovery();
+    if(res == 0)
+      res = test_manifest_durability();
+    if(res == 0)
+      res = test_chain_manifest<FullDeduplicator>("Full", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chain_manifest<BasicDeduplicator>("Basic", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chain_manifest<ListDeduplicator>("List", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chain_manifest<TreeDeduplicator>("Tree", chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
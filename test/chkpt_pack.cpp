@@ -0,0 +1,225 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoints appended to a pack, in two sessions, must be found through the trailing
+// index with the same bytes as the Host checkpoints and restart from the mapped pack.
+template<typename Deduplicator>
+int test_chkpt_pack(std::string name, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  Deduplicator deduplicator(chunk_size);
+  std::string pack_file("chkpt_pack_test.pack");
+  std::remove(pack_file.c_str());
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size, false);
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    deduplicator.checkpoint(data.data(), data_len, diff_h, i==0);
+    Kokkos::fence();
+    chkpts.push_back(diff_h);
+  }
+  // First half in one session, the rest appended after reopening the pack
+  uint32_t half = num_chkpts/2;
+  {
+    ChkptPack pack(pack_file, true);
+    for(uint32_t i=0; i<half; i++) {
+      pack.append(i, chkpts[i].data(), chkpts[i].size());
+    }
+  }
+  {
+    ChkptPack pack(pack_file, true);
+    if(pack.entries().size() != half) {
+      std::cout << "Reopened pack has " << pack.entries().size() << " checkpoints!\n";
+      res = -1;
+    }
+    for(uint32_t i=half; i<num_chkpts; i++) {
+      pack.append(i, chkpts[i].data(), chkpts[i].size());
+    }
+  }
+
+  ChkptPack pack(pack_file, false);
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> pack_chkpts;
+  uint64_t total = 0;
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    pack_entry_t entry;
+    if(!pack.find(i, entry) || (entry.offset % PACK_ALIGNMENT != 0)) {
+      std::cout << "Checkpoint " << i << " is missing or misaligned!\n";
+      res = -1;
+      break;
+    }
+    pack_chkpts.push_back(pack.view(i));
+    total += pack_chkpts[i].size();
+    if((pack_chkpts[i].size() != chkpts[i].size()) ||
+       (memcmp(pack_chkpts[i].data(), chkpts[i].data(), chkpts[i].size()) != 0)) {
+      std::cout << "Checkpoint " << i << " doesn't match the Host checkpoint!\n";
+      res = -1;
+    }
+  }
+  std::cout << name << ": " << num_chkpts << " checkpoints, " << total << " bytes in a pack of "
+            << pack.size() << " bytes" << std::endl;
+
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    Deduplicator restarter(chunk_size);
+    res = check_restart(restarter, pack_chkpts, i, data, name);
+  }
+  std::remove(pack_file.c_str());
+  return res;
+}
+
+// A checkpoint whose bytes do not match its write-ahead record must be reported as torn
+// and dropped, a pack whose index was overwritten or cut short must be recovered from the
+// records, and the remaining checkpoints must still restart.
+template<typename Deduplicator>
+int test_torn_pack(std::string name, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+  Deduplicator deduplicator(chunk_size);
+  std::string pack_file("chkpt_pack_torn_test.pack");
+  std::remove(pack_file.c_str());
+  pack_entry_t last;
+  {
+    ChkptPack pack(pack_file, true);
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      data.update(i, chunk_size, false);
+      Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+      deduplicator.checkpoint(data.data(), data_len, diff_h, i==0);
+      Kokkos::fence();
+      last = pack.append(i, diff_h.data(), diff_h.size());
+    }
+  }
+  uint32_t last_id = num_chkpts-1;
+  uint32_t torn_id = 0;
+
+  // A short append overwrote the start of the index and crashed before the new trailer
+  {
+    std::fstream f(pack_file, std::fstream::in | std::fstream::out | std::fstream::binary);
+    pack_trailer_t trailer;
+    f.seekg(-static_cast<std::streamoff>(sizeof(pack_trailer_t)), std::fstream::end);
+    f.read((char*)(&trailer), sizeof(pack_trailer_t));
+    pack_entry_t entry = {last_id, PACK_ENTRY_RECORD, last.offset, last.length/2};
+    f.seekp(static_cast<std::streamoff>(trailer.index_offset));
+    f.write((const char*)(&entry), sizeof(pack_entry_t));
+  }
+  {
+    ChkptPack pack(pack_file, true);
+    pack_entry_t entry;
+    if(pack.torn(torn_id) || (pack.entries().size() != num_chkpts) || !pack.find(0, entry) ||
+       (entry.chkpt_id != 0)) {
+      std::cout << name << ": overwritten index was used!\n";
+      res = -1;
+    }
+  }
+
+  // The index was written but the last checkpoint never reached the disk
+  {
+    std::fstream f(pack_file, std::fstream::in | std::fstream::out | std::fstream::binary);
+    std::streamoff corrupt = static_cast<std::streamoff>(last.offset + last.length/2);
+    f.seekg(corrupt);
+    char byte = static_cast<char>(f.get());
+    f.seekp(corrupt);
+    f.put(static_cast<char>(~byte));
+  }
+  {
+    ChkptPack pack(pack_file, false);
+    pack_entry_t entry;
+    if(!pack.torn(torn_id) || (torn_id != last_id) || pack.find(last_id, entry) ||
+       (pack.entries().size() != num_chkpts-1)) {
+      std::cout << name << ": corrupted checkpoint " << last_id << " was not detected!\n";
+      res = -1;
+    }
+  }
+
+  // The crash cut the last append short, together with the index after it
+  if((res == 0) && (truncate(pack_file.c_str(), static_cast<off_t>(last.offset + last.length/2)) != 0)) {
+    std::cout << name << ": failed to truncate the pack\n";
+    res = -1;
+  }
+  if(res == 0) {
+    ChkptPack pack(pack_file, true);
+    if(!pack.torn(torn_id) || (torn_id != last_id) || (pack.entries().size() != num_chkpts-1)) {
+      std::cout << name << ": pack without an index was not recovered!\n";
+      res = -1;
+    }
+  }
+  // The writable reopen rewrote the index
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> pack_chkpts;
+  if(res == 0) {
+    ChkptPack pack(pack_file, false);
+    if(pack.torn(torn_id) || (pack.entries().size() != num_chkpts-1)) {
+      std::cout << name << ": recovered index was not written!\n";
+      res = -1;
+    }
+    for(uint32_t i=0; i<num_chkpts-1 && res == 0; i++) {
+      pack_chkpts.push_back(pack.view(i));
+    }
+    std::cout << name << ": recovered " << pack.entries().size() << " of " << num_chkpts
+              << " checkpoints" << std::endl;
+
+    for(uint32_t i=0; i<num_chkpts-1 && res == 0; i++) {
+      Deduplicator restarter(chunk_size);
+      res = check_restart(restarter, pack_chkpts, i, data, name);
+    }
+  }
+  std::remove(pack_file.c_str());
+  return res;
+}
+
+// Files without a valid trailer are not packs
+int test_not_a_pack() {
+  std::string filename("chkpt_pack_test.bad");
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  f << "This is not a checkpoint pack, just some bytes at the end of a file";
+  f.close();
+  int res = -1;
+  try {
+    ChkptPack pack(filename, false);
+    std::cout << "Opened a file that is not a pack!\n";
+  } catch(const std::ios_base::failure& e) {
+    std::cout << "Rejected: " << e.what() << std::endl;
+    res = 0;
+  }
+  std::remove(filename.c_str());
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_not_a_pack();
+    if(res == 0)
+      res = test_chkpt_pack<FullDeduplicator>("Full", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_pack<BasicDeduplicator>("Basic", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_pack<ListDeduplicator>("List", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_pack<TreeDeduplicator>("Tree", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_torn_pack<BasicDeduplicator>("Basic", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_torn_pack<TreeDeduplicator>("Tree", chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
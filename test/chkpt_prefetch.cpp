@@ -0,0 +1,207 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+#define EMULATED_DIR "chkpt_prefetch_test_dir"
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Checkpoints must arrive with the bytes of their files in any order of use, also when
+// the budget is too small to read ahead or the restart holds on to earlier buffers.
+// Missing checkpoints must be reported when they are used and repeated ones up front.
+int test_prefetch(uint32_t num_chkpts) {
+  int res = 0;
+  std::vector<std::string> files;
+  std::vector<std::vector<uint8_t>> contents;
+  uint64_t total = 0;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    files.push_back("chkpt_prefetch_test." + std::to_string(i));
+    contents.push_back(std::vector<uint8_t>(1024 + static_cast<uint64_t>(rand()) % (256*1024)));
+    for(uint64_t j=0; j<contents[i].size(); j++) {
+      contents[i][j] = static_cast<uint8_t>(rand() % 256);
+    }
+    std::ofstream f(files[i], std::ofstream::out | std::ofstream::binary);
+    f.write((const char*)(contents[i].data()), contents[i].size());
+    total += contents[i].size();
+  }
+  std::vector<uint32_t> order;
+  for(int i=static_cast<int>(num_chkpts)-1; i>=0; i--) {
+    order.push_back(static_cast<uint32_t>(i));
+  }
+
+  writer_config_t config = default_writer_config();
+  config.stripe_threads = 4;
+  uint64_t budgets[3] = {PREFETCH_BUFFER, 300*1024, 1};
+  for(uint32_t b=0; b<3 && res == 0; b++) {
+    for(uint32_t hold=0; hold<2 && res == 0; hold++) {
+      ChkptPrefetcher prefetch(files, order, config, budgets[b]);
+      for(uint32_t i=0; i<order.size(); i++) {
+        ChkptPrefetcher::HostBuffer chkpt = prefetch.get(order[i]);
+        const std::vector<uint8_t>& expected = contents[order[i]];
+        if((chkpt.size() != expected.size()) || (memcmp(chkpt.data(), expected.data(), expected.size()) != 0)) {
+          std::cout << "Checkpoint " << order[i] << " doesn't match its file with a budget of "
+                    << budgets[b] << " bytes!\n";
+          res = -1;
+        }
+        if(hold == 0)
+          prefetch.release(order[i]);
+      }
+      if(prefetch.bytes_read() != total) {
+        std::cout << "Read " << prefetch.bytes_read() << " of " << total << " bytes!\n";
+        res = -1;
+      }
+    }
+  }
+
+  if(res == 0) {
+    std::vector<uint32_t> missing(1, num_chkpts);
+    std::remove(files[0].c_str());
+    missing.push_back(0);
+    ChkptPrefetcher prefetch(files, missing, config);
+    for(uint32_t i=0; i<missing.size(); i++) {
+      try {
+        prefetch.get(missing[i]);
+        std::cout << "Missing checkpoint " << missing[i] << " was not reported!\n";
+        res = -1;
+      } catch(const std::ios_base::failure& e) {
+        std::cout << "Rejected: " << e.what() << std::endl;
+      }
+    }
+  }
+  if((res == 0) && (num_chkpts > 1)) {
+    std::vector<uint32_t> repeated(2, num_chkpts-1);
+    try {
+      ChkptPrefetcher prefetch(files, repeated, config);
+      std::cout << "Repeated checkpoint " << repeated[0] << " was accepted!\n";
+      res = -1;
+    } catch(const std::ios_base::failure& e) {
+      std::cout << "Rejected: " << e.what() << std::endl;
+    }
+  }
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove(files[i].c_str());
+  }
+  return res;
+}
+
+// Reading checkpoints from slow storage must overlap the work done with the checkpoints
+// read before them
+int test_overlap(uint32_t num_chkpts) {
+  int res = 0;
+  std::vector<std::string> files;
+  std::vector<uint32_t> order;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    files.push_back(std::string(EMULATED_DIR) + "/chkpt_prefetch_test." + std::to_string(i));
+    std::ofstream f(files[i], std::ofstream::out | std::ofstream::binary);
+    f << "Checkpoint " << i;
+    order.push_back(i);
+  }
+  storage_model_t model = default_storage_model();
+  model.dir = EMULATED_DIR;
+  model.latency = 0.02;
+  set_storage_model(model);
+  double work = 0.02;
+
+  writer_config_t config = default_writer_config();
+  config.stripe_threads = 4;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  {
+    ChkptPrefetcher prefetch(files, order, config);
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      prefetch.get(i);
+      std::this_thread::sleep_for(std::chrono::duration<double>(work));
+      prefetch.release(i);
+    }
+    std::cout << "Waited " << prefetch.wait_time() << " seconds for checkpoints" << std::endl;
+  }
+  double elapsed = seconds_since(start);
+  double sequential = num_chkpts*(model.latency+work);
+  std::cout << "Prefetched " << num_chkpts << " checkpoints in " << elapsed << " seconds ("
+            << sequential << " one after the other)" << std::endl;
+  if(elapsed > 0.8*sequential) {
+    std::cout << "Reads did not overlap the work!\n";
+    res = -1;
+  }
+  set_storage_model(default_storage_model());
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove(files[i].c_str());
+  }
+  return res;
+}
+
+// Checkpoint files restarted through the prefetcher must restart the same data, with
+// checkpoints read one at a time or several at once
+template<typename Deduplicator>
+int test_restart(std::string name, std::string extension, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+  std::vector<std::string> files;
+  std::string null("/dev/null/");
+  Deduplicator deduplicator(chunk_size);
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size, false);
+    files.push_back("chkpt_prefetch_test." + std::to_string(i));
+    std::string filename = files[i] + extension;
+    deduplicator.checkpoint(data.data(), data_len, filename, null, i==0);
+    Kokkos::fence();
+  }
+
+  uint32_t threads[2] = {1, 8};
+  for(uint32_t t=0; t<2; t++) {
+    writer_config_t config = default_writer_config();
+    config.stripe_threads = threads[t];
+    for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+      Deduplicator restarter(chunk_size);
+      restarter.set_writer_config(config);
+      res = check_restart(restarter, files, i, data, name + " with " + std::to_string(threads[t]) + " threads");
+    }
+  }
+  if(res == 0)
+    std::cout << name << ": restarted " << num_chkpts << " checkpoints" << std::endl;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove((files[i] + extension).c_str());
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+    mkdir(EMULATED_DIR, 0755);
+
+    res = test_prefetch(num_chkpts);
+    if(res == 0)
+      res = test_overlap(num_chkpts);
+    if(res == 0)
+      res = test_restart<BasicDeduplicator>("Basic", ".basic.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_restart<ListDeduplicator>("List", ".hashlist.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_restart<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", chunk_size, num_chkpts);
+    rmdir(EMULATED_DIR);
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,128 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+std::vector<uint8_t> read_file(const std::string& filename) {
+  std::ifstream f(filename, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+  uint64_t file_len = static_cast<uint64_t>(f.tellg());
+  std::vector<uint8_t> file_bytes(file_len);
+  f.seekg(0);
+  f.read((char*)(file_bytes.data()), file_len);
+  f.close();
+  return file_bytes;
+}
+
+// Data appended in writes of odd sizes that straddle the pool buffers must end up in the
+// file exactly, with the file truncated to its real size after O_DIRECT writes.
+int test_writer(WriterBackend backend, bool direct) {
+  writer_config_t config = {backend, direct, 4, 64*1024};
+  uint64_t data_len = 1000003;
+  std::vector<uint8_t> data(data_len);
+  for(uint64_t j=0; j<data_len; j++) {
+    data[j] = static_cast<uint8_t>(rand() % 256);
+  }
+  std::string filename("chkpt_writer_test.data");
+  uint64_t num_written = 0;
+  WriterBackend used = backend;
+  bool used_direct = direct;
+  try {
+    ChkptWriter writer(filename, config);
+    used = writer.backend();
+    used_direct = writer.direct();
+    uint64_t offset = 0;
+    while(offset < data_len) {
+      uint64_t len = std::min(static_cast<uint64_t>(rand() % 100000 + 1), data_len-offset);
+      writer.write(data.data()+offset, len);
+      offset += len;
+    }
+    num_written = writer.close();
+  } catch(const std::ios_base::failure& e) {
+    std::cout << "Writer failed: " << e.what() << std::endl;
+    return -1;
+  }
+  std::vector<uint8_t> file_bytes = read_file(filename);
+  std::remove(filename.c_str());
+  std::cout << writer_backend_name(backend) << (direct ? " direct" : "") << " writer used "
+            << writer_backend_name(used) << (used_direct ? " direct" : "") << ": "
+            << num_written << " bytes written" << std::endl;
+  if((num_written != data_len) || (file_bytes.size() != data_len) ||
+     (memcmp(file_bytes.data(), data.data(), data_len) != 0)) {
+    std::cout << "File has " << file_bytes.size() << " bytes and doesn't match the data!\n";
+    return -1;
+  }
+  return 0;
+}
+
+// Checkpoints written through an asynchronous writer must hold exactly the bytes of the
+// same checkpoints copied to the Host.
+template<typename Deduplicator>
+int test_chkpt_writer(std::string name, writer_config_t config, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  Deduplicator to_file(chunk_size);
+  Deduplicator to_host(chunk_size);
+  to_file.set_writer_config(config);
+  std::string filename("chkpt_writer_test.chkpt");
+  std::string null("/dev/null/");
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    data.update(i, chunk_size, false);
+
+    to_file.checkpoint(data.data(), data_len, filename, null, i==0);
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    to_host.checkpoint(data.data(), data_len, diff_h, i==0);
+    Kokkos::fence();
+
+    std::vector<uint8_t> file_bytes = read_file(filename);
+    std::cout << name << " " << writer_backend_name(config.backend) << " checkpoint " << i
+              << ": " << file_bytes.size() << " bytes" << std::endl;
+    if((file_bytes.size() != diff_h.size()) ||
+       (memcmp(file_bytes.data(), diff_h.data(), diff_h.size()) != 0)) {
+      std::cout << "File doesn't match the Host checkpoint of " << diff_h.size() << " bytes!\n";
+      res = -1;
+    }
+  }
+  std::remove(filename.c_str());
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    WriterBackend backends[3] = {WriterStream, WriterThreads, WriterUring};
+    for(uint32_t i=0; i<3 && res == 0; i++) {
+      res = test_writer(backends[i], false);
+      if(res == 0)
+        res = test_writer(backends[i], true);
+    }
+    writer_config_t threads = {WriterThreads, false, 4, 64*1024};
+    writer_config_t uring = {WriterUring, true, 8, 128*1024};
+    if(res == 0)
+      res = test_chkpt_writer<FullDeduplicator>("Full", threads, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_writer<BasicDeduplicator>("Basic", threads, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_writer<ListDeduplicator>("List", uring, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_writer<TreeDeduplicator>("Tree", uring, chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,64 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Consolidate a chain of incremental checkpoints into a new baseline in the middle of the
+// chain and restart every later checkpoint without the checkpoints before the new baseline.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    uint32_t baseline_idx = num_chkpts/2;
+    std::vector<std::string> approaches = {"Basic", "List", "Tree"};
+    std::vector<DedupMode> modes = {Basic, List, Tree};
+    for(uint32_t mode=0; mode<approaches.size() && res == 0; mode++) {
+      BaseDeduplicator* deduplicator = make_deduplicator(modes[mode], chunk_size);
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      TestData data(data_len);
+      for(uint32_t i=0; i<num_chkpts; i++) {
+        next_chkpt(*deduplicator, data, incr_chkpts, chunk_size);
+      }
+
+      // Consolidate and drop the checkpoints before the new baseline
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > consolidated;
+      {
+        ChkptChain chain(incr_chkpts, mode == 2);
+        chain.consolidate(baseline_idx, consolidated);
+      }
+      for(uint32_t i=0; i<baseline_idx; i++) {
+        consolidated[i] = Kokkos::View<uint8_t*>::HostMirror("Removed", 1);
+      }
+
+      for(uint32_t i=baseline_idx; i<num_chkpts && res == 0; i++) {
+        header_t header;
+        memcpy(&header, consolidated[i].data(), sizeof(header_t));
+        if(header.ref_id < baseline_idx) {
+          std::cout << approaches[mode] << " checkpoint " << i
+                    << " references checkpoint " << header.ref_id << std::endl;
+          res = -1;
+          break;
+        }
+
+        res = check_restart(*deduplicator, consolidated, i, data, approaches[mode] + " consolidated");
+      }
+      delete deduplicator;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
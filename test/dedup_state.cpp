@@ -0,0 +1,92 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoint half of the data with one deduplicator, then continue the chain with a new
+// deduplicator that either loads the saved state or rebuilds it from the restarted data.
+// The continued checkpoints must stay in the original chain and every checkpoint must
+// restart correctly.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    uint32_t resume_id = num_chkpts/2;
+    std::vector<std::string> tests = {"Basic load", "List load", "Tree load",
+                                      "List rebuild", "Tree rebuild"};
+    std::vector<DedupMode> modes = {Basic, List, Tree, List, Tree};
+    std::vector<std::string> suffixes = {".basic.incr_chkpt", ".hashlist.incr_chkpt", ".hashtree.incr_chkpt",
+                                         ".hashlist.incr_chkpt", ".hashtree.incr_chkpt"};
+    std::string state_file("dedup_state_test.state");
+    for(uint32_t test=0; test<tests.size() && res == 0; test++) {
+      bool rebuild = test >= 3;
+      BaseDeduplicator* deduplicator = make_deduplicator(modes[test], chunk_size);
+
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      std::vector<std::string> chkpt_files;
+      TestData data(data_len);
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        if(i == resume_id) {
+          // Simulate a job restart
+          BaseDeduplicator* resumed = make_deduplicator(modes[test], chunk_size);
+          bool loaded = false;
+          if(rebuild) {
+            Kokkos::View<uint8_t*> restart_d("Restart buffer", data_len);
+            std::string null("/dev/null/");
+            deduplicator->restart(restart_d, chkpt_files, null, i-1);
+            Kokkos::fence();
+            loaded = resumed->rebuild_state(restart_d, chkpt_files, i-1);
+          } else {
+            deduplicator->save_state(state_file);
+            loaded = resumed->load_state(state_file);
+          }
+          if(!loaded || resumed->get_current_id() != i) {
+            std::cout << tests[test] << " resumed at checkpoint " << resumed->get_current_id() << std::endl;
+            res = -1;
+          }
+          delete deduplicator;
+          deduplicator = resumed;
+        }
+        Kokkos::View<uint8_t*>::HostMirror diff_h = next_chkpt(*deduplicator, data, incr_chkpts, chunk_size);
+        chkpt_files.push_back(std::string("dedup_state_test.") + std::to_string(i));
+        std::ofstream f(chkpt_files[i] + suffixes[test], std::ofstream::out | std::ofstream::binary);
+        f.write((const char*)(diff_h.data()), diff_h.size());
+        f.close();
+
+        // The resumed deduplicator continues the chain of the first baseline
+        header_t header;
+        memcpy(&header, diff_h.data(), sizeof(header_t));
+        if((header.chkpt_id != i) || (header.ref_id != 0)) {
+          std::cout << tests[test] << " checkpoint " << i << " has ID " << header.chkpt_id
+                    << " and baseline " << header.ref_id << std::endl;
+          res = -1;
+        }
+      }
+
+      if(res == 0)
+        res = check_restarts(*deduplicator, incr_chkpts, 0, data, tests[test]);
+      for(uint32_t i=0; i<chkpt_files.size(); i++) {
+        std::remove((chkpt_files[i] + suffixes[test]).c_str());
+      }
+      delete deduplicator;
+    }
+    std::remove(state_file.c_str());
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,74 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoint the same data with and without the digest filter. The filter has no false
+// negatives so both deduplicators must produce the same checkpoint sizes, the filter
+// must answer some lookups, and every checkpoint must restart correctly.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    TreeDeduplicator filtered(chunk_size);
+    TreeDeduplicator unfiltered(chunk_size);
+    filtered.set_digest_filter(10);
+
+    std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+    TestData data(data_len);
+    for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+      Kokkos::View<uint8_t*>::HostMirror diff_h = next_chkpt(filtered, data, incr_chkpts, chunk_size);
+      Kokkos::View<uint8_t*>::HostMirror unfiltered_h("Unfiltered diff", 1);
+      unfiltered.checkpoint(data.data(), data.size(), unfiltered_h, i==0);
+      Kokkos::fence();
+
+      header_t header, unfiltered_header;
+      memcpy(&header, diff_h.data(), sizeof(header_t));
+      memcpy(&unfiltered_header, unfiltered_h.data(), sizeof(header_t));
+      if((diff_h.size() != unfiltered_h.size()) ||
+         (header.num_first_ocur != unfiltered_header.num_first_ocur) ||
+         (header.num_shift_dupl != unfiltered_header.num_shift_dupl)) {
+        std::cout << "Checkpoint " << i << " is " << diff_h.size() << " bytes with the filter and "
+                  << unfiltered_h.size() << " bytes without" << std::endl;
+        res = -1;
+      }
+    }
+
+    // Every lookup is either rejected, a false positive, or a match
+    const std::vector<filter_stats_t>& stats = filtered.get_filter_stats();
+    uint64_t num_rejected = 0;
+    for(uint32_t s=0; s<stats.size() && res == 0; s++) {
+      num_rejected += stats[s].rejected;
+      if((stats[s].rejected + stats[s].false_positives > stats[s].lookups) || (stats[s].memory_bytes == 0)) {
+        std::cout << "Filter checkpoint " << stats[s].chkpt_id << ": " << stats[s].lookups << " lookups, "
+                  << stats[s].rejected << " rejected, " << stats[s].false_positives
+                  << " false positives" << std::endl;
+        res = -1;
+      }
+    }
+    if(res == 0 && (stats.size() != num_chkpts || num_rejected == 0)) {
+      std::cout << "Filter rejected " << num_rejected << " lookups over "
+                << stats.size() << " checkpoints" << std::endl;
+      res = -1;
+    }
+
+    if(res == 0)
+      res = check_restarts(filtered, incr_chkpts, 0, data, "Filtered");
+  }
+  Kokkos::finalize();
+  return res;
+}
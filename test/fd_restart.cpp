@@ -0,0 +1,97 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+void write_file(const std::string& filename, Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  f.write((const char*)(chkpt_h.data()), chkpt_h.size());
+  f.close();
+}
+
+// Restart every checkpoint of a chain into a file through a Host budget much smaller
+// than the data. The file must hold exactly the checkpointed data.
+template<typename Deduplicator>
+int test_fd_restart(std::string name, std::string suffix, bool tree_layout,
+                    uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  Deduplicator deduplicator(chunk_size);
+  std::vector<std::string> chkpt_files;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size);
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    deduplicator.checkpoint(data.data(), data_len, diff_h, i==0);
+    Kokkos::fence();
+    chkpt_files.push_back(std::string("fd_restart_test.") + std::to_string(i) + suffix);
+    write_file(chkpt_files[i], diff_h);
+  }
+
+  // Windows of 37 chunks so that they end inside the regions of the metadata
+  uint64_t budget = 2*37*static_cast<uint64_t>(chunk_size) + 5;
+  std::string restart_file("fd_restart_test.restart");
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    ChkptChain chain(chkpt_files, tree_layout);
+    int fd = open(restart_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    uint64_t num_written = chain.restart_fd(i, fd, budget);
+    close(fd);
+
+    Kokkos::View<uint8_t*>::HostMirror restart_h("Restarted file", data_len);
+    std::ifstream f(restart_file, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+    uint64_t file_len = static_cast<uint64_t>(f.tellg());
+    f.seekg(0);
+    f.read((char*)(restart_h.data()), std::min(file_len, data_len));
+    f.close();
+    std::string restart_digest = calculate_digest_host(restart_h);
+    std::cout << name << " checkpoint " << i << ": " << num_written << " bytes written" << std::endl;
+    res = data.correct_digests[i].compare(restart_digest);
+    if(num_written != data_len || file_len != data_len) {
+      std::cout << "Restarted file has " << file_len << " bytes!\n";
+      res = -1;
+    } else if(res == 0) {
+      std::cout << "Hashes match!\n";
+    } else {
+      std::cout << "Hashes don't match!\n";
+      std::cout << "Correct:          " << data.correct_digests[i] << std::endl;
+      std::cout << "Restarted:        " << restart_digest << std::endl;
+    }
+  }
+  std::remove(restart_file.c_str());
+  for(uint32_t i=0; i<chkpt_files.size(); i++) {
+    std::remove(chkpt_files[i].c_str());
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_fd_restart<BasicDeduplicator>("Basic", ".basic.incr_chkpt", false, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_fd_restart<ListDeduplicator>("List", ".hashlist.incr_chkpt", false, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_fd_restart<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", true, chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
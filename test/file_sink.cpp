@@ -0,0 +1,69 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoints written to files, gathered straight into the file when the execution
+// space can access Host memory, must hold exactly the bytes of the same checkpoints
+// copied to the Host.
+template<typename Deduplicator>
+int test_file_sink(std::string name, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  Deduplicator to_file(chunk_size);
+  Deduplicator to_host(chunk_size);
+  std::string filename("file_sink_test.chkpt");
+  std::string null("/dev/null/");
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    data.update(i, chunk_size);
+
+    to_file.checkpoint(data.data(), data_len, filename, null, i==0);
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    to_host.checkpoint(data.data(), data_len, diff_h, i==0);
+    Kokkos::fence();
+
+    std::ifstream f(filename, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+    uint64_t file_len = static_cast<uint64_t>(f.tellg());
+    std::vector<uint8_t> file_bytes(file_len);
+    f.seekg(0);
+    f.read((char*)(file_bytes.data()), file_len);
+    f.close();
+    std::cout << name << " checkpoint " << i << ": " << file_len << " bytes" << std::endl;
+    if((file_len != diff_h.size()) || (memcmp(file_bytes.data(), diff_h.data(), file_len) != 0)) {
+      std::cout << "File doesn't match the Host checkpoint of " << diff_h.size() << " bytes!\n";
+      res = -1;
+    }
+  }
+  std::remove(filename.c_str());
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_file_sink<BasicDeduplicator>("Basic", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_file_sink<ListDeduplicator>("List", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_file_sink<TreeDeduplicator>("Tree", chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,205 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include "deduplicator.hpp"
+#include <iostream>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+void write_file(const std::string& filename, uint64_t len) {
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  for(uint64_t i=0; i<len; i++) {
+    f.put(static_cast<char>(rand() % 256));
+  }
+}
+
+// Each policy must sync as often as it promises: never, once per checkpoint, or once per
+// group of checkpoints, with a pack reported by a whole group synced only once.
+int test_policies(uint32_t num_chkpts) {
+  int res = 0;
+  std::vector<std::string> files;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    files.push_back("group_commit_test." + std::to_string(i));
+    write_file(files[i], 4096);
+  }
+  std::string pack_file("group_commit_test.pack");
+  write_file(pack_file, 4096);
+
+  writer_config_t config = default_writer_config();
+  DurabilityPolicy policies[3] = {DurableNone, DurableChkpt, DurableGroup};
+  uint32_t group = 3;
+  uint64_t num_groups = (num_chkpts+group-1)/group;
+  uint64_t expected_commits[3] = {0, num_chkpts, num_groups};
+  // Every file and its directory on the first commit, the pack once per group
+  uint64_t expected_syncs[3] = {0, 2*static_cast<uint64_t>(num_chkpts), num_groups+1};
+  for(uint32_t p=0; p<3 && res == 0; p++) {
+    config.durability = policies[p];
+    config.group_chkpts = group;
+    config.group_seconds = 0.0;
+    GroupCommit commits(config);
+    for(uint32_t i=0; i<num_chkpts; i++) {
+      commits.written((policies[p] == DurableGroup) ? pack_file : files[i]);
+    }
+    if((policies[p] == DurableGroup) && (commits.num_commits() != num_chkpts/group)) {
+      std::cout << "Group commit committed " << commits.num_commits() << " full groups of "
+                << num_chkpts/group << "!\n";
+      res = -1;
+    }
+    commits.commit();
+    std::cout << durability_name(policies[p]) << ": " << commits.num_chkpts() << " checkpoints, "
+              << commits.num_commits() << " commits, " << commits.num_syncs() << " syncs, "
+              << commits.sync_time() << " seconds" << std::endl;
+    if((commits.num_chkpts() != num_chkpts) || (commits.num_commits() != expected_commits[p]) ||
+       (commits.num_syncs() != expected_syncs[p])) {
+      std::cout << "Expected " << expected_commits[p] << " commits and " << expected_syncs[p] << " syncs!\n";
+      res = -1;
+    }
+  }
+
+  // Groups are also committed once the interval has passed
+  if(res == 0) {
+    config.durability = DurableGroup;
+    config.group_chkpts = 0;
+    config.group_seconds = 0.05;
+    GroupCommit commits(config);
+    commits.written(files[0]);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    commits.written(files[0]);
+    if(commits.num_commits() != 1) {
+      std::cout << "Group was not committed after " << config.group_seconds << " seconds!\n";
+      res = -1;
+    }
+    // The timer commits the last group without a further checkpoint
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    if((res == 0) && (commits.num_commits() != 2)) {
+      std::cout << "Timer did not commit the group after " << config.group_seconds << " seconds!\n";
+      res = -1;
+    }
+  }
+
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove(files[i].c_str());
+  }
+  std::remove(pack_file.c_str());
+  return res;
+}
+
+// The stripe files and layout of a split checkpoint must be synced with it, and syncing
+// a file that is gone must be reported
+int test_striped() {
+  int res = 0;
+  uint64_t len = 1024*1024;
+  std::vector<uint8_t> data(len);
+  for(uint64_t i=0; i<len; i++) {
+    data[i] = static_cast<uint8_t>(rand() % 256);
+  }
+  writer_config_t config = default_writer_config();
+  config.backend = WriterStriped;
+  config.stripe_size = 64*1024;
+  config.stripe_files = 3;
+  config.durability = DurableChkpt;
+  std::string filename("group_commit_test.striped");
+  write_striped(filename, data.data(), len, config, true);
+  stripe_layout_t layout;
+  if(!read_stripe_layout(filename, layout) || (layout.files.size() != config.stripe_files)) {
+    std::cout << "Checkpoint was not split over " << config.stripe_files << " files!\n";
+    return -1;
+  }
+  {
+    GroupCommit commits(config);
+    commits.written(filename);
+    // Stripe files, the layout, and their directory
+    if(commits.num_syncs() != config.stripe_files+2) {
+      std::cout << "Synced " << commits.num_syncs() << " files of a split checkpoint!\n";
+      res = -1;
+    }
+  }
+  for(uint32_t i=0; i<layout.files.size(); i++) {
+    std::remove(layout.files[i].c_str());
+  }
+  std::remove((filename + STRIPE_LAYOUT_EXT).c_str());
+
+  GroupCommit commits(config);
+  try {
+    commits.written(filename);
+    std::cout << "Syncing a missing file succeeded!\n";
+    res = -1;
+  } catch(const std::ios_base::failure& e) {
+    std::cout << "Rejected: " << e.what() << std::endl;
+  }
+  return res;
+}
+
+// Checkpoints written by a deduplicator must be reported and still restart
+template<typename Deduplicator>
+int test_deduplicator(std::string name, std::string extension, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+  writer_config_t config = default_writer_config();
+  config.durability = DurableGroup;
+  config.group_chkpts = 4;
+  config.group_seconds = 0.0;
+  GroupCommit commits(config);
+  Deduplicator deduplicator(chunk_size);
+  deduplicator.set_writer_config(config);
+  deduplicator.set_group_commit(&commits);
+
+  std::vector<std::string> files;
+  std::string null("/dev/null/");
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size, false);
+    files.push_back("group_commit_test." + std::to_string(i));
+    std::string filename = files[i] + extension;
+    deduplicator.checkpoint(data.data(), data_len, filename, null, i==0);
+    Kokkos::fence();
+  }
+  commits.commit();
+  std::cout << name << ": " << commits.num_chkpts() << " checkpoints in " << commits.num_commits()
+            << " commits" << std::endl;
+  if((commits.num_chkpts() != num_chkpts) || (commits.num_commits() != (num_chkpts+3)/4)) {
+    std::cout << name << ": checkpoints were not reported to the group commit!\n";
+    res = -1;
+  }
+
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    Deduplicator restarter(chunk_size);
+    res = check_restart(restarter, files, i, data, name);
+  }
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove((files[i] + extension).c_str());
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_policies(num_chkpts);
+    if(res == 0)
+      res = test_striped();
+    if(res == 0)
+      res = test_deduplicator<FullDeduplicator>("Full", "", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_deduplicator<BasicDeduplicator>("Basic", ".basic.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_deduplicator<ListDeduplicator>("List", ".hashlist.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_deduplicator<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
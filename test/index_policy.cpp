@@ -0,0 +1,89 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Checkpoint with an index policy that evicts old first occurrences or drops unmatched
+// interior nodes. Entries must be evicted, checkpoints may only reference checkpoints
+// within the age limit, and every checkpoint must still restart correctly.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    uint32_t max_age = 2;
+    std::vector<std::string> tests = {"List max age", "Tree max age", "Tree drop unmatched"};
+    for(uint32_t test=0; test<tests.size() && res == 0; test++) {
+      BaseDeduplicator* deduplicator;
+      index_policy_t policy = {0, false};
+      if(test == 0) {
+        deduplicator = new ListDeduplicator(chunk_size);
+        policy.max_age = max_age;
+      } else if(test == 1) {
+        deduplicator = new TreeDeduplicator(chunk_size);
+        policy.max_age = max_age;
+      } else {
+        deduplicator = new TreeDeduplicator(chunk_size);
+        policy.drop_unmatched = true;
+      }
+      deduplicator->set_index_policy(policy);
+
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      TestData data(data_len);
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        Kokkos::View<uint8_t*>::HostMirror diff_h = next_chkpt(*deduplicator, data, incr_chkpts, chunk_size);
+
+        // Shifted duplicates may only reference checkpoints within the age limit
+        header_t header;
+        memcpy(&header, diff_h.data(), sizeof(header_t));
+        size_t counts_offset = sizeof(header_t) + static_cast<size_t>(header.num_first_ocur)*sizeof(uint32_t);
+        for(uint32_t c=0; c<header.num_prior_chkpts && policy.max_age > 0; c++) {
+          uint32_t prior = 0;
+          memcpy(&prior, diff_h.data()+counts_offset+c*2*sizeof(uint32_t), sizeof(uint32_t));
+          if((prior != i) && (prior + max_age < i)) {
+            std::cout << tests[test] << " checkpoint " << i
+                      << " references checkpoint " << prior << std::endl;
+            res = -1;
+          }
+        }
+      }
+
+      // The index must be reported after every checkpoint and entries must be evicted
+      const std::vector<index_stats_t>& stats = deduplicator->get_index_stats();
+      uint64_t num_evicted = 0;
+      for(uint32_t s=0; s<stats.size(); s++) {
+        num_evicted += stats[s].num_evicted;
+        if((stats[s].num_entries > stats[s].capacity) || (stats[s].memory_bytes == 0)) {
+          std::cout << tests[test] << " index after checkpoint " << stats[s].chkpt_id
+                    << " has " << stats[s].num_entries << " entries in "
+                    << stats[s].capacity << " slots" << std::endl;
+          res = -1;
+        }
+      }
+      if(res == 0 && (stats.size() != num_chkpts || (num_chkpts > max_age+1 && num_evicted == 0))) {
+        std::cout << tests[test] << " evicted " << num_evicted << " entries over "
+                  << stats.size() << " checkpoints" << std::endl;
+        res = -1;
+      }
+
+      if(res == 0)
+        res = check_restarts(*deduplicator, incr_chkpts, 0, data, tests[test]);
+      delete deduplicator;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
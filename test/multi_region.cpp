@@ -0,0 +1,140 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+void write_file(const std::string& filename, Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  f.write((const char*)(chkpt_h.data()), chkpt_h.size());
+  f.close();
+}
+
+// Checkpoint several separate buffers as one logical checkpoint. Chunks copied between
+// regions must only be stored once and every checkpoint must restart into new buffers
+// from host views and from files.
+template<typename Deduplicator>
+int test_regions(std::string name, std::string suffix, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  // Partial chunks at the end of each region, padded to 8192 chunks in total so the
+  // Tree has the same shape as in the single buffer tests
+  std::vector<uint64_t> sizes = {2300*static_cast<uint64_t>(chunk_size)+17, 
+                                 1700*static_cast<uint64_t>(chunk_size)+5, 
+                                 3*static_cast<uint64_t>(chunk_size)+1, 
+                                 0, 
+                                 4185*static_cast<uint64_t>(chunk_size)+3};
+  std::vector<std::string> names = {"pressure", "velocity", "params", "empty", "tracers"};
+  std::vector<Kokkos::View<uint8_t*>> views;
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> views_h;
+  std::vector<region_t> regions;
+  uint64_t total_len = 0;
+  for(uint32_t r=0; r<sizes.size(); r++) {
+    views.push_back(Kokkos::View<uint8_t*>(names[r], sizes[r]));
+    views_h.push_back(Kokkos::create_mirror_view(views[r]));
+    for(uint64_t j=0; j<sizes[r]; j++) {
+      views_h[r](j) = static_cast<uint8_t>(rand() % 256);
+    }
+    region_t region = {views[r].data(), sizes[r], names[r]};
+    regions.push_back(region);
+    total_len += sizes[r];
+  }
+  // Second region starts with a copy of the first
+  uint64_t copy_len = 1500*static_cast<uint64_t>(chunk_size);
+  memcpy(views_h[1].data(), views_h[0].data(), copy_len);
+
+  Deduplicator deduplicator(chunk_size);
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> incr_chkpts;
+  std::vector<std::string> chkpt_files;
+  std::vector<std::vector<std::string>> correct_digests;
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    if(i > 0) {
+      // Change part of a region and copy a chunk aligned block into another region
+      uint32_t r = static_cast<uint32_t>(rand()) % 2;
+      change_region(views_h[r].data(), sizes[r]);
+      uint64_t block = (std::min(sizes[4], sizes[1-r])/2)/chunk_size*chunk_size;
+      memcpy(views_h[4].data(), views_h[1-r].data(), block);
+    }
+    std::vector<std::string> digests;
+    for(uint32_t r=0; r<regions.size(); r++) {
+      Kokkos::deep_copy(views[r], views_h[r]);
+      digests.push_back(calculate_digest_host(views_h[r]));
+    }
+    correct_digests.push_back(digests);
+
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    deduplicator.checkpoint(regions, diff_h, i==0);
+    Kokkos::fence();
+    incr_chkpts.push_back(diff_h);
+    chkpt_files.push_back(std::string("multi_region_test.") + std::to_string(i));
+    write_file(chkpt_files[i] + suffix, diff_h);
+    if(i == 0) {
+      std::cout << name << " baseline: " << diff_h.size() << " bytes for " << total_len
+                << " bytes of regions" << std::endl;
+      if(diff_h.size() > total_len-copy_len/2)
+        res = -1;
+    }
+  }
+
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    for(uint32_t from_files=0; from_files<2 && res == 0; from_files++) {
+      std::vector<Kokkos::View<uint8_t*>> restart_views;
+      std::vector<region_t> restart_regions;
+      for(uint32_t r=0; r<sizes.size(); r++) {
+        restart_views.push_back(Kokkos::View<uint8_t*>("Restart " + names[r], sizes[r]));
+        region_t region = {restart_views[r].data(), sizes[r], names[r]};
+        restart_regions.push_back(region);
+      }
+      std::string null("/dev/null/");
+      if(from_files) {
+        deduplicator.restart(restart_regions, chkpt_files, null, i);
+      } else {
+        deduplicator.restart(restart_regions, incr_chkpts, null, i);
+      }
+      Kokkos::fence();
+      std::cout << name << " checkpoint " << i << (from_files ? " from files" : "") << std::endl;
+      for(uint32_t r=0; r<sizes.size() && res == 0; r++) {
+        auto restart_h = Kokkos::create_mirror_view(restart_views[r]);
+        Kokkos::deep_copy(restart_h, restart_views[r]);
+        std::string restart_digest = calculate_digest_host(restart_h);
+        res = correct_digests[i][r].compare(restart_digest);
+        if(res != 0) {
+          std::cout << "Region " << names[r] << " hashes don't match!\n";
+          std::cout << "Correct:          " << correct_digests[i][r] << std::endl;
+          std::cout << "Restarted:        " << restart_digest << std::endl;
+        }
+      }
+      if(res == 0)
+        std::cout << "Hashes match!\n";
+    }
+  }
+  for(uint32_t i=0; i<chkpt_files.size(); i++) {
+    std::remove((chkpt_files[i] + suffix).c_str());
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_regions<ListDeduplicator>("List", ".hashlist.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_regions<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,79 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Plan each checkpoint before making it and compare the predicted header, size, and
+// restart read volume with the checkpoint that is actually written. Planning must not
+// change the checkpoints that follow, so every checkpoint is also restarted.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    std::vector<std::string> approaches = {"Full", "Basic", "List", "Tree"};
+    std::vector<DedupMode> modes = {Full, Basic, List, Tree};
+    for(uint32_t mode=0; mode<approaches.size() && res == 0; mode++) {
+      BaseDeduplicator* deduplicator = make_deduplicator(modes[mode], chunk_size);
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      TestData data(data_len);
+
+      uint32_t ref_id = 0;
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        data.update(i, chunk_size);
+
+        // Plan a baseline that is never made, then plan the real checkpoint twice
+        deduplicator->plan(data.data(), data.size(), true);
+        chkpt_plan_t first = deduplicator->plan(data.data(), data.size(), i==0);
+        chkpt_plan_t plan = deduplicator->plan(data.data(), data.size(), i==0);
+
+        Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+        deduplicator->checkpoint(data.data(), data.size(), diff_h, i==0);
+        Kokkos::fence();
+        incr_chkpts.push_back(diff_h);
+
+        uint64_t restart_bytes = 0;
+        if(mode == 0) {
+          ref_id = i;
+        } else {
+          header_t header;
+          memcpy(&header, diff_h.data(), sizeof(header_t));
+          if(memcmp(&header, &plan.header, sizeof(header_t)) != 0) {
+            std::cout << approaches[mode] << " checkpoint " << i << " header differs from plan" << std::endl;
+            res = -1;
+          }
+          ref_id = header.ref_id;
+        }
+        for(uint32_t j=ref_id; j<=i; j++) {
+          restart_bytes += incr_chkpts[j].size();
+        }
+        if(plan.chkpt_bytes != diff_h.size() || plan.restart_bytes != restart_bytes ||
+           plan.chain_len != i-ref_id+1 || first.chkpt_bytes != plan.chkpt_bytes) {
+          std::cout << approaches[mode] << " checkpoint " << i << " planned " << plan.chkpt_bytes 
+                    << " bytes and " << plan.restart_bytes << " restart bytes, wrote " 
+                    << diff_h.size() << " bytes and " << restart_bytes << " restart bytes" << std::endl;
+          res = -1;
+        }
+      }
+
+      if(res == 0)
+        res = check_restarts(*deduplicator, incr_chkpts, 0, data, approaches[mode] + " planned");
+      delete deduplicator;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,77 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Restart byte ranges of each checkpoint and compare against the original data.
+// Data changes in small regions between checkpoints and blocks are copied to new
+// offsets so that ranges are resolved through fixed and shifted duplicates.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    std::vector<std::string> approaches = {"Full", "Basic", "List", "Tree"};
+    std::vector<DedupMode> modes = {Full, Basic, List, Tree};
+    for(uint32_t mode=0; mode<approaches.size() && res == 0; mode++) {
+      BaseDeduplicator* deduplicator = make_deduplicator(modes[mode], chunk_size);
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      TestData data(data_len);
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        next_chkpt(*deduplicator, data, incr_chkpts, chunk_size);
+
+        // Restart ranges that are unaligned, span several chunks, and run past the end
+        std::vector<std::pair<uint64_t,uint64_t>> ranges;
+        ranges.push_back(std::make_pair(0, chunk_size));
+        ranges.push_back(std::make_pair(chunk_size/2+3, 5*chunk_size+11));
+        ranges.push_back(std::make_pair(static_cast<uint64_t>(rand()) % data_len, data_len/10));
+        ranges.push_back(std::make_pair(data_len-chunk_size-5, 2*chunk_size));
+        for(uint32_t r=0; r<ranges.size(); r++) {
+          uint64_t offset = ranges[r].first;
+          uint64_t length = ranges[r].second;
+          if(offset+length > data_len)
+            length = data_len-offset;
+          // Every other range starts with a View too small to hold it
+          Kokkos::View<uint8_t*> range_d("Range buffer", (r % 2 == 0) ? length : 1);
+          std::string null("/dev/null/");
+          deduplicator->restart_range(range_d, offset, length, incr_chkpts, null, i);
+          Kokkos::fence();
+          Kokkos::View<uint8_t*>::HostMirror range_h = Kokkos::create_mirror_view(range_d);
+          Kokkos::deep_copy(range_h, range_d);
+
+          auto correct_h = Kokkos::subview(data.data_h, std::make_pair(offset, offset+length));
+          std::string correct = calculate_digest_host(correct_h, length);
+          std::string range_digest = calculate_digest_host(range_h);
+          res = correct.compare(range_digest);
+
+          std::cout << approaches[mode] << " checkpoint " << i
+                    << " range [" << offset << "," << offset+length << ")" << std::endl;
+          if(res == 0) {
+            std::cout << "Hashes match!\n";
+          } else {
+            std::cout << "Hashes don't match!\n";
+            std::cout << "Correct:     " << correct << std::endl;
+            std::cout << "Range chkpt: " << range_digest << std::endl;
+            break;
+          }
+        }
+      }
+      delete deduplicator;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,108 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+void write_file(const std::string& filename, const uint8_t* data, uint64_t len) {
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  f.write((const char*)(data), len);
+  f.close();
+}
+
+// Seed a deduplicator from reference files holding an older version of the data. The
+// first checkpoint must deduplicate against the reference instead of storing everything
+// and every checkpoint of the seeded chain, including the reference itself, must restart
+// correctly from host views and from files.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    std::vector<std::string> tests = {"Basic", "List", "Tree"};
+    std::vector<DedupMode> modes = {Basic, List, Tree};
+    std::vector<std::string> suffixes = {".basic.incr_chkpt", ".hashlist.incr_chkpt", ".hashtree.incr_chkpt"};
+    for(uint32_t test=0; test<tests.size() && res == 0; test++) {
+      // Reference image split over two files, shorter than the data so the end is zero-filled
+      uint64_t ref_len = data_len - data_len/8;
+      TestData data(data_len);
+      memset(data.data_h.data()+ref_len, 0, data_len-ref_len);
+      std::vector<std::string> reference_files = {"reference_seed_test.ref0", "reference_seed_test.ref1"};
+      uint64_t split = ref_len/3 + 7;
+      write_file(reference_files[0], data.data_h.data(), split);
+      write_file(reference_files[1], data.data_h.data()+split, ref_len-split);
+
+      BaseDeduplicator* seeded = make_deduplicator(modes[test], chunk_size);
+      BaseDeduplicator* unseeded = make_deduplicator(modes[test], chunk_size);
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      std::vector<std::string> chkpt_files;
+      Kokkos::View<uint8_t*>::HostMirror ref_h("Reference checkpoint", 1);
+      if(!seeded->seed_reference(reference_files, data_len, ref_h) || seeded->get_current_id() != 1) {
+        std::cout << tests[test] << " failed to seed from the reference files" << std::endl;
+        res = -1;
+      }
+      incr_chkpts.push_back(ref_h);
+      chkpt_files.push_back(std::string("reference_seed_test.reference"));
+      write_file(chkpt_files[0] + suffixes[test], ref_h.data(), ref_h.size());
+
+      data.update(0, chunk_size);
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        data.update(i+1, chunk_size);
+
+        Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+        seeded->checkpoint(data.data(), data.size(), diff_h, false);
+        Kokkos::fence();
+        incr_chkpts.push_back(diff_h);
+        chkpt_files.push_back(std::string("reference_seed_test.") + std::to_string(i));
+        write_file(chkpt_files[i+1] + suffixes[test], diff_h.data(), diff_h.size());
+
+        header_t header;
+        memcpy(&header, diff_h.data(), sizeof(header_t));
+        if((header.chkpt_id != i+1) || (header.ref_id != 0)) {
+          std::cout << tests[test] << " checkpoint " << i+1 << " has ID " << header.chkpt_id
+                    << " and baseline " << header.ref_id << std::endl;
+          res = -1;
+        }
+        // The first seeded checkpoint only stores what differs from the reference
+        if(i == 0) {
+          Kokkos::View<uint8_t*>::HostMirror full_h("Baseline", 1);
+          unseeded->checkpoint(data.data(), data.size(), full_h, true);
+          Kokkos::fence();
+          std::cout << tests[test] << " first checkpoint: " << diff_h.size() << " bytes seeded, "
+                    << full_h.size() << " bytes unseeded" << std::endl;
+          if(2*diff_h.size() > full_h.size())
+            res = -1;
+        }
+      }
+
+      for(uint32_t i=0; i<=num_chkpts && res == 0; i++) {
+        res = check_restart(*seeded, incr_chkpts, i, data, tests[test]);
+        if(res == 0)
+          res = check_restart(*seeded, chkpt_files, i, data, tests[test] + " from files");
+      }
+      for(uint32_t i=0; i<chkpt_files.size(); i++) {
+        std::remove((chkpt_files[i] + suffixes[test]).c_str());
+      }
+      for(uint32_t i=0; i<reference_files.size(); i++) {
+        std::remove(reference_files[i].c_str());
+      }
+      delete seeded;
+      delete unseeded;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,173 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Restart a checkpoint from a plan and compare it with the checkpointed data
+int check_restart(const RestartPlanCache& cache, const restart_plan_t& plan,
+                  const std::string& correct_digest, const std::string& name) {
+  Kokkos::View<uint8_t*> restart_d("Restart", 1);
+  cache.restart(plan, default_writer_config(), restart_d);
+  Kokkos::fence();
+  auto restart_h = Kokkos::create_mirror_view(restart_d);
+  Kokkos::deep_copy(restart_h, restart_d);
+  if((restart_h.size() != plan.datalen) || (correct_digest.compare(calculate_digest_host(restart_h)) != 0)) {
+    std::cout << name << ": checkpoint " << plan.chkpt_id << " restarted from its plan doesn't match!\n";
+    return -1;
+  }
+  return 0;
+}
+
+// Rewrite the last run of a plan file, returning whether the file had a run
+bool change_last_run(const std::string& plan_file, uint64_t src_shift, uint64_t len_cut) {
+  std::ifstream in(plan_file);
+  std::vector<std::string> lines;
+  std::string line;
+  while(std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  in.close();
+  uint32_t chkpt = 0;
+  uint64_t src = 0, dst = 0, len = 0;
+  std::istringstream run(lines.empty() ? std::string() : lines.back());
+  if((lines.size() < 2) || !(run >> chkpt >> src >> dst >> len))
+    return false;
+  lines.back() = std::to_string(chkpt) + " " + std::to_string(src+src_shift) + " " + std::to_string(dst) +
+                 " " + std::to_string(len-len_cut);
+  std::ofstream out(plan_file, std::ofstream::out | std::ofstream::trunc);
+  for(uint64_t i=0; i<lines.size(); i++) {
+    out << lines[i] << "\n";
+  }
+  return true;
+}
+
+// Plans must restart the same data as the chain they were resolved from, be found again
+// from their files by a new cache, and be discarded once a checkpoint they were resolved
+// from is recorded again in the manifest. Plan files whose runs leave a gap in the data
+// or reach past their checkpoint must not be used.
+template<typename Deduplicator>
+int test_plans(std::string name, std::string extension, bool tree_layout, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+  std::string manifest_file("restart_plan_test.manifest");
+  std::remove(manifest_file.c_str());
+  ChainManifest manifest(manifest_file);
+  std::vector<std::string> files;
+  std::string null("/dev/null/");
+  Deduplicator deduplicator(chunk_size);
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size, false);
+    files.push_back("restart_plan_test." + std::to_string(i) + extension);
+    deduplicator.checkpoint(data.data(), data_len, files[i], null, i==0);
+    Kokkos::fence();
+    manifest.record_file(i, files[i], true);
+  }
+
+  {
+    RestartPlanCache cache(manifest, manifest_file);
+    ChkptChain chain(files, tree_layout);
+    for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+      restart_plan_t plan;
+      if(cache.find(i, plan)) {
+        std::cout << name << ": found a plan for checkpoint " << i << " before resolving it!\n";
+        res = -1;
+      } else if(!cache.resolve(chain, i, plan)) {
+        std::cout << name << ": checkpoint " << i << " could not be planned!\n";
+        res = -1;
+      } else {
+        res = check_restart(cache, plan, data.correct_digests[i], name);
+      }
+    }
+  }
+
+  // Plans are read back from their files
+  RestartPlanCache cache(manifest, manifest_file);
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    restart_plan_t plan;
+    if(!cache.find(i, plan)) {
+      std::cout << name << ": plan of checkpoint " << i << " was not found in " << cache.plan_file(i) << "!\n";
+      res = -1;
+    } else {
+      res = check_restart(cache, plan, data.correct_digests[i], name);
+    }
+  }
+  if(res == 0)
+    std::cout << name << ": restarted " << num_chkpts << " checkpoints from " << cache.num_hits()
+              << " cached plans" << std::endl;
+
+  // Damaged plan files are resolved again
+  for(uint32_t damage=0; damage<2 && res == 0; damage++) {
+    manifest_entry_t entry;
+    manifest.find(0, entry);
+    uint64_t src_shift = (damage == 0) ? 0 : entry.length;
+    uint64_t len_cut = (damage == 0) ? 1 : 0;
+    restart_plan_t plan;
+    RestartPlanCache reopened(manifest, manifest_file);
+    if(change_last_run(reopened.plan_file(0), src_shift, len_cut) && reopened.find(0, plan)) {
+      std::cout << name << ": plan with " << ((damage == 0) ? "a gap" : "a run past its checkpoint")
+                << " was used!\n";
+      res = -1;
+    } else {
+      ChkptChain chain(files, tree_layout);
+      reopened.resolve(chain, 0, plan);
+    }
+  }
+
+  // Recording the last checkpoint again invalidates its plan but not the first one
+  if(res == 0) {
+    uint32_t last = num_chkpts-1;
+    std::fstream f(files[last], std::fstream::in | std::fstream::out | std::fstream::binary);
+    f.seekg(-1, std::fstream::end);
+    char c = static_cast<char>(f.get());
+    f.seekp(-1, std::fstream::end);
+    f.put(static_cast<char>(c ^ 0xFF));
+    f.close();
+    manifest.record_file(last, files[last], true);
+    restart_plan_t plan;
+    if((last > 0) && !cache.find(0, plan)) {
+      std::cout << name << ": plan of checkpoint 0 was invalidated by checkpoint " << last << "!\n";
+      res = -1;
+    }
+    RestartPlanCache reopened(manifest, manifest_file);
+    if(cache.find(last, plan) || reopened.find(last, plan)) {
+      std::cout << name << ": plan of checkpoint " << last << " survived recording it again!\n";
+      res = -1;
+    }
+  }
+
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove(files[i].c_str());
+    std::remove(cache.plan_file(i).c_str());
+  }
+  std::remove(manifest_file.c_str());
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_plans<BasicDeduplicator>("Basic", ".basic.incr_chkpt", false, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_plans<ListDeduplicator>("List", ".hashlist.incr_chkpt", false, chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_plans<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", true, chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,66 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+// Build a reverse-incremental chain: every checkpoint is written complete and the previous
+// checkpoint is rewritten as a reverse delta against it. Restart every checkpoint.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    std::vector<std::string> approaches = {"Basic", "List", "Tree"};
+    std::vector<DedupMode> modes = {Basic, List, Tree};
+    for(uint32_t mode=0; mode<approaches.size() && res == 0; mode++) {
+      BaseDeduplicator* deduplicator = make_deduplicator(modes[mode], chunk_size);
+      std::vector< Kokkos::View<uint8_t*>::HostMirror > incr_chkpts;
+      TestData data(data_len);
+      for(uint32_t i=0; i<num_chkpts; i++) {
+        data.update(i, chunk_size);
+
+        // Newest checkpoint is complete
+        Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+        deduplicator->checkpoint(data.data(), data.size(), diff_h, true);
+        Kokkos::fence();
+        incr_chkpts.push_back(diff_h);
+
+        // Previous checkpoint becomes a reverse delta
+        if(i > 0) {
+          ChkptChain chain(incr_chkpts, mode == 2);
+          chain.reverse_delta(i-1, incr_chkpts[i-1]);
+        }
+      }
+
+      for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+        header_t header;
+        memcpy(&header, incr_chkpts[i].data(), sizeof(header_t));
+        uint32_t expected_ref = (i == num_chkpts-1) ? i : i+1;
+        if(header.ref_id != expected_ref) {
+          std::cout << approaches[mode] << " checkpoint " << i
+                    << " references checkpoint " << header.ref_id << std::endl;
+          res = -1;
+          break;
+        }
+
+        res = check_restart(*deduplicator, incr_chkpts, i, data, approaches[mode] + " reverse");
+      }
+      delete deduplicator;
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,203 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+#define EMULATED_DIR "storage_emulator_test_dir"
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Reads and writes of emulated files must take at least as long as the bandwidth,
+// latency, and concurrency limit allow, files elsewhere must not be held back, and the
+// data must come back unchanged.
+int test_transfers() {
+  int res = 0;
+  uint64_t len = 4*1024*1024;
+  std::vector<uint8_t> data(len), read_back(len);
+  for(uint64_t i=0; i<len; i++) {
+    data[i] = static_cast<uint8_t>(rand() % 256);
+  }
+  writer_config_t config = default_writer_config();
+  config.backend = WriterStriped;
+  config.stripe_threads = 4;
+  config.stripe_size = 256*1024;
+  std::string emulated = std::string(EMULATED_DIR) + "/storage_emulator_test.bin";
+  std::string local = "storage_emulator_test.bin";
+
+  // Bandwidth is shared by the stripes written and read in parallel
+  storage_model_t model = default_storage_model();
+  model.dir = EMULATED_DIR;
+  model.write_bandwidth = 32*1024*1024;
+  model.read_bandwidth = 64*1024*1024;
+  set_storage_model(model);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  write_striped(emulated, data.data(), len, config, false);
+  double write_time = seconds_since(start);
+  start = std::chrono::steady_clock::now();
+  read_striped(emulated, 0, len, read_back.data(), config);
+  double read_time = seconds_since(start);
+  double expected_write = static_cast<double>(len)/model.write_bandwidth;
+  double expected_read = static_cast<double>(len)/model.read_bandwidth;
+  std::cout << "Emulated write: " << write_time << " seconds (at least " << expected_write
+            << "), read: " << read_time << " seconds (at least " << expected_read << ")" << std::endl;
+  if((write_time < 0.9*expected_write) || (read_time < 0.9*expected_read)) {
+    std::cout << "Emulated transfers were not throttled!\n";
+    res = -1;
+  }
+  if(memcmp(data.data(), read_back.data(), len) != 0) {
+    std::cout << "Emulated file doesn't match!\n";
+    res = -1;
+  }
+  storage_stats_t stats = get_storage_stats();
+  if((stats.bytes_written != len) || (stats.bytes_read != len) ||
+     (stats.num_transfers != 2*len/config.stripe_size)) {
+    std::cout << "Emulated storage counted " << stats.bytes_written << " bytes written, "
+              << stats.bytes_read << " bytes read in " << stats.num_transfers << " transfers!\n";
+    res = -1;
+  }
+
+  // Files outside the directory are not emulated
+  start = std::chrono::steady_clock::now();
+  write_striped(local, data.data(), len, config, false);
+  double local_time = seconds_since(start);
+  if((local_time > 0.5*expected_write) || (get_storage_stats().bytes_written != len)) {
+    std::cout << "File outside the emulated directory was held back!\n";
+    res = -1;
+  }
+
+  // Latency of transfers is only hidden up to the concurrency limit
+  uint32_t num_pieces = 16;
+  config.stripe_size = len/num_pieces;
+  model = default_storage_model();
+  model.dir = EMULATED_DIR;
+  model.latency = 0.01;
+  for(uint32_t concurrency=1; concurrency<=4 && res == 0; concurrency*=4) {
+    model.max_concurrency = concurrency;
+    set_storage_model(model);
+    start = std::chrono::steady_clock::now();
+    read_striped(emulated, 0, len, read_back.data(), config);
+    double elapsed = seconds_since(start);
+    double expected = num_pieces*model.latency/concurrency;
+    std::cout << "Concurrency " << concurrency << ": " << elapsed << " seconds (at least "
+              << expected << ")" << std::endl;
+    if(elapsed < 0.9*expected) {
+      std::cout << "Emulated concurrency limit was not enforced!\n";
+      res = -1;
+    }
+  }
+
+  // Opens are served one at a time with the metadata cost
+  model = default_storage_model();
+  model.dir = EMULATED_DIR;
+  model.metadata_cost = 0.005;
+  set_storage_model(model);
+  uint32_t num_opens = 10;
+  start = std::chrono::steady_clock::now();
+  for(uint32_t i=0; i<num_opens; i++) {
+    int fd = storage_open(emulated, O_RDONLY);
+    if(!storage_fd_emulated(fd)) {
+      std::cout << "Descriptor of an emulated file is not emulated!\n";
+      res = -1;
+    }
+    storage_close(fd);
+  }
+  double elapsed = seconds_since(start);
+  if((elapsed < 0.9*num_opens*model.metadata_cost) || (get_storage_stats().num_metadata_ops != num_opens)) {
+    std::cout << "Metadata cost was not paid: " << elapsed << " seconds for " << num_opens << " opens\n";
+    res = -1;
+  }
+
+  set_storage_model(default_storage_model());
+  std::remove(emulated.c_str());
+  std::remove(local.c_str());
+  return res;
+}
+
+// Checkpoints written to and restarted from the emulated storage must restart the same
+// data, and every byte of the checkpoint files must go through the emulator
+template<typename Deduplicator>
+int test_chkpt_files(std::string name, std::string extension, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+  storage_model_t model = default_storage_model();
+  model.dir = EMULATED_DIR;
+  model.write_bandwidth = 256*1024*1024;
+  model.read_bandwidth = 256*1024*1024;
+  model.latency = 0.0001;
+  model.metadata_cost = 0.0001;
+  set_storage_model(model);
+
+  std::vector<std::string> files;
+  std::string null("/dev/null/");
+  Deduplicator deduplicator(chunk_size);
+  uint64_t total = 0;
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size, false);
+    files.push_back(std::string(EMULATED_DIR) + "/storage_emulator_test." + std::to_string(i));
+    std::string filename = files[i] + extension;
+    deduplicator.checkpoint(data.data(), data_len, filename, null, i==0);
+    Kokkos::fence();
+    total += striped_size(filename);
+  }
+  storage_stats_t stats = get_storage_stats();
+  if(stats.bytes_written != total) {
+    std::cout << name << ": emulated storage wrote " << stats.bytes_written << " of " << total << " bytes!\n";
+    res = -1;
+  }
+
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    Deduplicator restarter(chunk_size);
+    res = check_restart(restarter, files, i, data, name);
+  }
+  stats = get_storage_stats();
+  std::cout << name << ": " << stats.bytes_written << " bytes written, " << stats.bytes_read
+            << " bytes read, " << stats.num_metadata_ops << " metadata operations, "
+            << stats.delay << " seconds of delay" << std::endl;
+  if((res == 0) && (stats.bytes_read == 0)) {
+    std::cout << name << ": restarts did not read from the emulated storage!\n";
+    res = -1;
+  }
+  set_storage_model(default_storage_model());
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove((files[i] + extension).c_str());
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+    mkdir(EMULATED_DIR, 0755);
+
+    res = test_transfers();
+    if(res == 0)
+      res = test_chkpt_files<BasicDeduplicator>("Basic", ".basic.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_files<ListDeduplicator>("List", ".hashlist.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_chkpt_files<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", chunk_size, num_chkpts);
+    rmdir(EMULATED_DIR);
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,80 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+void write_file(const std::string& filename, const uint8_t* data, uint64_t len) {
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  f.write((const char*)(data), len);
+  f.close();
+}
+
+uint64_t file_size(const std::string& filename) {
+  std::ifstream f(filename, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+  return static_cast<uint64_t>(f.tellg());
+}
+
+// Checkpoint files in windows smaller than the data. Chunks duplicated across windows
+// must only be stored once, every streamed checkpoint must be as large as the one made
+// from the whole data, and every checkpoint must restart correctly.
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    uint64_t data_len = 1024*1024;
+    // Windows end in the middle of the data and the last one is partial
+    uint64_t window_len = 1000*static_cast<uint64_t>(chunk_size)+chunk_size/2;
+    ListDeduplicator streamed(chunk_size);
+    ListDeduplicator whole(chunk_size);
+    TestData data(data_len);
+    // Second half starts with a copy of the first window
+    memcpy(data.data_h.data()+data_len/2, data.data_h.data(), window_len);
+
+    std::vector<std::string> chkpt_files;
+    std::string null("/dev/null/");
+    for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+      data.update(i, chunk_size);
+
+      std::string input = std::string("stream_chkpt_test.") + std::to_string(i);
+      write_file(input, data.data_h.data(), data_len);
+      chkpt_files.push_back(input);
+      std::string filename = input + ".hashlist.incr_chkpt";
+      streamed.checkpoint_stream(input, window_len, filename, null, i==0);
+      Kokkos::fence();
+      std::remove(input.c_str());
+
+      Kokkos::View<uint8_t*>::HostMirror whole_h("Whole diff", 1);
+      whole.checkpoint(data.data(), data_len, whole_h, i==0);
+      Kokkos::fence();
+      uint64_t streamed_size = file_size(filename);
+      std::cout << "Checkpoint " << i << ": " << streamed_size << " bytes streamed, "
+                << whole_h.size() << " bytes whole" << std::endl;
+      if(streamed_size != whole_h.size())
+        res = -1;
+      if(i == 0 && streamed_size > data_len-window_len/2)
+        res = -1;
+    }
+
+    if(res == 0)
+      res = check_restarts(streamed, chkpt_files, 0, data, "Streamed");
+    for(uint32_t i=0; i<chkpt_files.size(); i++) {
+      std::remove((chkpt_files[i] + ".hashlist.incr_chkpt").c_str());
+    }
+  }
+  Kokkos::finalize();
+  return res;
+}
@@ -0,0 +1,178 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include <type_traits>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+bool file_exists(const std::string& filename) {
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0;
+}
+
+// Data written in stripes, in one file or split over several files and directories,
+// must read back exactly, as a whole and in ranges that cross stripes.
+int test_striped_io(bool split, uint32_t num_threads) {
+  writer_config_t config = default_writer_config();
+  config.backend = WriterStriped;
+  config.stripe_threads = num_threads;
+  config.stripe_size = 4096*3+17;
+  config.stripe_files = split ? 5 : 1;
+  if(split)
+    config.stripe_dirs.push_back("striped_io_test_dir");
+  uint64_t data_len = 1000003;
+  std::vector<uint8_t> data(data_len);
+  for(uint64_t j=0; j<data_len; j++) {
+    data[j] = static_cast<uint8_t>(rand() % 256);
+  }
+  std::string filename("striped_io_test.data");
+  uint64_t num_written = write_striped(filename, data.data(), data_len, config, split);
+
+  stripe_layout_t layout;
+  read_stripe_layout(filename, layout);
+  std::cout << (split ? "Split" : "Single file") << " with " << num_threads << " threads: "
+            << num_written << " bytes in " << layout.files.size() << " files" << std::endl;
+  int res = 0;
+  if((num_written != data_len) || (striped_size(filename) != data_len) ||
+     (layout.files.size() != config.stripe_files)) {
+    std::cout << "Wrong size or number of files!\n";
+    res = -1;
+  }
+  for(uint32_t i=1; i<layout.files.size() && res == 0; i++) {
+    if(!file_exists(layout.files[i])) {
+      std::cout << "Missing stripe file " << layout.files[i] << std::endl;
+      res = -1;
+    }
+  }
+  if(split && (res == 0) && !file_exists("striped_io_test_dir/striped_io_test.data.stripe1")) {
+    std::cout << "No stripe file in the stripe directory!\n";
+    res = -1;
+  }
+
+  // Whole data and ranges, read in parallel and by one thread
+  writer_config_t serial = default_writer_config();
+  std::vector<uint8_t> read_back(data_len);
+  if(res == 0) {
+    read_striped(filename, 0, data_len, read_back.data(), config);
+    if(memcmp(read_back.data(), data.data(), data_len) != 0) {
+      std::cout << "Data doesn't match!\n";
+      res = -1;
+    }
+  }
+  for(uint32_t i=0; i<20 && res == 0; i++) {
+    uint64_t offset = static_cast<uint64_t>(rand()) % data_len;
+    uint64_t len = static_cast<uint64_t>(rand()) % (data_len-offset);
+    read_striped(filename, offset, len, read_back.data(), (i % 2 == 0) ? config : serial);
+    if(memcmp(read_back.data(), data.data()+offset, len) != 0) {
+      std::cout << "Range [" << offset << ", " << offset+len << ") doesn't match!\n";
+      res = -1;
+    }
+  }
+
+  remove_stripes(filename);
+  std::remove(filename.c_str());
+  for(uint32_t i=1; i<layout.files.size(); i++) {
+    if(file_exists(layout.files[i])) {
+      std::cout << "Stripe file " << layout.files[i] << " was not removed!\n";
+      res = -1;
+    }
+  }
+  return res;
+}
+
+// Full checkpoints split over several files must restart to the checkpointed data and
+// incremental checkpoints written in stripes must hold exactly the bytes of the same
+// checkpoints copied to the Host.
+template<typename Deduplicator>
+int test_striped_chkpt(std::string name, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  writer_config_t config = default_writer_config();
+  config.backend = WriterStriped;
+  config.stripe_threads = 4;
+  config.stripe_size = 64*1024+chunk_size;
+  config.stripe_files = 3;
+  config.stripe_dirs.push_back("striped_io_test_dir");
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  Deduplicator to_file(chunk_size);
+  Deduplicator to_host(chunk_size);
+  to_file.set_writer_config(config);
+  std::vector<std::string> chkpt_files;
+  std::string null("/dev/null/");
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    data.update(i, chunk_size, false);
+
+    chkpt_files.push_back(std::string("striped_io_test.") + std::to_string(i) + ".chkpt");
+    to_file.checkpoint(data.data(), data_len, chkpt_files[i], null, i==0);
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    to_host.checkpoint(data.data(), data_len, diff_h, i==0);
+    Kokkos::fence();
+
+    stripe_layout_t layout;
+    read_stripe_layout(chkpt_files[i], layout);
+    std::vector<uint8_t> file_bytes(striped_size(chkpt_files[i]));
+    read_striped(chkpt_files[i], 0, file_bytes.size(), file_bytes.data(), config);
+    std::cout << name << " checkpoint " << i << ": " << file_bytes.size() << " bytes in "
+              << layout.files.size() << " files" << std::endl;
+    if((file_bytes.size() != diff_h.size()) ||
+       (memcmp(file_bytes.data(), diff_h.data(), diff_h.size()) != 0)) {
+      std::cout << "File doesn't match the Host checkpoint of " << diff_h.size() << " bytes!\n";
+      res = -1;
+    }
+
+    // Only Full checkpoints, which are read whole, are split
+    bool is_full = std::is_same<Deduplicator, FullDeduplicator>::value;
+    if((res == 0) && (layout.files.size() != (is_full ? config.stripe_files : 1))) {
+      std::cout << "Checkpoint has the wrong number of files!\n";
+      res = -1;
+    }
+    if((res == 0) && is_full) {
+      Deduplicator restarter(chunk_size);
+      restarter.set_writer_config(config);
+      res = check_restart(restarter, chkpt_files, i, data, name + " striped");
+    }
+  }
+  for(uint32_t i=0; i<chkpt_files.size(); i++) {
+    remove_stripes(chkpt_files[i]);
+    std::remove(chkpt_files[i].c_str());
+  }
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+    mkdir("striped_io_test_dir", 0755);
+
+    res = test_striped_io(false, 1);
+    if(res == 0)
+      res = test_striped_io(false, 4);
+    if(res == 0)
+      res = test_striped_io(true, 4);
+    if(res == 0)
+      res = test_striped_chkpt<FullDeduplicator>("Full", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_striped_chkpt<ListDeduplicator>("List", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_striped_chkpt<TreeDeduplicator>("Tree", chunk_size, num_chkpts);
+    rmdir("striped_io_test_dir");
+  }
+  Kokkos::finalize();
+  return res;
+}
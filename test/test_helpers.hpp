@@ -0,0 +1,160 @@
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "deduplicator.hpp"
+#include "utils.hpp"
+
+// Fixed seed for rand() so that a failing run can be reproduced
+#define TEST_SEED 1931
+
+// Randomize a sixteenth of the data starting somewhere in its first half
+inline void change_region(uint8_t* data, uint64_t len) {
+  uint64_t change_start = static_cast<uint64_t>(rand()) % (len/2);
+  for(uint64_t j=change_start; j<change_start+len/16; j++) {
+    data[j] = static_cast<uint8_t>(rand() % 256);
+  }
+}
+
+// Change a small region and copy a chunk aligned block to a different offset, so the
+// next checkpoint has first occurrences, fixed duplicates, and shifted duplicates
+inline void change_and_shift(uint8_t* data, uint64_t len, uint64_t chunk_size) {
+  change_region(data, len);
+  uint64_t copy_len = len/8;
+  uint64_t copy_src = (static_cast<uint64_t>(rand()) % (len-copy_len))/chunk_size*chunk_size;
+  uint64_t copy_dst = (static_cast<uint64_t>(rand()) % (len-copy_len))/chunk_size*chunk_size;
+  memmove(data+copy_dst, data+copy_src, copy_len);
+}
+
+inline BaseDeduplicator* make_deduplicator(DedupMode mode, uint32_t chunk_size) {
+  if(mode == Full)
+    return new FullDeduplicator(chunk_size);
+  if(mode == Basic)
+    return new BasicDeduplicator(chunk_size);
+  if(mode == List)
+    return new ListDeduplicator(chunk_size);
+  return new TreeDeduplicator(chunk_size);
+}
+
+// Random data on the Device and Host that changes before every checkpoint of a test
+// chain. The digest of every version is kept to check restarted checkpoints against.
+class TestData {
+  public:
+    Kokkos::View<uint8_t*> data_d;
+    Kokkos::View<uint8_t*>::HostMirror data_h;
+    std::vector<std::string> correct_digests;
+
+    TestData(uint64_t data_len) : data_d("Device data", data_len) {
+      data_h = Kokkos::create_mirror_view(data_d);
+      for(uint64_t j=0; j<data_len; j++) {
+        data_h(j) = static_cast<uint8_t>(rand() % 256);
+      }
+    }
+
+    uint8_t* data() const {
+      return (uint8_t*)(data_d.data());
+    }
+
+    uint64_t size() const {
+      return data_d.size();
+    }
+
+    /**
+     * Make the version of the data for checkpoint chkpt_id, copy it to the Device and
+     * record its digest. Later versions change a region and, if shift is set, copy a
+     * chunk aligned block to a different offset.
+     *
+     * \param chkpt_id   ID of the checkpoint the data is for
+     * \param chunk_size Size of the chunks that shifted blocks are aligned to
+     * \param shift      Whether to shift a block besides changing a region
+     */
+    void update(uint32_t chkpt_id, uint32_t chunk_size, bool shift=true) {
+      if(chkpt_id > 0) {
+        if(shift) {
+          change_and_shift(data_h.data(), data_h.size(), chunk_size);
+        } else {
+          change_region(data_h.data(), data_h.size());
+        }
+      }
+      Kokkos::deep_copy(data_d, data_h);
+      correct_digests.push_back(calculate_digest_host(data_h));
+    }
+};
+
+/**
+ * Checkpoint the next version of the data and append the checkpoint to the chain. The
+ * first checkpoint is a baseline.
+ *
+ * \param deduplicator Deduplicator making the checkpoint
+ * \param data         Data of the test chain
+ * \param incr_chkpts  Checkpoints of the chain so far
+ * \param chunk_size   Size of the chunks
+ *
+ * \return Checkpoint that was appended
+ */
+template<typename Deduplicator>
+Kokkos::View<uint8_t*>::HostMirror
+next_chkpt(Deduplicator& deduplicator, TestData& data,
+           std::vector<Kokkos::View<uint8_t*>::HostMirror>& incr_chkpts, uint32_t chunk_size) {
+  uint32_t chkpt_id = static_cast<uint32_t>(incr_chkpts.size());
+  data.update(chkpt_id, chunk_size);
+  Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+  deduplicator.checkpoint(data.data(), data.size(), diff_h, chkpt_id == 0);
+  Kokkos::fence();
+  incr_chkpts.push_back(diff_h);
+  return diff_h;
+}
+
+/**
+ * Restart a checkpoint into a new Device buffer and compare it with the data it was
+ * made from.
+ *
+ * \param deduplicator Deduplicator restarting the checkpoint
+ * \param chkpts       Checkpoints of the chain, as Host Views or filenames
+ * \param chkpt_id     ID of the checkpoint to restart
+ * \param data         Data of the test chain
+ * \param name         Name of the checkpoint printed with the result
+ *
+ * \return 0 if the restarted data matches, nonzero otherwise
+ */
+template<typename Deduplicator, typename Chkpts>
+int check_restart(Deduplicator& deduplicator, Chkpts& chkpts, uint32_t chkpt_id,
+                  const TestData& data, const std::string& name) {
+  Kokkos::View<uint8_t*> restart_d("Restart buffer", data.size());
+  Kokkos::View<uint8_t*>::HostMirror restart_h = Kokkos::create_mirror_view(restart_d);
+  std::string null("/dev/null/");
+  deduplicator.restart(restart_d, chkpts, null, chkpt_id);
+  Kokkos::fence();
+  Kokkos::deep_copy(restart_h, restart_d);
+  std::string restart_digest = calculate_digest_host(restart_h);
+  int res = data.correct_digests[chkpt_id].compare(restart_digest);
+
+  std::cout << name << " checkpoint " << chkpt_id << std::endl;
+  if(res == 0) {
+    std::cout << "Hashes match!\n";
+  } else {
+    std::cout << "Hashes don't match!\n";
+    std::cout << "Correct:          " << data.correct_digests[chkpt_id] << std::endl;
+    std::cout << "Restarted:        " << restart_digest << std::endl;
+  }
+  return res;
+}
+
+// Restart every checkpoint of a chain from first on and stop at the first mismatch
+template<typename Deduplicator, typename Chkpts>
+int check_restarts(Deduplicator& deduplicator, Chkpts& chkpts, uint32_t first,
+                   const TestData& data, const std::string& name) {
+  int res = 0;
+  for(uint32_t i=first; i<data.correct_digests.size() && res == 0; i++) {
+    res = check_restart(deduplicator, chkpts, i, data, name);
+  }
+  return res;
+}
+
+#endif // TEST_HELPERS_HPP
@@ -0,0 +1,224 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+bool file_exists(const std::string& filename) {
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0;
+}
+
+// Checkpoints put into the ring must be flushed to the slow tier with the same bytes,
+// only the last capacity checkpoints may stay in the fast tier, and every checkpoint
+// must restart from the fastest tier that holds it.
+template<typename Deduplicator>
+int test_tiered_store(std::string name, uint32_t chunk_size, uint32_t num_chkpts, bool fast_dir) {
+  int res = 0;
+  uint64_t data_len = 1024*1024;
+  TestData data(data_len);
+
+  tier_config_t config = default_tier_config();
+  config.capacity = 3;
+  config.fast_dir = fast_dir ? "tiered_store_test_fast" : "";
+  config.slow_dir = "tiered_store_test_slow";
+  std::vector<std::string> names;
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> chkpts;
+  TieredStore store(config);
+  Deduplicator deduplicator(chunk_size);
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    data.update(i, chunk_size, false);
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    deduplicator.checkpoint(data.data(), data_len, diff_h, i==0);
+    Kokkos::fence();
+    chkpts.push_back(diff_h);
+    names.push_back(std::string("some_dir/tiered_store_test.") + std::to_string(i) + ".chkpt");
+    store.put(i, names[i], diff_h);
+  }
+
+  // Restart every checkpoint through the store before and after the flush
+  for(uint32_t pass=0; pass<2 && res == 0; pass++) {
+    if(pass == 1)
+      store.drain();
+    for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+      std::vector<Kokkos::View<uint8_t*>::HostMirror> restart_chkpts;
+      for(uint32_t j=0; j<=i && res == 0; j++) {
+        Kokkos::View<uint8_t*>::HostMirror chkpt;
+        if(!store.get(j, chkpt)) {
+          std::cout << "Checkpoint " << j << " is in no tier!\n";
+          res = -1;
+        }
+        restart_chkpts.push_back(chkpt);
+      }
+      if(res != 0)
+        break;
+      Deduplicator restarter(chunk_size);
+      res = check_restart(restarter, restart_chkpts, i, data, name);
+    }
+  }
+
+  // Flushed files hold the checkpoints, only the last ones stay in the fast directory
+  uint64_t total = 0;
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    std::string slow_file = config.slow_dir + "/tiered_store_test." + std::to_string(i) + ".chkpt";
+    std::string fast_file = config.fast_dir + "/tiered_store_test." + std::to_string(i) + ".chkpt";
+    std::vector<uint8_t> file_bytes(striped_size(slow_file));
+    read_striped(slow_file, 0, file_bytes.size(), file_bytes.data(), default_writer_config());
+    total += file_bytes.size();
+    if((file_bytes.size() != chkpts[i].size()) ||
+       (memcmp(file_bytes.data(), chkpts[i].data(), chkpts[i].size()) != 0)) {
+      std::cout << "Flushed checkpoint " << i << " doesn't match!\n";
+      res = -1;
+    }
+    bool in_ring = i+config.capacity >= num_chkpts;
+    if(fast_dir && (file_exists(fast_file) != in_ring)) {
+      std::cout << "Checkpoint " << i << (in_ring ? " is missing from" : " was not evicted from")
+                << " the fast tier!\n";
+      res = -1;
+    }
+    if((res == 0) && TieredStore::locate(config, names[i]).compare(fast_dir && in_ring ? fast_file : slow_file) != 0) {
+      std::cout << "Checkpoint " << i << " is not located in the fastest tier!\n";
+      res = -1;
+    }
+  }
+  if((res == 0) && (store.bytes_flushed() != total)) {
+    std::cout << "Flushed " << store.bytes_flushed() << " of " << total << " bytes!\n";
+    res = -1;
+  }
+  std::cout << name << (fast_dir ? " in a directory" : " in memory") << ": " << total
+            << " bytes flushed, put waited " << store.stall_time() << " seconds" << std::endl;
+
+  for(uint32_t i=0; i<num_chkpts; i++) {
+    std::remove((config.slow_dir + "/tiered_store_test." + std::to_string(i) + ".chkpt").c_str());
+    if(fast_dir)
+      std::remove((config.fast_dir + "/tiered_store_test." + std::to_string(i) + ".chkpt").c_str());
+  }
+  return res;
+}
+
+// A throttled flush must take at least as long as the bandwidth allows and must not
+// hold up put while the ring has room
+int test_flush_bandwidth() {
+  tier_config_t config = default_tier_config();
+  config.capacity = 4;
+  config.slow_dir = "tiered_store_test_slow";
+  config.flush_bandwidth = 8*1024*1024;
+  uint64_t len = 2*1024*1024;
+  Kokkos::View<uint8_t*>::HostMirror chkpt("Chkpt", len);
+  memset(chkpt.data(), 3, len);
+  int res = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  double put_seconds = 0.0;
+  {
+    TieredStore store(config);
+    for(uint32_t i=0; i<4; i++) {
+      store.put(i, std::string("tiered_store_test.bw") + std::to_string(i), chkpt, false);
+    }
+    std::chrono::duration<double> put_time = std::chrono::steady_clock::now() - start;
+    put_seconds = put_time.count();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  double expected = static_cast<double>(4*len)/config.flush_bandwidth;
+  std::cout << "Throttled flush: " << elapsed.count() << " seconds (at least " << expected
+            << "), put took " << put_seconds << " seconds" << std::endl;
+  if((elapsed.count() < 0.9*expected) || (put_seconds > 0.5*expected)) {
+    std::cout << "Flush was not throttled in the background!\n";
+    res = -1;
+  }
+  for(uint32_t i=0; i<4; i++) {
+    std::string filename = config.slow_dir + "/tiered_store_test.bw" + std::to_string(i);
+    if(striped_size(filename) != len) {
+      std::cout << "Missing flushed file " << filename << std::endl;
+      res = -1;
+    }
+    std::remove(filename.c_str());
+  }
+  return res;
+}
+
+// A checkpoint whose flush fails must stay in the ring, the failure must be thrown by
+// drain, and the checkpoint must be flushed once the slow tier can be written
+int test_flush_retry() {
+  tier_config_t config = default_tier_config();
+  config.capacity = 2;
+  config.slow_dir = "tiered_store_test_missing";
+  uint64_t len = 64*1024;
+  Kokkos::View<uint8_t*>::HostMirror chkpt("Chkpt", len);
+  memset(chkpt.data(), 5, len);
+  std::string filename = config.slow_dir + "/tiered_store_test.retry";
+  int res = 0;
+  {
+    TieredStore store(config);
+    store.put(0, "tiered_store_test.retry", chkpt, false);
+    bool failed = false;
+    try {
+      store.drain();
+    } catch(const std::ios_base::failure& e) {
+      failed = true;
+    }
+    Kokkos::View<uint8_t*>::HostMirror held;
+    if(!failed || (store.bytes_flushed() != 0)) {
+      std::cout << "Failed flush was not reported!\n";
+      res = -1;
+    } else if(!store.get(0, held) || (held.data() != chkpt.data())) {
+      std::cout << "Checkpoint left the ring after a failed flush!\n";
+      res = -1;
+    }
+    mkdir(config.slow_dir.c_str(), 0755);
+    try {
+      store.drain();
+    } catch(const std::ios_base::failure& e) {
+      // The retry may have run before the directory existed
+      store.drain();
+    }
+    if((res == 0) && ((store.bytes_flushed() != len) || (striped_size(filename) != len))) {
+      std::cout << "Failed flush was not retried!\n";
+      res = -1;
+    }
+  }
+  if(res == 0)
+    std::cout << "Failed flush retried" << std::endl;
+  std::remove(filename.c_str());
+  rmdir(config.slow_dir.c_str());
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+    mkdir("tiered_store_test_fast", 0755);
+    mkdir("tiered_store_test_slow", 0755);
+
+    res = test_flush_bandwidth();
+    if(res == 0)
+      res = test_flush_retry();
+    if(res == 0)
+      res = test_tiered_store<BasicDeduplicator>("Basic", chunk_size, num_chkpts, false);
+    if(res == 0)
+      res = test_tiered_store<ListDeduplicator>("List", chunk_size, num_chkpts, true);
+    if(res == 0)
+      res = test_tiered_store<TreeDeduplicator>("Tree", chunk_size, num_chkpts, false);
+    if(res == 0)
+      res = test_tiered_store<TreeDeduplicator>("Tree", chunk_size, num_chkpts, true);
+    rmdir("tiered_store_test_fast");
+    rmdir("tiered_store_test_slow");
+  }
+  Kokkos::finalize();
+  return res;
+}
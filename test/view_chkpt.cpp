@@ -0,0 +1,150 @@
+#include <Kokkos_Core.hpp>
+#include "stdio.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include "deduplicator.hpp"
+#include <iostream>
+#include <utility>
+#include "utils.hpp"
+#include "test_helpers.hpp"
+
+void write_file(const std::string& filename, Kokkos::View<uint8_t*>::HostMirror& chkpt_h) {
+  std::ofstream f(filename, std::ofstream::out | std::ofstream::binary);
+  f.write((const char*)(chkpt_h.data()), chkpt_h.size());
+  f.close();
+}
+
+// Checkpoint a View, or a subview of a parent View, without packing it. Every checkpoint
+// must restart into the same subview of a new parent from host views and from files
+// without touching the parent outside the subview.
+template<typename Deduplicator, typename ParentType, typename SubviewFunc>
+int test_view(std::string name, std::string suffix, ParentType parent, SubviewFunc make_view,
+              uint32_t num_regions, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  using value_type = typename ParentType::value_type;
+  auto view = make_view(parent);
+  auto parent_h = Kokkos::create_mirror_view(parent);
+  uint64_t parent_len = parent.size()*sizeof(value_type);
+  uint8_t* parent_bytes = reinterpret_cast<uint8_t*>(parent_h.data());
+  for(uint64_t j=0; j<parent_len; j++) {
+    parent_bytes[j] = static_cast<uint8_t>(rand() % 256);
+  }
+
+  // Strided Views are checkpointed in place when their contiguous runs fill a chunk
+  std::vector<region_t> regions;
+  bool in_place = ViewLayout(view).regions(chunk_size, regions);
+  if((in_place && regions.size() != num_regions) || (!in_place && num_regions != 0)) {
+    std::cout << name << " laid out as " << regions.size() << " regions instead of "
+              << num_regions << std::endl;
+    return -1;
+  }
+
+  Deduplicator deduplicator(chunk_size);
+  std::vector<Kokkos::View<uint8_t*>::HostMirror> incr_chkpts;
+  std::vector<std::string> chkpt_files;
+  std::vector<std::vector<uint8_t>> correct_parents;
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    if(i > 0) {
+      change_region(parent_bytes, parent_len);
+    }
+    Kokkos::deep_copy(parent, parent_h);
+    correct_parents.push_back(std::vector<uint8_t>(parent_bytes, parent_bytes+parent_len));
+
+    Kokkos::View<uint8_t*>::HostMirror diff_h("Diff", 1);
+    deduplicator.checkpoint(view, diff_h, i==0);
+    Kokkos::fence();
+    incr_chkpts.push_back(diff_h);
+    chkpt_files.push_back(std::string("view_chkpt_test.") + std::to_string(i));
+    write_file(chkpt_files[i] + suffix, diff_h);
+    if(i == 1 && 2*diff_h.size() > incr_chkpts[0].size()) {
+      std::cout << name << " incremental checkpoint of " << diff_h.size()
+                << " bytes for a baseline of " << incr_chkpts[0].size() << " bytes" << std::endl;
+      res = -1;
+    }
+  }
+
+  for(uint32_t i=0; i<num_chkpts && res == 0; i++) {
+    for(uint32_t from_files=0; from_files<2 && res == 0; from_files++) {
+      // New parent holding the correct data outside of the subview
+      ParentType restart_parent("Restart parent", parent.extent(0), parent.extent(1));
+      auto restart_h = Kokkos::create_mirror_view(restart_parent);
+      memcpy(restart_h.data(), correct_parents[i].data(), parent_len);
+      Kokkos::deep_copy(restart_parent, restart_h);
+      auto restart_view = make_view(restart_parent);
+      Kokkos::deep_copy(restart_view, static_cast<value_type>(0));
+
+      std::string null("/dev/null/");
+      if(from_files) {
+        deduplicator.restart(restart_view, chkpt_files, null, i);
+      } else {
+        deduplicator.restart(restart_view, incr_chkpts, null, i);
+      }
+      Kokkos::fence();
+      Kokkos::deep_copy(restart_h, restart_parent);
+      std::cout << name << " checkpoint " << i << (from_files ? " from files" : "") << std::endl;
+      res = memcmp(restart_h.data(), correct_parents[i].data(), parent_len);
+      if(res == 0) {
+        std::cout << "Restarted View matches!\n";
+      } else {
+        std::cout << "Restarted View doesn't match!\n";
+      }
+    }
+  }
+  for(uint32_t i=0; i<chkpt_files.size(); i++) {
+    std::remove((chkpt_files[i] + suffix).c_str());
+  }
+  return res;
+}
+
+template<typename Deduplicator>
+int test_views(std::string name, std::string suffix, uint32_t chunk_size, uint32_t num_chkpts) {
+  int res = 0;
+  // Contiguous multi-dimensional View, one region
+  using LeftView = Kokkos::View<double**, Kokkos::LayoutLeft>;
+  res = test_view<Deduplicator>(name + " LayoutLeft", suffix,
+                                LeftView("LayoutLeft", 1024, 128),
+                                [](const LeftView& v) { return v; },
+                                1, chunk_size, num_chkpts);
+
+  // Column range of a LayoutRight View, one region per row of 32 chunks
+  using RightView = Kokkos::View<double**, Kokkos::LayoutRight>;
+  uint64_t cols = 4*static_cast<uint64_t>(chunk_size);
+  if(res == 0)
+    res = test_view<Deduplicator>(name + " LayoutStride", suffix,
+                                  RightView("LayoutRight", 256, cols+24),
+                                  [cols](const RightView& v) {
+                                    return Kokkos::subview(v, Kokkos::ALL(),
+                                                           std::make_pair(static_cast<uint64_t>(8), 8+cols));
+                                  },
+                                  256, chunk_size, num_chkpts);
+
+  // Column of a LayoutRight View, runs of one element are packed
+  using ColumnsView = Kokkos::View<uint32_t**, Kokkos::LayoutRight>;
+  if(res == 0)
+    res = test_view<Deduplicator>(name + " Column", suffix,
+                                  ColumnsView("Columns", 256*1024, 3),
+                                  [](const ColumnsView& v) { return Kokkos::subview(v, Kokkos::ALL(), 1); },
+                                  0, chunk_size, num_chkpts);
+  return res;
+}
+
+int main(int argc, char** argv) {
+  int res = 0;
+  Kokkos::initialize(argc, argv);
+  {
+    STDOUT_PRINT("------------------------------------------------------\n");
+
+    uint32_t chunk_size = static_cast<uint32_t>(atoi(argv[1]));
+    uint32_t num_chkpts = static_cast<uint32_t>(atoi(argv[2]));
+    srand(TEST_SEED);
+
+    res = test_views<ListDeduplicator>("List", ".hashlist.incr_chkpt", chunk_size, num_chkpts);
+    if(res == 0)
+      res = test_views<TreeDeduplicator>("Tree", ".hashtree.incr_chkpt", chunk_size, num_chkpts);
+  }
+  Kokkos::finalize();
+  return res;
+}